@@ -0,0 +1,284 @@
+/*
+ * arena.c -- 文単位のメモリ管理モジュール(アリーナ)
+ *
+ * 1つの文の処理で使うメモリは、すべてこのモジュールが確保した大きな
+ * 領域から先頭から順に切り出して渡す。個々の領域は解放せず、文の
+ * 終わりにendStatementでまとめて解放する(切り出す位置を先頭に戻すだけ)。
+ * 確保した領域は次の文でもそのまま使う。
+ */
+
+#include "microdb.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * ARENA_BLOCK_SIZE -- まとめて確保する領域の大きさ(バイト数)
+ */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/*
+ * ARENA_RETAIN_BYTES -- 文の終わりに解放せずに残しておく領域の合計の上限
+ *
+ * 大きな結果を扱った文のあとで、メモリを抱え込んだままにしないための上限。
+ */
+#define ARENA_RETAIN_BYTES (1024 * 1024)
+
+/*
+ * ARENA_ALIGN -- 切り出す領域の先頭を揃える境界(バイト数)
+ */
+#define ARENA_ALIGN 16
+
+/*
+ * ArenaBlock -- まとめて確保した1つの領域
+ */
+typedef struct ArenaBlock ArenaBlock;
+struct ArenaBlock {
+    ArenaBlock *next;			/* 次の領域 */
+    size_t size;			/* areaの大きさ */
+    char area[] __attribute__((aligned(ARENA_ALIGN)));	/* 切り出す領域 */
+};
+
+/*
+ * firstBlock -- 確保した領域のリストの先頭
+ */
+static ArenaBlock *firstBlock = NULL;
+
+/*
+ * currentBlock -- 切り出し中の領域(firstBlockから順に使う)
+ */
+static ArenaBlock *currentBlock = NULL;
+
+/*
+ * currentUsed -- currentBlockのうち、切り出し済みのバイト数
+ */
+static size_t currentUsed = 0;
+
+/*
+ * numBlock -- 確保した領域の数
+ */
+static int numBlock = 0;
+
+/*
+ * arenaStats -- アリーナの利用状況の統計情報
+ */
+static ArenaStats arenaStats;
+
+/*
+ * newBlock -- 領域をcurrentBlockの次に確保する
+ *
+ * 引数:
+ *	size: 必要なバイト数
+ *
+ * 返り値:
+ *	確保した領域を返す。失敗したらNULLを返す
+ */
+static ArenaBlock *newBlock(size_t size)
+{
+    ArenaBlock *block;
+
+    if (size < ARENA_BLOCK_SIZE) {
+	size = ARENA_BLOCK_SIZE;
+    }
+    if ((block = (ArenaBlock *) malloc(sizeof(ArenaBlock) + size)) == NULL) {
+	return NULL;
+    }
+    block->size = size;
+    if (currentBlock == NULL) {
+	block->next = firstBlock;
+	firstBlock = block;
+    } else {
+	block->next = currentBlock->next;
+	currentBlock->next = block;
+    }
+    numBlock++;
+    arenaStats.blockBytes += size;
+
+    return block;
+}
+
+/*
+ * allocateMemory -- 処理中の文のためのメモリの確保
+ *
+ * 引数:
+ *	size: 確保するバイト数
+ *
+ * 返り値:
+ *	確保した領域(ARENA_ALIGNバイト境界に揃っている)へのポインタを返す。
+ *	失敗したらNULLを返す
+ *
+ * ***注意***
+ *	確保した領域は個別に解放しない。endStatementを呼ぶと、それまでに
+ *	確保した領域はすべて無効になる。
+ */
+void *allocateMemory(size_t size)
+{
+    ArenaBlock *block;
+    void *p;
+
+    size = (size + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+
+    /* 切り出し中の領域に収まらなければ、次の領域に移る */
+    if (currentBlock == NULL || currentUsed + size > currentBlock->size) {
+	block = (currentBlock == NULL) ? firstBlock : currentBlock->next;
+	if (block == NULL || block->size < size) {
+	    /* 前の文で使った領域がない(または小さい)ので、新しく確保する */
+	    if ((block = newBlock(size)) == NULL) {
+		return NULL;
+	    }
+	}
+	currentBlock = block;
+	currentUsed = 0;
+    }
+
+    p = currentBlock->area + currentUsed;
+    currentUsed += size;
+    arenaStats.currentBytes += size;
+
+    return p;
+}
+
+/*
+ * rewindArena -- 切り出す位置を先頭の領域に戻す
+ *
+ * 確保した数によらず一定時間で終わる。領域の合計がARENA_RETAIN_BYTESを
+ * 超えていた場合だけ、超えた分をmallocの管理に返す。
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	なし
+ */
+static void rewindArena()
+{
+    ArenaBlock **p, *block;
+    long kept = 0;
+
+    arenaStats.currentBytes = 0;
+    currentBlock = NULL;
+    currentUsed = 0;
+
+    /* 上限に収まる分だけ先頭から残し、残りの領域を解放する */
+    if (arenaStats.blockBytes > ARENA_RETAIN_BYTES) {
+	p = &firstBlock;
+	while ((block = *p) != NULL) {
+	    if (kept + block->size <= ARENA_RETAIN_BYTES) {
+		kept += block->size;
+		p = &block->next;
+		continue;
+	    }
+	    *p = block->next;
+	    arenaStats.blockBytes -= block->size;
+	    numBlock--;
+	    free(block);
+	}
+    }
+}
+
+/*
+ * beginStatement -- 文の処理の開始
+ *
+ * 文の外で確保された領域があれば、ここで片付ける。
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	なし
+ */
+void beginStatement()
+{
+    rewindArena();
+}
+
+/*
+ * endStatement -- 文の処理の終了(文のために確保したメモリをまとめて解放する)
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	なし
+ */
+void endStatement()
+{
+    /* この文で確保したバイト数(文の中では減らないので、これがピーク)を記録する */
+    arenaStats.statements++;
+    arenaStats.lastPeakBytes = arenaStats.currentBytes;
+    if (arenaStats.currentBytes > arenaStats.maxPeakBytes) {
+	arenaStats.maxPeakBytes = arenaStats.currentBytes;
+    }
+
+    rewindArena();
+}
+
+/*
+ * finalizeArena -- アリーナが確保した領域をすべて解放する
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	なし
+ */
+void finalizeArena()
+{
+    ArenaBlock *block, *next;
+
+    for (block = firstBlock; block != NULL; block = next) {
+	next = block->next;
+	free(block);
+    }
+    firstBlock = NULL;
+    currentBlock = NULL;
+    currentUsed = 0;
+    numBlock = 0;
+    arenaStats.blockBytes = 0;
+    arenaStats.currentBytes = 0;
+}
+
+/*
+ * getArenaStats -- アリーナの利用状況の取得
+ *
+ * 引数:
+ *	stats: 統計情報を書き込む構造体
+ *
+ * 返り値:
+ *	なし
+ */
+void getArenaStats(ArenaStats *stats)
+{
+    *stats = arenaStats;
+}
+
+/*
+ * resetArenaStats -- 文ごとのピークの統計情報のリセット
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	なし
+ */
+void resetArenaStats()
+{
+    arenaStats.statements = 0;
+    arenaStats.lastPeakBytes = 0;
+    arenaStats.maxPeakBytes = 0;
+}
+
+/*
+ * printArenaStats -- アリーナの利用状況の表示
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	なし
+ */
+void printArenaStats()
+{
+    printf("statements: %ld, last peak: %ld bytes, max peak: %ld bytes, reserved: %ld bytes (%d blocks)\n",
+	   arenaStats.statements, arenaStats.lastPeakBytes, arenaStats.maxPeakBytes,
+	   arenaStats.blockBytes, numBlock);
+}
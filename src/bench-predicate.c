@@ -0,0 +1,111 @@
+/*
+ * 条件式の評価モジュールのベンチマークプログラム
+ *
+ * メモリ上に作ったページに対して、integer型の条件の選択ビットマップを
+ * 命令(scalar、sse2、avx2)ごとに作り、1秒あたりに調べたレコード数を表示する。
+ *
+ *	make bench-predicate
+ *	./bench-predicate [ページ数] [繰り返し回数]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "microdb.h"
+
+/*
+ * ベンチマーク名
+ */
+#define BENCH_NAME "bench-predicate"
+
+/*
+ * RECORD_SIZE -- テスト用のレコードの大きさ
+ *
+ * (id integer, name string, age integer)というテーブルと同じ配置にする
+ */
+#define RECORD_SIZE (RECORD_FLAG_SIZE + sizeof(int) + MAX_STRING + sizeof(int))
+
+/*
+ * AGE_OFFSET -- 比べるフィールド(age)のレコード中の位置
+ */
+#define AGE_OFFSET (RECORD_FLAG_SIZE + sizeof(int) + MAX_STRING)
+
+/*
+ * getTime -- 現在の時刻(秒)
+ */
+double getTime()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    static OperatorType operators[] = { OPR_EQUAL, OPR_NOT_EQUAL, OPR_GREATER_THAN, OPR_LESS_THAN };
+    static char *operatorNames[] = { "=", "!=", ">", "<" };
+    unsigned char bitmap[SELECTION_BYTES];
+    Predicate predicate;
+    int numPage, repeat, numSlot, i, j, o, kernel, r;
+    long count;
+    double start, elapsed, rows;
+    char *pages, *p;
+
+    numPage = (argc > 1) ? atoi(argv[1]) : 2560;
+    repeat = (argc > 2) ? atoi(argv[2]) : 20;
+    numSlot = PAGE_SIZE / RECORD_SIZE;
+
+    /* 9割が使用中で、ageが0〜99のページを作る */
+    if ((pages = malloc((size_t) PAGE_SIZE * numPage)) == NULL) {
+	fprintf(stderr, "%s: cannot allocate pages.\n", BENCH_NAME);
+	exit(1);
+    }
+    memset(pages, 0, (size_t) PAGE_SIZE * numPage);
+    srand(1);
+    for (i = 0; i < numPage; i++) {
+	for (j = 0; j < numSlot; j++) {
+	    p = pages + (size_t) PAGE_SIZE * i + RECORD_SIZE * j;
+	    *p = (rand() % 10 != 0);
+	    r = rand() % 100;
+	    memcpy(p + AGE_OFFSET, &r, sizeof(int));
+	}
+    }
+
+    initializePredicateModule();
+    printf("%s: %d pages, %d records per page, %d times\n",
+	   BENCH_NAME, numPage, numSlot, repeat);
+
+    memset(&predicate, 0, sizeof(predicate));
+    predicate.kind = PREDICATE_INTEGER;
+    predicate.offset = AGE_OFFSET;
+    predicate.intValue = 50;
+
+    for (o = 0; o < 4; o++) {
+	predicate.operator = operators[o];
+	for (kernel = PREDICATE_KERNEL_SCALAR; kernel <= PREDICATE_KERNEL_AVX2; kernel++) {
+	    if (setPredicateKernel((PredicateKernel) kernel) != OK) {
+		continue;
+	    }
+
+	    count = 0;
+	    start = getTime();
+	    for (r = 0; r < repeat; r++) {
+		for (i = 0; i < numPage; i++) {
+		    count += filterPage(&predicate, pages + (size_t) PAGE_SIZE * i,
+					RECORD_SIZE, numSlot, bitmap);
+		}
+	    }
+	    elapsed = getTime() - start;
+	    rows = (double) numSlot * numPage * repeat;
+
+	    printf("age %-2s 50  %-6s  %8.1f Mrows/s  (%ld selected)\n",
+		   operatorNames[o], getPredicateKernelName(),
+		   rows / elapsed / 1e6, count / repeat);
+	}
+    }
+
+    free(pages);
+    exit(0);
+}
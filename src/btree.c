@@ -0,0 +1,747 @@
+/*
+ * btree.c -- B+木索引モジュール
+ *
+ * integer型のフィールドの値から、その値を持つレコードの位置(ページ番号と
+ * ページ中のレコードの番号)を引くためのB+木を、データファイルとは別の
+ * ファイル(索引ファイル)に置く。索引ファイルのページはデータファイルと
+ * 同じようにバッファに固定して、ページ上の節を直接読み書きする。
+ *
+ * 索引ファイルの構造(ファイル名: tableName.fieldName.idx)
+ *   ページ0: 管理情報(BtreeMeta)
+ *   ページ1以降: B+木の節(BtreeNode)
+ *
+ * 葉には(値, レコードの位置)の組を昇順に並べ、葉どうしをnextでつなぐ。
+ * 同じ値のレコードが複数あっても、レコードの位置まで含めて比べるので、
+ * 木の中の要素はすべて異なる。削除では要素を取り除くだけで、節の併合は
+ * しない(空になった葉も木に残る)。
+ */
+
+#include "microdb.h"
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+/*
+ * INDEX_FILE_EXT -- 索引ファイルの拡張子
+ */
+#define INDEX_FILE_EXT ".idx"
+
+/*
+ * BTREE_MAGIC -- 索引ファイルの先頭ページに書いておく識別用の値
+ */
+#define BTREE_MAGIC 0x42545245
+
+/*
+ * BTREE_META_PAGE -- 管理情報を置くページの番号
+ */
+#define BTREE_META_PAGE 0
+
+/*
+ * BtreeMeta -- 索引ファイルの管理情報(ページ0)
+ */
+typedef struct BtreeMeta BtreeMeta;
+struct BtreeMeta {
+    int magic;                          /* BTREE_MAGIC */
+    int root;                           /* 根の節のページ番号 */
+    int numPage;                        /* 索引ファイルのページ数(次に使うページ番号) */
+};
+
+/*
+ * BtreeEntry -- 葉に並べる要素(内部節では子を分ける境界に使う)
+ */
+typedef struct BtreeEntry BtreeEntry;
+struct BtreeEntry {
+    int key;                            /* フィールドの値 */
+    RecordId rid;                       /* レコードの位置 */
+};
+
+/*
+ * BTREE_HEADER_SIZE -- 節の先頭の、要素以外の部分の大きさ(バイト数)
+ */
+#define BTREE_HEADER_SIZE (3 * sizeof(int))
+
+/*
+ * BTREE_LEAF_ORDER -- 1つの葉に収まる要素の数
+ */
+#define BTREE_LEAF_ORDER ((int) ((PAGE_SIZE - BTREE_HEADER_SIZE) / sizeof(BtreeEntry)))
+
+/*
+ * BTREE_INNER_ORDER -- 1つの内部節に収まる境界の数(子の数はこれより1つ多い)
+ */
+#define BTREE_INNER_ORDER ((int) ((PAGE_SIZE - BTREE_HEADER_SIZE - sizeof(int)) / \
+                                  (sizeof(BtreeEntry) + sizeof(int))))
+
+/*
+ * BtreeNode -- B+木の節(1ページ)
+ *
+ * 内部節のchild[i]の下には、key[i - 1]以上key[i]未満の要素がある。
+ */
+typedef struct BtreeNode BtreeNode;
+struct BtreeNode {
+    int leaf;                           /* 葉なら1、内部節なら0 */
+    int numEntry;                       /* 葉なら要素の数、内部節なら境界の数 */
+    int next;                           /* 葉の場合、次の葉のページ番号(なければ-1) */
+    union {
+        BtreeEntry entry[BTREE_LEAF_ORDER];	/* 葉の要素 */
+        struct {
+            int child[BTREE_INNER_ORDER + 1];	/* 子のページ番号 */
+            BtreeEntry key[BTREE_INNER_ORDER];	/* 子を分ける境界 */
+        } inner;
+    } u;
+};
+
+_Static_assert(sizeof(BtreeNode) <= PAGE_SIZE, "BtreeNode must fit in a page");
+
+/*
+ * BtreeCursor -- openIndexCursorで開始した索引の範囲の走査の状態
+ */
+struct BtreeCursor {
+    File *file;                         /* 索引ファイル */
+    int high;                           /* 取り出す値の上限 */
+    int pageNum;                        /* 固定中の葉のページ番号 */
+    BtreeNode *node;                    /* 固定中の葉(読み終えたらNULL) */
+    int pos;                            /* 次に返す葉の中の要素の番号 */
+    Result status;                      /* 途中で失敗したらNG */
+};
+
+/*
+ * getIndexFileName -- 索引ファイルの名前を作る
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *	fieldName: 索引を付けたフィールドの名前
+ *
+ * 返り値:
+ *	[tableName].[fieldName].idxという文字列(文のアリーナに確保する)を返す。
+ *	失敗したらNULLを返す
+ */
+static char *getIndexFileName(char *tableName, char *fieldName)
+{
+    char *filename;
+    int len;
+
+    len = strlen(tableName) + 1 + strlen(fieldName) + strlen(INDEX_FILE_EXT) + 1;
+    if ((filename = allocateMemory(len)) == NULL) {
+        return NULL;
+    }
+    snprintf(filename, len, "%s.%s%s", tableName, fieldName, INDEX_FILE_EXT);
+
+    return filename;
+}
+
+/*
+ * compareEntry -- 要素の大小の比較(値、ページ番号、レコードの番号の順に比べる)
+ *
+ * 返り値:
+ *	xが小さければ負、等しければ0、大きければ正を返す
+ */
+static int compareEntry(BtreeEntry *x, BtreeEntry *y)
+{
+    if (x -> key != y -> key) {
+        return (x -> key < y -> key) ? -1 : 1;
+    }
+    if (x -> rid.pageNum != y -> rid.pageNum) {
+        return (x -> rid.pageNum < y -> rid.pageNum) ? -1 : 1;
+    }
+    if (x -> rid.slot != y -> rid.slot) {
+        return (x -> rid.slot < y -> rid.slot) ? -1 : 1;
+    }
+    return 0;
+}
+
+/*
+ * lowerBound -- 昇順に並んだ要素の中で、entry以上の最初の要素の番号を求める
+ *
+ * 返り値:
+ *	そのような要素がなければnumEntryを返す
+ */
+static int lowerBound(BtreeEntry *entries, int numEntry, BtreeEntry *entry)
+{
+    int low = 0, high = numEntry, mid;
+
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (compareEntry(&entries[mid], entry) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/*
+ * childIndex -- 内部節で、entryが入る子の番号を求める(entry以下の境界の数)
+ */
+static int childIndex(BtreeNode *node, BtreeEntry *entry)
+{
+    int low = 0, high = node -> numEntry, mid;
+
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (compareEntry(&node -> u.inner.key[mid], entry) <= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/*
+ * pinMeta -- 索引ファイルの管理情報のページを固定する
+ *
+ * 引数:
+ *	file: 索引ファイル
+ *	meta: 管理情報へのポインタを格納する場所
+ *
+ * 返り値:
+ *	成功ならOK、索引ファイルでなかったり失敗したらNGを返す
+ */
+static Result pinMeta(File *file, BtreeMeta **meta)
+{
+    char *page;
+
+    if (pinPage(file, BTREE_META_PAGE, &page) != OK) {
+        return NG;
+    }
+    *meta = (BtreeMeta *) page;
+    if ((*meta) -> magic != BTREE_MAGIC) {
+        unpinPage(file, BTREE_META_PAGE, UNMODIFIED);
+        return NG;
+    }
+    return OK;
+}
+
+/*
+ * newNode -- 索引ファイルの末尾に空の節を作って固定する
+ *
+ * 引数:
+ *	file: 索引ファイル
+ *	meta: 管理情報(固定中、ページ数を1つ増やす)
+ *	leaf: 葉なら1、内部節なら0
+ *	pageNum: 作った節のページ番号を格納する場所
+ *	node: 作った節へのポインタを格納する場所
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す
+ */
+static Result newNode(File *file, BtreeMeta *meta, int leaf, int *pageNum, BtreeNode **node)
+{
+    char *page;
+
+    if (pinNewPage(file, meta -> numPage, &page) != OK) {
+        return NG;
+    }
+    *pageNum = meta -> numPage++;
+    *node = (BtreeNode *) page;
+    (*node) -> leaf = leaf;
+    (*node) -> numEntry = 0;
+    (*node) -> next = -1;
+
+    return OK;
+}
+
+/*
+ * insertLeaf -- 葉に要素を挿入する(あふれたら葉を2つに分ける)
+ *
+ * 右端の葉の末尾への挿入(値の昇順に挿入する場合)では、葉を半分ずつに
+ * 分けずに新しい要素だけを右の葉に移して、葉を詰めたままにする。
+ *
+ * 引数:
+ *	file: 索引ファイル
+ *	meta: 管理情報(固定中)
+ *	node: 葉(固定中)
+ *	entry: 挿入する要素
+ *	separator: 葉を分けた場合、右の葉の最初の要素を格納する場所
+ *	newPage: 葉を分けた場合は右の葉のページ番号、分けなければ-1を格納する場所
+ *
+ * 返り値:
+ *	成功ならOK、同じ要素がすでにあったり失敗したらNGを返す
+ */
+static Result insertLeaf(File *file, BtreeMeta *meta, BtreeNode *node,
+                         BtreeEntry *entry, BtreeEntry *separator, int *newPage)
+{
+    BtreeEntry entries[BTREE_LEAF_ORDER + 1];
+    BtreeNode *right;
+    int pos, split, total;
+
+    *newPage = -1;
+    pos = lowerBound(node -> u.entry, node -> numEntry, entry);
+    if (pos < node -> numEntry && compareEntry(&node -> u.entry[pos], entry) == 0) {
+        return NG;
+    }
+
+    /* 空きがあれば、後ろの要素をずらして挿入する */
+    if (node -> numEntry < BTREE_LEAF_ORDER) {
+        memmove(&node -> u.entry[pos + 1], &node -> u.entry[pos],
+                sizeof(BtreeEntry) * (node -> numEntry - pos));
+        node -> u.entry[pos] = *entry;
+        node -> numEntry++;
+        return OK;
+    }
+
+    /* あふれたら、挿入した後の並びを左右の葉に分ける */
+    total = BTREE_LEAF_ORDER + 1;
+    memcpy(entries, node -> u.entry, sizeof(BtreeEntry) * pos);
+    entries[pos] = *entry;
+    memcpy(&entries[pos + 1], &node -> u.entry[pos], sizeof(BtreeEntry) * (BTREE_LEAF_ORDER - pos));
+    split = (pos == BTREE_LEAF_ORDER && node -> next == -1) ? BTREE_LEAF_ORDER : total / 2;
+
+    if (newNode(file, meta, 1, newPage, &right) != OK) {
+        *newPage = -1;
+        return NG;
+    }
+    memcpy(node -> u.entry, entries, sizeof(BtreeEntry) * split);
+    node -> numEntry = split;
+    memcpy(right -> u.entry, &entries[split], sizeof(BtreeEntry) * (total - split));
+    right -> numEntry = total - split;
+    right -> next = node -> next;
+    node -> next = *newPage;
+    *separator = right -> u.entry[0];
+    unpinPage(file, *newPage, MODIFIED);
+
+    return OK;
+}
+
+/*
+ * insertInner -- 内部節に、子を分けてできた境界と右の子を挿入する
+ *
+ * 引数:
+ *	file: 索引ファイル
+ *	meta: 管理情報(固定中)
+ *	node: 内部節(固定中)
+ *	pos: 分けた子の番号
+ *	separator: 入力は挿入する境界、内部節を分けた場合は上の節に渡す境界を格納する場所
+ *	newPage: 入力は右の子のページ番号、内部節を分けた場合は右の節のページ番号、
+ *	         分けなければ-1を格納する場所
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す
+ */
+static Result insertInner(File *file, BtreeMeta *meta, BtreeNode *node, int pos,
+                          BtreeEntry *separator, int *newPage)
+{
+    BtreeEntry keys[BTREE_INNER_ORDER + 1];
+    int children[BTREE_INNER_ORDER + 2];
+    BtreeNode *right;
+    int n = node -> numEntry, split, rightPage;
+
+    /* 空きがあれば、境界と子をずらして挿入する */
+    if (n < BTREE_INNER_ORDER) {
+        memmove(&node -> u.inner.key[pos + 1], &node -> u.inner.key[pos], sizeof(BtreeEntry) * (n - pos));
+        memmove(&node -> u.inner.child[pos + 2], &node -> u.inner.child[pos + 1], sizeof(int) * (n - pos));
+        node -> u.inner.key[pos] = *separator;
+        node -> u.inner.child[pos + 1] = *newPage;
+        node -> numEntry++;
+        *newPage = -1;
+        return OK;
+    }
+
+    /* あふれたら、真ん中の境界を上の節に渡して左右の節に分ける */
+    memcpy(keys, node -> u.inner.key, sizeof(BtreeEntry) * pos);
+    keys[pos] = *separator;
+    memcpy(&keys[pos + 1], &node -> u.inner.key[pos], sizeof(BtreeEntry) * (n - pos));
+    memcpy(children, node -> u.inner.child, sizeof(int) * (pos + 1));
+    children[pos + 1] = *newPage;
+    memcpy(&children[pos + 2], &node -> u.inner.child[pos + 1], sizeof(int) * (n - pos));
+    split = (n + 1) / 2;
+
+    if (newNode(file, meta, 0, &rightPage, &right) != OK) {
+        return NG;
+    }
+    memcpy(node -> u.inner.key, keys, sizeof(BtreeEntry) * split);
+    memcpy(node -> u.inner.child, children, sizeof(int) * (split + 1));
+    node -> numEntry = split;
+    memcpy(right -> u.inner.key, &keys[split + 1], sizeof(BtreeEntry) * (n - split));
+    memcpy(right -> u.inner.child, &children[split + 1], sizeof(int) * (n - split + 1));
+    right -> numEntry = n - split;
+    *separator = keys[split];
+    *newPage = rightPage;
+    unpinPage(file, rightPage, MODIFIED);
+
+    return OK;
+}
+
+/*
+ * insertNode -- pageNumの節を根とする部分木に要素を挿入する
+ *
+ * 引数:
+ *	file: 索引ファイル
+ *	meta: 管理情報(固定中)
+ *	pageNum: 部分木の根の節のページ番号
+ *	entry: 挿入する要素
+ *	separator: 節を分けた場合、上の節に渡す境界を格納する場所
+ *	newPage: 節を分けた場合は右の節のページ番号、分けなければ-1を格納する場所
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す
+ */
+static Result insertNode(File *file, BtreeMeta *meta, int pageNum, BtreeEntry *entry,
+                         BtreeEntry *separator, int *newPage)
+{
+    BtreeNode *node;
+    char *page;
+    Result result;
+    int pos;
+
+    *newPage = -1;
+    if (pinPage(file, pageNum, &page) != OK) {
+        return NG;
+    }
+    node = (BtreeNode *) page;
+
+    if (node -> leaf) {
+        result = insertLeaf(file, meta, node, entry, separator, newPage);
+        unpinPage(file, pageNum, (result == OK) ? MODIFIED : UNMODIFIED);
+        return result;
+    }
+
+    /* 子に挿入し、子を分けた場合はこの節に境界と右の子を加える */
+    pos = childIndex(node, entry);
+    if (insertNode(file, meta, node -> u.inner.child[pos], entry, separator, newPage) != OK) {
+        unpinPage(file, pageNum, UNMODIFIED);
+        return NG;
+    }
+    if (*newPage == -1) {
+        unpinPage(file, pageNum, UNMODIFIED);
+        return OK;
+    }
+    result = insertInner(file, meta, node, pos, separator, newPage);
+    unpinPage(file, pageNum, MODIFIED);
+
+    return result;
+}
+
+/*
+ * findLeaf -- entryが入る葉を探して固定する
+ *
+ * 引数:
+ *	file: 索引ファイル
+ *	root: 根の節のページ番号
+ *	entry: 探す要素
+ *	pageNum: 葉のページ番号を格納する場所
+ *	node: 葉へのポインタを格納する場所
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す
+ */
+static Result findLeaf(File *file, int root, BtreeEntry *entry, int *pageNum, BtreeNode **node)
+{
+    char *page;
+    int child;
+
+    *pageNum = root;
+    for (;;) {
+        if (pinPage(file, *pageNum, &page) != OK) {
+            return NG;
+        }
+        *node = (BtreeNode *) page;
+        if ((*node) -> leaf) {
+            return OK;
+        }
+        child = (*node) -> u.inner.child[childIndex(*node, entry)];
+        unpinPage(file, *pageNum, UNMODIFIED);
+        *pageNum = child;
+    }
+}
+
+/*
+ * createIndexFile -- 空の索引ファイルの作成
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *	fieldName: 索引を付けるフィールドの名前
+ *
+ * 返り値:
+ *	作成に成功したらOK、失敗したらNGを返す
+ */
+Result createIndexFile(char *tableName, char *fieldName)
+{
+    char *filename, *page;
+    File *file;
+    BtreeMeta *meta;
+    BtreeNode *root;
+    int rootPage;
+
+    if ((filename = getIndexFileName(tableName, fieldName)) == NULL ||
+        createFile(filename) != OK) {
+        return NG;
+    }
+    if ((file = openFile(filename)) == NULL) {
+        return NG;
+    }
+
+    /* 管理情報と、空の葉1つだけの根を作る */
+    if (pinNewPage(file, BTREE_META_PAGE, &page) != OK) {
+        closeFile(file);
+        return NG;
+    }
+    meta = (BtreeMeta *) page;
+    meta -> magic = BTREE_MAGIC;
+    meta -> numPage = BTREE_META_PAGE + 1;
+    if (newNode(file, meta, 1, &rootPage, &root) != OK) {
+        unpinPage(file, BTREE_META_PAGE, MODIFIED);
+        closeFile(file);
+        return NG;
+    }
+    meta -> root = rootPage;
+    unpinPage(file, rootPage, MODIFIED);
+    unpinPage(file, BTREE_META_PAGE, MODIFIED);
+
+    return closeFile(file);
+}
+
+/*
+ * deleteIndexFile -- 索引ファイルの削除
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *	fieldName: 索引を付けたフィールドの名前
+ *
+ * 返り値:
+ *	削除に成功したらOK、失敗したらNGを返す
+ */
+Result deleteIndexFile(char *tableName, char *fieldName)
+{
+    char *filename;
+
+    if ((filename = getIndexFileName(tableName, fieldName)) == NULL) {
+        return NG;
+    }
+    return deleteFile(filename);
+}
+
+/*
+ * openIndexFile -- 索引ファイルのオープン
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *	fieldName: 索引を付けたフィールドの名前
+ *
+ * 返り値:
+ *	オープンした索引ファイルのFile構造体を返す。失敗したらNULLを返す
+ *	使い終わったらcloseFileで閉じること
+ */
+File *openIndexFile(char *tableName, char *fieldName)
+{
+    char *filename;
+
+    if ((filename = getIndexFileName(tableName, fieldName)) == NULL) {
+        return NULL;
+    }
+    return openFile(filename);
+}
+
+/*
+ * insertIndexEntry -- 索引に(値, レコードの位置)を挿入する
+ *
+ * 引数:
+ *	file: 索引ファイル
+ *	key: フィールドの値
+ *	rid: レコードの位置
+ *
+ * 返り値:
+ *	成功ならOK、同じ要素がすでにあったり失敗したらNGを返す
+ */
+Result insertIndexEntry(File *file, int key, RecordId *rid)
+{
+    BtreeMeta *meta;
+    BtreeNode *root;
+    BtreeEntry entry, separator;
+    int newPage, rootPage, numPage;
+    Result result;
+
+    if (pinMeta(file, &meta) != OK) {
+        return NG;
+    }
+    numPage = meta -> numPage;
+    entry.key = key;
+    entry.rid = *rid;
+
+    /* 根を分けた場合は、新しい根を作って木を1段高くする */
+    result = insertNode(file, meta, meta -> root, &entry, &separator, &newPage);
+    if (result == OK && newPage != -1) {
+        if (newNode(file, meta, 0, &rootPage, &root) != OK) {
+            result = NG;
+        } else {
+            root -> numEntry = 1;
+            root -> u.inner.key[0] = separator;
+            root -> u.inner.child[0] = meta -> root;
+            root -> u.inner.child[1] = newPage;
+            meta -> root = rootPage;
+            unpinPage(file, rootPage, MODIFIED);
+        }
+    }
+
+    unpinPage(file, BTREE_META_PAGE, (meta -> numPage != numPage) ? MODIFIED : UNMODIFIED);
+    return result;
+}
+
+/*
+ * deleteIndexEntry -- 索引から(値, レコードの位置)を取り除く
+ *
+ * 引数:
+ *	file: 索引ファイル
+ *	key: フィールドの値
+ *	rid: レコードの位置
+ *
+ * 返り値:
+ *	成功ならOK、その要素がなかったり失敗したらNGを返す
+ */
+Result deleteIndexEntry(File *file, int key, RecordId *rid)
+{
+    BtreeMeta *meta;
+    BtreeNode *node;
+    BtreeEntry entry;
+    int pageNum, pos;
+
+    if (pinMeta(file, &meta) != OK) {
+        return NG;
+    }
+    entry.key = key;
+    entry.rid = *rid;
+    if (findLeaf(file, meta -> root, &entry, &pageNum, &node) != OK) {
+        unpinPage(file, BTREE_META_PAGE, UNMODIFIED);
+        return NG;
+    }
+    unpinPage(file, BTREE_META_PAGE, UNMODIFIED);
+
+    pos = lowerBound(node -> u.entry, node -> numEntry, &entry);
+    if (pos == node -> numEntry || compareEntry(&node -> u.entry[pos], &entry) != 0) {
+        unpinPage(file, pageNum, UNMODIFIED);
+        return NG;
+    }
+    memmove(&node -> u.entry[pos], &node -> u.entry[pos + 1],
+            sizeof(BtreeEntry) * (node -> numEntry - pos - 1));
+    node -> numEntry--;
+    unpinPage(file, pageNum, MODIFIED);
+
+    return OK;
+}
+
+/*
+ * openIndexCursor -- 値がlow以上high以下の要素の走査の開始
+ *
+ * 要素は値の昇順(同じ値ならレコードの位置の順)にnextIndexEntryで取り出す。
+ * 走査中は読んでいる葉を1つだけ固定しておく。
+ *
+ * 引数:
+ *	file: 索引ファイル
+ *	low: 取り出す値の下限
+ *	high: 取り出す値の上限
+ *
+ * 返り値:
+ *	走査の状態(文のアリーナに確保する)を返す。失敗したらNULLを返す
+ *
+ * ***注意***
+ *	走査を終えたら、葉の固定を解除するため必ずcloseIndexCursorを呼ぶこと。
+ */
+BtreeCursor *openIndexCursor(File *file, int low, int high)
+{
+    BtreeCursor *cursor;
+    BtreeMeta *meta;
+    BtreeEntry entry;
+
+    if ((cursor = (BtreeCursor *) allocateMemory(sizeof(BtreeCursor))) == NULL) {
+        return NULL;
+    }
+    cursor -> file = file;
+    cursor -> high = high;
+    cursor -> node = NULL;
+    cursor -> pos = 0;
+    cursor -> status = OK;
+    if (low > high) {
+        return cursor;
+    }
+
+    /* 値がlowの要素のうち、最も小さいものより前から探す */
+    if (pinMeta(file, &meta) != OK) {
+        return NULL;
+    }
+    entry.key = low;
+    entry.rid.pageNum = INT_MIN;
+    entry.rid.slot = INT_MIN;
+    if (findLeaf(file, meta -> root, &entry, &cursor -> pageNum, &cursor -> node) != OK) {
+        unpinPage(file, BTREE_META_PAGE, UNMODIFIED);
+        return NULL;
+    }
+    unpinPage(file, BTREE_META_PAGE, UNMODIFIED);
+    cursor -> pos = lowerBound(cursor -> node -> u.entry, cursor -> node -> numEntry, &entry);
+
+    return cursor;
+}
+
+/*
+ * nextIndexEntry -- 範囲に入る次の要素の取り出し
+ *
+ * 引数:
+ *	cursor: 走査の状態
+ *	key: 要素の値を格納する場所(NULLなら格納しない)
+ *	rid: 要素のレコードの位置を格納する場所
+ *
+ * 返り値:
+ *	要素を取り出せたらOK、もうなければ(または失敗したら)NGを返す
+ */
+Result nextIndexEntry(BtreeCursor *cursor, int *key, RecordId *rid)
+{
+    BtreeEntry *entry;
+    char *page;
+    int next;
+
+    while (cursor -> node != NULL) {
+        if (cursor -> pos < cursor -> node -> numEntry) {
+            entry = &cursor -> node -> u.entry[cursor -> pos];
+            if (entry -> key > cursor -> high) {
+                break;
+            }
+            cursor -> pos++;
+            if (key != NULL) {
+                *key = entry -> key;
+            }
+            *rid = entry -> rid;
+            return OK;
+        }
+
+        /* 葉を読み終えたら、次の葉に移る */
+        next = cursor -> node -> next;
+        unpinPage(cursor -> file, cursor -> pageNum, UNMODIFIED);
+        cursor -> node = NULL;
+        if (next == -1) {
+            return NG;
+        }
+        if (pinPage(cursor -> file, next, &page) != OK) {
+            cursor -> status = NG;
+            return NG;
+        }
+        cursor -> pageNum = next;
+        cursor -> node = (BtreeNode *) page;
+        cursor -> pos = 0;
+    }
+
+    /* 上限を超えたら、固定している葉を解除して終わる */
+    if (cursor -> node != NULL) {
+        unpinPage(cursor -> file, cursor -> pageNum, UNMODIFIED);
+        cursor -> node = NULL;
+    }
+    return NG;
+}
+
+/*
+ * closeIndexCursor -- 索引の走査の終了
+ *
+ * 引数:
+ *	cursor: 走査の状態
+ *
+ * 返り値:
+ *	走査が成功していればOK、途中で失敗していたらNGを返す
+ *	(索引ファイルは閉じない)
+ */
+Result closeIndexCursor(BtreeCursor *cursor)
+{
+    if (cursor -> node != NULL) {
+        unpinPage(cursor -> file, cursor -> pageNum, UNMODIFIED);
+        cursor -> node = NULL;
+    }
+    return cursor -> status;
+}
@@ -18,6 +18,181 @@
  */
 #define DATA_FILE_EXT ".dat"
 
+/*
+ * CATALOG_BUCKETS -- カタログキャッシュのハッシュ表のバケット数(2のべき乗)
+ */
+#define CATALOG_BUCKETS 64
+
+/*
+ * CatalogEntry -- カタログキャッシュに保持する1つのテーブルのデータ定義情報
+ */
+typedef struct CatalogEntry CatalogEntry;
+struct CatalogEntry {
+    char *tableName;			/* テーブル名 */
+    TableInfo *tableInfo;		/* データ定義情報 */
+    CatalogEntry *next;			/* 同じバケットにある次の要素 */
+};
+
+/*
+ * catalog -- テーブル名からデータ定義情報を引くハッシュ表(カタログキャッシュ)
+ *
+ * データ定義ファイルは、テーブルごとに最初に参照されたときに一度だけ読み込む。
+ * createTable、dropTable、createIndexで、そのテーブルの要素を無効にする。
+ */
+static CatalogEntry *catalog[CATALOG_BUCKETS];
+
+/*
+ * hashTableName -- テーブル名からカタログキャッシュのバケット番号を求める
+ */
+static unsigned int hashTableName(char *tableName)
+{
+    unsigned int h = 0;
+
+    while (*tableName != '\0') {
+	h = h * 31 + (unsigned char) *tableName++;
+    }
+    return h & (CATALOG_BUCKETS - 1);
+}
+
+/*
+ * invalidateCatalog -- カタログキャッシュからテーブルの要素を取り除く
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *
+ * 返り値:
+ *	なし
+ */
+static void invalidateCatalog(char *tableName)
+{
+    CatalogEntry **p, *entry;
+
+    for (p = &catalog[hashTableName(tableName)]; *p != NULL; p = &(*p)->next) {
+	if (strcmp((*p)->tableName, tableName) == 0) {
+	    entry = *p;
+	    *p = entry->next;
+	    free(entry->tableName);
+	    free(entry->tableInfo);
+	    free(entry);
+	    return;
+	}
+    }
+}
+
+/*
+ * setRecordLayout -- レコードの配置の計算
+ *
+ * レコードは先頭の「使用中」フラグに続けて、フィールドを定義順に
+ * 隙間なく並べたものである。各フィールドの位置と大きさ、レコードの
+ * 大きさ、1ページに収まるレコード数をここで一度だけ求めておき、
+ * データ操作モジュールはrecord + offsetで直接フィールドを参照する。
+ *
+ * 引数:
+ *	tableInfo: 配置を計算するデータ定義情報
+ *
+ * 返り値:
+ *	なし
+ */
+void setRecordLayout(TableInfo *tableInfo)
+{
+    int i, offset;
+
+    offset = RECORD_FLAG_SIZE;
+    for (i = 0; i < tableInfo->numField; i++) {
+	switch (tableInfo->fieldInfo[i].dataType) {
+	case TYPE_INTEGER:
+	    tableInfo->fieldInfo[i].width = sizeof(int);
+	    break;
+	case TYPE_STRING:
+	    tableInfo->fieldInfo[i].width = MAX_STRING;
+	    break;
+	default:
+	    tableInfo->fieldInfo[i].width = 0;
+	    break;
+	}
+	tableInfo->fieldInfo[i].offset = offset;
+	offset += tableInfo->fieldInfo[i].width;
+    }
+    tableInfo->recordSize = offset;
+    tableInfo->recordsPerPage = PAGE_SIZE / offset;
+}
+
+/*
+ * loadTableInfo -- データ定義ファイルからデータ定義情報を読み込む
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *
+ * 返り値:
+ *	読み込んだデータ定義情報(mallocした領域)を返す
+ *	エラーの場合には、NULLを返す
+ */
+static TableInfo *loadTableInfo(char *tableName)
+{
+    int i, k, len, numIndex;
+    char *filename;
+    File *file;
+    char page[PAGE_SIZE];
+    char *p;
+    TableInfo *tableInfo;
+
+    /* [tableName].defという文字列を作る */
+    len = strlen(tableName) + strlen(DEF_FILE_EXT) + 1;
+    if ((filename = allocateMemory(len)) == NULL) {
+        return NULL;
+    }
+    snprintf(filename, len, "%s%s", tableName, DEF_FILE_EXT);
+
+    /* [tableName].defをオープンする */
+    if ((file = openFile(filename)) == NULL) {
+        return NULL;
+    }
+
+    /* データ定義情報は先頭のページに収められている */
+    if (readPage(file, 0, page) != OK ||
+        (tableInfo = (TableInfo *) malloc(sizeof(TableInfo))) == NULL) {
+        closeFile(file);
+        return NULL;
+    }
+    p = page;
+
+    /* 配列pageの先頭からフィールド数を読み取る */
+    memcpy(&(tableInfo->numField), p, sizeof(tableInfo->numField));
+    p += sizeof(tableInfo->numField);
+
+    /* それぞれのフィールドについて、フィールド名とデータ型をpageから読み取る */
+    for (i = 0; i < tableInfo->numField; i++) {
+        /* i番目のフィールドの名前の読み取り */
+        memcpy(tableInfo->fieldInfo[i].name, p, sizeof(tableInfo->fieldInfo[i].name));
+        p += sizeof(tableInfo->fieldInfo[i].name);
+
+        /* i番目のフィールドのデータ型の読み取り */
+        memcpy(&(tableInfo->fieldInfo[i].dataType), p, sizeof(tableInfo->fieldInfo[i].dataType));
+        p += sizeof(tableInfo->fieldInfo[i].dataType);
+
+        tableInfo->fieldInfo[i].indexed = 0;
+    }
+
+    /* フィールドの定義に続けて、索引を付けたフィールドの番号を読み取る */
+    memcpy(&numIndex, p, sizeof(numIndex));
+    p += sizeof(numIndex);
+    for (i = 0; i < numIndex; i++) {
+        memcpy(&k, p, sizeof(k));
+        p += sizeof(k);
+        if (k >= 0 && k < tableInfo->numField) {
+            tableInfo->fieldInfo[k].indexed = 1;
+        }
+    }
+
+    /* レコードの配置を計算しておく */
+    setRecordLayout(tableInfo);
+
+    if (closeFile(file) == NG) {
+        free(tableInfo);
+        return NULL;
+    }
+    return tableInfo;
+}
 
 /*
  * initializeDataDefModule -- データ定義モジュールの初期化
@@ -44,6 +219,19 @@ Result initializeDataDefModule()
  */
 Result finalizeDataDefModule()
 {
+    CatalogEntry *entry, *next;
+    int i;
+
+    /* カタログキャッシュを空にする */
+    for (i = 0; i < CATALOG_BUCKETS; i++) {
+	for (entry = catalog[i]; entry != NULL; entry = next) {
+	    next = entry->next;
+	    free(entry->tableName);
+	    free(entry->tableInfo);
+	    free(entry);
+	}
+	catalog[i] = NULL;
+    }
     return OK;
 }
 
@@ -62,12 +250,12 @@ Result finalizeDataDefModule()
  *   |フィールド数       |フィールド名          |データ型           |
  *   |(sizeof(int)バイト)|(MAX_FIELD_NAMEバイト)|(sizeof(int)バイト)|
  *   +-------------------+----------------------+-------------------+----
- * 以降、フィールド名とデータ型が交互に続く。
+ * 以降、フィールド名とデータ型が交互に続く。その後ろに、索引を付けた
+ * フィールドの数と、それぞれのフィールドの番号(sizeof(int)バイトずつ)が
+ * 続く(createTableの時点では索引はないので0)。
  */
 Result createTable(char *tableName, TableInfo *tableInfo)
 {
-	initializeDataDefModule();
-
     int i, len;
     char *filename;
     File *file;
@@ -76,11 +264,14 @@ Result createTable(char *tableName, TableInfo *tableInfo)
 
     /* [tableName].defという文字列を作る */   
     len = strlen(tableName) + strlen(DEF_FILE_EXT) + 1;
-    if ((filename = malloc(len)) == NULL) {
+    if ((filename = allocateMemory(len)) == NULL) {
         return NG;
     }
     snprintf(filename, len, "%s%s", tableName, DEF_FILE_EXT);
 
+    /* 同じ名前のテーブルの古い定義がカタログキャッシュに残らないようにする */
+    invalidateCatalog(tableName);
+
     /* [tableName].defというファイルを作る */
     if (createFile(filename) != OK) {
         return NG;
@@ -125,7 +316,95 @@ Result createTable(char *tableName, TableInfo *tableInfo)
         return NG;
     }
 
-    finalizeDataDefModule();
+    return OK;
+}
+
+/*
+ * createIndex -- 索引の作成
+ *
+ * integer型のフィールドにはB+木索引を、string型のフィールドにはハッシュ索引を
+ * 付ける。すでに挿入されているレコードから索引ファイルを作ったあとで、データ
+ * 定義ファイルに索引を付けたフィールドの番号を書き加える。以降のinsertRecord、
+ * deleteRecordは索引も更新し、検索や削除の条件にこのフィールドの比較
+ * (B+木索引なら=、<、>など、ハッシュ索引なら=)があれば索引を使う。
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *	fieldName: 索引を付けるフィールドの名前
+ *
+ * 返り値:
+ *	成功ならOK、フィールドがない、すでに索引がある、または失敗したらNGを返す
+ */
+Result createIndex(char *tableName, char *fieldName)
+{
+    int i, k, len, numIndex;
+    char *filename;
+    File *file;
+    char page[PAGE_SIZE];
+    char *p;
+    TableInfo *tableInfo;
+    DataType dataType;
+
+    /* 索引を付けるフィールドを探す */
+    if ((tableInfo = getTableInfo(tableName)) == NULL) {
+        return NG;
+    }
+    for (k = 0; k < tableInfo->numField; k++) {
+        if (strcmp(tableInfo->fieldInfo[k].name, fieldName) == 0) {
+            break;
+        }
+    }
+    if (k == tableInfo->numField || tableInfo->fieldInfo[k].indexed) {
+        freeTableInfo(tableInfo);
+        return NG;
+    }
+    dataType = tableInfo->fieldInfo[k].dataType;
+    freeTableInfo(tableInfo);
+
+    /* すでにあるレコードから索引ファイルを作る */
+    if (buildIndex(tableName, fieldName) != OK) {
+        if (dataType == TYPE_INTEGER) {
+            deleteIndexFile(tableName, fieldName);
+        } else {
+            deleteHashFile(tableName, fieldName);
+        }
+        return NG;
+    }
+
+    /* [tableName].defという文字列を作る */
+    len = strlen(tableName) + strlen(DEF_FILE_EXT) + 1;
+    if ((filename = allocateMemory(len)) == NULL) {
+        return NG;
+    }
+    snprintf(filename, len, "%s%s", tableName, DEF_FILE_EXT);
+    if ((file = openFile(filename)) == NULL) {
+        return NG;
+    }
+    if (readPage(file, 0, page) != OK) {
+        closeFile(file);
+        return NG;
+    }
+
+    /* フィールドの定義の後ろにある、索引を付けたフィールドの番号の並びに加える */
+    p = page;
+    memcpy(&i, p, sizeof(i));
+    p += sizeof(i) + i * (MAX_FIELD_NAME + sizeof(DataType));
+    memcpy(&numIndex, p, sizeof(numIndex));
+    memcpy(p + sizeof(numIndex) + numIndex * sizeof(int), &k, sizeof(k));
+    numIndex++;
+    memcpy(p, &numIndex, sizeof(numIndex));
+
+    if (writePage(file, 0, page) != OK) {
+        closeFile(file);
+        return NG;
+    }
+    if (closeFile(file) != OK) {
+        return NG;
+    }
+
+    /* 索引を付けたことがデータ定義情報に反映されるようにする */
+    invalidateCatalog(tableName);
+
     return OK;
 }
 
@@ -140,15 +419,34 @@ Result createTable(char *tableName, TableInfo *tableInfo)
  */
 Result dropTable(char *tableName)
 {
-	initializeDataDefModule();
-    int len;
+    int i, len;
     char *filename;
+    TableInfo *tableInfo;
 
+    /* 索引ファイルを削除する(テーブルの定義を取り除く前に、索引を付けたフィールドを調べる) */
+    if ((tableInfo = getTableInfo(tableName)) != NULL) {
+        for (i = 0; i < tableInfo->numField; i++) {
+            if (!tableInfo->fieldInfo[i].indexed) {
+                continue;
+            }
+            if (tableInfo->fieldInfo[i].dataType == TYPE_INTEGER) {
+                deleteIndexFile(tableName, tableInfo->fieldInfo[i].name);
+            } else {
+                deleteHashFile(tableName, tableInfo->fieldInfo[i].name);
+            }
+        }
+        freeTableInfo(tableInfo);
+    }
+
+    /* 空き領域マップファイルの削除(空き領域マップを使う前に作ったテーブルにはない) */
+    deleteFreeSpaceFile(tableName);
 
+    /* カタログキャッシュからテーブルの定義を取り除く */
+    invalidateCatalog(tableName);
 
      /* [tableName].defという文字列を作る */   
     len = strlen(tableName) + strlen(DEF_FILE_EXT) + 1;
-    if ((filename = malloc(len)) == NULL) {
+    if ((filename = allocateMemory(len)) == NULL) {
         return NG;
     }
     snprintf(filename, len, "%s%s", tableName, DEF_FILE_EXT);
@@ -160,7 +458,7 @@ Result dropTable(char *tableName)
 
      /* [tableName].datという文字列を作る */   
     len = strlen(tableName) + strlen(DATA_FILE_EXT) + 1;
-    if ((filename = malloc(len)) == NULL) {
+    if ((filename = allocateMemory(len)) == NULL) {
         return NG;
     }
 
@@ -171,13 +469,15 @@ Result dropTable(char *tableName)
     }
 
     printf("テーブル%sを削除しました\n",tableName );
-	finalizeDataDefModule();
 	return OK;
 }
 
 /*
  * getTableInfo -- 表のデータ定義情報を取得する関数
  *
+ * データ定義情報はカタログキャッシュから返す。キャッシュになければ
+ * データ定義ファイルから一度だけ読み込んで登録する。
+ *
  * 引数:
  *	tableName: 情報を表示する表の名前
  *
@@ -186,67 +486,42 @@ Result dropTable(char *tableName)
  *	エラーの場合には、NULLを返す
  *
  * ***注意***
- *	この関数が返すデータ定義情報を収めたメモリ領域は、不要になったら
- *	必ずfreeTableInfoで解放すること。
+ *	この関数が返すデータ定義情報はカタログキャッシュと共有しているので、
+ *	書き換えてはならない。createTable、dropTable、createIndexを呼ぶまで有効である。
+ *	使い終わったらfreeTableInfoを呼ぶこと(共有しているので実際には解放しない)。
  */
 TableInfo *getTableInfo(char *tableName)
 {
-	initializeDataDefModule();
-
-    int i, len;
-    char *filename;
-    File *file;
-    char page[PAGE_SIZE];
-    char *p;
+    CatalogEntry *entry;
+    TableInfo *tableInfo;
+    unsigned int h = hashTableName(tableName);
 
-	TableInfo *tableInfo;
-    tableInfo = (TableInfo *)malloc( sizeof(TableInfo));//sizeofで渡すデータ型はポインタで指す先のデータ型    
-	
-    /* [tableName].defという文字列を作る */   
-    len = strlen(tableName) + strlen(DEF_FILE_EXT) + 1;
-    if ((filename = malloc(len)) == NULL) {
-        return NULL;
+    /* カタログキャッシュを探す */
+    for (entry = catalog[h]; entry != NULL; entry = entry->next) {
+	if (strcmp(entry->tableName, tableName) == 0) {
+	    return entry->tableInfo;
+	}
     }
-    snprintf(filename, len, "%s%s", tableName, DEF_FILE_EXT);
-
 
-    /* [tableName].defをオープンする */
-    if ((file = openFile(filename)) == NULL) {
-        return NULL;
+    /* なければデータ定義ファイルから読み込んで登録する */
+    if ((tableInfo = loadTableInfo(tableName)) == NULL) {
+	return NULL;
     }
-
-    /* PAGE_SIZEバイト分だけファイルから読み取ってページ数分だけループ */
-    for (i = 0 ; i < getNumPages(filename) ; i++ ){    
-
-        readPage(file, i, page);
-        p = page;
-
-        /* 配列pageの先頭からフィールド数を読み取る */
-        memcpy( &(tableInfo->numField), p , sizeof(tableInfo->numField));
-        p += sizeof(tableInfo->numField);
-
-        /* それぞれのフィールドについて、フィールド名とデータ型をpageに記録する */
-        for (i = 0; i < tableInfo->numField ; i++) {
-            /* i番目のフィールドの名前の記録 */
-            memcpy(tableInfo->fieldInfo[i].name , p , sizeof(tableInfo->fieldInfo[i].name) );
-            p += sizeof(tableInfo->fieldInfo[i].name);
-
-            /* i番目のフィールドのデータ型の記録 */
-            memcpy(&(tableInfo->fieldInfo[i].dataType), p , sizeof(tableInfo->fieldInfo[i].dataType));
-            p += sizeof(tableInfo->fieldInfo[i].dataType);
-        }
-
+    if ((entry = (CatalogEntry *) malloc(sizeof(CatalogEntry))) == NULL ||
+	(entry->tableName = strdup(tableName)) == NULL) {
+	free(entry);
+	free(tableInfo);
+	return NULL;
     }
+    entry->tableInfo = tableInfo;
+    entry->next = catalog[h];
+    catalog[h] = entry;
 
-    if(closeFile(file) == NG){
-        return NULL;
-    }
-    finalizeDataDefModule();
     return tableInfo;
 }
 
 /*
- * freeTableInfo -- データ定義情報を収めたメモリ領域の解放
+ * freeTableInfo -- データ定義情報の使用の終了
  *
  * 引数:
  *	tableInfo
@@ -255,16 +530,15 @@ TableInfo *getTableInfo(char *tableName)
  *	なし
  *
  * ***注意***
- *	関数getTableInfoが返すデータ定義情報を収めたメモリ領域は、
- *	不要になったら必ずこの関数で解放すること。
+ *	関数getTableInfoが返すデータ定義情報はカタログキャッシュと共有しているので、
+ *	ここでは解放しない。カタログキャッシュの要素は、createTable、dropTable、
+ *	createIndex、finalizeDataDefModuleで解放される。
  */
 void freeTableInfo(TableInfo *tableInfo)
 {
-	initializeDataDefModule();
-    free(tableInfo);
-	finalizeDataDefModule();
-
+    return;
 }
+
 /*
  * printTableInfo -- テーブルのデータ定義情報を表示する(動作確認用)
  *
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 
 /*
  * DATA_FILE_EXT -- データファイルの拡張子
@@ -13,708 +14,2226 @@
 #define DATA_FILE_EXT ".dat"
 
 /*
- * addFlag -- データ追加フラグ
- * このフラグが立っているレコードデータのみ追加する    
+ * SCAN_MODE_ENV -- selectRecordの読み方を指定する環境変数の名前
+ *
+ * "mmap"を指定すると、データファイルをマップして読む。
+ */
+#define SCAN_MODE_ENV "MICRODB_SCAN_MODE"
+
+/*
+ * scanMode -- selectRecordがデータファイルを読む方法
+ */
+static ScanMode scanMode = SCAN_BUFFERED;
+
+/*
+ * DISTINCT_MEMORY_ENV -- 重複除去に使うメモリの上限(バイト数)を指定する環境変数の名前
+ */
+#define DISTINCT_MEMORY_ENV "MICRODB_DISTINCT_MEMORY"
+
+/*
+ * DEFAULT_DISTINCT_MEMORY -- 重複除去に使うメモリの上限の既定値(バイト数)
+ */
+#define DEFAULT_DISTINCT_MEMORY (16 * 1024 * 1024)
+
+/*
+ * DISTINCT_PARTITION_BITS -- 一時ファイルに書き出すときの分割数(2のべき乗)の指数
+ *
+ * 深さlevelの分割では、ハッシュ値のlevel * DISTINCT_PARTITION_BITSビット目から
+ * DISTINCT_PARTITION_BITSビットで分割先を決める。
+ */
+#define DISTINCT_PARTITION_BITS 4
+#define DISTINCT_PARTITIONS (1 << DISTINCT_PARTITION_BITS)
+
+/*
+ * DISTINCT_MAX_LEVEL -- 分割の深さの上限(ハッシュ値のビットを使い切らない範囲)
+ */
+#define DISTINCT_MAX_LEVEL (64 / DISTINCT_PARTITION_BITS - 1)
+
+/*
+ * DISTINCT_MIN_BUCKETS -- 重複除去のハッシュ表のバケット数の初期値
+ */
+#define DISTINCT_MIN_BUCKETS 1024
+
+/*
+ * DISTINCT_CHUNK_SIZE -- 重複除去のハッシュ表の要素をまとめて確保する大きさ
+ */
+#define DISTINCT_CHUNK_SIZE (64 * 1024)
+
+/*
+ * distinctMemory -- 重複除去に使うメモリの上限(バイト数)
+ */
+static long distinctMemory = DEFAULT_DISTINCT_MEMORY;
+
+/*
+ * DistinctEntry -- 重複除去のハッシュ表の要素(返したレコード1つ)
+ */
+typedef struct DistinctEntry DistinctEntry;
+struct DistinctEntry {
+    DistinctEntry *next;		/* 同じバケットの次の要素 */
+    unsigned long hash;			/* レコードのハッシュ値 */
+    char data[];			/* レコードのバイト列 */
+};
+
+/*
+ * DistinctChunk -- 重複除去のハッシュ表の要素をまとめて確保した領域
+ */
+typedef struct DistinctChunk DistinctChunk;
+struct DistinctChunk {
+    DistinctChunk *next;		/* 前に確保した領域 */
+    char area[DISTINCT_CHUNK_SIZE];	/* 要素を並べる領域 */
+};
+
+/*
+ * DistinctPartition -- 一時ファイルに書き出した、処理待ちの分割
+ */
+typedef struct DistinctPartition DistinctPartition;
+struct DistinctPartition {
+    FILE *file;				/* レコードを書き出した一時ファイル */
+    int level;				/* 分割の深さ */
+    DistinctPartition *next;		/* 次に処理する分割 */
+};
+
+/*
+ * DistinctSet -- 重複除去のための、返したレコードの集合
+ *
+ * ハッシュ表で重複を調べるので、レコード数に比例する時間で済む。
+ * ハッシュ表がメモリの上限に達したら表への追加をやめ、表にない
+ * レコードはハッシュ値で分割して一時ファイルに書き出す。テーブルを
+ * 読み終えたら、分割を1つずつ読み込んで同じように重複を除く。
+ * 分割ごとに表を作り直して使い回すので、アリーナではなくmallocで確保する。
+ */
+struct DistinctSet {
+    TableInfo *tableInfo;		/* レコードのデータ定義情報 */
+    DistinctEntry **bucket;		/* ハッシュ表 */
+    int numBucket;			/* バケット数 */
+    int numEntry;			/* 表に入っているレコード数 */
+    DistinctChunk *chunk;		/* 要素を収める領域のリスト */
+    int chunkUsed;			/* 先頭のchunkで使用済みのバイト数 */
+    long memoryUsed;			/* ハッシュ表に使っているバイト数 */
+    int frozen;				/* 上限に達して表に追加しなくなったら1 */
+    int level;				/* 処理中のレコードの分割の深さ */
+    FILE *spill[DISTINCT_PARTITIONS];	/* 書き出し中の分割 */
+    DistinctPartition *pending;		/* 処理待ちの分割 */
+    FILE *input;			/* 読み込み中の分割 */
+    char *buffer;			/* 分割から読み込んだレコード */
+    long numProbed;			/* 重複を調べるときに表の要素と比べた回数 */
+};
+
+/*
+ * DistinctResult -- レコードを重複除去の集合に加えた結果
+ */
+typedef enum {
+    DISTINCT_NEW,			/* 初めてのレコード(返してよい) */
+    DISTINCT_DUPLICATE,			/* すでに返したレコード */
+    DISTINCT_SPILLED,			/* 一時ファイルに書き出した(後で判定する) */
+    DISTINCT_ERROR			/* 失敗した */
+} DistinctResult;
+
+/*
+ * initializeDataManipModule -- データ操作モジュールの初期化
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値;
+ *	成功ならOK、失敗ならNGを返す
+ */
+Result initializeDataManipModule()
+{
+    char *mode;
+
+    char *memory;
+
+    if ((mode = getenv(SCAN_MODE_ENV)) != NULL && strcmp(mode, "mmap") == 0) {
+        scanMode = SCAN_MMAP;
+    }
+    if ((memory = getenv(DISTINCT_MEMORY_ENV)) != NULL && atol(memory) > 0) {
+        distinctMemory = atol(memory);
+    }
+    return initializePredicateModule();
+}
+
+/*
+ * setScanMode -- selectRecordがデータファイルを読む方法の指定
+ *
+ * SCAN_MMAPを指定すると、データファイルを読み取り専用でマップし、
+ * ページをバッファにコピーせずにレコードを直接読む。大きなテーブルを
+ * 走査するときに向いている。
+ *
+ * 引数:
+ *	mode: 読む方法
+ *
+ * 返り値:
+ *	なし
+ */
+void setScanMode(ScanMode mode)
+{
+    scanMode = mode;
+}
+
+/*
+ * setDistinctMemory -- 重複除去に使うメモリの上限の指定
+ *
+ * 重複除去したレコードのハッシュ表がこの大きさを超えると、残りの
+ * レコードは一時ファイルに分割して書き出してから処理する。
+ *
+ * 引数:
+ *	bytes: 上限のバイト数
+ *
+ * 返り値:
+ *	なし
+ */
+void setDistinctMemory(long bytes)
+{
+    distinctMemory = bytes;
+}
+
+/*
+ * finalizeDataManipModule -- データ操作モジュールの終了処理
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値;
+ *	成功ならOK、失敗ならNGを返す
+ */
+Result finalizeDataManipModule()
+{
+    return OK;
+}
+
+/*
+ * getIntField -- レコードのinteger型のフィールドの値を返す
+ *
+ * 引数:
+ *	tableInfo: データ定義情報(レコードの配置)
+ *	record: レコードのバイト列(「使用中」フラグの位置から始まる)
+ *	k: フィールドの番号
+ *
+ * 返り値:
+ *	k番目のフィールドの値
+ */
+int getIntField(TableInfo *tableInfo, char *record, int k)
+{
+    int value;
+
+    memcpy(&value, record + tableInfo -> fieldInfo[k].offset, sizeof(int));
+    return value;
+}
+
+/*
+ * getStringField -- レコードのstring型のフィールドの値を返す
+ *
+ * 引数:
+ *	tableInfo: データ定義情報(レコードの配置)
+ *	record: レコードのバイト列(「使用中」フラグの位置から始まる)
+ *	k: フィールドの番号
+ *
+ * 返り値:
+ *	k番目のフィールドの値を収めた、レコード中の領域へのポインタ
+ *
+ * ***注意***
+ *	値がMAX_STRINGバイトちょうどの場合は、'\0'で終わっていない。
+ */
+char *getStringField(TableInfo *tableInfo, char *record, int k)
+{
+    return record + tableInfo -> fieldInfo[k].offset;
+}
+
+/*
+ * compareRecord -- 渡されたレコードが等しいかどうかを返す
+ *
+ * 引数:
+ *	tableInfo: データ定義情報(レコードの配置)
+ *	x: レコードのバイト列
+ *	y: レコードのバイト列
+ *
+ * 返り値:
+ *	すべてのフィールドの値が等しければOK、そうでなければNGを返す
+ */
+static Result compareRecord(TableInfo *tableInfo, char *x, char *y)
+{
+    int k;
+
+    for (k = 0; k < tableInfo -> numField; k++) {
+        switch (tableInfo -> fieldInfo[k].dataType) {
+        case TYPE_INTEGER:
+            if (getIntField(tableInfo, x, k) != getIntField(tableInfo, y, k)) {
+                return NG;
+            }
+            break;
+        case TYPE_STRING:
+            if (strncmp(getStringField(tableInfo, x, k), getStringField(tableInfo, y, k), MAX_STRING) != 0) {
+                return NG;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return OK;
+}
+
+/*
+ * appendRecord -- レコード集合の末尾にレコードを追加する
+ *
+ * レコードはページ上のバイト列のまま、文のアリーナに詰めて収める。
+ *
+ * 引数:
+ *	recordSet: 追加するレコード集合
+ *	record: ページ上のレコードの先頭
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す
+ */
+static Result appendRecord(RecordSet *recordSet, char *record)
+{
+    Record *r;
+
+    if ((r = (Record *) allocateMemory(offsetof(Record, data) + recordSet -> tableInfo -> recordSize)) == NULL) {
+        return NG;
+    }
+    memcpy(r -> data, record, recordSet -> tableInfo -> recordSize);
+    r -> next = NULL;
+
+    /* 末尾につなぐ */
+    if (recordSet -> tail == NULL) {
+        recordSet -> record = r;
+    } else {
+        recordSet -> tail -> next = r;
+    }
+    recordSet -> tail = r;
+    recordSet -> numRecord++;
+
+    return OK;
+}
+
+/*
+ * closeIndexes -- openIndexesでオープンした索引ファイルを閉じる
+ *
+ * 引数:
+ *	indexFile: フィールドごとの索引ファイル
+ *	numField: 閉じるフィールドの数(先頭から)
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す
+ */
+static Result closeIndexes(File **indexFile, int numField)
+{
+    Result result = OK;
+    int i;
+
+    for (i = 0; i < numField; i++) {
+        if (indexFile[i] != NULL && closeFile(indexFile[i]) != OK) {
+            result = NG;
+        }
+    }
+    return result;
+}
+
+/*
+ * openIndexes -- テーブルに付けた索引の索引ファイルをすべてオープンする
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *	tableInfo: テーブルのデータ定義情報
+ *	indexFile: フィールドごとの索引ファイル(索引がなければNULL)を格納する配列
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す(オープンした索引ファイルは閉じておく)
+ */
+static Result openIndexes(char *tableName, TableInfo *tableInfo, File **indexFile)
+{
+    int i;
+
+    for (i = 0; i < tableInfo -> numField; i++) {
+        indexFile[i] = NULL;
+        if (!tableInfo -> fieldInfo[i].indexed) {
+            continue;
+        }
+        if (tableInfo -> fieldInfo[i].dataType == TYPE_INTEGER) {
+            indexFile[i] = openIndexFile(tableName, tableInfo -> fieldInfo[i].name);
+        } else {
+            indexFile[i] = openHashFile(tableName, tableInfo -> fieldInfo[i].name);
+        }
+        if (indexFile[i] == NULL) {
+            closeIndexes(indexFile, i);
+            return NG;
+        }
+    }
+    return OK;
+}
+
+/*
+ * updateIndexes -- レコードの挿入、削除に合わせて、テーブルのすべての索引を更新する
+ *
+ * 引数:
+ *	tableInfo: テーブルのデータ定義情報
+ *	indexFile: フィールドごとの索引ファイル
+ *	record: 挿入した(削除する)レコードのバイト列
+ *	rid: レコードの位置
+ *	insert: 挿入なら1、削除なら0
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す
+ */
+static Result updateIndexes(TableInfo *tableInfo, File **indexFile, char *record, RecordId *rid, int insert)
+{
+    Result result = OK, r;
+    char *p;
+    int i, key;
+
+    for (i = 0; i < tableInfo -> numField; i++) {
+        if (indexFile[i] == NULL) {
+            continue;
+        }
+        p = record + tableInfo -> fieldInfo[i].offset;
+        if (tableInfo -> fieldInfo[i].dataType == TYPE_INTEGER) {
+            memcpy(&key, p, sizeof(int));
+            r = insert ? insertIndexEntry(indexFile[i], key, rid) : deleteIndexEntry(indexFile[i], key, rid);
+        } else {
+            r = insert ? insertHashEntry(indexFile[i], p, rid) : deleteHashEntry(indexFile[i], p, rid);
+        }
+        if (r != OK) {
+            result = NG;
+        }
+    }
+    return result;
+}
+
+/*
+ * findFreeSlot -- ページ中の未使用のレコードの場所を探す
+ *
+ * 引数:
+ *	tableInfo: データ定義情報
+ *	page: データファイルのページ
+ *	start: 探し始める場所の番号
+ *
+ * 返り値:
+ *	start以降で最初の未使用の場所の番号を返す。なければ-1を返す
+ */
+static int findFreeSlot(TableInfo *tableInfo, char *page, int start)
+{
+    int j;
+
+    for (j = start; j < tableInfo -> recordsPerPage; j++) {
+        if (page[tableInfo -> recordSize * j] == 0) {
+            return j;
+        }
+    }
+    return -1;
+}
+
+/*
+ * openFreeSpaceMap -- テーブルの空き領域マップファイルをオープンする
+ *
+ * 空き領域マップファイルがなければ(空き領域マップを使う前に作ったテーブル)、
+ * データファイルを一度だけ読んで作る。
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *	file: データファイル
+ *	tableInfo: データ定義情報
+ *
+ * 返り値:
+ *	オープンした空き領域マップファイルを返す。失敗したらNULLを返す
+ */
+static File *openFreeSpaceMap(char *tableName, File *file, TableInfo *tableInfo)
+{
+    File *fsm;
+    char *page;
+    int numPage, i, hasFree;
+
+    if ((fsm = openFreeSpaceFile(tableName)) != NULL) {
+        return fsm;
+    }
+
+    if (createFreeSpaceFile(tableName) != OK || (fsm = openFreeSpaceFile(tableName)) == NULL) {
+        return NULL;
+    }
+    numPage = getNumPages(file -> name);
+    for (i = 0; i < numPage; i++) {
+        if (pinPage(file, i, &page) != OK) {
+            closeFile(fsm);
+            deleteFreeSpaceFile(tableName);
+            return NULL;
+        }
+        hasFree = (findFreeSlot(tableInfo, page, 0) != -1);
+        unpinPage(file, i, UNMODIFIED);
+        if (hasFree && setPageFree(fsm, i, 1) != OK) {
+            closeFile(fsm);
+            deleteFreeSpaceFile(tableName);
+            return NULL;
+        }
+    }
+    return fsm;
+}
+
+/*
+ * addIndexEntries -- 挿入するレコードの位置を、すべての索引に加える
+ *
+ * 途中の索引で失敗したら(同じ要素がすでにあった場合など)、それまでに
+ * 加えた要素を取り除いて、どの索引も元のままにする。
+ *
+ * 引数:
+ *	tableInfo: テーブルのデータ定義情報
+ *	indexFile: フィールドごとの索引ファイル
+ *	record: 挿入するレコードのバイト列
+ *	rid: レコードを挿入する位置
+ *
+ * 返り値:
+ *	すべての索引に加えたらOK、失敗したらNGを返す
+ */
+static Result addIndexEntries(TableInfo *tableInfo, File **indexFile, char *record, RecordId *rid)
+{
+    File *one[MAX_FIELD], *added[MAX_FIELD];
+    int i;
+
+    for (i = 0; i < tableInfo -> numField; i++) {
+        one[i] = added[i] = NULL;
+    }
+    for (i = 0; i < tableInfo -> numField; i++) {
+        if (indexFile[i] == NULL) {
+            continue;
+        }
+        one[i] = indexFile[i];
+        if (updateIndexes(tableInfo, one, record, rid, 1) != OK) {
+            updateIndexes(tableInfo, added, record, rid, 0);
+            return NG;
+        }
+        one[i] = NULL;
+        added[i] = indexFile[i];
+    }
+    return OK;
+}
+
+/*
+ * removeIndexEntries -- 削除するレコードの位置を、すべての索引から取り除く
+ *
+ * 途中の索引で失敗したら(要素が見つからなかった場合など)、それまでに
+ * 取り除いた要素を加え直して、どの索引も元のままにする。
+ *
+ * 引数:
+ *	tableInfo: テーブルのデータ定義情報
+ *	indexFile: フィールドごとの索引ファイル
+ *	record: 削除するレコードのバイト列
+ *	rid: レコードの位置
+ *
+ * 返り値:
+ *	すべての索引から取り除いたらOK、失敗したらNGを返す
+ */
+static Result removeIndexEntries(TableInfo *tableInfo, File **indexFile, char *record, RecordId *rid)
+{
+    File *one[MAX_FIELD], *removed[MAX_FIELD];
+    int i;
+
+    for (i = 0; i < tableInfo -> numField; i++) {
+        one[i] = removed[i] = NULL;
+    }
+    for (i = 0; i < tableInfo -> numField; i++) {
+        if (indexFile[i] == NULL) {
+            continue;
+        }
+        one[i] = indexFile[i];
+        if (updateIndexes(tableInfo, one, record, rid, 0) != OK) {
+            updateIndexes(tableInfo, removed, record, rid, 1);
+            return NG;
+        }
+        one[i] = NULL;
+        removed[i] = indexFile[i];
+    }
+    return OK;
+}
+
+/*
+ * makeRecord -- 挿入するレコードのバイト列を作る
+ *
+ * 引数:
+ *	tableInfo: データ定義情報
+ *	recordData: レコードのデータ
+ *	record: バイト列を書き込む場所(recordSizeバイト)
+ *
+ * 返り値:
+ *	成功したらOK、失敗したらNGを返す
+ */
+static Result makeRecord(TableInfo *tableInfo, RecordData *recordData, char *record)
+{
+    int i;
+
+    /* 先頭に、「使用中」を意味するフラグを立てる */
+    memset(record, 1, RECORD_FLAG_SIZE);
+
+    /* 各フィールドの位置にデータを埋め込む */
+    for (i = 0; i < tableInfo -> numField; i++) {
+        char *p = record + tableInfo -> fieldInfo[i].offset;
+
+        switch (tableInfo -> fieldInfo[i].dataType) {
+        case TYPE_INTEGER:
+            memcpy(p, &(recordData -> fieldData[i].intValue), sizeof(int));
+            break;
+        case TYPE_STRING:
+            /* 値の後ろは0で埋めて、同じ値は同じバイト列になるようにする */
+            strncpy(p, recordData -> fieldData[i].stringValue, MAX_STRING);
+            break;
+        default:
+            /* ここにくることはないはず */
+            return NG;
+        }
+    }
+
+    return OK;
+}
+
+/*
+ * insertRecords -- 複数のレコードの一括挿入
+ *
+ * テーブルの情報の取得と、データファイル、空き領域マップファイル、索引ファイルの
+ * オープンは一度だけ行う。レコードは固定したページの空いた場所に順に詰めていき、
+ * ページが満杯になったら次の空きのあるページ(なければ末尾に足したページ)に移る。
+ * 1つのページを固定するのは一度だけなので、書き換えたページはファイルを閉じる
+ * ときなどに一度だけ書き出される。
+ *
+ * 引数:
+ *	tableName: レコードを挿入するテーブルの名前
+ *	recordData: 挿入するレコードのデータの配列
+ *	numRecord: 挿入するレコードの数
+ *	rids: 挿入したレコードの位置を返す配列(numRecord個、不要ならNULL)
+ *
+ * 返り値:
+ *	すべての挿入に成功したらOK、失敗したらNGを返す
+ *	(失敗したレコードより前のレコードは挿入されている。失敗したレコードは
+ *	ページにも索引にも残さない)
+ */
+Result insertRecords(char *tableName, RecordData *recordData, int numRecord, RecordId *rids)
+{
+    TableInfo *tableInfo;
+    int recordSize;
+    int numPage;
+    char *record;
+    char *page = NULL;
+    char *filename;
+    long len;
+    File *file;
+    File *fsm;
+    File *indexFile[MAX_FIELD];
+    RecordId rid;
+    Result result = OK;
+    int current = -1;
+    modifyFlag modified = UNMODIFIED;
+    int i, j = -1, n;
+
+
+    /* テーブルの情報を取得する */
+    if ( (tableInfo = getTableInfo(tableName)) == NULL){
+        /* エラー処理 */
+        return NG;
+    }
+
+    /* 1レコード分のデータをファイルに収めるのに必要なバイト数(計算済み) */
+    recordSize = tableInfo -> recordSize;
+
+    /* 1レコード分のバイト列を作る場所を確保する(レコードごとに使い回す) */
+    if ((record = (char *)allocateMemory(recordSize)) == NULL) {
+        /* エラー処理 */
+        return NG;
+    }
+
+     /* [tableName].datという文字列を作る */   
+    len = strlen(tableName) + strlen(DATA_FILE_EXT) + 1;
+    if ((filename = allocateMemory(len)) == NULL) {
+        return NG;
+    }
+    snprintf(filename, len, "%s%s", tableName, DATA_FILE_EXT);
+
+    /* データファイルをオープンする */
+    if((file = openFile(filename)) == NULL){
+        return NG;
+    }
+
+    /*
+     * データファイルのページ数を調べる(末尾に足したページはまだ書き出して
+     * いないので、以降はここで数える)
+     */
+    numPage = getNumPages(filename);
+
+    /* 空きのあるページは空き領域マップで引く */
+    if ((fsm = openFreeSpaceMap(tableName, file, tableInfo)) == NULL) {
+        closeFile(file);
+        return NG;
+    }
+
+    /* 挿入したレコードの位置を、索引にも加えられるようにする */
+    if (openIndexes(tableName, tableInfo, indexFile) != OK) {
+        closeFile(fsm);
+        closeFile(file);
+        return NG;
+    }
+
+    for (n = 0; n < numRecord && result == OK; n++) {
+        /* 使用中のフラグと各フィールドのデータを埋め込んだバイト列を作る */
+        if (makeRecord(tableInfo, &recordData[n], record) != OK) {
+            result = NG;
+            break;
+        }
+
+        /* 固定中のページの、前に挿入した場所より後ろに空きがあるか */
+        j = (current == -1) ? -1 : findFreeSlot(tableInfo, page, j + 1);
+
+        /* なければ、空き領域マップが示すページか、末尾に足すページに移る */
+        while (j == -1 && result == OK) {
+            if (current != -1) {
+                /* 満杯にしたページは、印を消してから固定を解除する */
+                if (setPageFree(fsm, current, 0) != OK) {
+                    result = NG;
+                }
+                unpinPage(file, current, MODIFIED);
+                current = -1;
+            }
+
+            if ((i = findFreePage(fsm)) == -2) {
+                result = NG;
+            } else if (i >= numPage) {
+                /* データファイルにないページの印は消しておく */
+                setPageFree(fsm, i, 0);
+            } else if (i >= 0) {
+                /* 1ページ分のデータをバッファに固定して、直接参照する */
+                if (pinPage(file, i, &page) != OK) {
+                    result = NG;
+                } else if ((j = findFreeSlot(tableInfo, page, 0)) == -1) {
+                    /* 印が古く、初めから満杯だった */
+                    unpinPage(file, i, UNMODIFIED);
+                    setPageFree(fsm, i, 0);
+                } else {
+                    current = i;
+                    modified = UNMODIFIED;
+                }
+            } else {
+                /* 空きのあるページがなければ、ファイルの最後に新しく空のページを用意する */
+                if (pinNewPage(file, numPage, &page) != OK || setPageFree(fsm, numPage, 1) != OK) {
+                    result = NG;
+                } else {
+                    current = numPage++;
+                    modified = MODIFIED;
+                    j = 0;
+                }
+            }
+        }
+        if (result != OK) {
+            break;
+        }
+
+        rid.pageNum = current;
+        rid.slot = j;
+
+        /*
+         * 索引があれば、先に挿入する位置を加えておく(失敗したら、このレコードは
+         * ページに書かずに終える)
+         */
+        if (addIndexEntries(tableInfo, indexFile, record, &rid) != OK) {
+            result = NG;
+            break;
+        }
+
+        /* 見つけた空き領域に上で用意したバイト列recordを埋め込む */
+        memcpy(page + recordSize * j, record, recordSize);
+        modified = MODIFIED;
+
+        /* レコードの位置は削除されるまで変わらないので、そのまま返せる */
+        if (rids != NULL) {
+            rids[n] = rid;
+        }
+    }
+
+    /* 最後に挿入したページの固定を解除する(満杯になっていれば印を消す) */
+    if (current != -1) {
+        if (findFreeSlot(tableInfo, page, 0) == -1 && setPageFree(fsm, current, 0) != OK) {
+            result = NG;
+        }
+        unpinPage(file, current, modified);
+    }
+
+    if (closeIndexes(indexFile, tableInfo -> numField) != OK) {
+        result = NG;
+    }
+    if (closeFile(fsm) != OK) {
+        result = NG;
+    }
+    if (closeFile(file) != OK) {
+        result = NG;
+    }
+
+    /* 使用済みのtableInfoデータのメモリを解放する */
+    freeTableInfo(tableInfo);
+    return result;
+}
+
+/*
+ * insertRecord -- レコードの挿入
+ *
+ * 引数:
+ *	tableName: レコードを挿入するテーブルの名前
+ *	recordData: 挿入するレコードのデータ
+ *	ridp: 挿入したレコードの位置を返す場所(不要ならNULL)
+ *
+ * 返り値:
+ *	挿入に成功したらOK、失敗したらNGを返す
+ */
+Result insertRecord(char *tableName, RecordData *recordData, RecordId *ridp)
+{
+    return insertRecords(tableName, recordData, 1, ridp);
+}
+
+
+
+/*
+ * newRecordSet -- 空のレコード集合を作る
+ *
+ * 引数:
+ *	tableInfo: レコードのデータ定義情報
+ *
+ * 返り値:
+ *	作成したレコード集合を返す。失敗したらNULLを返す
+ */
+static RecordSet *newRecordSet(TableInfo *tableInfo)
+{
+    RecordSet *recordSet;
+
+    if ((recordSet = (RecordSet *) allocateMemory(sizeof(RecordSet))) == NULL) {
+        return NULL;
+    }
+    recordSet -> numRecord = 0;
+    recordSet -> tableInfo = tableInfo;
+    recordSet -> tail = NULL;
+    recordSet -> record = NULL;
+
+    return recordSet;
+}
+
+/*
+ * hashRecord -- レコードのハッシュ値(FNV-1a)を求める
+ *
+ * compareRecordで等しいレコードが同じハッシュ値になるように、
+ * 文字列型のフィールドは'\0'までを使う。
+ *
+ * 引数:
+ *	tableInfo: データ定義情報(レコードの配置)
+ *	record: レコードのバイト列
+ *
+ * 返り値:
+ *	ハッシュ値
+ */
+static unsigned long hashRecord(TableInfo *tableInfo, char *record)
+{
+    unsigned long h = 14695981039346656037UL;
+    unsigned char *p;
+    int k, len, i;
+
+    for (k = 0; k < tableInfo -> numField; k++) {
+        p = (unsigned char *) record + tableInfo -> fieldInfo[k].offset;
+        if (tableInfo -> fieldInfo[k].dataType == TYPE_STRING) {
+            len = strnlen((char *) p, MAX_STRING);
+        } else {
+            len = tableInfo -> fieldInfo[k].width;
+        }
+        for (i = 0; i < len; i++) {
+            h = (h ^ p[i]) * 1099511628211UL;
+        }
+        /* フィールドの区切り */
+        h = (h ^ 0xff) * 1099511628211UL;
+    }
+    return h;
+}
+
+/*
+ * getDistinctBucket -- レコードのハッシュ値から重複除去のハッシュ表のバケットを決める
+ *
+ * 深さlevelの分割のレコードは、分割に使った下位level * DISTINCT_PARTITION_BITS
+ * ビットがすべて同じなので、それより上のビットでバケットを決める。
+ *
+ * 引数:
+ *	hash: レコードのハッシュ値
+ *	level: 分割の深さ
+ *	numBucket: バケット数(2のべき乗)
+ *
+ * 返り値:
+ *	バケットの番号を返す
+ */
+static int getDistinctBucket(unsigned long hash, int level, int numBucket)
+{
+    return (int) ((hash >> (level * DISTINCT_PARTITION_BITS)) & (numBucket - 1));
+}
+
+/*
+ * resetDistinctTable -- 重複除去のハッシュ表を空にする
+ *
+ * 引数:
+ *	set: 重複除去の集合
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す
+ */
+static Result resetDistinctTable(DistinctSet *set)
+{
+    DistinctChunk *chunk;
+
+    while ((chunk = set -> chunk) != NULL) {
+        set -> chunk = chunk -> next;
+        free(chunk);
+    }
+    set -> chunkUsed = DISTINCT_CHUNK_SIZE;
+
+    free(set -> bucket);
+    set -> numBucket = DISTINCT_MIN_BUCKETS;
+    if ((set -> bucket = (DistinctEntry **) calloc(set -> numBucket, sizeof(DistinctEntry *))) == NULL) {
+        return NG;
+    }
+    set -> numEntry = 0;
+    set -> memoryUsed = sizeof(DistinctEntry *) * set -> numBucket;
+    set -> frozen = 0;
+
+    return OK;
+}
+
+/*
+ * growDistinctTable -- 重複除去のハッシュ表のバケット数を2倍にする
+ *
+ * 引数:
+ *	set: 重複除去の集合
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す
+ */
+static Result growDistinctTable(DistinctSet *set)
+{
+    DistinctEntry **bucket, *entry, *next;
+    int numBucket = set -> numBucket * 2;
+    int i, k;
+
+    if ((bucket = (DistinctEntry **) calloc(numBucket, sizeof(DistinctEntry *))) == NULL) {
+        return NG;
+    }
+    for (i = 0; i < set -> numBucket; i++) {
+        for (entry = set -> bucket[i]; entry != NULL; entry = next) {
+            next = entry -> next;
+            k = getDistinctBucket(entry -> hash, set -> level, numBucket);
+            entry -> next = bucket[k];
+            bucket[k] = entry;
+        }
+    }
+    free(set -> bucket);
+    set -> memoryUsed += sizeof(DistinctEntry *) * (numBucket - set -> numBucket);
+    set -> bucket = bucket;
+    set -> numBucket = numBucket;
+
+    return OK;
+}
+
+/*
+ * newDistinctSet -- 空の重複除去の集合を作る
+ *
+ * 引数:
+ *	tableInfo: レコードのデータ定義情報
+ *
+ * 返り値:
+ *	作成した集合を返す。失敗したらNULLを返す
+ */
+static DistinctSet *newDistinctSet(TableInfo *tableInfo)
+{
+    DistinctSet *set;
+
+    if ((set = (DistinctSet *) calloc(1, sizeof(DistinctSet))) == NULL) {
+        return NULL;
+    }
+    set -> tableInfo = tableInfo;
+    if ((set -> buffer = (char *) malloc(tableInfo -> recordSize)) == NULL ||
+        resetDistinctTable(set) != OK) {
+        free(set -> buffer);
+        free(set);
+        return NULL;
+    }
+
+    return set;
+}
+
+/*
+ * freeDistinctSet -- 重複除去の集合の解放(一時ファイルも閉じる)
+ *
+ * 引数:
+ *	set: 重複除去の集合
+ *
+ * 返り値:
+ *	なし
+ */
+static void freeDistinctSet(DistinctSet *set)
+{
+    DistinctChunk *chunk;
+    DistinctPartition *partition;
+    int i;
+
+    for (i = 0; i < DISTINCT_PARTITIONS; i++) {
+        if (set -> spill[i] != NULL) {
+            fclose(set -> spill[i]);
+        }
+    }
+    while ((partition = set -> pending) != NULL) {
+        set -> pending = partition -> next;
+        fclose(partition -> file);
+        free(partition);
+    }
+    if (set -> input != NULL) {
+        fclose(set -> input);
+    }
+    while ((chunk = set -> chunk) != NULL) {
+        set -> chunk = chunk -> next;
+        free(chunk);
+    }
+    free(set -> bucket);
+    free(set -> buffer);
+    free(set);
+}
+
+/*
+ * addDistinct -- レコードを重複除去の集合に加える
+ *
+ * 引数:
+ *	set: 重複除去の集合
+ *	record: レコードのバイト列
+ *
+ * 返り値:
+ *	初めてのレコードならDISTINCT_NEW、すでにあればDISTINCT_DUPLICATE、
+ *	ハッシュ表が上限に達していて一時ファイルに書き出したらDISTINCT_SPILLED、
+ *	失敗したらDISTINCT_ERRORを返す
+ */
+static DistinctResult addDistinct(DistinctSet *set, char *record)
+{
+    TableInfo *tableInfo = set -> tableInfo;
+    DistinctEntry *entry;
+    DistinctChunk *chunk;
+    unsigned long hash;
+    int size, partition, k;
+
+    /* 同じハッシュ値のレコードと比べる */
+    hash = hashRecord(tableInfo, record);
+    k = getDistinctBucket(hash, set -> level, set -> numBucket);
+    for (entry = set -> bucket[k]; entry != NULL; entry = entry -> next) {
+        set -> numProbed++;
+        if (entry -> hash == hash && compareRecord(tableInfo, entry -> data, record) == OK) {
+            return DISTINCT_DUPLICATE;
+        }
+    }
+
+    size = offsetof(DistinctEntry, data) + tableInfo -> recordSize;
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+    /*
+     * 表に追加するとメモリの上限を超える場合は、以後は表に追加しない
+     * (分割の深さが上限に達していたら、上限を超えても表に追加する)
+     */
+    if (!set -> frozen && set -> chunkUsed + size > DISTINCT_CHUNK_SIZE &&
+        set -> memoryUsed + (long) sizeof(DistinctChunk) > distinctMemory &&
+        set -> level < DISTINCT_MAX_LEVEL) {
+        set -> frozen = 1;
+    }
+
+    /* 表に追加しない場合は、ハッシュ値で分割して一時ファイルに書き出す */
+    if (set -> frozen) {
+        partition = (hash >> (set -> level * DISTINCT_PARTITION_BITS)) & (DISTINCT_PARTITIONS - 1);
+        if (set -> spill[partition] == NULL && (set -> spill[partition] = tmpfile()) == NULL) {
+            return DISTINCT_ERROR;
+        }
+        if (fwrite(record, tableInfo -> recordSize, 1, set -> spill[partition]) != 1) {
+            return DISTINCT_ERROR;
+        }
+        return DISTINCT_SPILLED;
+    }
+
+    /* 要素を収める領域を用意して、表に追加する */
+    if (set -> chunkUsed + size > DISTINCT_CHUNK_SIZE) {
+        if ((chunk = (DistinctChunk *) malloc(sizeof(DistinctChunk))) == NULL) {
+            return DISTINCT_ERROR;
+        }
+        chunk -> next = set -> chunk;
+        set -> chunk = chunk;
+        set -> chunkUsed = 0;
+        set -> memoryUsed += sizeof(DistinctChunk);
+    }
+    entry = (DistinctEntry *) (set -> chunk -> area + set -> chunkUsed);
+    set -> chunkUsed += size;
+    entry -> hash = hash;
+    memcpy(entry -> data, record, tableInfo -> recordSize);
+    entry -> next = set -> bucket[k];
+    set -> bucket[k] = entry;
+
+    /* 要素が増えたらバケット数を増やす */
+    if (++set -> numEntry > set -> numBucket && growDistinctTable(set) != OK) {
+        return DISTINCT_ERROR;
+    }
+
+    return DISTINCT_NEW;
+}
+
+/*
+ * nextDistinctInput -- 次に処理する分割を読み込み始める
+ *
+ * 書き出し中の分割を処理待ちに加え(深さ優先で処理するため先頭に置く)、
+ * 処理待ちの先頭の分割を取り出す。ハッシュ表は分割ごとに作り直す。
+ *
+ * 引数:
+ *	set: 重複除去の集合
+ *
+ * 返り値:
+ *	処理する分割があればOK、なければ(または失敗したら)NGを返す
+ */
+static Result nextDistinctInput(DistinctSet *set)
+{
+    DistinctPartition *partition;
+    int i;
+
+    for (i = 0; i < DISTINCT_PARTITIONS; i++) {
+        if (set -> spill[i] == NULL) {
+            continue;
+        }
+        if ((partition = (DistinctPartition *) malloc(sizeof(DistinctPartition))) == NULL) {
+            return NG;
+        }
+        rewind(set -> spill[i]);
+        partition -> file = set -> spill[i];
+        partition -> level = set -> level + 1;
+        partition -> next = set -> pending;
+        set -> pending = partition;
+        set -> spill[i] = NULL;
+    }
+
+    if ((partition = set -> pending) == NULL) {
+        return NG;
+    }
+    set -> pending = partition -> next;
+    set -> input = partition -> file;
+    set -> level = partition -> level;
+    free(partition);
+
+    return resetDistinctTable(set);
+}
+
+/*
+ * IndexProbe -- 索引で引くレコードの条件(chooseIndexが決める)
+ */
+typedef struct IndexProbe IndexProbe;
+struct IndexProbe {
+    int field;				/* 索引を付けたフィールドの番号 */
+    int low;				/* integer型の場合、値の下限 */
+    int high;				/* integer型の場合、値の上限 */
+    char *key;				/* string型の場合、等しい値 */
+    double selectivity;			/* 比較の絞り込みの強さの見積もり */
+};
+
+/*
+ * getIndexProbe -- 条件式の1つの比較を、索引で引く条件に直す
+ *
+ * integer型のフィールドはB+木索引で値の範囲を、string型のフィールドは
+ * ハッシュ索引で等しい値を引く。
+ *
+ * 引数:
+ *	tableInfo: テーブルのデータ定義情報
+ *	predicate: 変換済みの比較
+ *	probe: 索引で引く条件を格納する場所
+ *
+ * 返り値:
+ *	索引を付けたintegerのフィールドの=、<、>、<=、>=、between、
+ *	またはstring型のフィールドの=ならOK、それ以外(索引で引けない比較)ならNGを返す
+ */
+static Result getIndexProbe(TableInfo *tableInfo, Predicate *predicate, IndexProbe *probe)
+{
+    int k, v = predicate -> intValue;
+    DataType dataType;
+
+    if (predicate -> kind == PREDICATE_INTEGER) {
+        dataType = TYPE_INTEGER;
+    } else if (predicate -> kind == PREDICATE_STRING && predicate -> operator == OPR_EQUAL) {
+        dataType = TYPE_STRING;
+    } else {
+        return NG;
+    }
+    for (k = 0; k < tableInfo -> numField; k++) {
+        if (tableInfo -> fieldInfo[k].offset == predicate -> offset &&
+            tableInfo -> fieldInfo[k].dataType == dataType) {
+            break;
+        }
+    }
+    if (k == tableInfo -> numField || !tableInfo -> fieldInfo[k].indexed) {
+        return NG;
+    }
+
+    probe -> field = k;
+    probe -> selectivity = predicate -> selectivity;
+    if (dataType == TYPE_STRING) {
+        probe -> key = predicate -> stringValue;
+        return OK;
+    }
+
+    /* 範囲が空になる場合は、下限を上限より大きくしておく */
+    probe -> key = NULL;
+    probe -> low = INT_MIN;
+    probe -> high = INT_MAX;
+    switch (predicate -> operator) {
+    case OPR_EQUAL:
+        probe -> low = probe -> high = v;
+        break;
+    case OPR_GREATER_THAN:
+        probe -> low = (v == INT_MAX) ? INT_MAX : v + 1;
+        probe -> high = (v == INT_MAX) ? INT_MIN : INT_MAX;
+        break;
+    case OPR_LESS_THAN:
+        probe -> low = (v == INT_MIN) ? INT_MAX : INT_MIN;
+        probe -> high = (v == INT_MIN) ? INT_MIN : v - 1;
+        break;
+    case OPR_GREATER_EQUAL:
+        probe -> low = v;
+        break;
+    case OPR_LESS_EQUAL:
+        probe -> high = v;
+        break;
+    case OPR_BETWEEN:
+        probe -> low = v;
+        probe -> high = predicate -> intHigh;
+        break;
+    default:
+        return NG;
+    }
+    return OK;
+}
+
+/*
+ * chooseIndex -- 条件式から、レコードを索引で引くかどうかを決める
+ *
+ * 条件式そのもの、またはandの子のうち、索引を付けたフィールドの比較が
+ * あれば索引を使う。andの子が複数あれば、最も絞り込みの強い比較の
+ * フィールドを選び、integer型なら同じフィールドの比較の範囲をすべて重ねる。
+ * 索引で引いたレコードも条件式全体で調べ直すので、残りの比較はそのままでよい。
+ *
+ * 引数:
+ *	tableInfo: テーブルのデータ定義情報
+ *	predicate: 変換済みの条件式
+ *	probe: 索引で引く条件を格納する場所
+ *
+ * 返り値:
+ *	索引を使うならOK、全ページを読むならNGを返す
+ */
+static Result chooseIndex(TableInfo *tableInfo, Predicate *predicate, IndexProbe *probe)
+{
+    IndexProbe child;
+    int i, found = 0;
+
+    if (predicate -> kind != PREDICATE_AND) {
+        return getIndexProbe(tableInfo, predicate, probe);
+    }
+
+    for (i = 0; i < predicate -> numChild; i++) {
+        if (getIndexProbe(tableInfo, &predicate -> child[i], &child) == OK &&
+            (!found || child.selectivity < probe -> selectivity)) {
+            *probe = child;
+            found = 1;
+        }
+    }
+    if (!found || probe -> key != NULL) {
+        return found ? OK : NG;
+    }
+
+    for (i = 0; i < predicate -> numChild; i++) {
+        if (getIndexProbe(tableInfo, &predicate -> child[i], &child) == OK &&
+            child.field == probe -> field) {
+            probe -> low = (child.low > probe -> low) ? child.low : probe -> low;
+            probe -> high = (child.high < probe -> high) ? child.high : probe -> high;
+        }
+    }
+    return OK;
+}
+
+/*
+ * openProbe -- 索引で引くレコードの位置の走査の開始
+ *
+ * 引数:
+ *	indexFile: 引く索引の索引ファイル
+ *	probe: 索引で引く条件
+ *	cursor: B+木索引の走査の状態を格納する場所(string型ならNULLを格納する)
+ *	hashCursor: ハッシュ索引の走査の状態を格納する場所(integer型ならNULLを格納する)
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す
+ */
+static Result openProbe(File *indexFile, IndexProbe *probe, BtreeCursor **cursor, HashCursor **hashCursor)
+{
+    *cursor = NULL;
+    *hashCursor = NULL;
+    if (probe -> key != NULL) {
+        *hashCursor = openHashCursor(indexFile, probe -> key);
+        return (*hashCursor != NULL) ? OK : NG;
+    }
+    *cursor = openIndexCursor(indexFile, probe -> low, probe -> high);
+    return (*cursor != NULL) ? OK : NG;
+}
+
+/*
+ * nextProbe -- 索引で引いた次のレコードの位置の取り出し
+ *
+ * 返り値:
+ *	位置を取り出せたらOK、もうなければ(または失敗したら)NGを返す
+ */
+static Result nextProbe(BtreeCursor *cursor, HashCursor *hashCursor, RecordId *rid)
+{
+    if (cursor != NULL) {
+        return nextIndexEntry(cursor, NULL, rid);
+    }
+    return nextHashEntry(hashCursor, rid);
+}
+
+/*
+ * closeProbe -- 索引で引くレコードの位置の走査の終了
+ *
+ * 返り値:
+ *	走査が成功していればOK、途中で失敗していたらNGを返す
+ */
+static Result closeProbe(BtreeCursor *cursor, HashCursor *hashCursor)
+{
+    Result result = OK;
+
+    if (cursor != NULL && closeIndexCursor(cursor) != OK) {
+        result = NG;
+    }
+    if (hashCursor != NULL && closeHashCursor(hashCursor) != OK) {
+        result = NG;
+    }
+    return result;
+}
+
+/*
+ * nextIndexRecord -- 索引で引いたレコードから条件に合う次のレコードを取り出す
+ *
+ * 索引が返すレコードの位置のページを固定し、レコードが使用中で
+ * 条件式全体を満たすかどうかを調べ直す。続けて同じページの
+ * レコードを返す間はページを固定したままにする。
+ *
+ * 引数:
+ *	scan: 走査の状態
+ *
+ * 返り値:
+ *	レコードのバイト列の先頭を返す。レコードがもうなければ(または
+ *	失敗したら)NULLを返す
+ */
+static char *nextIndexRecord(Scan *scan)
+{
+    TableInfo *tableInfo = scan -> tableInfo;
+    RecordId rid;
+    char *record;
+
+    while (nextProbe(scan -> cursor, scan -> hashCursor, &rid) == OK) {
+        if (rid.pageNum >= scan -> numPage || rid.slot >= tableInfo -> recordsPerPage) {
+            continue;
+        }
+        if (scan -> page == NULL || scan -> pageNum != rid.pageNum) {
+            if (scan -> page != NULL) {
+                unpinPage(scan -> file, scan -> pageNum, UNMODIFIED);
+                scan -> page = NULL;
+            }
+            if (pinPage(scan -> file, rid.pageNum, &scan -> page) != OK) {
+                scan -> page = NULL;
+                scan -> status = NG;
+                return NULL;
+            }
+            scan -> pageNum = rid.pageNum;
+        }
+
+        record = scan -> page + tableInfo -> recordSize * rid.slot;
+        if (*record != 0 && checkPredicate(&scan -> predicate, record) == OK) {
+            return record;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * nextPageRecord -- ページから条件に合う次のレコードを取り出す
+ *
+ * 引数:
+ *	scan: 走査の状態
+ *
+ * 返り値:
+ *	レコードのバイト列の先頭を返す。レコードがもうなければ(または
+ *	失敗したら)NULLを返す
+ */
+static char *nextPageRecord(Scan *scan)
+{
+    TableInfo *tableInfo = scan -> tableInfo;
+    int slot;
+
+    /*索引で引く場合は、索引が返す位置のレコードだけを調べる*/
+    if (scan -> cursor != NULL || scan -> hashCursor != NULL) {
+        return nextIndexRecord(scan);
+    }
+
+    for (;;) {
+        /*次のページを固定する(マップしていればマップした領域を直接参照する)*/
+        if (scan -> page == NULL) {
+            if (scan -> pageNum >= scan -> numPage) {
+                return NULL;
+            }
+            if (scan -> area != NULL) {
+                scan -> page = scan -> area + (size_t) PAGE_SIZE * scan -> pageNum;
+            } else if (pinPage(scan -> file, scan -> pageNum, &scan -> page) != OK) {
+                scan -> page = NULL;
+                scan -> pageNum = scan -> numPage;
+                scan -> status = NG;
+                return NULL;
+            }
+            scan -> slot = 0;
+
+            /*ページ中で使用中かつ条件に合うレコードを、まとめて調べておく*/
+            filterPage(&scan -> predicate, scan -> page, tableInfo -> recordSize,
+                       tableInfo -> recordsPerPage, scan -> selection);
+        }
+
+        /*選択ビットマップで次に選ばれているレコードを返す*/
+        slot = nextSelectedSlot(scan -> selection, scan -> slot, tableInfo -> recordsPerPage);
+        if (slot >= 0) {
+            scan -> slot = slot + 1;
+            return scan -> page + tableInfo -> recordSize * slot;
+        }
+
+        /*ページを読み終えたら固定を解除して、次のページへ進む*/
+        if (scan -> area == NULL) {
+            unpinPage(scan -> file, scan -> pageNum, UNMODIFIED);
+        }
+        scan -> page = NULL;
+        scan -> pageNum++;
+    }
+}
+
+/*
+ * setProjection -- 走査で取り出すフィールド(射影)の設定
+ *
+ * 取り出すフィールドだけを定義順に詰めた配置(resultInfo)を作る。
+ * 条件の評価はページ上のバイト列のまま行い、条件に合ったレコードの
+ * 取り出すフィールドだけをこの配置にコピーする(それ以外のフィールドは
+ * ページからコピーしない)。
+ *
+ * 引数:
+ *	scan: 走査の状態
+ *	condition: 取り出すフィールドの名前(numColumnが0ならすべて)
+ *
+ * 返り値:
+ *	成功ならOK、ないフィールドが指定されていたり失敗したらNGを返す
+ */
+static Result setProjection(Scan *scan, Condition *condition)
+{
+    TableInfo *tableInfo = scan -> tableInfo;
+    TableInfo *resultInfo;
+    int i, k;
+
+    /* 射影しなければ、ページ上のレコードをそのまま返す */
+    scan -> resultInfo = tableInfo;
+    if (condition -> numColumn == 0) {
+        return OK;
+    }
+
+    if ((resultInfo = (TableInfo *) allocateMemory(sizeof(TableInfo))) == NULL) {
+        return NG;
+    }
+    resultInfo -> numField = condition -> numColumn;
+    for (k = 0; k < condition -> numColumn; k++) {
+        for (i = 0; i < tableInfo -> numField; i++) {
+            if (strcmp(tableInfo -> fieldInfo[i].name, condition -> columnNames[k]) == 0) {
+                break;
+            }
+        }
+        if (i == tableInfo -> numField) {
+            return NG;
+        }
+        resultInfo -> fieldInfo[k] = tableInfo -> fieldInfo[i];
+        scan -> projection[k] = i;
+    }
+    setRecordLayout(resultInfo);
+
+    if ((scan -> row = allocateMemory(resultInfo -> recordSize)) == NULL) {
+        return NG;
+    }
+    scan -> row[0] = 1;
+    scan -> resultInfo = resultInfo;
+
+    return OK;
+}
+
+/*
+ * projectRecord -- ページ上のレコードから、取り出すフィールドだけをコピーする
+ *
+ * 引数:
+ *	scan: 走査の状態
+ *	record: ページ上のレコードのバイト列
+ *
+ * 返り値:
+ *	resultInfoの配置に組み立てたレコード(scan->row)を返す
+ */
+static char *projectRecord(Scan *scan, char *record)
+{
+    TableInfo *resultInfo = scan -> resultInfo;
+    FieldInfo *field;
+    int k;
+
+    for (k = 0; k < resultInfo -> numField; k++) {
+        field = &scan -> tableInfo -> fieldInfo[scan -> projection[k]];
+        memcpy(scan -> row + resultInfo -> fieldInfo[k].offset, record + field -> offset, field -> width);
+    }
+    return scan -> row;
+}
+
+/*
+ * openScan -- テーブルの走査の開始
+ *
+ * 条件に合うレコードを、nextRecordで1つずつ取り出せるようにする。
+ * 結果をメモリに溜めないので、テーブルの大きさによらず一定のメモリで
+ * 走査できる(重複除去をする場合は、それまでに返したレコードを覚えておく)。
+ * 条件式に索引を付けたフィールドの比較があれば、全ページを読まずに索引で
+ * 引いたレコードだけを読む(B+木索引の場合、レコードはそのフィールドの値の順に返る)。
+ *
+ * 引数:
+ *	tableName: 走査するテーブルの名前
+ *	condition: 取り出すレコードの条件
+ *
+ * 返り値:
+ *	走査の状態を返す。失敗したらNULLを返す
+ *
+ * ***注意***
+ *	走査を終えたら、ページの固定を解除するため必ずcloseScanを呼ぶこと。
+ *	走査の状態は文のアリーナに確保する。
  */
-typedef enum { NOT_ADD = 0, ADD = 1 } AddFlag;
+Scan *openScan(char *tableName, Condition *condition)
+{
+    Scan *scan;
+    TableInfo *tableInfo;
+    long len;
+    char *filename;
+    IndexProbe probe;
+
+    /*テーブル情報の取得*/
+    if ((tableInfo = getTableInfo(tableName)) == NULL) {
+        return NULL;
+    }
+
+    if ((scan = (Scan *) allocateMemory(sizeof(Scan))) == NULL) {
+        return NULL;
+    }
+    scan -> file = NULL;
+    scan -> tableInfo = tableInfo;
+    scan -> resultInfo = tableInfo;
+    scan -> row = NULL;
+    scan -> area = NULL;
+    scan -> numPage = 0;
+    scan -> pageNum = 0;
+    scan -> slot = 0;
+    scan -> page = NULL;
+    scan -> indexFile = NULL;
+    scan -> cursor = NULL;
+    scan -> hashCursor = NULL;
+    scan -> distinct = NULL;
+    scan -> numSpilled = 0;
+    scan -> numProbed = 0;
+    scan -> status = OK;
+
+    /* 条件式は走査の初めに一度だけ変換しておく */
+    if (compileCondition(tableInfo, condition, &scan -> predicate) != OK) {
+        return NULL;
+    }
+
+    /* 取り出すフィールドの配置を決めておく */
+    if (setProjection(scan, condition) != OK) {
+        return NULL;
+    }
+
+    /* 重複除去をする場合は、返したレコード(取り出すフィールドだけ)を覚えておく集合を用意する */
+    if (condition -> distinct == DISTINCT &&
+        (scan -> distinct = newDistinctSet(scan -> resultInfo)) == NULL) {
+        return NULL;
+    }
+
+    /* [tableName].datという文字列を作る */   
+    len = strlen(tableName) + strlen(DATA_FILE_EXT) + 1;
+    if ((filename = allocateMemory(len)) == NULL) {
+        closeScan(scan);
+        return NULL;
+    }
+    snprintf(filename, len, "%s%s", tableName, DATA_FILE_EXT);
+
+    /*ファイルのオープン*/
+    if ((scan -> file = openFile(filename)) == NULL) {
+        closeScan(scan);
+        return NULL;
+    }
+
+    /*索引を付けたフィールドの比較があれば、索引で引いたレコードだけを読む*/
+    if (chooseIndex(tableInfo, &scan -> predicate, &probe) == OK) {
+        if (probe.key != NULL) {
+            scan -> indexFile = openHashFile(tableName, tableInfo -> fieldInfo[probe.field].name);
+        } else {
+            scan -> indexFile = openIndexFile(tableName, tableInfo -> fieldInfo[probe.field].name);
+        }
+        if (scan -> indexFile == NULL ||
+            openProbe(scan -> indexFile, &probe, &scan -> cursor, &scan -> hashCursor) != OK) {
+            closeScan(scan);
+            return NULL;
+        }
+        scan -> numPage = getNumPages(filename);
+        return scan;
+    }
+
+    /*全ページを順に読むので、共有のバッファを荒らさないようにする*/
+    setFileAccessMode(scan -> file, ACCESS_SEQUENTIAL);
+
+    /*ページ数の取得(マップして読む場合は、マップしたページ数を使う)*/
+    if (scanMode != SCAN_MMAP || mapFile(scan -> file, &scan -> area, &scan -> numPage) != OK) {
+        scan -> area = NULL;
+        scan -> numPage = getNumPages(filename);
+    }
+
+    return scan;
+}
 
 /*
- * initializeDataManipModule -- データ操作モジュールの初期化
+ * nextRecord -- 条件に合う次のレコードの取り出し
+ *
+ * レコードはコピーせず、バッファに固定したページ(マップしていれば
+ * マップした領域)の上のバイト列をそのまま返す。射影する場合は、
+ * 取り出すフィールドだけを詰めたレコードを返す。各フィールドは
+ * scan->resultInfoを渡してgetIntField、getStringFieldで読む。
+ * 重複除去をする場合、メモリの上限を超えて一時ファイルに書き出した
+ * レコードは、テーブルを読み終えてから返す(順序は保たれない)。
  *
  * 引数:
- *	なし
+ *	scan: 走査の状態
  *
- * 返り値;
- *	成功ならOK、失敗ならNGを返す
+ * 返り値:
+ *	レコードのバイト列の先頭を返す。次にnextRecordかcloseScanを
+ *	呼ぶまで有効である。
+ *	レコードがもうなければNULLを返す(失敗した場合はscan->statusがNGになる)
  */
-Result initializeDataManipModule()
+char *nextRecord(Scan *scan)
 {
-    return OK;
+    DistinctSet *set = scan -> distinct;
+    DistinctResult result;
+    char *p;
+
+    for (;;) {
+        if ((p = nextPageRecord(scan)) != NULL) {
+            /* 射影する場合は、条件に合ったレコードの必要なフィールドだけをコピーする */
+            if (scan -> resultInfo != scan -> tableInfo) {
+                p = projectRecord(scan, p);
+            }
+        } else {
+            /* テーブルを読み終えたら、一時ファイルに書き出した分割を1つずつ読む */
+            if (set == NULL || scan -> status != OK) {
+                return NULL;
+            }
+            if (set -> input == NULL && nextDistinctInput(set) != OK) {
+                return NULL;
+            }
+            if (fread(set -> buffer, set -> tableInfo -> recordSize, 1, set -> input) != 1) {
+                /* 分割を読み終えた */
+                if (ferror(set -> input)) {
+                    scan -> status = NG;
+                    return NULL;
+                }
+                fclose(set -> input);
+                set -> input = NULL;
+                continue;
+            }
+            p = set -> buffer;
+        }
+
+        if (set == NULL) {
+            return p;
+        }
+
+        /* 重複除去をする場合、まだ返していないレコードだけを返す */
+        result = addDistinct(set, p);
+        scan -> numProbed = set -> numProbed;
+        switch (result) {
+        case DISTINCT_NEW:
+            return p;
+        case DISTINCT_DUPLICATE:
+            break;
+        case DISTINCT_SPILLED:
+            scan -> numSpilled++;
+            break;
+        default:
+            scan -> status = NG;
+            return NULL;
+        }
+    }
 }
 
 /*
- * finalizeDataManipModule -- データ操作モジュールの終了処理
+ * closeScan -- テーブルの走査の終了
  *
  * 引数:
- *	なし
+ *	scan: 走査の状態
  *
- * 返り値;
+ * 返り値:
  *	成功ならOK、失敗ならNGを返す
  */
-Result finalizeDataManipModule()
+Result closeScan(Scan *scan)
 {
-    return OK;
-}
+    Result result = scan -> status;
 
-/*
- * compareFieldData --渡されたフィールドが等しいかどうかを返す  
- *   
- * 引数；
- *  x：FieldData型のデータ
- *  y：FieldData型のデータ
- *  返り値：
- *  Result 
- */
-static Result compareFieldData(FieldData *x , FieldData *y){
-    if( strcmp(x -> name ,y -> name) != 0 ){
-        return NG;
+    if (scan -> file != NULL) {
+        /*固定したままのページがあれば解除する*/
+        if (scan -> page != NULL && scan -> area == NULL) {
+            unpinPage(scan -> file, scan -> pageNum, UNMODIFIED);
+        }
+        unmapFile(scan -> area, scan -> numPage);
+        if (closeFile(scan -> file) != OK) {
+            result = NG;
+        }
     }
-
-    if( x -> dataType != y -> dataType){
-        return NG;
+    if (closeProbe(scan -> cursor, scan -> hashCursor) != OK) {
+        result = NG;
     }
-
-    if( x -> intValue != y -> intValue){
-        return NG;
+    if (scan -> indexFile != NULL && closeFile(scan -> indexFile) != OK) {
+        result = NG;
     }
-
-    if( strcmp(x -> stringValue , y -> stringValue) != 0) {
-        return NG;
+    if (scan -> distinct != NULL) {
+        freeDistinctSet(scan -> distinct);
     }
-    return OK;
-}
 
+    /* 走査の状態は文のアリーナに確保しているので、文の終わりにまとめて解放される */
+    return result;
+}
 
 /*
- * compareRecordData --渡されたレコードが等しいかどうかを返す  
- *   
- * 引数；
- *  x：RecordData型のデータ
- *  y：RecordData型のデータ
- *  返り値：
- *   Result
+ * selectRecord -- レコードの検索
+ *
+ * openScanで走査し、条件に合うレコードをすべてレコード集合に集める。
+ * 検索結果の各レコードは、ページ上と同じ形式のバイト列のまま収める
+ * (射影する場合は、取り出すフィールドだけを詰めたバイト列を収める)。
+ * フィールド名やデータ型、位置はrecordSet->tableInfoに1つだけ持つ。
+ * 結果を順に処理するだけなら、openScanを直接使う方がメモリを使わない。
+ *
+ * 引数:
+ *	tableName: レコードを検索するテーブルの名前
+ *	condition: 検索するレコードの条件
+ *
+ * 返り値:
+ *	検索に成功したら検索されたレコード(の集合)へのポインタを返し、
+ *	検索に失敗したらNULLを返す。
+ *	検索した結果、該当するレコードが1つもなかった場合も、レコードの
+ *	集合へのポインタを返す。
+ *
+ * ***注意***
+ *	この関数が返すレコードの集合は文のアリーナに確保するので、
+ *	文の終わり(endStatement)までしか使えない。
  */
-static Result compareRecordData(RecordData *x , RecordData *y){
-    
-    if( x -> numField != y -> numField){
-        return NG;
+RecordSet *selectRecord(char *tableName, Condition *condition)
+{
+    RecordSet *recordSet;
+    Scan *scan;
+    char *p;
+
+    if ((scan = openScan(tableName, condition)) == NULL) {
+        return NULL;
+    }
+    if ((recordSet = newRecordSet(scan -> resultInfo)) == NULL) {
+        closeScan(scan);
+        return NULL;
     }
 
-    if( !compareFieldData(x -> fieldData , y -> fieldData)){
-        return NG;
+    /*条件に合ったレコードを、ページ上のバイト列のまま(射影する場合は詰めて)末尾に追加していく*/
+    while ((p = nextRecord(scan)) != NULL) {
+        if (appendRecord(recordSet, p) != OK) {
+            scan -> status = NG;
+            break;
+        }
     }
-    
-    return OK;
+
+    if (closeScan(scan) != OK) {
+        freeRecordSet(recordSet);
+        return NULL;
+    }
+    return recordSet;
 }
 
 
 
+/*
+ * freeRecordSet -- レコード集合の使用の終了
+ *
+ * 引数:
+ *	recordSet: 使い終わったレコード集合
+ *
+ * 返り値:
+ *	なし
+ *
+ * ***注意***
+ *	レコード集合とレコードは文のアリーナに確保しているので、ここでは
+ *	解放しない。文の終わり(endStatement)にまとめて解放される。
+ */
+void freeRecordSet(RecordSet *recordSet)
+{   
+    freeTableInfo(recordSet -> tableInfo);
+}
 
 /*
- * getRecordSize -- 1レコード分の保存に必要なバイト数の計算
+ * deleteIndexedRecord -- 索引で引いたレコードのうち、条件に合うものを削除する
+ *
+ * 索引を走査しながら同じ索引の要素を取り除くことはできないので、
+ * 先に索引で引いたレコードの位置をすべて集めてから削除する。
  *
  * 引数:
- *	tableInfo: データ定義情報を収めた構造体
+ *	file: データファイル
+ *	numPage: データファイルのページ数
+ *	tableInfo: テーブルのデータ定義情報
+ *	predicate: 変換済みの条件式
+ *	indexFile: フィールドごとの索引ファイル
+ *	fsm: 空き領域マップファイル
+ *	probe: 索引で引く条件
  *
  * 返り値:
- *	tableInfoのテーブルに収められた1つのレコードを保存するのに
- *	必要なバイト数
- * 教官からのコメント
- * データレコードが"まとめて"ページにはいるかどうかを確認しているプログラムのため、
- * フィールドとフィールドの間に空きができることはない！！！
- * また、小分けしてフィールドの情報を格納する場合は、ポインタを動かす度に、逐一4096を超えているか
- * 確認する必要がある！！           
+ *	削除に成功したらOK、失敗したらNGを返す
  */
-static int getRecordSize(TableInfo *tableInfo)
+static Result deleteIndexedRecord(File *file, int numPage, TableInfo *tableInfo, Predicate *predicate,
+                                  File **indexFile, File *fsm, IndexProbe *probe)
 {
-    int total = 0;
-    int i;
-    for ( i = 0 ; i < tableInfo -> numField ; i ++) {//フィールド数分だけループする
-        /* i番目のフィールドがINT型かSTRING型か調べる */
+    BtreeCursor *cursor;
+    HashCursor *hashCursor;
+    RecordId rid, *rids = NULL, *p;
+    Result result = OK;
+    int numRid = 0, maxRid = 0, i;
+    char *page, *record;
+
+    /* 索引で引いたレコードの位置を集める(数がわからないので、足りなくなったら倍にする) */
+    if (openProbe(indexFile[probe -> field], probe, &cursor, &hashCursor) != OK) {
+        return NG;
+    }
+    while (nextProbe(cursor, hashCursor, &rid) == OK) {
+        if (numRid == maxRid) {
+            maxRid = (maxRid == 0) ? 64 : maxRid * 2;
+            if ((p = (RecordId *) realloc(rids, sizeof(RecordId) * maxRid)) == NULL) {
+                result = NG;
+                break;
+            }
+            rids = p;
+        }
+        rids[numRid++] = rid;
+    }
+    if (closeProbe(cursor, hashCursor) != OK) {
+        result = NG;
+    }
 
-        /* INT型ならtotalにsizeof(int)を加算 */
-        if( tableInfo -> fieldInfo[i].dataType == TYPE_INTEGER){
-            total += sizeof(int);
+    /* 集めた位置のレコードのうち、使用中で条件を満足するものを削除する */
+    for (i = 0; i < numRid && result == OK; i++) {
+        if (rids[i].pageNum >= numPage || rids[i].slot >= tableInfo -> recordsPerPage) {
+            continue;
+        }
+        if (pinPage(file, rids[i].pageNum, &page) != OK) {
+            result = NG;
+            break;
+        }
+        record = page + tableInfo -> recordSize * rids[i].slot;
+        if (*record == 0 || checkPredicate(predicate, record) != OK) {
+            unpinPage(file, rids[i].pageNum, UNMODIFIED);
+            continue;
+        }
+        /* 索引から取り除けなければ、レコードは残しておく */
+        if (removeIndexEntries(tableInfo, indexFile, record, &rids[i]) != OK) {
+            unpinPage(file, rids[i].pageNum, UNMODIFIED);
+            result = NG;
+            break;
         }
-        /* STRING型ならtotalにMAX_STRINGを加算 */
-        if(tableInfo -> fieldInfo[i].dataType == TYPE_STRING){
-            total += MAX_STRING;
+        *record = 0;
+        unpinPage(file, rids[i].pageNum, MODIFIED);
+        if (setPageFree(fsm, rids[i].pageNum, 1) != OK) {
+            result = NG;
         }
     }
 
-    /* フラグの分の1を足す */
-    total++;
-
-    return total;
+    free(rids);
+    return result;
 }
 
 /*
- * insertRecord -- レコードの挿入
+ * deleteRecord -- レコードの削除
  *
  * 引数:
- *	tableName: レコードを挿入するテーブルの名前
- *	recordData: 挿入するレコードのデータ
+ *	tableName: レコードを削除するテーブルの名前
+ *	condition: 削除するレコードの条件
  *
  * 返り値:
- *	挿入に成功したらOK、失敗したらNGを返す
+ *	削除に成功したらOK、失敗したらNGを返す
  */
-Result insertRecord(char *tableName, RecordData *recordData)
+Result deleteRecord(char *tableName, Condition *condition)
 {
+
+    File *file;
     TableInfo *tableInfo;
-    int recordSize;
     int numPage;
-    char *record;
-    char *p;
-    char page[PAGE_SIZE];
     char *filename;
-    long len;
-    File *file;
+    char *page;
+    int recordSize;
+    int len;
     int i,j;
+    modifyFlag modified;
+    Predicate predicate;
+    unsigned char selection[SELECTION_BYTES];
+    File *indexFile[MAX_FIELD];
+    File *fsm;
+    RecordId rid;
+    Result result = OK;
+    IndexProbe probe;
 
-
-    /* テーブルの情報を取得する */
-    if ( (tableInfo = getTableInfo(tableName)) == NULL){
-        /* エラー処理 */
+    /* [tableName].datという文字列を作る */   
+    len = strlen(tableName) + strlen(DATA_FILE_EXT) + 1;
+    if ((filename = allocateMemory(len)) == NULL) {
         return NG;
     }
+    snprintf(filename, len, "%s%s", tableName, DATA_FILE_EXT);
 
-    /* 1レコード分のデータをファイルに収めるのに必要なバイト数を計算する */
-    recordSize = getRecordSize(tableInfo);
-
-    /* 必要なバイト数分のメモリを確保する */
-    if ((record = (char *)malloc(recordSize)) == NULL) {
-        /* エラー処理 */
+    /*ファイルのオープン*/
+    if( (file = openFile(filename))== NULL){
         return NG;
     }
-   
-    p = record;
 
-    /* 先頭に、「使用中」を意味するフラグを立てる */
-    memset(p, 1, 1);
-    p += 1;
-
-    /* 確保したメモリ領域に、フィールド数分だけ、順次データを埋め込む */
-    for (i = 0; i < tableInfo->numField; i++) {
-    	switch (tableInfo->fieldInfo[i].dataType) {
-    	case TYPE_INTEGER:
-            memcpy(p, &(recordData-> fieldData[i].intValue) , sizeof(int));
-    	    p += sizeof(int);
-    	    break;
-    	case TYPE_STRING:
-    	    memcpy(p, &(recordData-> fieldData[i].stringValue) , MAX_STRING);
-    	    p += MAX_STRING;
-    	    break;
-    	default:
-    	    /* ここにくることはないはず */
-                freeTableInfo(tableInfo);
-                free(record);
-    	    return NG;
-    	}
-    }
+    /*ページ数の取得*/
+    numPage = getNumPages(filename);
 
+    /*テーブル情報の取得*/
+    if ((tableInfo = getTableInfo(tableName)) == NULL) {
+        closeFile(file);
+        return NG;
+    }
 
-    /* 使用済みのtableInfoデータのメモリを解放する */
-    freeTableInfo(tableInfo);
+    /*レコードサイズの取得*/
+    recordSize = tableInfo -> recordSize;
 
-    /*
-     * ここまでで、挿入するレコードの情報を埋め込んだバイト列recordができあがる
-     */
-    
-     /* [tableName].datという文字列を作る */   
-    len = strlen(tableName) + strlen(DATA_FILE_EXT) + 1;
-    if ((filename = malloc(len)) == NULL) {
+    /* 条件式は初めに一度だけ変換しておく */
+    if (compileCondition(tableInfo, condition, &predicate) != OK) {
+        closeFile(file);
         return NG;
     }
-    snprintf(filename, len, "%s%s", tableName, DATA_FILE_EXT);
 
-    /* データファイルをオープンする */
-    if((file = openFile(filename)) == NULL){
+    /* 削除するレコードの位置を、索引からも取り除けるようにする */
+    if (openIndexes(tableName, tableInfo, indexFile) != OK) {
+        closeFile(file);
         return NG;
     }
 
-    /* データファイルのページ数を調べる */
-    numPage = getNumPages(filename);
+    /* レコードを削除したページは、空き領域マップに空きありと記録する */
+    if ((fsm = openFreeSpaceMap(tableName, file, tableInfo)) == NULL) {
+        closeIndexes(indexFile, tableInfo -> numField);
+        closeFile(file);
+        return NG;
+    }
 
+    /* 索引を付けたフィールドの比較があれば、索引で引いたレコードだけを調べる */
+    if (chooseIndex(tableInfo, &predicate, &probe) == OK) {
+        result = deleteIndexedRecord(file, numPage, tableInfo, &predicate, indexFile, fsm, &probe);
+        if (closeIndexes(indexFile, tableInfo -> numField) != OK) {
+            result = NG;
+        }
+        if (closeFile(fsm) != OK) {
+            result = NG;
+        }
+        freeTableInfo(tableInfo);
+        if (closeFile(file) != OK) {
+            return NG;
+        }
+        return result;
+    }
 
-    /* PAGE_SIZEバイト分の大きさを持つ配列pageを初期化する */
-    memset(page, 0, PAGE_SIZE);
-    
+    /*全ページを順に読むので、共有のバッファを荒らさないようにする*/
+    setFileAccessMode(file, ACCESS_SEQUENTIAL);
 
-    /* レコードを挿入できる場所を探す */
+    /* レコードを1つずつ取りだし、条件を満足するかどうかチェックする */
     for ( i = 0; i < numPage; i++) {
-        /* 1ページ分のデータを読み込む */
-        if (readPage(file, i, page) != OK) {
-            free(record);
-	    return NG;
-	   }
-        /* pageの先頭からrecordSizeバイトずつ飛びながら、先頭のフラグが「0」(未使用)の場所を探す */
-        for ( j = 0; j < (PAGE_SIZE / recordSize); j++) {
-    	    char *q;
-            q = page; 
-    	    q = q + recordSize*j;
-    	    if (*q == 0) {
-        		/* 見つけた空き領域に上で用意したバイト列recordを埋め込む */
-        		memcpy(q, record , recordSize);
-
-        		/* ファイルに書き戻す */
-        		if (writePage(file, i, page) != OK) {
-                            free(record);
-        		    return NG;
-        		}
-        		closeFile(file);
-                        free(record);
-        		return OK;
-	       }
-	    }
-    }
+        /* 1ページ分のデータをバッファに固定して、直接参照する */
+        if (pinPage(file, i, &page) != OK) {
+            /* エラー処理 */
+            closeIndexes(indexFile, tableInfo -> numField);
+            closeFile(fsm);
+            closeFile(file);
+	  return NG;
+        }
+        modified = UNMODIFIED;
+        /* ページ中で使用中かつ条件を満足するレコードを、まとめて調べる */
+        if (filterPage(&predicate, page, recordSize, tableInfo -> recordsPerPage, selection) > 0) {
+            /* 条件を満足したレコードを削除する(使用フラグを0に書き換えていく) */
+            for (j = nextSelectedSlot(selection, 0, tableInfo -> recordsPerPage); j >= 0;
+                 j = nextSelectedSlot(selection, j + 1, tableInfo -> recordsPerPage)) {
+                rid.pageNum = i;
+                rid.slot = j;
+                /* 索引から取り除けなければ、レコードは残しておく */
+                if (removeIndexEntries(tableInfo, indexFile, page + recordSize * j, &rid) != OK) {
+                    result = NG;
+                    continue;
+                }
+                page[recordSize * j] = 0;
+                modified = MODIFIED;
+            }
+            if (modified == MODIFIED && setPageFree(fsm, i, 1) != OK) {
+                result = NG;
+            }
+        }
 
-    /*
-     * ファイルの最後まで探しても未使用の場所が見つからなかったら
-     * ファイルの最後に新しく空のページを用意し、そこに書き込む
-     */
-    /*からページの作成*/
-    char Epage[PAGE_SIZE];
-    memset(Epage , 0 , PAGE_SIZE);
-    /*空ページの書き込み*/
-    if(writePage(file , numPage, Epage) != OK){
-        return NG;
+        /* ページの固定を解除する(削除したレコードがあれば変更ありとする) */
+        unpinPage(file, i, modified);
     }
-    /*numPageが0のとき（初めてデータを書き込むとき）のみの処理(要改善)*/
-    if(numPage == 0){
-        char *q;
-        q = page;
-        /*レコードを書き込む*/
-        memcpy(q, record , recordSize);
+    if (closeIndexes(indexFile, tableInfo -> numField) != OK) {
+        result = NG;
     }
-
-    /* ファイルに書き戻す */
-    if (writePage(file, numPage , page) != OK) {
-                free(record);
+    if (closeFile(fsm) != OK) {
+        result = NG;
+    }
+    freeTableInfo(tableInfo);
+     if((closeFile(file)) != OK){
         return NG;
     }
-    closeFile(file);
-    free(record);
-    return OK;
+    //  printf("テーブルを削除しました");
+    return result;
 }
 
-
-
 /*
- * checkCondition -- レコードが条件を満足するかどうかのチェック
+ * openDataFile -- テーブルのデータファイルをオープンする
  *
  * 引数:
- *	recordData: チェックするレコード
- *	condition: チェックする条件
+ *	tableName: テーブルの名前
  *
  * 返り値:
- *	レコードrecordが条件conditionを満足すればOK、満足しなければNGを返す
+ *	オープンしたファイルを返す。失敗したらNULLを返す
  */
-static Result checkCondition(RecordData *recordData, Condition *condition)
+static File *openDataFile(char *tableName)
 {
-  int i;
-    /*条件式が存在せず、全てのレコード表示の場合*/
-    if(condition -> allmach == 1 ){
-        return OK;
-    }
-
-     /* 条件conditionに指定されているフィールド名をrecordから探す */
-    for ( i = 0; i < recordData->numField ; i++) {
-        /* フィールド名が同じかどうかチェック */
-        if (strcmp(recordData -> fieldData[i].name, condition->name) == 0) {
-
-            /* 比較演算子を満足するかどうかのチェック */ 
-            if( recordData -> fieldData[i].dataType == TYPE_STRING)
-            {
-                switch( condition -> operator){
-                case OPR_EQUAL :
-		  //	  printf("データ:%s\n", recordData->fieldData[i].stringValue);
-		  // printf("比較：%s\n",condition -> stringValue);
-                        if( strcmp(recordData -> fieldData[i].stringValue, condition -> stringValue) == 0  ){
-
-                        }else{
-                            return NG;
-                        }
-                    break;
-                case OPR_NOT_EQUAL : 
-                    if( strcmp(recordData -> fieldData[i].stringValue, condition -> stringValue) != 0){
-
-                    }else{
-                        return NG;
-                    }
-                    break;  /* != */
-                case OPR_GREATER_THAN : /* > */
-                    return NG;
-                case OPR_LESS_THAN :/* < */     
-                    return NG;
-                default  : 
-                    return NG;
-                }
-            }
+    char *filename;
+    int len;
 
-            if( recordData -> fieldData[i].dataType == TYPE_INTEGER)
-            {
-                switch( condition -> operator){
-                case OPR_EQUAL : 
-
-                 if( recordData -> fieldData[i].intValue == condition -> intValue){
-
-                    }else{
-                        return NG;
-                    }
-                    break;       /* = */                   
-                case OPR_NOT_EQUAL : 
-                 if( recordData -> fieldData[i].intValue != condition -> intValue){
-
-                    }else{
-                        return NG;
-                    }
-
-                    break;  /* != */
-                case OPR_GREATER_THAN :
-                   
-                 if( recordData -> fieldData[i].intValue > condition -> intValue){
-                    
-                    }else{
-                        return NG;
-                    }
-                    break;       /* > */
-                case OPR_LESS_THAN   :
-                 if( recordData -> fieldData[i].intValue < condition -> intValue){
-
-                    }else{
-                        return NG;
-                    }
-                    break;  /* < */     
-                    default  : 
-                    return NG;
-                }
-            }
-            if(recordData -> fieldData[i].dataType == TYPE_UNKNOWN){
-                return NG;
-            }
-        }
+    /* [tableName].datという文字列を作る */
+    len = strlen(tableName) + strlen(DATA_FILE_EXT) + 1;
+    if ((filename = allocateMemory(len)) == NULL) {
+        return NULL;
     }
-    return OK;
+    snprintf(filename, len, "%s%s", tableName, DATA_FILE_EXT);
+
+    return openFile(filename);
 }
 
 /*
- * selectRecord -- レコードの検索
+ * pinRecord -- レコードの位置のページを固定する
+ *
+ * 位置が範囲外か、レコードが使用中でなければページは固定しない。
  *
  * 引数:
- *	tableName: レコードを検索するテーブルの名前
- *	condition: 検索するレコードの条件
+ *	file: データファイル
+ *	tableInfo: データ定義情報
+ *	rid: レコードの位置
+ *	record: 固定したページ上のレコードの場所を返す
  *
  * 返り値:
- *	検索に成功したら検索されたレコード(の集合)へのポインタを返し、
- *	検索に失敗したらNULLを返す。
- *	検索した結果、該当するレコードが1つもなかった場合も、レコードの
- *	集合へのポインタを返す。
- *
- * ***注意***
- *	この関数が返すレコードの集合を収めたメモリ領域は、不要になったら
- *	必ずfreeRecordSetで解放すること。
+ *	使用中のレコードのページを固定したらOK、そうでなければNGを返す
  */
-RecordSet *selectRecord(char *tableName, Condition *condition)
+static Result pinRecord(File *file, TableInfo *tableInfo, RecordId *rid, char **record)
 {
-     RecordSet *recordSet; 
-     RecordData *recordData; 
-     File *file;
-     TableInfo *tableInfo;
-     long len;
-     char *filename;
-     int numPage;
-     char page[PAGE_SIZE];
-     int recordSize;
-     int i,j,k;
-     /*レコードセットの初期化 */
-     if ((recordSet = (RecordSet *) malloc(sizeof(RecordSet))) == NULL) 
-     {
-                    /* エラー処理 */
-        return NULL;
-     }
-     recordSet -> numRecord = 0;
-     recordSet -> tail = NULL;
-     recordSet -> recordData = NULL;
+    char *page;
 
-    /* [tableName].datという文字列を作る */   
-    len = strlen(tableName) + strlen(DATA_FILE_EXT) + 1;
-    if ((filename = malloc(len)) == NULL) {
-        return NULL;
+    if (rid -> pageNum < 0 || rid -> pageNum >= getNumPages(file -> name) ||
+        rid -> slot < 0 || rid -> slot >= tableInfo -> recordsPerPage) {
+        return NG;
     }
-    snprintf(filename, len, "%s%s", tableName, DATA_FILE_EXT);
-
-    /*ファイルのオープン*/
-    if( (file = openFile(filename))== NULL){
-        return NULL;
+    if (pinPage(file, rid -> pageNum, &page) != OK) {
+        return NG;
+    }
+    *record = page + tableInfo -> recordSize * rid -> slot;
+    if (**record == 0) {
+        unpinPage(file, rid -> pageNum, UNMODIFIED);
+        return NG;
     }
 
+    return OK;
+}
 
+/*
+ * fetchRecord -- レコードの位置を指定して、1件のレコードを読む
+ *
+ * 引数:
+ *	tableName: テーブルの名前
+ *	rid: 読むレコードの位置(insertRecordが返したもの)
+ *
+ * 返り値:
+ *	レコードのバイト列(recordSizeバイト、アリーナ上)を返す。
+ *	位置が範囲外か、レコードが削除されていればNULLを返す
+ */
+char *fetchRecord(char *tableName, RecordId *rid)
+{
+    TableInfo *tableInfo;
+    File *file;
+    char *record, *copy = NULL;
 
-    /*ページ数の取得*/
-    numPage = getNumPages(filename);
-
-
-    /*テーブル情報の取得*/
-    tableInfo = getTableInfo(tableName);
-
-    /*レコードサイズの取得*/
-    recordSize = getRecordSize(tableInfo);
-
-    
-    /* データが挿入されていない時はそのままrecordSetを返す */
-    if ( numPage == 0){
-
+    if ((tableInfo = getTableInfo(tableName)) == NULL) {
+        return NULL;
+    }
+    if ((file = openDataFile(tableName)) == NULL) {
         freeTableInfo(tableInfo);
-        if((closeFile(file)) != OK){
-            return NULL;
-        }
-    return recordSet;
-
+        return NULL;
     }
 
-    /*ページ数の数だけループする*/
-    for( i = 0 ; i  < numPage ; i ++ ){
-
-        
-        /*1ページ分読み込む*/
-        if (readPage(file, i, page) != OK) {
-            /* エラー処理 */
-            return NULL;
-        }
-
-        /*pageの戦闘からrecord_sizeバイトずつ切り取って処理する*/
-        
-        for (  j = 0 ; j < (PAGE_SIZE/recordSize) ; j++ ){
-            char *p;
-            p = page + recordSize * j; 
-            
-            /*先頭のポインタが１だったら（使用中だったら）レコードを読みこむ */
-            if (*p == 1){
-                /*メモリが使用中かどうかのフラグの数だけポインタを進める*/
-                p++;
-                /* RecordData構造体のためのメモリを確保する */
-                if ((recordData = (RecordData *) malloc(sizeof(RecordData))) == NULL) {
-                    /* エラー処理 */
-                }
-                
-                /*１レコード分のデータを、RecordData構造体に入れる*/
-                recordData -> numField = tableInfo -> numField;
-                recordData -> next = NULL;
-                
-                /* フィールド数分だけループして、データ型ごとに読み込んで構造体を作る*/
-                for( k = 0 ; k  < (tableInfo -> numField) ; k++){
-                    /*フィールド情報*/
-                    strcpy(recordData -> fieldData[k].name ,tableInfo -> fieldInfo[k].name);
-                    recordData -> fieldData[k].dataType = tableInfo -> fieldInfo[k].dataType;
-                    switch (tableInfo->fieldInfo[k].dataType) {
-                    case TYPE_INTEGER:
-                        memcpy(&(recordData -> fieldData[k].intValue) , p , sizeof(int));
-                        p += sizeof(int);
-                        break;
-                    case TYPE_STRING:
-                        memcpy(&(recordData -> fieldData[k].stringValue) ,p , MAX_STRING);
-                        p += MAX_STRING;
-                        break;
-                    default:
-                        /* ここにくることはないはず */
-                            freeTableInfo(tableInfo);
-                            free(recordData);
-                        return NULL;
-                    }
-                }
-                
-                /*条件に合ったレコードを挿入する*/
-                if( checkCondition(recordData , condition) == OK){
-		  RecordData *r;
-		  r = recordSet -> recordData;
-		  /* 基本は追加用のフラッグを立てておく */
-		  AddFlag  addFlag = ADD;
-		  
-		  /*レコードセットにまだ一つもレコードがない場合*/
-		  if( r == NULL)
-          {
-		      recordSet -> recordData = recordData;
-		      recordSet -> tail = recordData;                        
-		      /* レコードの数を追加 */
-		      recordSet -> numRecord++;
-		      continue;
-            }
-            /* 重複削除宣言がされていた場合 */
-            if(condition->distinct == DISTINCT)
-            {
-              /*レコードセットの中を一つずつ見ていく*/
-              while( r -> next != NULL)
-              {
-                /* RecordDataとまったく同じレコードがすでに RecordSetの線形リストにあったら、そのRecordDataは追加しない */
-                if (compareRecordData(r , recordData) == OK)
-                {
-                  /* 追加しないようフラッグを立てる */
-                  addFlag = NOT_ADD;
-                  break;
-                }
-                r = r -> next;
-              }  
-            }
-    		  		  
-		  /* レコードを追加する必要がないため、処理を抜ける */
-		  if(addFlag == NOT_ADD){
-		    continue;
-		  }
-		  if(addFlag == ADD){
-		    /* 末尾にデータを追加 */ 
-		    recordSet -> tail -> next = recordData;
-		    /* 追加したデータを末尾に登録 */
-		    recordSet -> tail = recordData;       
-		    /* レコードの数を増やす */
-            recordSet -> numRecord++;
-		  }
-                }
-            }
+    /* ページの固定を解除した後も使えるように、アリーナにコピーして返す */
+    if (pinRecord(file, tableInfo, rid, &record) == OK) {
+        if ((copy = allocateMemory(tableInfo -> recordSize)) != NULL) {
+            memcpy(copy, record, tableInfo -> recordSize);
         }
+        unpinPage(file, rid -> pageNum, UNMODIFIED);
     }
-    
+
     freeTableInfo(tableInfo);
-    if((closeFile(file)) != OK){
+    if (closeFile(file) != OK) {
         return NULL;
     }
-    return recordSet;
+    return copy;
 }
 
-
-
-
 /*
- * freeRecordSet -- レコード集合の情報を収めたメモリ領域の解放
+ * deleteRecordByRid -- レコードの位置を指定して、1件のレコードを削除する
  *
  * 引数:
- *	recordSet: 解放するメモリ領域
+ *	tableName: テーブルの名前
+ *	rid: 削除するレコードの位置
  *
  * 返り値:
- *	なし
- *
- * ***注意***
- *	関数selectRecordが返すレコードの集合を収めたメモリ領域は、
- *	不要になったら必ずこの関数で解放すること。
+ *	削除に成功したらOK、位置が範囲外かレコードが使用中でなければNGを返す
  */
-void freeRecordSet(RecordSet *recordSet)
-{   
-    RecordData *p;
-    p = recordSet -> recordData;
-    
-    while(p != NULL){
+Result deleteRecordByRid(char *tableName, RecordId *rid)
+{
+    TableInfo *tableInfo;
+    File *file;
+    File *indexFile[MAX_FIELD];
+    File *fsm;
+    char *record;
+    Result result;
+
+    if ((tableInfo = getTableInfo(tableName)) == NULL) {
+        return NG;
+    }
+    if ((file = openDataFile(tableName)) == NULL) {
+        freeTableInfo(tableInfo);
+        return NG;
+    }
+    if (openIndexes(tableName, tableInfo, indexFile) != OK) {
+        freeTableInfo(tableInfo);
+        closeFile(file);
+        return NG;
+    }
+    if ((fsm = openFreeSpaceMap(tableName, file, tableInfo)) == NULL) {
+        closeIndexes(indexFile, tableInfo -> numField);
+        freeTableInfo(tableInfo);
+        closeFile(file);
+        return NG;
+    }
 
-        p = p -> next;
-        free(recordSet -> recordData);
-        recordSet -> recordData = p;
+    if ((result = pinRecord(file, tableInfo, rid, &record)) == OK) {
+        /* 索引から取り除いてから、使用フラグを0にする(取り除けなければ残しておく) */
+        if (removeIndexEntries(tableInfo, indexFile, record, rid) != OK) {
+            unpinPage(file, rid -> pageNum, UNMODIFIED);
+            result = NG;
+        } else {
+            *record = 0;
+            unpinPage(file, rid -> pageNum, MODIFIED);
+            if (setPageFree(fsm, rid -> pageNum, 1) != OK) {
+                result = NG;
+            }
+        }
+    }
 
+    if (closeIndexes(indexFile, tableInfo -> numField) != OK) {
+        result = NG;
     }
-    free(recordSet);
+    if (closeFile(fsm) != OK) {
+        result = NG;
+    }
+    freeTableInfo(tableInfo);
+    if (closeFile(file) != OK) {
+        return NG;
+    }
+    return result;
 }
 
 /*
- * deleteRecord -- レコードの削除
+ * updateRecordByRid -- レコードの位置を指定して、1件のレコードを書き換える
+ *
+ * レコードはその場で書き換えるので、位置は変わらない。
+ * 索引は、値が変わったフィールドのものだけを更新する。
  *
  * 引数:
- *	tableName: レコードを削除するテーブルの名前
- *	condition: 削除するレコードの条件
+ *	tableName: テーブルの名前
+ *	rid: 書き換えるレコードの位置
+ *	recordData: 新しいレコードのデータ
  *
  * 返り値:
- *	削除に成功したらOK、失敗したらNGを返す
+ *	更新に成功したらOK、位置が範囲外かレコードが使用中でなければNGを返す
  */
-Result deleteRecord(char *tableName, Condition *condition)
+Result updateRecordByRid(char *tableName, RecordId *rid, RecordData *recordData)
 {
-
-    File *file;
     TableInfo *tableInfo;
-    int numPage;
-    char *filename;
-    char page[PAGE_SIZE];
-    int recordSize;
-    int len;
-    int i,j,k;
+    File *file;
+    File *indexFile[MAX_FIELD];
+    File *changed[MAX_FIELD];
+    char *record, *newRecord;
+    Result result;
+    int i;
 
-    /* [tableName].datという文字列を作る */   
-    len = strlen(tableName) + strlen(DATA_FILE_EXT) + 1;
-    if ((filename = malloc(len)) == NULL) {
+    if ((tableInfo = getTableInfo(tableName)) == NULL) {
         return NG;
     }
-    snprintf(filename, len, "%s%s", tableName, DATA_FILE_EXT);
-
-    /*ファイルのオープン*/
-    if( (file = openFile(filename))== NULL){
+    if ((newRecord = allocateMemory(tableInfo -> recordSize)) == NULL ||
+        makeRecord(tableInfo, recordData, newRecord) != OK) {
+        freeTableInfo(tableInfo);
+        return NG;
+    }
+    if ((file = openDataFile(tableName)) == NULL) {
+        freeTableInfo(tableInfo);
+        return NG;
+    }
+    if (openIndexes(tableName, tableInfo, indexFile) != OK) {
+        freeTableInfo(tableInfo);
+        closeFile(file);
         return NG;
     }
 
-    /*ページ数の取得*/
-    numPage = getNumPages(filename);
-
-    /*テーブル情報の取得*/
-    tableInfo = getTableInfo(tableName);
-
-    /*レコードサイズの取得*/
-    recordSize = getRecordSize(tableInfo);
-
-
-    /* レコードを1つずつ取りだし、条件を満足するかどうかチェックする */
-    for ( i = 0; i < numPage; i++) {
-        /* 1ページ分のデータを読み込む */
-        if (readPage(file, i, page) != OK) {
-            /* エラー処理 */
-	  return NG;
-        }
-        /* pageの先頭からrecord_sizeバイトずつ切り取って処理する */
-        for ( j = 0; j < (PAGE_SIZE / recordSize); j++) {
-            RecordData *recordData;
-                char *p;
-
-            /* 先頭の「使用中」のフラグが0だったら読み飛ばす */
-            p = &page[recordSize * j];
-            if (*p == 0) {
-                continue;
-            }
+    if ((result = pinRecord(file, tableInfo, rid, &record)) == OK) {
+        /* 値が変わるフィールドの索引だけ、新しい値を加えてから古い値を取り除く */
+        for (i = 0; i < tableInfo -> numField; i++) {
+            FieldInfo *field = &tableInfo -> fieldInfo[i];
 
-            /* RecordData構造体のためのメモリを確保する */
-            if ((recordData = (RecordData *) malloc(sizeof(RecordData))) == NULL) {
-                /* エラー処理 */
-	      return NG;
-            }
-            /* フラグの分だけポインタを進める */
-            p++;
-             /*１レコード分のデータを、RecordData構造体に入れる*/
-	    recordData -> numField = tableInfo -> numField;
-	    recordData -> next = NULL;
-            for ( k = 0; k < tableInfo->numField; k++) {
-                /* TableInfo構造体からRecordData構造体にフィールド名とデータ型の情報をコピーする */
-                /*フィールド情報*/
-                    strcpy(recordData -> fieldData[k].name ,tableInfo -> fieldInfo[k].name);
-                    recordData -> fieldData[k].dataType = tableInfo -> fieldInfo[k].dataType;
-                /* フィールド値の読み取り */
-                switch (recordData->fieldData[k].dataType) {
-                case TYPE_INTEGER:
-                    memcpy(&(recordData -> fieldData[k].intValue ), p , sizeof(int));
-                    p += sizeof(int);
-                    break;
-                case TYPE_STRING:
-                    memcpy(&(recordData -> fieldData[k].stringValue) ,p , MAX_STRING);
-                    p += MAX_STRING;
-                    break;
-                default:
-                    /* ここに来ることはないはず */
-                    freeTableInfo(tableInfo);
-                    free(recordData);
-                    return NG;
-                }
-            }
-            /* 条件を満足するかどうか調べる */
-            if (checkCondition(recordData, condition) == OK) {
-            /* 条件を満足したので、そのレコードを削除する(使用フラグを0に書き換えていく) */
-                page[recordSize * j] = 0;
+            changed[i] = NULL;
+            if (indexFile[i] != NULL &&
+                memcmp(record + field -> offset, newRecord + field -> offset, field -> width) != 0) {
+                changed[i] = indexFile[i];
             }
-                /* 削除処理が終ったら不要なRecordData構造体のメモリを解放する */
-                free(recordData);
         }
-
-        /* ページの内容をファイルに書き戻す */
-        if (writePage(file, i, page) != OK) {
-            /* エラー処理 */
-            return NG;
+        /* 新しい値を加えられなければ、ページも索引も元のままにする */
+        if (addIndexEntries(tableInfo, changed, newRecord, rid) != OK) {
+            unpinPage(file, rid -> pageNum, UNMODIFIED);
+            result = NG;
+        } else if (removeIndexEntries(tableInfo, changed, record, rid) != OK) {
+            updateIndexes(tableInfo, changed, newRecord, rid, 0);
+            unpinPage(file, rid -> pageNum, UNMODIFIED);
+            result = NG;
+        } else {
+            memcpy(record, newRecord, tableInfo -> recordSize);
+            unpinPage(file, rid -> pageNum, MODIFIED);
         }
     }
-     if((closeFile(file)) != OK){
+
+    if (closeIndexes(indexFile, tableInfo -> numField) != OK) {
+        result = NG;
+    }
+    freeTableInfo(tableInfo);
+    if (closeFile(file) != OK) {
         return NG;
     }
-    //  printf("テーブルを削除しました");
-    return OK;
+    return result;
 }
 
 /*
@@ -732,7 +2251,7 @@ Result createDataFile(char *tableName)
     char *filename;
     /* [tableName].datという文字列を作る */   
     len = (int)strlen(tableName) + strlen(DATA_FILE_EXT) + 1;
-    if ((filename = malloc(len)) == NULL) {
+    if ((filename = allocateMemory(len)) == NULL) {
         return NG;
     }
     snprintf(filename, len, "%s%s", tableName, DATA_FILE_EXT);
@@ -741,6 +2260,12 @@ Result createDataFile(char *tableName)
         return NG;
     }
 
+    /* 空のデータファイルの空き領域マップも作っておく */
+    if (createFreeSpaceFile(tableName) != OK) {
+        deleteFile(filename);
+        return NG;
+    }
+
     return OK;
 
 }
@@ -760,7 +2285,7 @@ Result deleteDataFile(char *tableName)
     char *filename;
     /* [tableName].datという文字列を作る */   
     len = (int)strlen(tableName) + strlen(DATA_FILE_EXT) + 1;
-    if ((filename = malloc(len)) == NULL) {
+    if ((filename = allocateMemory(len)) == NULL) {
         return NG;
     }
     snprintf(filename, len, "%s%s", tableName, DATA_FILE_EXT);
@@ -768,36 +2293,116 @@ Result deleteDataFile(char *tableName)
     if( (deleteFile(filename)) == NG){
         return NG;
     }
+
+    /* 空き領域マップは古いテーブルにはないので、削除できなくてもよい */
+    deleteFreeSpaceFile(tableName);
     return OK;
 }
 
 /*
- * printRecordSet -- レコード集合の表示
+ * buildIndex -- すでにあるレコードからの索引ファイルの作成
+ *
+ * integer型のフィールドにはB+木索引、string型のフィールドにはハッシュ索引を作る。
  *
  * 引数:
- *	recordSet: 表示するレコード集合
+ *	tableName: テーブル名
+ *	fieldName: 索引を付けるフィールドの名前
  *
  * 返り値:
- *	なし
+ *	作成に成功したらOK、失敗したらNGを返す
  */
-void printRecordSet(RecordSet *recordSet)
+Result buildIndex(char *tableName, char *fieldName)
 {
-    /*レコードデータが一つも挿入されてないとき*/
-  if(recordSet == NULL){
-    printf("テーブルがありません");
-    return ;
- }
-    if(recordSet -> numRecord == 0){
-        printf("データがありません");
-        return ;
+    TableInfo *tableInfo;
+    File *file, *indexFile[MAX_FIELD];
+    RecordId rid;
+    Result result = OK;
+    char *filename, *page, *record;
+    int len, numPage, i, k;
+
+    if ((tableInfo = getTableInfo(tableName)) == NULL) {
+        return NG;
+    }
+    for (k = 0; k < tableInfo -> numField; k++) {
+        if (strcmp(tableInfo -> fieldInfo[k].name, fieldName) == 0) {
+            break;
+        }
+    }
+    if (k == tableInfo -> numField) {
+        freeTableInfo(tableInfo);
+        return NG;
+    }
+
+    /* [tableName].datという文字列を作る */
+    len = strlen(tableName) + strlen(DATA_FILE_EXT) + 1;
+    if ((filename = allocateMemory(len)) == NULL) {
+        return NG;
+    }
+    snprintf(filename, len, "%s%s", tableName, DATA_FILE_EXT);
+
+    /* 空の索引ファイルを作ってオープンする(このフィールドの索引だけを更新する) */
+    for (i = 0; i < tableInfo -> numField; i++) {
+        indexFile[i] = NULL;
+    }
+    if (tableInfo -> fieldInfo[k].dataType == TYPE_INTEGER) {
+        if (createIndexFile(tableName, fieldName) != OK ||
+            (indexFile[k] = openIndexFile(tableName, fieldName)) == NULL) {
+            return NG;
+        }
+    } else {
+        if (createHashFile(tableName, fieldName) != OK ||
+            (indexFile[k] = openHashFile(tableName, fieldName)) == NULL) {
+            return NG;
+        }
+    }
+    if ((file = openFile(filename)) == NULL) {
+        closeFile(indexFile[k]);
+        return NG;
+    }
+
+    /*全ページを順に読むので、共有のバッファを荒らさないようにする*/
+    setFileAccessMode(file, ACCESS_SEQUENTIAL);
+    numPage = getNumPages(filename);
+
+    /* 使用中のレコードをすべて索引に加える */
+    for (rid.pageNum = 0; rid.pageNum < numPage && result == OK; rid.pageNum++) {
+        if (pinPage(file, rid.pageNum, &page) != OK) {
+            result = NG;
+            break;
+        }
+        for (rid.slot = 0; rid.slot < tableInfo -> recordsPerPage && result == OK; rid.slot++) {
+            record = page + tableInfo -> recordSize * rid.slot;
+            if (*record != 0) {
+                result = updateIndexes(tableInfo, indexFile, record, &rid, 1);
+            }
+        }
+        unpinPage(file, rid.pageNum, UNMODIFIED);
+    }
+    freeTableInfo(tableInfo);
+
+    if (closeFile(file) != OK) {
+        result = NG;
+    }
+    if (closeFile(indexFile[k]) != OK) {
+        result = NG;
     }
+    return result;
+}
 
-    RecordData *record;
+/*
+ * printRecordHeader -- 表の見出し(フィールド名)の表示
+ *
+ * 引数:
+ *	tableInfo: 表示するレコードのデータ定義情報
+ *
+ * 返り値:
+ *	なし
+ */
+static void printRecordHeader(TableInfo *tableInfo)
+{
     int i,sub;
-    char fieldStr[MAX_STRING];// |Field  |Field  となっている部分
-    char IntStr[MAX_STRING];//数値を文字列に変換した
-    record = recordSet->recordData;
-    int NumField = record -> numField;
+    char fieldStr[MAX_STRING + 1];// |Field  |Field  となっている部分
+    int NumField = tableInfo -> numField;
 
     /* Fieldの上部分を表示*/
     printTableFence(NumField);
@@ -806,15 +2411,15 @@ void printRecordSet(RecordSet *recordSet)
      * | Field名(20byte) | (20byte) |
      * を表示していく
      */
-    for( i = 0 ; i < record -> numField ; i ++){
+    for( i = 0 ; i < NumField ; i ++){
         /*空白を初期化*/
-        memset(fieldStr,0,MAX_STRING);
+        memset(fieldStr,0,sizeof(fieldStr));
 
         printf("|");
-        printf("%s",record->fieldData[i].name);
+        printf("%s",tableInfo->fieldInfo[i].name);
         
         /*フィールドを代入した後の残りの空白の数を取得    */
-        sub = MAX_STRING - strlen(record->fieldData[i].name);
+        sub = MAX_STRING - strlen(tableInfo->fieldInfo[i].name);
         memset(fieldStr,' ',sub);
         printf("%s",fieldStr);
     }
@@ -823,48 +2428,132 @@ void printRecordSet(RecordSet *recordSet)
 
     /*Field部分の下部分を表示*/
     printTableFence(NumField);
+}
 
-    /* レコードを1つずつ取りだし、表示する */
-    for (record = recordSet->recordData; record != NULL; record = record->next) {
-            /* すべてのフィールドのフィールド名とフィールド値を表示する */
-        for (i = 0; i < record->numField; i++) {
+/*
+ * printRecord -- 1つのレコードを表の1行として表示
+ *
+ * 引数:
+ *	tableInfo: レコードのデータ定義情報
+ *	record: 表示するレコードのバイト列
+ *
+ * 返り値:
+ *	なし
+ */
+static void printRecord(TableInfo *tableInfo, char *record)
+{
+    int i,sub;
+    char fieldStr[MAX_STRING + 1];
+    char IntStr[MAX_STRING];//数値を文字列に変換した
+    char *stringValue;
+
+            /* すべてのフィールドの値を、レコードのバイト列から直接読んで表示する */
+        for (i = 0; i < tableInfo -> numField; i++) {
         /*空白を初期化*/
-        memset(fieldStr,0,MAX_STRING);
+        memset(fieldStr,0,sizeof(fieldStr));
         printf("|");
 
-        switch (record->fieldData[i].dataType) {
+        switch (tableInfo->fieldInfo[i].dataType) {
         case TYPE_INTEGER:
 
         memset(IntStr,0,MAX_STRING);
-        sprintf(IntStr,"%d",record->fieldData[i].intValue );        
+        sprintf(IntStr,"%d",getIntField(tableInfo, record, i));
         sub = MAX_STRING - strlen(IntStr);
         memset(fieldStr,' ',sub);
 
         printf("%s",fieldStr );
-        printf("%d", record->fieldData[i].intValue);
+        printf("%s", IntStr);
 
         break;
         case TYPE_STRING:
 
          /*フィールドを代入した後の残りの空白の数を取得    */
-        sub = MAX_STRING - strlen(record->fieldData[i].stringValue);
+        stringValue = getStringField(tableInfo, record, i);
+        sub = MAX_STRING - strnlen(stringValue, MAX_STRING);
         memset(fieldStr,' ',sub);
-        printf("%s", record->fieldData[i].stringValue);
+        printf("%.*s", MAX_STRING, stringValue);
         printf("%s",fieldStr);
        
 
         break;
         default:
         /* ここに来ることはないはず */
-        return;
+        break;
         }
 
     }
     printf("|");
     printf("\n");
+}
+
+/*
+ * printRecordSet -- レコード集合の表示
+ *
+ * 引数:
+ *	recordSet: 表示するレコード集合
+ *
+ * 返り値:
+ *	なし
+ */
+void printRecordSet(RecordSet *recordSet)
+{
+    Record *record;
+
+    /*レコードデータが一つも挿入されてないとき*/
+  if(recordSet == NULL){
+    printf("テーブルがありません");
+    return ;
+ }
+    if(recordSet -> numRecord == 0){
+        printf("データがありません");
+        return ;
     }
-    printTableFence(NumField);
+
+    printRecordHeader(recordSet -> tableInfo);
+
+    /* レコードを1つずつ取りだし、表示する */
+    for (record = recordSet->record; record != NULL; record = record->next) {
+        printRecord(recordSet -> tableInfo, record -> data);
+    }
+    printTableFence(recordSet -> tableInfo -> numField);
+}
+
+/*
+ * printScan -- 走査で取り出したレコードの表示
+ *
+ * レコードを取り出しながら1行ずつ表示するので、結果をメモリに溜めない。
+ *
+ * 引数:
+ *	scan: openScanで開始した走査の状態
+ *
+ * 返り値:
+ *	なし
+ */
+void printScan(Scan *scan)
+{
+    char *record;
+    int numRecord = 0;
+
+  if(scan == NULL){
+    printf("テーブルがありません");
+    return ;
+ }
+
+    /* 最初のレコードを取り出したときに見出しを表示する */
+    while ((record = nextRecord(scan)) != NULL) {
+        if (numRecord++ == 0) {
+            printRecordHeader(scan -> resultInfo);
+        }
+        printRecord(scan -> resultInfo, record);
+    }
+
+    if (numRecord == 0) {
+        printf("データがありません");
+        return ;
+    }
+    printTableFence(scan -> resultInfo -> numField);
 }
+
 /*
  * printTableFence -- +--------+の部分を表示する
  *
@@ -873,10 +2562,11 @@ void printRecordSet(RecordSet *recordSet)
  */
 void printTableFence(int NumField){
 
-char tableStr[MAX_STRING]; // +-------+------　の部分
+char tableStr[MAX_STRING + 1]; // +-------+------　の部分
 int i;
  /* tableStrに"-"を詰め込んでいく*/
 memset(tableStr,'-',MAX_STRING);
+tableStr[MAX_STRING] = '\0';
 
 /*描画開始*/
 for(i = 0; i <  NumField ; i ++){
@@ -905,18 +2595,19 @@ void printTableData(char *tableName)
     int numPage;
     char *filename;
     char page[PAGE_SIZE];
+    FieldInfo *fieldInfo;
 
     /* テーブルのデータ定義情報を取得する */
     if ((tableInfo = getTableInfo(tableName)) == NULL) {
     return;
     }
 
-    /* 1レコード分のデータをファイルに収めるのに必要なバイト数を計算する */
-    recordSize = getRecordSize(tableInfo);
+    /* 1レコード分のデータをファイルに収めるのに必要なバイト数(計算済み) */
+    recordSize = tableInfo -> recordSize;
 
     /* データファイルのファイル名を保存するメモリ領域の確保 */
     len = strlen(tableName) + strlen(DATA_FILE_EXT) + 1;
-    if ((filename = malloc(len)) == NULL) {
+    if ((filename = allocateMemory(len)) == NULL) {
     freeTableInfo(tableInfo);
     return;
     }
@@ -929,12 +2620,11 @@ void printTableData(char *tableName)
 
     /* データファイルをオープンする */
     if ((file = openFile(filename)) == NULL) {
-    free(filename);
     freeTableInfo(tableInfo);
     return;
     }
 
-    free(filename);
+    setFileAccessMode(file, ACCESS_SEQUENTIAL);
 
     /* レコードを1つずつ取りだし、表示する */
     for (i = 0; i < numPage; i++) {
@@ -942,32 +2632,28 @@ void printTableData(char *tableName)
         readPage(file, i, page);
 
         /* pageの先頭からrecord_sizeバイトずつ切り取って処理する */
-        for (j = 0; j < (PAGE_SIZE / recordSize); j++) {
+        for (j = 0; j < tableInfo -> recordsPerPage; j++) {
             /* 先頭の「使用中」のフラグが0だったら読み飛ばす */
         char *p = &page[recordSize * j];
         if (*p == 0) {
         continue;
         }
 
-        /* フラグの分だけポインタを進める */
-        p++;
-
-            /* 1レコード分のデータを出力する */
+            /* 1レコード分のデータを、各フィールドの位置から直接読んで出力する */
         for (k = 0; k < tableInfo->numField; k++) {
         int intValue;
         char stringValue[MAX_STRING];
 
-        printf("Field %s = ", tableInfo->fieldInfo[k].name);
+        fieldInfo = &tableInfo->fieldInfo[k];
+        printf("Field %s = ", fieldInfo->name);
 
-        switch (tableInfo->fieldInfo[k].dataType) {
+        switch (fieldInfo->dataType) {
         case TYPE_INTEGER:
-            memcpy(&intValue, p, sizeof(int));
-            p += sizeof(int);
+            memcpy(&intValue, p + fieldInfo->offset, sizeof(int));
             printf("%d\n", intValue);
             break;
         case TYPE_STRING:
-            memcpy(stringValue, p, MAX_STRING);
-            p += MAX_STRING;
+            memcpy(stringValue, p + fieldInfo->offset, MAX_STRING);
             printf("%s\n", stringValue);
             break;
         default:
@@ -979,5 +2665,7 @@ void printTableData(char *tableName)
         printf("\n");
     }
     }
-}
 
+    freeTableInfo(tableInfo);
+    closeFile(file);
+}
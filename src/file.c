@@ -5,511 +5,2945 @@
 #include "microdb.h"
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/* pwritevに一度に渡せるiovecの数(定義されていない環境向け) */
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+
+/*
+ * NUM_BUFFER -- ファイルアクセスモジュールが管理するバッファの大きさ(ページ数)の既定値
+ *
+ * 環境変数MICRODB_BUFFER_PAGESが設定されていれば、その値を優先する。
+ */
+#define NUM_BUFFER 1024
+
+/*
+ * BUFFER_PAGES_ENV -- バッファの大きさ(ページ数)を指定する環境変数の名前
+ */
+#define BUFFER_PAGES_ENV "MICRODB_BUFFER_PAGES"
+
+/*
+ * MIN_BUFFER -- MICRODB_BUFFER_PAGESに指定できるバッファの大きさの最小値
+ *
+ * レコードの挿入では、データファイルのページ、空き領域マップの管理情報と
+ * ビットマップのページ、索引の管理情報と根から葉までの節、分割で作る節を
+ * 同時に固定する(4段のB+木で十数ページ)。これに先読み(既定値16ページ)の
+ * 分と余裕を加えた大きさにする。
+ */
+#define MIN_BUFFER 64
+
+/*
+ * BUFFER_POLICY_ENV -- バッファの置換方式を指定する環境変数の名前
+ *
+ * "lru"(既定値), "clock", "2q", "lru2"のいずれかを指定する。
+ */
+#define BUFFER_POLICY_ENV "MICRODB_BUFFER_POLICY"
+
+/*
+ * NUM_SCAN_RING -- 順次走査用の専用バッファ(リング)の大きさ(ページ数)の既定値
+ *
+ * 環境変数MICRODB_SCAN_RING_PAGESが設定されていれば、その値を優先する。
+ * 0を指定するとリングを使わない。
+ */
+#define NUM_SCAN_RING 32
+
+/*
+ * SCAN_RING_ENV -- 順次走査用リングの大きさを指定する環境変数の名前
+ */
+#define SCAN_RING_ENV "MICRODB_SCAN_RING_PAGES"
+
+/*
+ * NUM_READAHEAD -- 順次アクセスを検出したときに先読みするページ数の既定値
+ *
+ * 環境変数MICRODB_READAHEAD_PAGESが設定されていれば、その値を優先する。
+ * 0または1を指定すると先読みしない。
+ */
+#define NUM_READAHEAD 16
+
+/*
+ * READAHEAD_ENV -- 先読みするページ数を指定する環境変数の名前
+ */
+#define READAHEAD_ENV "MICRODB_READAHEAD_PAGES"
+
+/*
+ * MAX_READAHEAD -- 一度に先読みするページ数の上限
+ */
+#define MAX_READAHEAD 256
+
+/*
+ * WRITER_RATE_ENV -- バックグラウンドライタが1秒間に書き出すページ数の上限を指定する環境変数
+ *
+ * 1以上を指定すると、バックグラウンドライタを動かす(既定では動かさない)。
+ */
+#define WRITER_RATE_ENV "MICRODB_BGWRITER_RATE"
+
+/*
+ * WRITER_CLEAN_ENV -- バックグラウンドライタが目標とする未変更のバッファの割合(%)を指定する環境変数
+ */
+#define WRITER_CLEAN_ENV "MICRODB_BGWRITER_CLEAN_PERCENT"
+
+/*
+ * WRITER_CLEAN_PERCENT -- 未変更のバッファの割合(%)の目標の既定値
+ */
+#define WRITER_CLEAN_PERCENT 50
+
+/*
+ * WRITER_INTERVAL_MS -- バックグラウンドライタが書き出しを行う間隔(ミリ秒)
+ */
+#define WRITER_INTERVAL_MS 100
+
+/*
+ * WRITER_BATCH -- バックグラウンドライタが一度に書き出すページ数の上限
+ */
+#define WRITER_BATCH 64
+
+/*
+ * MAX_ASYNC_READ -- 完了を待たずに発行しておける先読みの要求の数
+ */
+#define MAX_ASYNC_READ 4
 
 /*
- * NUM_BUFFER -- ファイルアクセスモジュールが管理するバッファの大きさ(ページ数)
+ * SEQUENTIAL_THRESHOLD -- 何ページ続けて順に読まれたら順次アクセスとみなすか
  */
-#define NUM_BUFFER 4
+#define SEQUENTIAL_THRESHOLD 2
 
 /*
- * modifyFlag -- 変更フラグ
+ * MAX_USAGE_COUNT -- CLOCK方式で数える参照回数の上限
  */
-typedef enum { UNMODIFIED = 0, MODIFIED = 1 } modifyFlag;
+#define MAX_USAGE_COUNT 5
+
+/*
+ * QueueType -- バッファが置換方式のどのリストに入っているかを表す列挙型
+ */
+typedef enum {
+  QUEUE_NONE = 0,			/* どのリストにも入っていない */
+  QUEUE_FREE,				/* 未使用バッファのリスト */
+  QUEUE_LRU,				/* LRU方式のリスト */
+  QUEUE_A1IN,				/* 2Q方式の一度だけ参照されたページのFIFO */
+  QUEUE_AM,				/* 2Q方式の複数回参照されたページのLRUリスト */
+  QUEUE_CLOCK,				/* CLOCK方式で管理中 */
+  QUEUE_HEAP				/* LRU-2方式のヒープで管理中 */
+} QueueType;
 
 /*
  * Buffer -- 1ページ分のバッファを記憶する構造体
  */
 typedef struct Buffer Buffer;
 struct Buffer {
-  File *file;					/* バッファの内容が格納されたファイル */
-  /* file == NULLならこのバッファは未使用 */
+  int fileId;					/* バッファの内容が格納されたファイルの識別番号 */
+  /* fileId == -1ならこのバッファは未使用 */
+  int desc;					/* 書き戻しに使うファイルディスクリプタ */
   int pageNum;				/* ページ番号 */
-  char page[PAGE_SIZE];		/* ページの内容を格納する配列 */
+  int pinCount;				/* ピンされている数(0より大きければ追い出さない) */
+  char *page;				/* ページの内容を格納する領域(PAGE_SIZEバイト) */
   struct Buffer *prev;		/* 一つ前のバッファへのポインタ */
   struct Buffer *next;		/* 一つ後ろのバッファへのポインタ */
+  struct Buffer *hashNext;	/* ページ表の同じバケットにある次のバッファへのポインタ */
+  struct Buffer *dirtyPrev;	/* 同じファイルの変更済みバッファのリストの前の要素 */
+  struct Buffer *dirtyNext;	/* 同じファイルの変更済みバッファのリストの次の要素 */
   modifyFlag modified;		/* ページの内容が更新されたかどうかを示すフラグ */
+  QueueType queue;			/* 入っているリストの種類 */
+  int inRing;				/* 順次走査用リングのバッファなら1 */
+  int prefetched;			/* 先読みしたあと、まだ参照されていなければ1 */
+  int readaheadMark;		/* 参照されたら次の範囲の先読みを始めるページなら1 */
+  int asyncRead;			/* 読み込み中の先読み要求の番号(-1なら読み込み済み) */
+  int usageCount;			/* CLOCK方式の参照回数 */
+  unsigned long lastAccess;	/* LRU-2方式の最後の参照時刻 */
+  unsigned long prevAccess;	/* LRU-2方式の最後から2番目の参照時刻(なければ0) */
+  int heapIndex;			/* LRU-2方式のヒープ上の位置 */
+};
+
+/*
+ * BufferList -- バッファの両方向リスト
+ */
+typedef struct BufferList BufferList;
+struct BufferList {
+  Buffer *head;				/* 先頭(最近使われた側)へのポインタ */
+  Buffer *tail;				/* 最後尾(追い出す側)へのポインタ */
+  int count;				/* リストに入っているバッファの数 */
+};
+
+/*
+ * BufferPolicy -- バッファの置換方式を表す構造体
+ *
+ * 置換方式ごとに、以下の関数を用意する。
+ * どの関数も、未使用のバッファ(fileId == -1)を受け取ることはない。
+ */
+typedef struct BufferPolicy BufferPolicy;
+struct BufferPolicy {
+  char *name;					/* 置換方式の名前 */
+  Result (*initialize)(void);		/* 置換方式の初期化 */
+  void (*admit)(Buffer *);		/* 新しくページを読み込んだバッファを登録する */
+  void (*touch)(Buffer *);		/* バッファにあったページが参照されたことを記録する */
+  void (*remove)(Buffer *);		/* バッファを管理対象から外す */
+  Buffer *(*victim)(void);		/* 追い出すバッファを選び、管理対象から外す */
+};
+
+/*
+ * GhostEntry -- 2Q方式で、追い出したページを覚えておくための記録
+ */
+typedef struct GhostEntry GhostEntry;
+struct GhostEntry {
+  int fileId;				/* ファイル識別番号(-1なら未使用) */
+  int pageNum;				/* ページ番号 */
+  int hashNext;				/* 同じバケットにある次の記録の添字(-1なら終わり) */
+};
+
+/*
+ * FileEntry -- バッファ上のページをファイルと対応づけるための識別情報
+ *
+ * ページはFile構造体へのポインタではなく、ファイルの実体(デバイス番号と
+ * iノード番号の組)で識別する。こうすることで、ファイルをクローズして
+ * 再びオープンしても、バッファに残っているページをそのまま使える。
+ */
+typedef struct FileEntry FileEntry;
+struct FileEntry {
+  int used;					/* このエントリが使用中かどうか */
+  dev_t dev;				/* デバイス番号 */
+  ino_t ino;				/* iノード番号 */
+  char name[MAX_FILENAME];	/* 最後にオープンしたときのファイル名 */
+  BufferStats stats;		/* このファイルのページに関する統計情報 */
+  Buffer *dirtyHead;		/* このファイルの変更済みバッファのリスト */
+  int numDirty;				/* このファイルの変更済みバッファの数 */
+  int lastPage;				/* 最後に読まれたページの番号 */
+  int sequentialRun;		/* 直前まで続けて順に読まれたページ数 */
+  int readaheadNext;		/* 次に先読みを始めるページの番号 */
+};
+
+/*
+ * AsyncRead -- 完了を待たずに発行した先読みの要求
+ *
+ * 読み込み先のバッファはページ表に登録し、完了するまでピンしておく。
+ * そのページが参照されたら、完了を待ってからピンを外す。
+ */
+typedef struct AsyncRead AsyncRead;
+struct AsyncRead {
+  int used;					/* 要求を発行中なら1 */
+  int fileId;				/* 読み込んでいるファイルの識別番号 */
+  PageRequest req;			/* ページ入出力モジュールに渡した要求 */
+  struct iovec iov[MAX_READAHEAD];	/* 各ページの読み込み先 */
+  Buffer *bufs[MAX_READAHEAD];	/* 読み込み先のバッファ */
+};
+
+/*
+ * numBuffer -- 確保したバッファの数(ページ数)
+ */
+static int numBuffer = 0;
+
+/*
+ * bufferPool -- 確保したバッファ(Buffer構造体)の配列
+ */
+static Buffer *bufferPool = NULL;
+
+/*
+ * pageArea -- 全バッファのページ内容を格納する領域
+ */
+static char *pageArea = NULL;
+
+/*
+ * pageTable -- (ファイル識別番号, ページ番号)からバッファを引くハッシュ表
+ *
+ * LRUリストとは別に管理し、バッファの検索をバッファ数によらず定数時間で行う。
+ * 同じバケットに入るバッファはhashNextでつなぐ。
+ */
+static Buffer **pageTable = NULL;
+
+/*
+ * pageTableMask -- ページ表のバケット数-1 (バケット数は2のべき乗)
+ */
+static unsigned int pageTableMask = 0;
+
+/*
+ * policy -- 使用中のバッファの置換方式
+ */
+static BufferPolicy *policy = NULL;
+
+/*
+ * freeList -- 未使用のバッファのリスト
+ */
+static BufferList freeList;
+
+/*
+ * lruList -- LRU方式のリスト
+ */
+static BufferList lruList;
+
+/*
+ * a1inList, amList -- 2Q方式のリスト
+ */
+static BufferList a1inList;
+static BufferList amList;
+
+/*
+ * ghostTable, ghostBucket -- 2Q方式で追い出したページの記録(A1out)とそのハッシュ表
+ */
+static GhostEntry *ghostTable = NULL;
+static int *ghostBucket = NULL;
+static int numGhost = 0;
+static int ghostHand = 0;
+static unsigned int ghostMask = 0;
+
+/*
+ * clockHand -- CLOCK方式の針の位置
+ */
+static int clockHand = 0;
+
+/*
+ * accessHeap -- LRU-2方式で、最後から2番目の参照時刻の順に並べたヒープ
+ */
+static Buffer **accessHeap = NULL;
+static int heapSize = 0;
+
+/*
+ * accessClock -- LRU-2方式の参照時刻を数えるカウンタ
+ */
+static unsigned long accessClock = 0;
+
+/*
+ * numRing -- 順次走査用リングのバッファ数
+ *
+ * リングのバッファはbufferPoolのnumBuffer番目以降に置く。
+ */
+static int numRing = 0;
+
+/*
+ * ringHand -- 順次走査用リングで次に使うバッファの位置
+ */
+static int ringHand = 0;
+
+/*
+ * readaheadWindow -- 順次アクセスを検出したときに先読みするページ数
+ */
+static int readaheadWindow = NUM_READAHEAD;
+
+/*
+ * asyncReads -- 完了を待たずに発行した先読みの要求
+ */
+static AsyncRead asyncReads[MAX_ASYNC_READ];
+
+/*
+ * numDirtyBuffer -- 変更済みのバッファの数(すべてのファイルの合計)
+ */
+static int numDirtyBuffer = 0;
+
+/*
+ * bufferLock -- バッファやファイル識別情報の表を操作するときに取るロック
+ *
+ * バックグラウンドライタのスレッドと、それ以外の処理との排他に使う。
+ * 外部から呼ばれる関数の入口で取り、出口で外す。
+ */
+static pthread_mutex_t bufferLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * BackgroundWriter -- バックグラウンドライタの状態
+ */
+typedef struct BackgroundWriter BackgroundWriter;
+struct BackgroundWriter {
+  int running;				/* スレッドが動いていれば1 */
+  int stop;					/* スレッドに終了を求めるなら1 */
+  int busy;					/* 書き出し中(ロックを外している)なら1 */
+  int cleanPercent;			/* 未変更のバッファの割合(%)の目標 */
+  int pagesPerSecond;		/* 1秒間に書き出すページ数の上限 */
+  int hand;					/* 次に調べるバッファの位置 */
+  pthread_t thread;			/* バックグラウンドライタのスレッド */
+  pthread_cond_t wake;		/* バックグラウンドライタを起こすための条件変数 */
+  pthread_cond_t idle;		/* 書き出しが終わったことを知らせる条件変数 */
+  Buffer *bufs[WRITER_BATCH];	/* 書き出し中のバッファ */
+  int descs[WRITER_BATCH];	/* 書き出すファイルのディスクリプタ */
+  int pageNums[WRITER_BATCH];	/* 書き出すページの番号 */
+  int written[WRITER_BATCH];	/* 書き出せたら1 */
+  char *copies;				/* 書き出すページの内容の写し(WRITER_BATCHページ分) */
+};
+
+/*
+ * writer -- バックグラウンドライタ
+ */
+static BackgroundWriter writer = {
+  0, 0, 0, WRITER_CLEAN_PERCENT, 0, 0, 0,
+  PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER
 };
 
 /*
- * bufferListHead -- LRUリストの先頭へのポインタ
+ * totalStats -- バッファ全体の統計情報
+ */
+static BufferStats totalStats;
+
+/*
+ * fileTable -- ファイル識別情報の表(添字がファイル識別番号になる)
+ */
+static FileEntry *fileTable = NULL;
+
+/*
+ * numFileEntry -- fileTableで使用している要素数
+ */
+static int numFileEntry = 0;
+
+/*
+ * maxFileEntry -- fileTableに確保した要素数
+ */
+static int maxFileEntry = 0;
+
+/*
+ * getSizeFromEnv -- 環境変数からバッファの大きさ(ページ数)を読み取る
+ *
+ * 引数:
+ *	name: 環境変数の名前
+ *	defaultValue: 環境変数が設定されていない場合の値
+ *	minValue: 許される最小値
+ *
+ * 返り値:
+ *	環境変数に正しい整数が指定されていればその値、そうでなければdefaultValueを返す。
+ */
+static int getSizeFromEnv(char *name, int defaultValue, int minValue)
+{
+  char *value;
+  char *end;
+  long n;
+
+  if ((value = getenv(name)) == NULL) {
+    return defaultValue;
+  }
+
+  n = strtol(value, &end, 10);
+  if (*end != '\0' || n < minValue || n > (1L << 24)) {
+    fprintf(stderr, "%s=%s is invalid, using %d pages.\n", name, value, defaultValue);
+    return defaultValue;
+  }
+
+  return (int) n;
+}
+
+/*
+ * listRemove -- バッファをリストから取り除く
+ *
+ * 引数:
+ *	list: リスト
+ *	buf: 取り除くバッファ
+ *
+ * 返り値:
+ *	なし
+ */
+static void listRemove(BufferList *list, Buffer *buf)
+{
+  if (buf->prev != NULL) {
+    buf->prev->next = buf->next;
+  } else {
+    list->head = buf->next;
+  }
+  if (buf->next != NULL) {
+    buf->next->prev = buf->prev;
+  } else {
+    list->tail = buf->prev;
+  }
+  buf->prev = NULL;
+  buf->next = NULL;
+  buf->queue = QUEUE_NONE;
+  list->count--;
+}
+
+/*
+ * listPushHead -- バッファをリストの先頭に入れる
+ *
+ * 引数:
+ *	list: リスト
+ *	buf: 入れるバッファ(どのリストにも入っていないもの)
+ *	queue: リストの種類
+ *
+ * 返り値:
+ *	なし
+ */
+static void listPushHead(BufferList *list, Buffer *buf, QueueType queue)
+{
+  buf->prev = NULL;
+  buf->next = list->head;
+  if (list->head != NULL) {
+    list->head->prev = buf;
+  } else {
+    list->tail = buf;
+  }
+  list->head = buf;
+  buf->queue = queue;
+  list->count++;
+}
+
+/*
+ * moveBufferToListHead -- バッファをリストの先頭へ移動
+ *
+ * 引数:
+ *	list: リスト
+ *	buf: リストの先頭に移動させるバッファへのポインタ
+ *
+ * 返り値:
+ *	なし
+ */
+static void moveBufferToListHead(BufferList *list, Buffer *buf)
+{
+  QueueType queue = buf->queue;
+
+  /* bufferが先頭の場合何もしない */
+  if (buf == list->head) {
+    return;
+  }
+
+  listRemove(list, buf);
+  listPushHead(list, buf, queue);
+}
+
+/*
+ * findUnpinnedFromTail -- リストの最後尾から、ピンされていないバッファを探す
+ *
+ * 引数:
+ *	list: リスト
+ *
+ * 返り値:
+ *	見つかったバッファ。なければNULLを返す。
+ */
+static Buffer *findUnpinnedFromTail(BufferList *list)
+{
+  Buffer *buf;
+
+  for (buf = list->tail; buf != NULL && buf->pinCount > 0; buf = buf->prev) {
+    ;
+  }
+  return buf;
+}
+
+/*
+ * LRU方式 -- 最も長い間参照されていないページを追い出す
+ */
+static Result lruInitialize()
+{
+  memset(&lruList, 0, sizeof(lruList));
+  return OK;
+}
+
+static void lruAdmit(Buffer *buf)
+{
+  listPushHead(&lruList, buf, QUEUE_LRU);
+}
+
+static void lruTouch(Buffer *buf)
+{
+  moveBufferToListHead(&lruList, buf);
+}
+
+static void lruRemove(Buffer *buf)
+{
+  listRemove(&lruList, buf);
+}
+
+static Buffer *lruVictim()
+{
+  Buffer *buf;
+
+  if ((buf = findUnpinnedFromTail(&lruList)) != NULL) {
+    listRemove(&lruList, buf);
+  }
+  return buf;
+}
+
+/*
+ * CLOCK方式 -- 参照回数を持たせ、針を回しながら参照回数を減らしていき、
+ * 0になっているページを追い出す
  */
-static Buffer *bufferListHead = NULL;
+static Result clockInitialize()
+{
+  clockHand = 0;
+  return OK;
+}
+
+static void clockAdmit(Buffer *buf)
+{
+  buf->usageCount = 1;
+  buf->queue = QUEUE_CLOCK;
+}
+
+static void clockTouch(Buffer *buf)
+{
+  if (buf->usageCount < MAX_USAGE_COUNT) {
+    buf->usageCount++;
+  }
+}
+
+static void clockRemove(Buffer *buf)
+{
+  buf->usageCount = 0;
+  buf->queue = QUEUE_NONE;
+}
+
+static Buffer *clockVictim()
+{
+  Buffer *buf;
+  int tries;
+
+  /* 参照回数が上限のバッファでも、針が上限+1周すれば0になる */
+  for (tries = 0; tries < numBuffer * (MAX_USAGE_COUNT + 1); tries++) {
+    buf = &bufferPool[clockHand];
+    clockHand = (clockHand + 1) % numBuffer;
+
+    if (buf->queue != QUEUE_CLOCK || buf->pinCount > 0) {
+      continue;
+    }
+    if (buf->usageCount == 0) {
+      clockRemove(buf);
+      return buf;
+    }
+    buf->usageCount--;
+  }
+
+  return NULL;
+}
+
+/*
+ * 2Q方式 -- 一度だけ参照されたページはA1inのFIFOに入れ、A1inから追い出された
+ * ページの記録(A1out)に残っているページが再び参照されたときにだけ、Amの
+ * LRUリストに入れる。一度きりのアクセスで頻繁に使うページが追い出されにくい。
+ */
+static int a1inLimit()
+{
+  /* A1inの大きさは全体の1/4とする */
+  return (numBuffer / 4 > 0) ? numBuffer / 4 : 1;
+}
+
+static unsigned int hashGhost(int fileId, int pageNum)
+{
+  unsigned int h = (unsigned int) pageNum * 0x9e3779b1u ^ (unsigned int) fileId * 0x85ebca6bu;
+  return (h ^ (h >> 15)) & ghostMask;
+}
+
+/*
+ * unlinkGhost -- 記録をハッシュ表から外す
+ */
+static void unlinkGhost(int index)
+{
+  int *p;
+
+  for (p = &ghostBucket[hashGhost(ghostTable[index].fileId, ghostTable[index].pageNum)];
+       *p != -1; p = &ghostTable[*p].hashNext) {
+    if (*p == index) {
+      *p = ghostTable[index].hashNext;
+      break;
+    }
+  }
+  ghostTable[index].fileId = -1;
+}
+
+/*
+ * addGhost -- A1inから追い出したページを記録する(古い記録から上書きする)
+ */
+static void addGhost(Buffer *buf)
+{
+  GhostEntry *g = &ghostTable[ghostHand];
+  unsigned int h;
+
+  if (g->fileId != -1) {
+    unlinkGhost(ghostHand);
+  }
+  g->fileId = buf->fileId;
+  g->pageNum = buf->pageNum;
+  h = hashGhost(g->fileId, g->pageNum);
+  g->hashNext = ghostBucket[h];
+  ghostBucket[h] = ghostHand;
+
+  ghostHand = (ghostHand + 1) % numGhost;
+}
+
+/*
+ * takeGhost -- ページの記録があれば消して1を返す
+ */
+static int takeGhost(int fileId, int pageNum)
+{
+  int i;
+
+  for (i = ghostBucket[hashGhost(fileId, pageNum)]; i != -1; i = ghostTable[i].hashNext) {
+    if (ghostTable[i].fileId == fileId && ghostTable[i].pageNum == pageNum) {
+      unlinkGhost(i);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static Result twoQInitialize()
+{
+  int i;
+
+  memset(&a1inList, 0, sizeof(a1inList));
+  memset(&amList, 0, sizeof(amList));
+
+  /* A1outには全体の1/2のページ数分の記録を残す */
+  numGhost = (numBuffer / 2 > 0) ? numBuffer / 2 : 1;
+  for (i = 1; i < numGhost; i <<= 1) {
+    ;
+  }
+  ghostMask = (unsigned int) i - 1;
+  ghostHand = 0;
+
+  if ((ghostTable = (GhostEntry *) malloc(sizeof(GhostEntry) * numGhost)) == NULL) {
+    return NG;
+  }
+  if ((ghostBucket = (int *) malloc(sizeof(int) * i)) == NULL) {
+    free(ghostTable);
+    ghostTable = NULL;
+    return NG;
+  }
+  memset(ghostBucket, 0xff, sizeof(int) * i);
+  for (i = 0; i < numGhost; i++) {
+    ghostTable[i].fileId = -1;
+    ghostTable[i].hashNext = -1;
+  }
+  return OK;
+}
+
+static void twoQAdmit(Buffer *buf)
+{
+  /* 最近追い出したばかりのページなら、よく使われるページとしてAmに入れる */
+  if (takeGhost(buf->fileId, buf->pageNum)) {
+    listPushHead(&amList, buf, QUEUE_AM);
+  } else {
+    listPushHead(&a1inList, buf, QUEUE_A1IN);
+  }
+}
+
+static void twoQTouch(Buffer *buf)
+{
+  /* A1inのページは参照されても動かさない(FIFO) */
+  if (buf->queue == QUEUE_AM) {
+    moveBufferToListHead(&amList, buf);
+  }
+}
+
+static void twoQRemove(Buffer *buf)
+{
+  listRemove((buf->queue == QUEUE_AM) ? &amList : &a1inList, buf);
+}
+
+static Buffer *twoQVictim()
+{
+  Buffer *buf = NULL;
+
+  /* A1inが上限を超えていればA1inから、そうでなければAmから追い出す */
+  if (a1inList.count > a1inLimit() || amList.count == 0) {
+    if ((buf = findUnpinnedFromTail(&a1inList)) != NULL) {
+      listRemove(&a1inList, buf);
+      addGhost(buf);
+      return buf;
+    }
+  }
+  if ((buf = findUnpinnedFromTail(&amList)) != NULL) {
+    listRemove(&amList, buf);
+    return buf;
+  }
+  if ((buf = findUnpinnedFromTail(&a1inList)) != NULL) {
+    listRemove(&a1inList, buf);
+    addGhost(buf);
+  }
+  return buf;
+}
+
+/*
+ * LRU-2方式 -- 最後から2番目の参照時刻が最も古いページを追い出す
+ * (一度しか参照されていないページは、最後から2番目の参照時刻を0とみなす)
+ *
+ * バッファは(最後から2番目の参照時刻, 最後の参照時刻)の小さい順に並べた
+ * ヒープで管理する。
+ */
+static int heapLess(Buffer *a, Buffer *b)
+{
+  if (a->prevAccess != b->prevAccess) {
+    return a->prevAccess < b->prevAccess;
+  }
+  return a->lastAccess < b->lastAccess;
+}
+
+static void heapSet(int i, Buffer *buf)
+{
+  accessHeap[i] = buf;
+  buf->heapIndex = i;
+}
+
+static void heapSiftUp(int i)
+{
+  Buffer *buf = accessHeap[i];
+
+  while (i > 0 && heapLess(buf, accessHeap[(i - 1) / 2])) {
+    heapSet(i, accessHeap[(i - 1) / 2]);
+    i = (i - 1) / 2;
+  }
+  heapSet(i, buf);
+}
+
+static void heapSiftDown(int i)
+{
+  Buffer *buf = accessHeap[i];
+  int child;
+
+  while ((child = 2 * i + 1) < heapSize) {
+    if (child + 1 < heapSize && heapLess(accessHeap[child + 1], accessHeap[child])) {
+      child++;
+    }
+    if (!heapLess(accessHeap[child], buf)) {
+      break;
+    }
+    heapSet(i, accessHeap[child]);
+    i = child;
+  }
+  heapSet(i, buf);
+}
+
+static Result lru2Initialize()
+{
+  heapSize = 0;
+  accessClock = 0;
+  if ((accessHeap = (Buffer **) malloc(sizeof(Buffer *) * numBuffer)) == NULL) {
+    return NG;
+  }
+  return OK;
+}
+
+static void lru2Admit(Buffer *buf)
+{
+  buf->prevAccess = 0;
+  buf->lastAccess = ++accessClock;
+  buf->queue = QUEUE_HEAP;
+  heapSet(heapSize++, buf);
+  heapSiftUp(buf->heapIndex);
+}
+
+static void lru2Touch(Buffer *buf)
+{
+  /* 同じページへの連続した参照は、一回の参照とみなす */
+  if (buf->lastAccess == accessClock) {
+    return;
+  }
+  buf->prevAccess = buf->lastAccess;
+  buf->lastAccess = ++accessClock;
+  heapSiftDown(buf->heapIndex);
+}
+
+static void lru2Remove(Buffer *buf)
+{
+  int i = buf->heapIndex;
+
+  heapSize--;
+  if (i != heapSize) {
+    heapSet(i, accessHeap[heapSize]);
+    heapSiftDown(i);
+    heapSiftUp(accessHeap[i]->heapIndex);
+  }
+  buf->queue = QUEUE_NONE;
+}
+
+static Buffer *lru2Victim()
+{
+  Buffer *buf = NULL;
+  int i;
+
+  if (heapSize == 0) {
+    return NULL;
+  }
+
+  /* 通常はヒープの先頭を追い出す。ピンされていれば、残りから最小のものを探す */
+  if (accessHeap[0]->pinCount == 0) {
+    buf = accessHeap[0];
+  } else {
+    for (i = 1; i < heapSize; i++) {
+      if (accessHeap[i]->pinCount == 0 && (buf == NULL || heapLess(accessHeap[i], buf))) {
+        buf = accessHeap[i];
+      }
+    }
+  }
+
+  if (buf != NULL) {
+    lru2Remove(buf);
+  }
+  return buf;
+}
+
+/*
+ * policyTable -- 選択できる置換方式の一覧
+ */
+static BufferPolicy policyTable[] = {
+  { "lru", lruInitialize, lruAdmit, lruTouch, lruRemove, lruVictim },
+  { "clock", clockInitialize, clockAdmit, clockTouch, clockRemove, clockVictim },
+  { "2q", twoQInitialize, twoQAdmit, twoQTouch, twoQRemove, twoQVictim },
+  { "lru2", lru2Initialize, lru2Admit, lru2Touch, lru2Remove, lru2Victim },
+};
+
+/*
+ * selectPolicy -- 環境変数MICRODB_BUFFER_POLICYから置換方式を決める
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	置換方式を返す。指定がないか、知らない名前の場合はLRU方式を返す。
+ */
+static BufferPolicy *selectPolicy()
+{
+  char *name;
+  int i;
+
+  if ((name = getenv(BUFFER_POLICY_ENV)) == NULL) {
+    return &policyTable[0];
+  }
+
+  for (i = 0; i < (int) (sizeof(policyTable) / sizeof(policyTable[0])); i++) {
+    if (strcmp(policyTable[i].name, name) == 0) {
+      return &policyTable[i];
+    }
+  }
+
+  fprintf(stderr, "%s=%s is unknown, using lru.\n", BUFFER_POLICY_ENV, name);
+  return &policyTable[0];
+}
+
+/*
+ * initializeBufferList -- バッファリストの初期化
+ *
+ * **注意**
+ *	この関数は、ファイルアクセスモジュールを使用する前に必ず一度だけ呼び出すこと。
+ *	(initializeFileModule()から呼び出すこと。)
+ *
+ * 引数:
+ *	size: 確保するバッファの数(ページ数)
+ *	ringSize: 順次走査用リングのバッファの数(ページ数)
+ *
+ * 返り値:
+ *	初期化に成功すればOK、失敗すればNGを返す。
+ */
+static Result initializeBufferList(int size, int ringSize)
+{
+  Buffer *buf;
+  int total = size + ringSize;
+  int i;
+
+  /* Buffer構造体とページ内容の領域を、それぞれまとめて確保する */
+  if ((bufferPool = (Buffer *) malloc(sizeof(Buffer) * total)) == NULL) {
+    /* メモリ不足なのでエラーを返す */
+    return NG;
+  }
+  if (posix_memalign((void **) &pageArea, PAGE_SIZE, (size_t) PAGE_SIZE * total) != 0) {
+    free(bufferPool);
+    bufferPool = NULL;
+    return NG;
+  }
+  numBuffer = size;
+  numRing = ringSize;
+  ringHand = 0;
+
+  /* ページ表のバケット数は、バッファ数以上の2のべき乗にする */
+  for (i = 1; i < total; i <<= 1) {
+    ;
+  }
+  if ((pageTable = (Buffer **) calloc(i, sizeof(Buffer *))) == NULL) {
+    free(bufferPool);
+    free(pageArea);
+    bufferPool = NULL;
+    pageArea = NULL;
+    return NG;
+  }
+  pageTableMask = (unsigned int) i - 1;
+
+  /*
+   * リング以外のバッファはすべて未使用のバッファのリストにつないでおく
+   */
+  memset(&freeList, 0, sizeof(freeList));
+  for (i = total - 1; i >= 0; i--) {
+    buf = &bufferPool[i];
+
+    /* Buffer構造体の初期化 */
+    memset(buf, 0, sizeof(Buffer));
+    buf->fileId = -1;
+    buf->desc = -1;
+    buf->pageNum = -1;
+    buf->modified = UNMODIFIED;
+    buf->asyncRead = -1;
+    buf->page = pageArea + (size_t) PAGE_SIZE * i;
+    memset(buf->page, 0, PAGE_SIZE);
+
+    if (i >= size) {
+      buf->inRing = 1;
+    } else {
+      listPushHead(&freeList, buf, QUEUE_FREE);
+    }
+  }
+
+  /* 置換方式の初期化 */
+  policy = selectPolicy();
+  if (policy->initialize() != OK) {
+    free(bufferPool);
+    free(pageArea);
+    free(pageTable);
+    bufferPool = NULL;
+    pageArea = NULL;
+    pageTable = NULL;
+    return NG;
+  }
+
+  return OK;
+}
+
+/*
+ * fileStats -- ファイルごとの統計情報の取得
+ *
+ * 引数:
+ *	fileId: ファイル識別番号
+ *
+ * 返り値:
+ *	統計情報へのポインタ
+ */
+static BufferStats *fileStats(int fileId)
+{
+  return &fileTable[fileId].stats;
+}
+
+/*
+ * countRead -- ファイルからのページの読み込みを数える
+ *
+ * 引数:
+ *	fileId: ファイル識別番号
+ *	numPages: 読み込んだページ数
+ *
+ * 返り値:
+ *	なし
+ */
+static void countRead(int fileId, int numPages)
+{
+  BufferStats *stats = fileStats(fileId);
+
+  totalStats.pagesRead += numPages;
+  totalStats.bytesRead += (long) numPages * PAGE_SIZE;
+  stats->pagesRead += numPages;
+  stats->bytesRead += (long) numPages * PAGE_SIZE;
+}
+
+/*
+ * countWrite -- ファイルへのページの書き出しを数える
+ *
+ * 引数:
+ *	fileId: ファイル識別番号
+ *	numPages: 書き出したページ数
+ *
+ * 返り値:
+ *	なし
+ */
+static void countWrite(int fileId, int numPages)
+{
+  BufferStats *stats = fileStats(fileId);
+
+  totalStats.pagesWritten += numPages;
+  totalStats.bytesWritten += (long) numPages * PAGE_SIZE;
+  stats->pagesWritten += numPages;
+  stats->bytesWritten += (long) numPages * PAGE_SIZE;
+}
+
+/*
+ * markDirty -- バッファを変更済みにする
+ *
+ * 変更済みのバッファはファイルごとのリストにつなぎ、書き戻すときに
+ * バッファ全体を調べなくても済むようにする。
+ *
+ * 引数:
+ *	buf: 変更済みにするバッファ
+ *
+ * 返り値:
+ *	なし
+ */
+static void markDirty(Buffer *buf)
+{
+  FileEntry *entry = &fileTable[buf->fileId];
+
+  if (buf->modified == MODIFIED) {
+    return;
+  }
+
+  buf->modified = MODIFIED;
+  buf->dirtyPrev = NULL;
+  buf->dirtyNext = entry->dirtyHead;
+  if (entry->dirtyHead != NULL) {
+    entry->dirtyHead->dirtyPrev = buf;
+  }
+  entry->dirtyHead = buf;
+  entry->numDirty++;
+  numDirtyBuffer++;
+
+  /* 変更済みのバッファが目標を超えたら、バックグラウンドライタを起こす */
+  if (writer.running && !writer.busy &&
+      (long) numDirtyBuffer * 100 > (long) numBuffer * (100 - writer.cleanPercent)) {
+    pthread_cond_signal(&writer.wake);
+  }
+}
+
+/*
+ * markClean -- バッファを未変更にする
+ *
+ * 引数:
+ *	buf: 未変更にするバッファ
+ *
+ * 返り値:
+ *	なし
+ */
+static void markClean(Buffer *buf)
+{
+  FileEntry *entry;
+
+  if (buf->modified == UNMODIFIED) {
+    return;
+  }
+
+  entry = &fileTable[buf->fileId];
+  if (buf->dirtyPrev != NULL) {
+    buf->dirtyPrev->dirtyNext = buf->dirtyNext;
+  } else {
+    entry->dirtyHead = buf->dirtyNext;
+  }
+  if (buf->dirtyNext != NULL) {
+    buf->dirtyNext->dirtyPrev = buf->dirtyPrev;
+  }
+  buf->dirtyPrev = NULL;
+  buf->dirtyNext = NULL;
+  entry->numDirty--;
+  numDirtyBuffer--;
+
+  buf->modified = UNMODIFIED;
+}
+
+/*
+ * transferPage -- 1ページの読み込みまたは書き出し
+ *
+ * 引数:
+ *	desc: ファイルディスクリプタ
+ *	pageNum: ページ番号
+ *	page: ページの内容を格納する領域(PAGE_SIZEバイト)
+ *	write: 書き出すなら1、読み込むなら0
+ *
+ * 返り値:
+ *	1ページ分を転送できればOK、そうでなければNG
+ */
+static Result transferPage(int desc, int pageNum, char *page, int write)
+{
+  PageRequest req, *reqs = &req;
+  struct iovec iov;
+
+  iov.iov_base = page;
+  iov.iov_len = PAGE_SIZE;
+  req.desc = desc;
+  req.write = write;
+  req.pageNum = pageNum;
+  req.numPages = 1;
+  req.iov = &iov;
+
+  if (submitPageRequests(&reqs, 1) != OK || req.bytes < PAGE_SIZE) {
+    return NG;
+  }
+  return OK;
+}
+
+/*
+ * writeBackBuffer -- バッファの内容のファイルへの書き戻し
+ *
+ * 引数:
+ *	buf: 書き戻すバッファ
+ *
+ * 返り値:
+ *	成功の場合OK、失敗の場合NG
+ */
+static Result writeBackBuffer(Buffer *buf)
+{
+  /* 位置を指定して書き出すので、ファイルの読み書き位置は使わない */
+  if (transferPage(buf->desc, buf->pageNum, buf->page, 1) != OK) {
+    return NG;
+  }
+  countWrite(buf->fileId, 1);
+
+  /* 変更フラグを0に戻す */
+  markClean(buf);
+  return OK;
+}
+
+/*
+ * compareBufferPageNum -- バッファをページ番号の順に並べるための比較関数
+ */
+static int compareBufferPageNum(const void *x, const void *y)
+{
+  const Buffer *a = *(const Buffer **) x;
+  const Buffer *b = *(const Buffer **) y;
+
+  return (a->pageNum > b->pageNum) - (a->pageNum < b->pageNum);
+}
+
+/*
+ * flushFileBuffers -- ファイルの変更済みのページをすべて書き戻す
+ *
+ * 変更済みのページをページ番号の順に並べ、ページ番号が連続している部分を
+ * 1つの要求にまとめる。すべての要求をページ入出力モジュールに一度に渡すので、
+ * io_uringを使っている場合は、それぞれの連続した部分が並行して書き出される。
+ *
+ * 引数:
+ *	fileId: ファイル識別番号
+ *
+ * 返り値:
+ *	成功の場合OK、失敗の場合NG
+ */
+static Result flushFileBuffers(int fileId)
+{
+  FileEntry *entry = &fileTable[fileId];
+  Buffer **dirty;
+  Buffer *buf;
+  struct iovec *iov;
+  PageRequest *reqs, **reqList;
+  int n, numReqs, start, end, written, i, j;
+  Result result = OK;
+
+  if (entry->numDirty == 0) {
+    return OK;
+  }
+
+  /* 変更済みのバッファを集めて、ページ番号の順に並べる */
+  n = entry->numDirty;
+  dirty = (Buffer **) malloc(sizeof(Buffer *) * n);
+  iov = (struct iovec *) malloc(sizeof(struct iovec) * n);
+  reqs = (PageRequest *) malloc(sizeof(PageRequest) * n);
+  reqList = (PageRequest **) malloc(sizeof(PageRequest *) * n);
+  if (dirty == NULL || iov == NULL || reqs == NULL || reqList == NULL) {
+    free(dirty);
+    free(iov);
+    free(reqs);
+    free(reqList);
+    return NG;
+  }
+  i = 0;
+  for (buf = entry->dirtyHead; buf != NULL; buf = buf->dirtyNext) {
+    dirty[i++] = buf;
+  }
+  qsort(dirty, n, sizeof(Buffer *), compareBufferPageNum);
+
+  /* ページ番号が連続している部分ごとに要求を作る(1つの要求はIOV_MAXページまで) */
+  numReqs = 0;
+  for (start = 0; start < n; start = end) {
+    for (end = start + 1; end < n && end - start < IOV_MAX &&
+           dirty[end]->pageNum == dirty[end - 1]->pageNum + 1; end++) {
+      ;
+    }
+    for (i = start; i < end; i++) {
+      iov[i].iov_base = dirty[i]->page;
+      iov[i].iov_len = PAGE_SIZE;
+    }
+    reqs[numReqs].desc = dirty[start]->desc;
+    reqs[numReqs].write = 1;
+    reqs[numReqs].pageNum = dirty[start]->pageNum;
+    reqs[numReqs].numPages = end - start;
+    reqs[numReqs].iov = &iov[start];
+    reqList[numReqs] = &reqs[numReqs];
+    numReqs++;
+  }
+
+  if (submitPageRequests(reqList, numReqs) != OK) {
+    result = NG;
+  }
+
+  /* 書き出せたページを未変更にする(途中までしか書けなかった要求は、残りを1ページずつ書き出す) */
+  start = 0;
+  for (i = 0; i < numReqs; i++) {
+    written = (reqs[i].bytes < 0) ? 0 : (int) (reqs[i].bytes / PAGE_SIZE);
+    if (written > reqs[i].numPages) {
+      written = reqs[i].numPages;
+    }
+    if (written > 0) {
+      countWrite(fileId, written);
+    }
+    for (j = 0; j < reqs[i].numPages; j++) {
+      if (j < written) {
+        markClean(dirty[start + j]);
+      } else if (writeBackBuffer(dirty[start + j]) != OK) {
+        result = NG;
+      }
+    }
+    start += reqs[i].numPages;
+  }
+
+  free(dirty);
+  free(iov);
+  free(reqs);
+  free(reqList);
+  return result;
+}
+
+/*
+ * hashPage -- ページ表のバケット番号の計算
+ *
+ * 引数:
+ *	fileId: ファイル識別番号
+ *	pageNum: ページ番号
+ *
+ * 返り値:
+ *	バケット番号
+ */
+static unsigned int hashPage(int fileId, int pageNum)
+{
+  unsigned int h;
+
+  /* 連続したページ番号が別々のバケットに散らばるように混ぜる */
+  h = (unsigned int) pageNum * 0x9e3779b1u;
+  h ^= (unsigned int) fileId * 0x85ebca6bu;
+  h ^= h >> 15;
+  return h & pageTableMask;
+}
+
+/*
+ * insertPageTable -- バッファをページ表に登録する
+ *
+ * 引数:
+ *	buf: 登録するバッファ(fileIdとpageNumを設定済みのもの)
+ *
+ * 返り値:
+ *	なし
+ */
+static void insertPageTable(Buffer *buf)
+{
+  unsigned int h = hashPage(buf->fileId, buf->pageNum);
+
+  buf->hashNext = pageTable[h];
+  pageTable[h] = buf;
+}
+
+/*
+ * removePageTable -- バッファをページ表から取り除く
+ *
+ * 引数:
+ *	buf: 取り除くバッファ
+ *
+ * 返り値:
+ *	なし
+ */
+static void removePageTable(Buffer *buf)
+{
+  Buffer **p;
+
+  for (p = &pageTable[hashPage(buf->fileId, buf->pageNum)]; *p != NULL; p = &(*p)->hashNext) {
+    if (*p == buf) {
+      *p = buf->hashNext;
+      buf->hashNext = NULL;
+      return;
+    }
+  }
+}
+
+/*
+ * findBuffer -- 指定したページを保持しているバッファを探す
+ *
+ * 引数:
+ *	fileId: ファイル識別番号
+ *	pageNum: ページ番号
+ *
+ * 返り値:
+ *	見つかればそのバッファ、見つからなければNULLを返す
+ */
+static Buffer *findBuffer(int fileId, int pageNum)
+{
+  Buffer *buf;
+
+  /* ページ表の該当するバケットだけを探す */
+  for (buf = pageTable[hashPage(fileId, pageNum)]; buf != NULL; buf = buf->hashNext) {
+    if (buf->fileId == fileId && buf->pageNum == pageNum) {
+      return buf;
+    }
+  }
+
+  return NULL;
+}
+
+/*
+ * releaseBuffer -- バッファに入っていたページを書き戻して、ページ表から外す
+ *
+ * 引数:
+ *	buf: 空けるバッファ
+ *
+ * 返り値:
+ *	成功の場合OK、書き戻しに失敗した場合NG
+ */
+static Result releaseBuffer(Buffer *buf)
+{
+  if (buf->fileId == -1) {
+    return OK;
+  }
+
+  /* 変更フラグが立っていたら、その内容をファイルに書き戻す */
+  if (buf->modified == MODIFIED) {
+    if (writeBackBuffer(buf) != OK) {
+      return NG;
+    }
+    totalStats.dirtyWritebacks++;
+    fileStats(buf->fileId)->dirtyWritebacks++;
+  }
+  totalStats.evictions++;
+  fileStats(buf->fileId)->evictions++;
+
+  /* 先読みしたのに一度も参照されなかったページ */
+  if (buf->prefetched) {
+    totalStats.prefetchMisses++;
+    fileStats(buf->fileId)->prefetchMisses++;
+    buf->prefetched = 0;
+  }
+
+  /* 前のページの登録をページ表から外す */
+  removePageTable(buf);
+  buf->fileId = -1;
+  buf->pageNum = -1;
+  return OK;
+}
+
+/*
+ * getEmptyBuffer -- ページを読み込むためのバッファの確保
+ *
+ * 未使用のバッファがあればそれを使い、なければ置換方式が選んだバッファを
+ * 空けて使う。変更されていれば書き戻してから空ける。
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	空けたバッファ(どのリストにも入っていないもの)を返す。すべてのバッファが
+ *	ピンされている場合や書き戻しに失敗した場合はNULLを返す。
+ */
+static Buffer *getEmptyBuffer()
+{
+  Buffer *buf;
+
+  if ((buf = freeList.head) != NULL) {
+    listRemove(&freeList, buf);
+    return buf;
+  }
+
+  /* すべてのバッファがピンされている */
+  if ((buf = policy->victim()) == NULL) {
+    return NULL;
+  }
+
+  if (releaseBuffer(buf) != OK) {
+    /* 書き戻せなかったページは捨てずに管理対象に戻しておく */
+    policy->admit(buf);
+    return NULL;
+  }
+  return buf;
+}
+
+/*
+ * getRingBuffer -- 順次走査用リングからページを読み込むためのバッファを確保
+ *
+ * 順次走査で読むページは、リングのバッファを順に使い回して読み込む。
+ * 大きなテーブルを走査しても、共有のバッファにあるページは追い出されない。
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	空けたバッファを返す。リングのバッファがすべてピンされている場合や
+ *	書き戻しに失敗した場合はNULLを返す。(呼び出し側は共有のバッファを使う)
+ */
+static Buffer *getRingBuffer()
+{
+  Buffer *buf;
+  int i;
+
+  for (i = 0; i < numRing; i++) {
+    buf = &bufferPool[numBuffer + ringHand];
+    ringHand = (ringHand + 1) % numRing;
+    if (buf->pinCount == 0) {
+      return (releaseBuffer(buf) == OK) ? buf : NULL;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * putEmptyBuffer -- 使わなかったバッファを未使用のバッファに戻す
+ *
+ * 引数:
+ *	buf: getEmptyBufferまたはgetRingBufferで確保したバッファ
+ *
+ * 返り値:
+ *	なし
+ */
+static void putEmptyBuffer(Buffer *buf)
+{
+  if (buf->fileId != -1) {
+    markClean(buf);
+  }
+  buf->fileId = -1;
+  buf->pageNum = -1;
+  buf->pinCount = 0;
+  buf->prefetched = 0;
+  buf->readaheadMark = 0;
+  buf->asyncRead = -1;
+  if (!buf->inRing) {
+    listPushHead(&freeList, buf, QUEUE_FREE);
+  }
+}
+
+/*
+ * finishAsyncRead -- 発行した先読みの要求の完了を待ち、読み込み先のバッファのピンを外す
+ *
+ * 読み込めなかったページのバッファは、ページ表から外して未使用に戻す。
+ *
+ * 引数:
+ *	index: 先読みの要求の番号
+ *
+ * 返り値:
+ *	なし
+ */
+static void finishAsyncRead(int index)
+{
+  AsyncRead *ar = &asyncReads[index];
+  Buffer *buf;
+  int numRead, i;
+
+  if (waitPageRequest(&ar->req) != OK) {
+    ar->req.bytes = -1;
+  }
+  numRead = (ar->req.bytes < 0) ? 0 : (int) (ar->req.bytes / PAGE_SIZE);
+
+  for (i = 0; i < ar->req.numPages; i++) {
+    buf = ar->bufs[i];
+    buf->pinCount--;
+    buf->asyncRead = -1;
+    if (i >= numRead) {
+      removePageTable(buf);
+      if (!buf->inRing) {
+        policy->remove(buf);
+      }
+      putEmptyBuffer(buf);
+    }
+  }
+
+  if (numRead > 0) {
+    countRead(ar->fileId, numRead);
+    totalStats.pagesPrefetched += numRead;
+    fileStats(ar->fileId)->pagesPrefetched += numRead;
+  }
+  ar->used = 0;
+}
+
+/*
+ * finishFileAsyncReads -- ファイルに対して発行した先読みの要求の完了をすべて待つ
+ *
+ * ファイルをクローズしたりバッファを無効にしたりする前に呼ぶ。
+ *
+ * 引数:
+ *	fileId: ファイル識別番号(-1ならすべてのファイル)
+ *
+ * 返り値:
+ *	なし
+ */
+static void finishFileAsyncReads(int fileId)
+{
+  int i;
+
+  for (i = 0; i < MAX_ASYNC_READ; i++) {
+    if (asyncReads[i].used && (fileId == -1 || asyncReads[i].fileId == fileId)) {
+      finishAsyncRead(i);
+    }
+  }
+}
+
+/*
+ * waitWriterIdle -- バックグラウンドライタの書き出しが終わるのを待つ
+ *
+ * バックグラウンドライタが書き出し中のページは、未変更の印をつけたまま
+ * ファイルにはまだ書かれていない。ファイルをクローズしたり、書き戻しを
+ * 保証したりする前に呼ぶ。bufferLockを取った状態で呼ぶこと。
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	なし
+ */
+static void waitWriterIdle()
+{
+  while (writer.busy) {
+    pthread_cond_wait(&writer.idle, &bufferLock);
+  }
+}
+
+/*
+ * invalidateFileBuffers -- 指定したファイルのページをすべてバッファから捨てる
+ *
+ * ファイルを削除したり作り直したりするときに呼び出す。
+ * 変更されたページも書き戻さずに捨てる。
+ *
+ * 引数:
+ *	fileId: ファイル識別番号
+ *
+ * 返り値:
+ *	なし
+ */
+static void invalidateFileBuffers(int fileId)
+{
+  int i;
+
+  waitWriterIdle();
+  finishFileAsyncReads(fileId);
+
+  for (i = 0; i < numBuffer + numRing; i++) {
+    Buffer *buf = &bufferPool[i];
+    if (buf->fileId == fileId) {
+      removePageTable(buf);
+      if (!buf->inRing) {
+        policy->remove(buf);
+      }
+      putEmptyBuffer(buf);
+    }
+  }
+}
+
+/*
+ * lookupFileId -- デバイス番号とiノード番号からファイル識別番号を求める
+ *
+ * 引数:
+ *	dev: デバイス番号
+ *	ino: iノード番号
+ *	create: 見つからなかったときに新しく登録するなら1
+ *
+ * 返り値:
+ *	ファイル識別番号を返す。見つからない(または登録に失敗した)場合は-1を返す。
+ */
+static int lookupFileId(dev_t dev, ino_t ino, int create)
+{
+  FileEntry *newTable;
+  int i, freeId = -1;
+
+  for (i = 0; i < numFileEntry; i++) {
+    if (fileTable[i].used == 0) {
+      if (freeId == -1) {
+        freeId = i;
+      }
+      continue;
+    }
+    if (fileTable[i].dev == dev && fileTable[i].ino == ino) {
+      return i;
+    }
+  }
+
+  if (create == 0) {
+    return -1;
+  }
+
+  /* 空いているエントリがなければ表を広げる */
+  if (freeId == -1) {
+    if (numFileEntry == maxFileEntry) {
+      int newMax = (maxFileEntry == 0) ? 16 : maxFileEntry * 2;
+      if ((newTable = realloc(fileTable, sizeof(FileEntry) * newMax)) == NULL) {
+        return -1;
+      }
+      fileTable = newTable;
+      maxFileEntry = newMax;
+    }
+    freeId = numFileEntry++;
+  }
+
+  fileTable[freeId].used = 1;
+  fileTable[freeId].dev = dev;
+  fileTable[freeId].ino = ino;
+  fileTable[freeId].name[0] = '\0';
+  fileTable[freeId].dirtyHead = NULL;
+  fileTable[freeId].numDirty = 0;
+  fileTable[freeId].lastPage = -1;
+  fileTable[freeId].sequentialRun = 0;
+  fileTable[freeId].readaheadNext = -1;
+  memset(&fileTable[freeId].stats, 0, sizeof(BufferStats));
+  return freeId;
+}
+
+/*
+ * forgetFile -- ファイルに対応するページと識別情報を捨てる
+ *
+ * ファイルの削除や作り直しの前に呼び出し、古い内容がバッファに残らないようにする。
+ * (iノード番号は再利用されることがあるので、識別情報も捨てておく。)
+ *
+ * 引数:
+ *	filename: ファイル名
+ *
+ * 返り値:
+ *	なし
+ */
+static void forgetFile(char *filename)
+{
+  struct stat stbuf;
+  int fileId;
+
+  if (stat(filename, &stbuf) == -1) {
+    return;
+  }
+  if ((fileId = lookupFileId(stbuf.st_dev, stbuf.st_ino, 0)) == -1) {
+    return;
+  }
+
+  invalidateFileBuffers(fileId);
+  fileTable[fileId].used = 0;
+}
+
+
+/*
+ * initializeFileModule -- ファイルアクセスモジュールの初期化処理
+ *
+ * バッファはこの関数で一度だけ確保し、以降はファイルのオープンやクローズを
+ * またいで使い続ける。二回目以降の呼び出しでは何もしない。
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	成功の場合OK、失敗の場合NG
+ */
+Result initializeFileModule()
+{
+  /* すでに初期化済みなら何もしない */
+  if (bufferPool != NULL) {
+    return OK;
+  }
+
+  if(initializeBufferList(getSizeFromEnv(BUFFER_PAGES_ENV, NUM_BUFFER, MIN_BUFFER),
+                          getSizeFromEnv(SCAN_RING_ENV, NUM_SCAN_RING, 0)) != OK){
+    return NG;
+  }
+  setReadaheadWindow(getSizeFromEnv(READAHEAD_ENV, NUM_READAHEAD, 0));
+  if (initializePageIO() != OK) {
+    return NG;
+  }
+
+  /* 環境変数で指定されていれば、バックグラウンドライタを動かす */
+  if (getSizeFromEnv(WRITER_RATE_ENV, 0, 0) > 0) {
+    startBackgroundWriter(getSizeFromEnv(WRITER_RATE_ENV, 0, 0),
+                          getSizeFromEnv(WRITER_CLEAN_ENV, WRITER_CLEAN_PERCENT, 0));
+  }
+  return OK;
+}
+
+/*
+ * finalizeFileModule -- ファイルアクセスモジュールの終了処理
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	成功の場合OK、失敗の場合NG
+ */
+Result finalizeFileModule()
+{
+  Result result;
+
+  if (bufferPool == NULL) {
+    return OK;
+  }
+
+  /* クローズされていないファイルの変更されたページを書き戻す */
+  stopBackgroundWriter();
+  finishFileAsyncReads(-1);
+  result = flushAllBuffers();
+  finalizePageIO();
+
+  free(bufferPool);
+  free(pageArea);
+  free(fileTable);
+  free(pageTable);
+  free(ghostTable);
+  free(ghostBucket);
+  free(accessHeap);
+  bufferPool = NULL;
+  pageTable = NULL;
+  pageArea = NULL;
+  fileTable = NULL;
+  ghostTable = NULL;
+  ghostBucket = NULL;
+  accessHeap = NULL;
+  numBuffer = 0;
+  numRing = 0;
+  numDirtyBuffer = 0;
+  memset(&totalStats, 0, sizeof(totalStats));
+  numFileEntry = 0;
+  maxFileEntry = 0;
+
+  return result;
+}
+
+/*
+ * createFile -- ファイルの作成
+ *
+ * 引数:
+ *	*filename: 作成するファイルのファイル名
+ *
+ * 返り値:
+ *	成功の場合OK、失敗の場合NG
+ */
+Result createFile(char *filename)
+{	
+  int desc;
+
+  /* 同じ名前のファイルがあれば中身が空になるので、そのページを捨てておく */
+  pthread_mutex_lock(&bufferLock);
+  forgetFile(filename);
+  pthread_mutex_unlock(&bufferLock);
+
+  if( (desc = creat(filename, S_IRUSR | S_IWUSR)) == -1 )
+    return NG;	
+  close(desc);
+  return OK;
+}
+
+/*
+ * deleteFile -- ファイルの削除
+ *
+ * 引数:
+ *	*filename
+ *
+ * 返り値:
+ *	Result
+ */
+Result deleteFile(char *filename)
+{	
+  /* 削除するファイルのページをバッファから捨てる */
+  pthread_mutex_lock(&bufferLock);
+  forgetFile(filename);
+  pthread_mutex_unlock(&bufferLock);
+
+  if(unlink(filename) == -1) {
+    return NG;
+  }	
+  return OK;
+}
+
+/*
+ * openFile -- ファイルのオープン
+ *
+ * 引数:
+ *	*fileame
+ *
+ * 返り値:
+ *	オープンしたファイルのFile構造体
+ *	オープンに失敗した場合にはNULLを返す
+ */
+File *openFile(char *filename)
+{
+  File *file;
+  struct stat stbuf;
+
+  /* バッファがまだ確保されていなければ確保する */
+  if (initializeFileModule() != OK) {
+    return NULL;
+  }
+
+  file = malloc(sizeof(File));
+  if ( file == NULL){
+    return NULL;
+  }
+  if( (file -> desc = open(filename , O_RDWR)) == -1 ){
+    free(file);
+    return NULL;
+  }
+
+  /* ファイルの実体からファイル識別番号を決める */
+  pthread_mutex_lock(&bufferLock);
+  if (fstat(file->desc, &stbuf) == -1 ||
+      (file->fileId = lookupFileId(stbuf.st_dev, stbuf.st_ino, 1)) == -1) {
+    pthread_mutex_unlock(&bufferLock);
+    close(file->desc);
+    free(file);
+    return NULL;
+  }
+  file -> access = ACCESS_NORMAL;
+  strncpy(file -> name , filename, MAX_FILENAME - 1);
+  file -> name[MAX_FILENAME - 1] = '\0';
+  strcpy(fileTable[file->fileId].name, file->name);
+  pthread_mutex_unlock(&bufferLock);
+
+  return file;
+}
+
+/*
+ * closeFile -- ファイルのクローズ
+ *
+ * 変更されたページはファイルに書き戻すが、ページ自体はバッファに残しておく。
+ * 次に同じファイルをオープンしたときには、そのページをそのまま使える。
+ *
+ * 引数:
+ *	クローズするファイルのFile構造体
+ *
+ * 返り値:
+ *	成功の場合OK、失敗の場合NG
+ */
+Result closeFile(File *file)
+{
+  Result result;
+
+  pthread_mutex_lock(&bufferLock);
+
+  /* 読み込み中の先読みや書き出し中のページがあれば、ディスクリプタを閉じる前に完了を待つ */
+  waitWriterIdle();
+  finishFileAsyncReads(file->fileId);
+
+  /* 同じファイルの変更済みのページを、連続した部分ごとにまとめて書き戻す */
+  result = flushFileBuffers(file->fileId);
+  pthread_mutex_unlock(&bufferLock);
+  if (result != OK) {
+    return NG;
+  }
+
+  if( close (file -> desc) == -1 ){
+    return NG;
+  }	   
+  free(file); 	
+  return OK;
+}
+
+/*
+ * allocateBuffer -- ファイルのページを読み込むためのバッファの確保
+ *
+ * 順次走査中のファイルなら順次走査用リングのバッファを使い、
+ * リングのバッファがすべてピンされているときは共有のバッファを使う。
+ *
+ * 引数:
+ *	file: アクセスするファイルのFile構造体
+ *
+ * 返り値:
+ *	空けたバッファを返す。確保できなかった場合はNULLを返す。
+ */
+static Buffer *allocateBuffer(File *file)
+{
+  Buffer *buf = NULL;
+
+  if (file->access == ACCESS_SEQUENTIAL && numRing > 0) {
+    buf = getRingBuffer();
+  }
+  if (buf == NULL) {
+    buf = getEmptyBuffer();
+  }
+  return buf;
+}
+
+/*
+ * registerBuffer -- ページを読み込んだバッファをページ表と置換方式に登録する
+ *
+ * 引数:
+ *	buf: ページを読み込んだバッファ
+ *	file: アクセスしたファイルのFile構造体
+ *	pageNum: ページ番号
+ *
+ * 返り値:
+ *	なし
+ */
+static void registerBuffer(Buffer *buf, File *file, int pageNum)
+{
+  buf -> fileId = file -> fileId;
+  buf -> desc = file -> desc;
+  buf -> pageNum = pageNum;
+  insertPageTable(buf);
+
+  /* 新しく読み込んだページを置換方式に登録する(リングのバッファは対象外) */
+  if (!buf->inRing) {
+    policy->admit(buf);
+  }
+}
+
+/*
+ * isSequentialAccess -- ファイルが先頭から順に読まれているかどうかの判定
+ *
+ * ファイルごとに最後に読まれたページを覚えておき、直前のページの次の
+ * ページが続けて読まれていれば順次アクセスとみなす。
+ *
+ * 引数:
+ *	file: アクセスするファイルのFile構造体
+ *	pageNum: 読むページの番号
+ *
+ * 返り値:
+ *	順次アクセスなら1、そうでなければ0を返す。
+ */
+static int isSequentialAccess(File *file, int pageNum)
+{
+  FileEntry *entry = &fileTable[file->fileId];
+
+  if (pageNum == entry->lastPage + 1) {
+    entry->sequentialRun++;
+  } else {
+    entry->sequentialRun = 0;
+  }
+  entry->lastPage = pageNum;
+
+  return file->access == ACCESS_SEQUENTIAL || entry->sequentialRun >= SEQUENTIAL_THRESHOLD;
+}
+
+/*
+ * readaheadLimit -- 一度に先読みできるページ数の上限
+ *
+ * 先読みするページ数は、ファイルの末尾と使えるバッファの数で制限する。
+ * 完了を待たずに次の範囲も読む場合は、順次走査用リングの半分までにする。
+ *
+ * 引数:
+ *	file: アクセスするファイルのFile構造体
+ *	pageNum: 先読みを始めるページの番号
+ *
+ * 返り値:
+ *	先読みできるページ数(0ならファイルの末尾を超えている)
+ */
+static int readaheadLimit(File *file, int pageNum)
+{
+  struct stat st;
+  int window, ring;
+
+  window = (readaheadWindow < MAX_READAHEAD) ? readaheadWindow : MAX_READAHEAD;
+  if (window > IOV_MAX) {
+    window = IOV_MAX;
+  }
+  if (file->access == ACCESS_SEQUENTIAL && numRing > 0) {
+    ring = isAsyncPageIO() ? numRing / 2 : numRing;
+    window = (window < ring) ? window : ((ring > 0) ? ring : 1);
+  } else if (window > numBuffer / 4) {
+    window = (numBuffer / 4 > 0) ? numBuffer / 4 : 1;
+  }
+
+  if (fstat(file->desc, &st) == -1) {
+    return 1;
+  }
+  if (window > st.st_size / PAGE_SIZE - pageNum) {
+    window = (st.st_size / PAGE_SIZE - pageNum > 0) ? (int) (st.st_size / PAGE_SIZE - pageNum) : 0;
+  }
+  return window;
+}
+
+/*
+ * startAsyncReadahead -- 指定したページから先を、完了を待たずに先読みする
+ *
+ * io_uringを使っている場合だけ行う。読み込み先のバッファはすぐにページ表に
+ * 登録し、最初のページに目印をつけておく。そのページが参照されたら、
+ * さらに次の範囲の先読みを始める。
+ *
+ * 引数:
+ *	file: アクセスするファイルのFile構造体
+ *	pageNum: 先読みを始めるページの番号
+ *
+ * 返り値:
+ *	なし
+ */
+static void startAsyncReadahead(File *file, int pageNum)
+{
+  AsyncRead *ar;
+  int window, count, index;
+
+  if (!isAsyncPageIO() || readaheadWindow <= 1) {
+    return;
+  }
+  for (index = 0; index < MAX_ASYNC_READ && asyncReads[index].used; index++) {
+    ;
+  }
+  if (index == MAX_ASYNC_READ) {
+    return;
+  }
+  ar = &asyncReads[index];
+
+  window = readaheadLimit(file, pageNum);
+  for (count = 0; count < window; count++) {
+    if (findBuffer(file->fileId, pageNum + count) != NULL ||
+        (ar->bufs[count] = allocateBuffer(file)) == NULL) {
+      break;
+    }
+    ar->bufs[count]->pinCount++;
+    ar->iov[count].iov_base = ar->bufs[count]->page;
+    ar->iov[count].iov_len = PAGE_SIZE;
+  }
+  if (count == 0) {
+    return;
+  }
+
+  ar->used = 1;
+  ar->fileId = file->fileId;
+  ar->req.desc = file->desc;
+  ar->req.write = 0;
+  ar->req.pageNum = pageNum;
+  ar->req.numPages = count;
+  ar->req.iov = ar->iov;
+  if (startPageRequest(&ar->req) != OK) {
+    /* 発行できなかったので、その場で読み込む */
+    PageRequest *req = &ar->req;
+    submitPageRequests(&req, 1);
+  }
+
+  /* 完了していなくても、ページ表に登録しておく(参照されたら完了を待つ) */
+  for (count = 0; count < ar->req.numPages; count++) {
+    registerBuffer(ar->bufs[count], file, pageNum + count);
+    ar->bufs[count]->prefetched = 1;
+    ar->bufs[count]->asyncRead = index;
+  }
+  ar->bufs[0]->readaheadMark = 1;
+  fileTable[file->fileId].readaheadNext = pageNum + ar->req.numPages;
+}
+
+/*
+ * readAhead -- 指定したページとそれに続くページをまとめて読み込む
+ *
+ * 続くページのうちバッファにないものについて空きバッファを確保し、
+ * 1つの要求で読み込む。さらにその次の範囲を、io_uringを使っていれば
+ * 完了を待たずに読み込み始め、そうでなければposix_fadviseでカーネルに
+ * 先読みさせておき、次の読み込みがディスクを待たずに済むようにする。
+ *
+ * 引数:
+ *	file: アクセスするファイルのFile構造体
+ *	pageNum: 要求されたページの番号
+ *	buf: 要求されたページを読み込むバッファ(登録は呼び出し側で行う)
+ *
+ * 返り値:
+ *	要求されたページを読み込めればOK、失敗の場合NG
+ */
+static Result readAhead(File *file, int pageNum, Buffer *buf)
+{
+  Buffer *batch[MAX_READAHEAD];
+  struct iovec iov[MAX_READAHEAD];
+  PageRequest req, *reqs = &req;
+  int window, count, numRead, i;
+
+  if ((window = readaheadLimit(file, pageNum)) < 1) {
+    window = 1;
+  }
+
+  /*
+   * 読み込み中のバッファが他のページに使われないよう、一時的にピンしておく
+   * (バッファにあるページに当たったら、そこで先読みをやめる)
+   */
+  batch[0] = buf;
+  buf->pinCount++;
+  for (count = 1; count < window; count++) {
+    if (findBuffer(file->fileId, pageNum + count) != NULL ||
+        (batch[count] = allocateBuffer(file)) == NULL) {
+      break;
+    }
+    batch[count]->pinCount++;
+  }
+
+  for (i = 0; i < count; i++) {
+    iov[i].iov_base = batch[i]->page;
+    iov[i].iov_len = PAGE_SIZE;
+  }
+  req.desc = file->desc;
+  req.write = 0;
+  req.pageNum = pageNum;
+  req.numPages = count;
+  req.iov = iov;
+  if (submitPageRequests(&reqs, 1) != OK) {
+    req.bytes = -1;
+  }
+  numRead = (req.bytes < 0) ? 0 : (int) (req.bytes / PAGE_SIZE);
+
+  /* 読み込めたページだけ登録し、残りのバッファは未使用に戻す */
+  for (i = 1; i < count; i++) {
+    batch[i]->pinCount--;
+    if (i < numRead) {
+      registerBuffer(batch[i], file, pageNum + i);
+      batch[i]->prefetched = 1;
+    } else {
+      putEmptyBuffer(batch[i]);
+    }
+  }
+
+  if (numRead == 0) {
+    buf->pinCount--;
+    return NG;
+  }
+  countRead(file->fileId, numRead);
+  totalStats.pagesPrefetched += numRead - 1;
+  fileStats(file->fileId)->pagesPrefetched += numRead - 1;
+
+  /* 次に読まれる範囲を読み込み始めておく */
+  if (numRead == count) {
+    if (isAsyncPageIO()) {
+      startAsyncReadahead(file, pageNum + count);
+    } else if (readaheadWindow > 1) {
+      posix_fadvise(file->desc, (off_t) (pageNum + count) * PAGE_SIZE,
+                    (off_t) readaheadWindow * PAGE_SIZE, POSIX_FADV_WILLNEED);
+    }
+  }
+  buf->pinCount--;
+
+  return OK;
+}
+
+/*
+ * fetchBuffer -- 指定したページを保持するバッファの取得
+ *
+ * ページがバッファになければ空きバッファを用意し、readFromDiskが1なら
+ * ファイルから読み込み、0ならページの内容を0で埋める。
+ * 順次走査中のファイルのページは、順次走査用リングのバッファに読み込む。
+ * ファイルが順に読まれているときは、続くページもまとめて先読みする。
+ *
+ * 引数:
+ *	file: アクセスするファイルのFile構造体
+ *	pageNum: ページ番号
+ *	readFromDisk: バッファにないときにファイルから読み込むなら1
+ *
+ * 返り値:
+ *	成功の場合はバッファ、失敗の場合はNULLを返す
+ */
+static Buffer *fetchBuffer(File *file, int pageNum, int readFromDisk)
+{
+  Buffer *buf;
+  int sequential = 0;
+
+  if (readFromDisk) {
+    sequential = isSequentialAccess(file, pageNum);
+  }
+
+  /* 先読みで読み込み中のページなら、完了を待つ(読み込めなければバッファから消える) */
+  if ((buf = findBuffer(file->fileId, pageNum)) != NULL && buf->asyncRead != -1) {
+    finishAsyncRead(buf->asyncRead);
+    buf = findBuffer(file->fileId, pageNum);
+  }
+
+  /* 要求されたページがバッファに保存されているかどうか探す */
+  if (buf != NULL) {
+    totalStats.hits++;
+    fileStats(file->fileId)->hits++;
+
+    /* 先読みしておいたページが参照された */
+    if (buf->prefetched) {
+      totalStats.prefetchHits++;
+      fileStats(file->fileId)->prefetchHits++;
+      buf->prefetched = 0;
+    }
+
+    /* 参照されたことを置換方式に知らせる(リングのバッファは対象外) */
+    if (!buf->inRing) {
+      policy->touch(buf);
+    }
+    buf -> desc = file -> desc;
+
+    /* 目印のページまで読み進んだら、次の範囲の先読みを始める */
+    if (buf->readaheadMark) {
+      buf->readaheadMark = 0;
+      if (sequential) {
+        buf->pinCount++;
+        startAsyncReadahead(file, fileTable[file->fileId].readaheadNext);
+        buf->pinCount--;
+      }
+    }
+    return buf;
+  }
+
+  totalStats.misses++;
+  fileStats(file->fileId)->misses++;
+
+  /*
+   * 空きバッファを用意する(必要なら置換方式が選んだバッファを書き戻して空ける)
+   * 先読みの読み込み中やバックグラウンドライタの書き出し中でピンされている
+   * バッファしかなければ、その完了を待つ
+   */
+  if ((buf = allocateBuffer(file)) == NULL) {
+    waitWriterIdle();
+    finishFileAsyncReads(-1);
+    if ((buf = allocateBuffer(file)) == NULL) {
+      fprintf(stderr, "Cannot get an empty buffer.\n");
+      return NULL;
+    }
+  }
+
+  if (readFromDisk && sequential && readaheadWindow > 1) {
+    /* 順次アクセスなので、続くページもまとめて読み込む */
+    if (readAhead(file, pageNum, buf) != OK) {
+      putEmptyBuffer(buf);
+      return NULL;
+    }
+  } else if (readFromDisk) {
+    /*
+     * 空きバッファにファイルの内容を読み込む
+     * (位置を指定して読むので、ファイルの読み書き位置は使わない)
+     */
+    if (transferPage(file->desc, pageNum, buf->page, 0) != OK) {
+      putEmptyBuffer(buf);
+      return NULL;
+    }
+    countRead(file->fileId, 1);
+  } else {
+    memset(buf->page, 0, PAGE_SIZE);
+  }
+
+  /* Buffer構造体への各種情報の設定 */
+  registerBuffer(buf, file, pageNum);
+
+  return buf;
+}
+
+/*
+ * readPage -- 1ページ分のデータのファイルからの読み出し
+ *
+ * 引数:
+ *	file: アクセスするファイルのFile構造体
+ *	pageNum: 読み出すページの番号
+ *	page: 読み出した内容を格納するPAGE_SIZEバイトの領域
+ *
+ * 返り値:
+ *	成功の場合OK、失敗の場合NG
+ */
+Result readPage(File *file, int pageNum, char *page)
+{
+  Buffer *buf;
+
+  pthread_mutex_lock(&bufferLock);
+  if ((buf = fetchBuffer(file, pageNum, 1)) == NULL) {
+    pthread_mutex_unlock(&bufferLock);
+    return NG;
+  }
+
+  /* バッファの内容を引数のpageにコピーする */
+  memcpy(page, buf -> page , PAGE_SIZE );
+  pthread_mutex_unlock(&bufferLock);
+
+  return OK;
+}
+
+/*
+ * writePage -- 1ページ分のデータのファイルへの書き出し
+ *
+ * 引数:
+ *	file: アクセスするファイルのFile構造体
+ *	pageNum: 書き出すページの番号
+ *	page: 書き出す内容を格納するPAGE_SIZEバイトの領域
+ *
+ * 返り値:
+ *	成功の場合OK、失敗の場合NG
+ */
+Result writePage(File *file, int pageNum, char *page)
+{
+  Buffer *buf;
+
+  /* ページ全体を書き換えるので、バッファになくてもファイルからは読み込まない */
+  pthread_mutex_lock(&bufferLock);
+  if ((buf = fetchBuffer(file, pageNum, 0)) == NULL) {
+    pthread_mutex_unlock(&bufferLock);
+    return NG;
+  }
+
+  /* バッファに引数のpageの内容をコピーする */
+  memcpy(buf -> page, page, PAGE_SIZE );
+
+  /*データの更新を行ったのでMODIFIEDにする*/
+  markDirty(buf);
+  pthread_mutex_unlock(&bufferLock);
+
+  return OK;
+}
+
+/*
+ * pinPage -- ページをバッファに固定し、その内容を直接参照する
+ *
+ * readPageと異なり、ページの内容をコピーせず、バッファ内の領域へのポインタを返す。
+ * ピンしたページはunpinPageを呼ぶまで追い出されない。
+ *
+ * 引数:
+ *	file: アクセスするファイルのFile構造体
+ *	pageNum: ページ番号
+ *	page: バッファ内のページ(PAGE_SIZEバイト)へのポインタを格納する場所
+ *
+ * 返り値:
+ *	成功の場合OK、失敗の場合NG
+ *
+ * ***注意***
+ *	ピンしたページは、使い終わったら必ずunpinPageで固定を解除すること。
+ *	ページの内容を書き換えた場合はunpinPageにMODIFIEDを渡すこと。
+ */
+Result pinPage(File *file, int pageNum, char **page)
+{
+  Buffer *buf;
+
+  pthread_mutex_lock(&bufferLock);
+  if ((buf = fetchBuffer(file, pageNum, 1)) == NULL) {
+    pthread_mutex_unlock(&bufferLock);
+    return NG;
+  }
+
+  buf -> pinCount++;
+  *page = buf -> page;
+  pthread_mutex_unlock(&bufferLock);
+
+  return OK;
+}
+
+/*
+ * pinNewPage -- 新しいページを用意してバッファに固定する
+ *
+ * ファイルの末尾に追加するページのように、ファイルから読み込む必要のない
+ * ページに使う。ページの内容は0で埋められ、変更済みとして扱われる。
+ *
+ * 引数:
+ *	file: アクセスするファイルのFile構造体
+ *	pageNum: ページ番号
+ *	page: バッファ内のページ(PAGE_SIZEバイト)へのポインタを格納する場所
+ *
+ * 返り値:
+ *	成功の場合OK、失敗の場合NG
+ */
+Result pinNewPage(File *file, int pageNum, char **page)
+{
+  Buffer *buf;
+
+  pthread_mutex_lock(&bufferLock);
+  if ((buf = fetchBuffer(file, pageNum, 0)) == NULL) {
+    pthread_mutex_unlock(&bufferLock);
+    return NG;
+  }
+
+  memset(buf -> page, 0, PAGE_SIZE);
+  markDirty(buf);
+  buf -> pinCount++;
+  *page = buf -> page;
+  pthread_mutex_unlock(&bufferLock);
+
+  return OK;
+}
 
 /*
- * bufferListTail -- LRUリストの最後へのポインタ
+ * unpinPage -- pinPageで固定したページの固定の解除
+ *
+ * 引数:
+ *	file: アクセスするファイルのFile構造体
+ *	pageNum: ページ番号
+ *	modified: ページの内容を書き換えた場合はMODIFIED
+ *
+ * 返り値:
+ *	成功の場合OK、ページがピンされていない場合NG
  */
-static Buffer *bufferListTail = NULL;
+Result unpinPage(File *file, int pageNum, modifyFlag modified)
+{
+  Buffer *buf;
+
+  pthread_mutex_lock(&bufferLock);
+  if ((buf = findBuffer(file->fileId, pageNum)) == NULL || buf->pinCount == 0) {
+    pthread_mutex_unlock(&bufferLock);
+    return NG;
+  }
+
+  if (modified == MODIFIED) {
+    markDirty(buf);
+  }
+  buf -> pinCount--;
+  pthread_mutex_unlock(&bufferLock);
+
+  return OK;
+}
 
 /*
- * initializeBufferList -- バッファリストの初期化
+ * flushAllBuffers -- すべてのファイルの変更済みのページを書き戻す(チェックポイント)
  *
- * **注意**
- *	この関数は、ファイルアクセスモジュールを使用する前に必ず一度だけ呼び出すこと。
- *	(initializeFileModule()から呼び出すこと。)
+ * ファイルごとに、ページ番号が連続している部分をまとめて書き出す。
+ * 書き戻したページはバッファに残る。
  *
  * 引数:
  *	なし
  *
  * 返り値:
- *	初期化に成功すればOK、失敗すればNGを返す。
+ *	成功の場合OK、失敗の場合NG
  */
-static Result initializeBufferList()
+Result flushAllBuffers()
 {
-  Buffer *oldBuf = NULL;
-  Buffer *buf;
+  Result result = OK;
   int i;
 
-  /*
-   * NUM_BUFFER個分のバッファを用意し、
-   * ポインタをつないで両方向リストにする
-   */
-  for (i = 0; i < NUM_BUFFER; i++) {	
-    /* 1個分のバッファ(Buffer構造体)のメモリ領域の確保 */
-    if ((buf = (Buffer *) malloc(sizeof(Buffer))) == NULL) {
-      /* メモリ不足なのでエラーを返す */
-      return NG;
-    }
-
-    /* Buffer構造体の初期化 */
-    buf->file = NULL;
-    buf->pageNum = -1;
-    buf->modified = UNMODIFIED;
-    memset(buf->page, 0, PAGE_SIZE);
-    buf->prev = NULL;
-    buf->next = NULL;
-
-    /* ポインタをつないで両方向リストにする */
-    if (oldBuf != NULL) {
-      oldBuf->next = buf;
-    }
-    buf->prev = oldBuf;
-
-    /* リストの一番最初の要素へのポインタを保存 */
-    if (buf->prev == NULL) {
-      bufferListHead = buf;
-    }
-
-    /* リストの一番最後の要素へのポインタを保存 */
-    if (i == NUM_BUFFER - 1) {
-      bufferListTail = buf;
+  pthread_mutex_lock(&bufferLock);
+  waitWriterIdle();
+  for (i = 0; i < numFileEntry; i++) {
+    if (fileTable[i].used && fileTable[i].numDirty > 0) {
+      if (flushFileBuffers(i) != OK) {
+        result = NG;
+      }
     }
-
-    /* 次のループのために保存 */
-    oldBuf = buf;
   }
+  pthread_mutex_unlock(&bufferLock);
 
-  return OK;
+  return result;
 }
 
-
 /*
- * moveBufferToListHead -- バッファをリストの先頭へ移動
+ * writerRound -- バックグラウンドライタが1回分の書き出しを行う
+ *
+ * 変更済みのバッファが目標の割合を超えていれば、バッファを順に調べて
+ * ピンされていない変更済みのバッファを選ぶ。選んだページの内容を写して
+ * 未変更の印をつけ、書き出しが終わるまでピンしておく(追い出されて
+ * 古い内容が読み直されないようにするため)。書き出しの間はロックを外すので、
+ * その間にページが変更されても、また変更済みになるだけで内容は失われない。
+ * bufferLockを取った状態で呼ぶこと。
  *
  * 引数:
- *	buf: リストの先頭に移動させるバッファへのポインタ
+ *	limit: 書き出すページ数の上限
  *
  * 返り値:
- *	なし
+ *	書き出したページ数
  */
-static void moveBufferToListHead(Buffer *buf)
+static int writerRound(int limit)
 {
-  /*　先頭のポインタを見つけるようのポインタ*/
-  Buffer *p = NULL;
-  int i;
+  Buffer *buf;
+  int maxDirty, total, n, scanned, i;
 
-  /* bufferが先頭の場合何もしない */
-  if( buf == bufferListHead){
-    return ;
+  maxDirty = (int) ((long) numBuffer * (100 - writer.cleanPercent) / 100);
+  if (numDirtyBuffer - maxDirty < limit) {
+    limit = numDirtyBuffer - maxDirty;
+  }
+  if (limit > WRITER_BATCH) {
+    limit = WRITER_BATCH;
   }
 
-  /* bufferが最後尾の場合*/
-  if( buf == bufferListTail){
+  /* 書き出すバッファを選ぶ */
+  total = numBuffer + numRing;
+  n = 0;
+  for (scanned = 0; scanned < total && n < limit; scanned++) {
+    buf = &bufferPool[writer.hand];
+    writer.hand = (writer.hand + 1) % total;
+    if (buf->fileId == -1 || buf->modified != MODIFIED ||
+        buf->pinCount > 0 || buf->asyncRead != -1) {
+      continue;
+    }
+    memcpy(writer.copies + (size_t) PAGE_SIZE * n, buf->page, PAGE_SIZE);
+    writer.bufs[n] = buf;
+    writer.descs[n] = buf->desc;
+    writer.pageNums[n] = buf->pageNum;
+    markClean(buf);
+    buf->pinCount++;
+    n++;
+  }
+  if (n == 0) {
+    return 0;
+  }
 
-    /*最後尾を更新*/
-    bufferListTail =  buf -> prev;
+  /* ロックを外して書き出す */
+  writer.busy = 1;
+  pthread_mutex_unlock(&bufferLock);
+  for (i = 0; i < n; i++) {
+    writer.written[i] = (pwrite(writer.descs[i], writer.copies + (size_t) PAGE_SIZE * i,
+                                PAGE_SIZE, (off_t) writer.pageNums[i] * PAGE_SIZE) == PAGE_SIZE);
+  }
+  pthread_mutex_lock(&bufferLock);
 
-    /*リストからの削除処理*/
-    bufferListTail -> next = NULL;
-    buf -> prev = NULL;
+  /* 書き出せなかったページは変更済みに戻す */
+  for (i = 0; i < n; i++) {
+    buf = writer.bufs[i];
+    buf->pinCount--;
+    if (writer.written[i]) {
+      countWrite(buf->fileId, 1);
+      totalStats.backgroundWrites++;
+      fileStats(buf->fileId)->backgroundWrites++;
+    } else {
+      markDirty(buf);
+    }
+  }
+  writer.busy = 0;
+  pthread_cond_broadcast(&writer.idle);
 
-    /*先頭への挿入処理*/
-    buf -> next = bufferListHead;
-    buf -> next -> prev = buf;
-      
-    /*先頭を更新*/
-    bufferListHead = buf;
+  return n;
+}
 
-    return ;
-  }
+/*
+ * writerMain -- バックグラウンドライタのスレッドの本体
+ *
+ * WRITER_INTERVAL_MSごとに、1秒あたりpagesPerSecondページの割合を超えない
+ * 範囲で、変更済みのバッファを書き出す。変更済みのバッファが目標を超えると
+ * 間隔の途中でも起こされるが、その間隔の分の上限を使い切っていれば待つ。
+ */
+static void *writerMain(void *arg)
+{
+  struct timespec deadline;
+  int budget, n;
 
-  /*リストからの削除処理*/
-  buf -> prev -> next = buf -> next;
-  buf -> next -> prev = buf -> prev;
+  pthread_mutex_lock(&bufferLock);
+  while (!writer.stop) {
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += (long) WRITER_INTERVAL_MS * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+    budget = (int) ((long) writer.pagesPerSecond * WRITER_INTERVAL_MS / 1000);
+    if (budget < 1) {
+      budget = 1;
+    }
 
-  /*先頭への挿入処理*/
-  buf -> next = bufferListHead;
-  buf -> prev = NULL;
-  buf -> next -> prev = buf;
+    for (;;) {
+      while (budget > 0 && !writer.stop && (n = writerRound(budget)) > 0) {
+        budget -= n;
+      }
+      if (writer.stop ||
+          pthread_cond_timedwait(&writer.wake, &bufferLock, &deadline) != 0) {
+        break;
+      }
+    }
+  }
+  pthread_mutex_unlock(&bufferLock);
 
-  /*先頭を更新*/
-  bufferListHead = buf;
+  return NULL;
 }
 
-
 /*
- * initializeFileModule -- ファイルアクセスモジュールの初期化処理
+ * startBackgroundWriter -- バックグラウンドライタを動かす
+ *
+ * 変更済みのページを追い出される前に少しずつ書き出しておき、ページを
+ * 読み込むときに追い出すバッファがほとんど未変更であるようにする。
  *
  * 引数:
- *	なし
+ *	pagesPerSecond: 1秒間に書き出すページ数の上限
+ *	cleanPercent: 未変更(または未使用)のバッファの割合(%)の目標
  *
  * 返り値:
  *	成功の場合OK、失敗の場合NG
  */
-Result initializeFileModule()
+Result startBackgroundWriter(int pagesPerSecond, int cleanPercent)
 {
-  if(initializeBufferList() != OK){
+  if (bufferPool == NULL || writer.running || pagesPerSecond < 1 ||
+      cleanPercent < 0 || cleanPercent > 100) {
+    return NG;
+  }
+
+  if ((writer.copies = (char *) malloc((size_t) PAGE_SIZE * WRITER_BATCH)) == NULL) {
+    return NG;
+  }
+  writer.pagesPerSecond = pagesPerSecond;
+  writer.cleanPercent = cleanPercent;
+  writer.hand = 0;
+  writer.stop = 0;
+  writer.busy = 0;
+  if (pthread_create(&writer.thread, NULL, writerMain, NULL) != 0) {
+    free(writer.copies);
+    writer.copies = NULL;
     return NG;
   }
+  writer.running = 1;
+
   return OK;
 }
 
 /*
- * finalizeFileModule -- ファイルアクセスモジュールの終了処理
+ * stopBackgroundWriter -- バックグラウンドライタを止める
  *
  * 引数:
  *	なし
  *
  * 返り値:
- *	成功の場合OK、失敗の場合NG
+ *	なし
  */
-Result finalizeFileModule()
+void stopBackgroundWriter()
 {
-  return OK;
+  if (!writer.running) {
+    return;
+  }
+
+  pthread_mutex_lock(&bufferLock);
+  writer.stop = 1;
+  pthread_cond_signal(&writer.wake);
+  pthread_mutex_unlock(&bufferLock);
+
+  pthread_join(writer.thread, NULL);
+  free(writer.copies);
+  writer.copies = NULL;
+  writer.running = 0;
 }
 
 /*
- * createFile -- ファイルの作成
+ * setFileAccessMode -- ファイルのアクセスの仕方の指定
+ *
+ * ACCESS_SEQUENTIALを指定すると、以降バッファにないページは順次走査用の
+ * リングに読み込むようになる。テーブル全体を走査するときに使う。
  *
  * 引数:
- *	*filename: 作成するファイルのファイル名
+ *	file: アクセスするファイルのFile構造体
+ *	access: アクセスの仕方
  *
  * 返り値:
- *	成功の場合OK、失敗の場合NG
+ *	なし
  */
-Result createFile(char *filename)
-{	
-  if( creat(filename, S_IRUSR | S_IWUSR) == -1 )
-    return NG;	
-  return OK;
+void setFileAccessMode(File *file, AccessMode access)
+{
+  file -> access = access;
+
+  /* カーネルにもアクセスの仕方を伝えておく */
+  posix_fadvise(file->desc, 0, 0,
+                (access == ACCESS_SEQUENTIAL) ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_NORMAL);
 }
 
 /*
- * deleteFile -- ファイルの削除
+ * setReadaheadWindow -- 順次アクセスのときに先読みするページ数の指定
  *
  * 引数:
- *	*filename
+ *	pages: 先読みするページ数(要求されたページを含む)。0または1なら先読みしない。
  *
  * 返り値:
- *	Result
+ *	なし
  */
-Result deleteFile(char *filename)
-{	
-  if(unlink(filename) == -1) {
-    return NG;
-  }	
-  return OK;
+void setReadaheadWindow(int pages)
+{
+  if (pages < 0) {
+    pages = 0;
+  } else if (pages > MAX_READAHEAD) {
+    pages = MAX_READAHEAD;
+  }
+  readaheadWindow = pages;
 }
 
 /*
- * openFile -- ファイルのオープン
+ * getNumPage -- ファイルのページ数の取得
  *
  * 引数:
- *	*fileame
+ *	filename: ファイル名
  *
  * 返り値:
- *	オープンしたファイルのFile構造体
- *	オープンに失敗した場合にはNULLを返す
+ *	引数で指定されたファイルの大きさ(ページ数)
+ *	エラーの場合には-1を返す
  */
-File *openFile(char *filename)
+int getNumPages(char *filename)
 {
-  File *file;
-  file = malloc(sizeof(File));
-  if ( file == NULL){
-    return NULL;
-  }
-  initializeFileModule();
-  if( (file -> desc = open(filename , O_RDWR)) == -1 ){
-    return NULL;
+  struct stat stbuf;	
+  if(stat (filename , &stbuf) == -1){
+    return -1;
   }
-  strcpy(file -> name , filename);
-	
-
-  return file;
+  return (stbuf.st_size/PAGE_SIZE);
 }
 
 /*
- * closeFile -- ファイルのクローズ
+ * mapFile -- ファイル全体を読み取り専用でメモリにマップする
+ *
+ * 大きなファイルを先頭から順に読むときに、バッファを通さずにページを
+ * 直接参照するために使う。バッファに残っている変更済みのページを
+ * 先に書き戻しておくので、マップした内容はバッファの内容と一致する。
+ * マップしている間は、このファイルにページを書き込まないこと。
  *
  * 引数:
- *	クローズするファイルのFile構造体
+ *	file: マップするファイルのFile構造体
+ *	area: マップした領域の先頭を格納する場所(ページ数が0ならNULL)
+ *	numPages: マップしたページ数を格納する場所
  *
  * 返り値:
  *	成功の場合OK、失敗の場合NG
+ *
+ * ***注意***
+ *	マップした領域は、使い終わったら必ずunmapFileで解放すること。
  */
-Result closeFile(File *file)
+Result mapFile(File *file, char **area, int *numPages)
 {
+  struct stat stbuf;
+  Result result;
+  void *addr;
 
-  Buffer *buf,*emptyBuf;
-
-  /*同じファイルから読み込まれているページが複数ある可能性もある*/
-  for (buf = bufferListHead; buf != NULL; buf = buf->next)
-    {
-      /* 引数のファイルが保存されているバッファを見つける */
-      if (buf->file == file ) {
-	/*変更フラグが立っていたら書き戻す*/
-	if( buf -> modified == MODIFIED){
-	  if (lseek(buf -> file -> desc,PAGE_SIZE*buf -> pageNum, SEEK_SET) == -1) {
-	    return NG;
-	  }
-	  if (write(buf -> file -> desc, buf -> page, PAGE_SIZE ) == -1) {
-	    return NG;   
-	  }
-	  /* 変更フラグを0に戻す */
-	  buf -> modified = UNMODIFIED;
-	}
-	/* 書き戻したのでバッファの中身を空にする */
-	buf -> file = NULL; 
-      }
-    }
-  if( close (file -> desc) == -1 ){
+  /* バッファ上の変更をファイルに反映させてからマップする */
+  pthread_mutex_lock(&bufferLock);
+  waitWriterIdle();
+  finishFileAsyncReads(file->fileId);
+  result = flushFileBuffers(file->fileId);
+  pthread_mutex_unlock(&bufferLock);
+  if (result != OK || fstat(file->desc, &stbuf) == -1) {
     return NG;
-  }	   
-  free(file); 	
+  }
+
+  *area = NULL;
+  *numPages = (int) (stbuf.st_size / PAGE_SIZE);
+  if (*numPages == 0) {
+    return OK;
+  }
+
+  addr = mmap(NULL, (size_t) *numPages * PAGE_SIZE, PROT_READ, MAP_SHARED, file->desc, 0);
+  if (addr == MAP_FAILED) {
+    return NG;
+  }
+
+  /* 先頭から順に読むことをカーネルに伝え、先読みさせる */
+  madvise(addr, (size_t) *numPages * PAGE_SIZE, MADV_SEQUENTIAL);
+  *area = (char *) addr;
+
   return OK;
 }
 
 /*
- * readPage -- 1ページ分のデータのファイルからの読み出し
+ * unmapFile -- mapFileでマップした領域の解放
  *
  * 引数:
- *	file: アクセスするファイルのFile構造体
- *	pageNum: 読み出すページの番号
- *	page: 読み出した内容を格納するPAGE_SIZEバイトの領域
+ *	area: マップした領域の先頭
+ *	numPages: マップしたページ数
  *
  * 返り値:
- *	成功の場合OK、失敗の場合NG
+ *	なし
  */
-Result readPage(File *file, int pageNum, char *page)
+void unmapFile(char *area, int numPages)
 {
-	
-  Buffer *buf,*emptyBuf;
-  emptyBuf = NULL;
-  /*
-   * 読み出しを要求されたページがバッファに保存されているかどうか、
-   * リストの先頭から順に探す
-   */
-  for (buf = bufferListHead; buf != NULL; buf = buf->next) {
-    /* 要求されたページがリストの中にあるかどうかチェックする */
-    if (buf->file == file && buf->pageNum == pageNum) {
-      /* 要求されたページがバッファにあったので、その内容を引数のpageにコピーする */
-      memcpy(page, buf -> page , PAGE_SIZE );
-
-      /* アクセスされたバッファを、リストの先頭に移動させる */
-      moveBufferToListHead(buf);
-
-      return OK;
-    }
-
-    /* バッファの空きがあれば,emptyBufとする */
-    if( buf -> file == NULL){
-      // emptyBuf = buf;
-      // emptyBuf -> file = file;
-      // emptyBuf -> pageNum = pageNum;
-      // memcpy(emptyBuf -> page , page , PAGE_SIZE);
-      emptyBuf = buf;
-      break;
-    }
-  }
-	
-  /*空きが見つからなかったら、バッファリストの一番最後のバッファを空ける。*/
-  if( emptyBuf  == NULL){
-    emptyBuf = bufferListTail;
-  }
-    
-  /*
-   *このとき、最後のバッファに変更フラグが立っていたら、
-   *バッファの内容が変更されているので、その内容をlseekとwriteでファイルに書き戻す。
-   */
-  if( emptyBuf -> modified == MODIFIED){
-    if (lseek(emptyBuf -> file -> desc,PAGE_SIZE*emptyBuf ->pageNum, SEEK_SET) == -1) {
-      return NG;
-    }
-    if (write(emptyBuf -> file -> desc, page, PAGE_SIZE ) == -1) {
-      return NG;   
-    }
-    /* 変更フラグを0に戻す */
-    emptyBuf -> modified = UNMODIFIED;
+  if (area != NULL) {
+    munmap(area, (size_t) numPages * PAGE_SIZE);
   }
+}
 
-  /*
-   * lseekとreadシステムコールで空きバッファにファイルの内容を読み込み、
-   * Buffer構造体に保存する
-   */
+/*
+ * getBufferStats -- バッファ全体の統計情報の取得
+ *
+ * 引数:
+ *	stats: 統計情報を格納する構造体
+ *
+ * 返り値:
+ *	なし
+ */
+void getBufferStats(BufferStats *stats)
+{
+  pthread_mutex_lock(&bufferLock);
+  *stats = totalStats;
+  pthread_mutex_unlock(&bufferLock);
+}
+
+/*
+ * getFileBufferStats -- ファイルごとの統計情報の取得
+ *
+ * 引数:
+ *	filename: ファイル名
+ *	stats: 統計情報を格納する構造体
+ *
+ * 返り値:
+ *	成功の場合OK、ファイルがまだオープンされたことがない場合NG
+ */
+Result getFileBufferStats(char *filename, BufferStats *stats)
+{
+  struct stat stbuf;
+  int fileId;
 
-  /* 読み出し位置の設定 */
-  if (lseek(file->desc, pageNum * PAGE_SIZE, SEEK_SET) == -1) {
+  if (stat(filename, &stbuf) == -1) {
     return NG;
   }
 
-  /* 1ページ分のデータをemptyBufへ読み出す */
-  if (read(file->desc, emptyBuf->page, PAGE_SIZE) < PAGE_SIZE) {
+  pthread_mutex_lock(&bufferLock);
+  if ((fileId = lookupFileId(stbuf.st_dev, stbuf.st_ino, 0)) == -1) {
+    pthread_mutex_unlock(&bufferLock);
     return NG;
   }
-
-  /* バッファの内容を引数のpageにコピー */
-  memcpy(page, emptyBuf -> page , PAGE_SIZE );
-
-  /* Buffer構造体(emptyBuf)への各種情報の設定 */
-  emptyBuf -> file = file;
-  emptyBuf -> pageNum = pageNum;
-  memcpy(emptyBuf -> page , page , PAGE_SIZE);
-
-  /* アクセスされたバッファ(emptyBuf)を、リストの先頭に移動させる */
-  moveBufferToListHead(emptyBuf);
-
+  *stats = fileTable[fileId].stats;
+  pthread_mutex_unlock(&bufferLock);
   return OK;
 }
 
 /*
- * writePage -- 1ページ分のデータのファイルへの書き出し
+ * resetBufferStats -- 統計情報を0に戻す
+ *
+ * 処理の段階ごとにヒット率などを測るときに使う。
  *
  * 引数:
- *	file: アクセスするファイルのFile構造体
- *	pageNum: 書き出すページの番号
- *	page: 書き出す内容を格納するPAGE_SIZEバイトの領域
+ *	なし
  *
  * 返り値:
- *	成功の場合OK、失敗の場合NG
+ *	なし
  */
-Result writePage(File *file, int pageNum, char *page)
+void resetBufferStats()
 {
-  Buffer *buf,*emptyBuf;
-  emptyBuf = NULL;
-  /* バッファの先頭が空の時はバッファが空とみなして、先頭にデータを入れて終了 */
-  if( bufferListHead -> file == NULL){
-    emptyBuf = bufferListHead;
-    /* Buffer構造体(emptyBuf)への各種情報の設定 */
-    emptyBuf -> file = file;
-    emptyBuf -> pageNum = pageNum;
-    emptyBuf -> modified = MODIFIED;
-    /* emptyBufに引数のpageを書き込む*/
-    memcpy(emptyBuf -> page , page , PAGE_SIZE);
-
-    bufferListHead = emptyBuf;
-    /* アクセスされたバッファ(emptyBuf)を、リストの先頭に移動させる */
-    moveBufferToListHead(emptyBuf);
+  int i;
 
-    return OK;
-  }
-  /*
-   * 書き出しを要求されたページがバッファに保存されているかどうか、
-   * リストの先頭から順に探す
-   */
-  for (buf = bufferListHead; buf != NULL; buf = buf->next) {
-    /* 要求されたページがリストの中にあるかどうかチェックする */
-    if (buf->file == file && buf->pageNum == pageNum) {
-      /* 要求されたページがバッファにあったので、その引数のpageの内容をバッファにコピーする */
-      memcpy(buf -> page, page, PAGE_SIZE );
-      /*データの更新を行ったのでMODIFIEDにする*/
-      buf -> modified = MODIFIED;
-      /* アクセスされたバッファを、リストの先頭に移動させる */
-      moveBufferToListHead(buf);
-      
-      return OK;
-    }
-    
-    /* バッファの空きがあれば、emptyBufとする */
-    if( buf -> file == NULL){
-      emptyBuf = buf;
-      break;
-    }
-  }
-	
-  /*空きが見つからなかったら、バッファリストの一番最後のバッファを空ける。*/
-  if( emptyBuf == NULL){
-    emptyBuf = bufferListTail;
+  pthread_mutex_lock(&bufferLock);
+  memset(&totalStats, 0, sizeof(totalStats));
+  for (i = 0; i < numFileEntry; i++) {
+    memset(&fileTable[i].stats, 0, sizeof(BufferStats));
   }
-    
-  /*
-   *このとき、最後のバッファに変更フラグが立っていたら、
-   *バッファの内容が変更されているので、その内容をlseekとwriteでファイルに書き戻してから書き直す
-   */
-  if( emptyBuf -> modified == MODIFIED){
-    if (lseek(emptyBuf -> file -> desc,PAGE_SIZE*emptyBuf -> pageNum, SEEK_SET) == -1) {
-      return NG;
-    }
-    if (write(emptyBuf -> file -> desc, emptyBuf -> page, PAGE_SIZE ) == -1) {
-      return NG;   
-    }
-    /* 変更フラグを0に戻す */
-    emptyBuf -> modified = UNMODIFIED;
-  }
-    
-  /* Buffer構造体(emptyBuf)への各種情報の設定 */
-  emptyBuf -> file = file;
-  emptyBuf -> pageNum = pageNum;
-  emptyBuf -> modified = MODIFIED;
-  /* emptyBufに引数のpageを書き込む*/
-  memcpy(emptyBuf -> page , page , PAGE_SIZE);
+  pthread_mutex_unlock(&bufferLock);
+}
 
-  /* アクセスされたバッファ(emptyBuf)を、リストの先頭に移動させる */
-  moveBufferToListHead(emptyBuf);
+/*
+ * printStatsLine -- 統計情報を1行で出力する(printBufferStatsの下請け)
+ */
+static void printStatsLine(char *name, BufferStats *stats)
+{
+  long accesses = stats->hits + stats->misses;
 
-  return OK;
+  printf("%-20s %10ld %10ld %6.1f%% %10ld %10ld %12ld %12ld\n",
+         name, stats->hits, stats->misses,
+         (accesses > 0) ? 100.0 * stats->hits / accesses : 0.0,
+         stats->evictions, stats->dirtyWritebacks,
+         stats->bytesRead, stats->bytesWritten);
 }
 
 /*
- * getNumPage -- ファイルのページ数の取得
+ * printBufferStats -- バッファの利用状況の出力
  *
- * 引数:
- *	filename: ファイル名
- *
- * 返り値:
- *	引数で指定されたファイルの大きさ(ページ数)
- *	エラーの場合には-1を返す
+ * 置換方式、バッファの使用状況、全体とファイルごとの統計情報を出力する。
  */
-int getNumPages(char *filename)
+void printBufferStats()
 {
-  struct stat stbuf;	
-  if(stat (filename , &stbuf) == -1){
-    return -1;
+  int i, numUsed = 0, numDirty = 0, numPinned = 0;
+
+  if (bufferPool == NULL) {
+    printf("Buffer pool is not initialized.\n");
+    return;
   }
-  return (stbuf.st_size/PAGE_SIZE);
+
+  pthread_mutex_lock(&bufferLock);
+  for (i = 0; i < numBuffer + numRing; i++) {
+    if (bufferPool[i].fileId == -1) {
+      continue;
+    }
+    numUsed++;
+    if (bufferPool[i].modified == MODIFIED) {
+      numDirty++;
+    }
+    if (bufferPool[i].pinCount > 0) {
+      numPinned++;
+    }
+  }
+
+  printf("policy: %s, io: %s, pages: %d (+%d scan ring), used: %d, dirty: %d, pinned: %d\n",
+         policy->name, getPageIOName(), numBuffer, numRing, numUsed, numDirty, numPinned);
+  printf("%-20s %10s %10s %7s %10s %10s %12s %12s\n",
+         "file", "hits", "misses", "ratio", "evictions", "writebacks",
+         "bytes read", "bytes written");
+  for (i = 0; i < numFileEntry; i++) {
+    BufferStats *stats = &fileTable[i].stats;
+    if (fileTable[i].used == 0 || stats->hits + stats->misses + stats->pagesWritten == 0) {
+      continue;
+    }
+    printStatsLine(fileTable[i].name, stats);
+  }
+  printStatsLine("(total)", &totalStats);
+  printf("readahead: window %d pages, prefetched: %ld, prefetch hits: %ld, prefetch misses: %ld\n",
+         readaheadWindow, totalStats.pagesPrefetched,
+         totalStats.prefetchHits, totalStats.prefetchMisses);
+  if (writer.running) {
+    printf("background writer: %d pages/s, target clean %d%%, written: %ld\n",
+           writer.pagesPerSecond, writer.cleanPercent, totalStats.backgroundWrites);
+  } else {
+    printf("background writer: off\n");
+  }
+  pthread_mutex_unlock(&bufferLock);
 }
 
 /*
  * printBufferList -- バッファのリストの内容の出力(テスト用)
+ *
+ * 使用中のバッファについてはページの最初の3バイトを出力し、
+ * 未使用のバッファは個数だけをまとめて出力する。
  */
 void printBufferList()
 {
     Buffer *buf;
+    int i;
 
-    printf("Buffer List:");
+    pthread_mutex_lock(&bufferLock);
+    printf("Buffer List(%s):", policy->name);
 
     /* それぞれのバッファの最初の3バイトだけ出力する */
-    for (buf = bufferListHead; buf != NULL; buf = buf->next) {
-  if (buf->file == NULL) {
-      printf("(empty) ");
-  } else {
-      printf("    %c%c%c ", buf->page[0], buf->page[1], buf->page[2]);
-  }
+    for (i = 0; i < numBuffer + numRing; i++) {
+	buf = &bufferPool[i];
+	if (buf->fileId != -1) {
+	    printf("    %c%c%c ", buf->page[0], buf->page[1], buf->page[2]);
+	}
+    }
+
+    if (freeList.count > 0) {
+	printf("(empty) x %d", freeList.count);
     }
 
     printf("\n");
+    pthread_mutex_unlock(&bufferLock);
 }
@@ -0,0 +1,297 @@
+/*
+ * freespace.c -- 空き領域マップモジュール
+ *
+ * データファイルのページごとに、未使用のレコードの場所が残っているかどうかを
+ * 1ビットで表したビットマップを、データファイルとは別のファイル(空き領域
+ * マップファイル)に置く。レコードの挿入ではこのビットを引いて、空きのある
+ * ページへ直接行く(なければファイルの末尾にページを足す)。
+ *
+ * 空き領域マップファイルの構造(ファイル名: tableName.fsm)
+ *   ページ0: 管理情報(FreeSpaceMeta)
+ *   ページ1以降: ビットマップ。ページ1 + kのビットiが、データファイルの
+ *               ページ k * FSM_PAGE_BITS + iに空きがあることを表す
+ *
+ * ビットが立っていないページは満杯として扱う。ビットは挿入と削除のたびに
+ * 更新するが、挿入する側でもページの中を確かめ、空きがなければビットを落とす。
+ */
+
+#include "microdb.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * FSM_FILE_EXT -- 空き領域マップファイルの拡張子
+ */
+#define FSM_FILE_EXT ".fsm"
+
+/*
+ * FSM_MAGIC -- 空き領域マップファイルの先頭ページに書いておく識別用の値
+ */
+#define FSM_MAGIC 0x46534d50
+
+/*
+ * FSM_META_PAGE -- 管理情報を置くページの番号
+ */
+#define FSM_META_PAGE 0
+
+/*
+ * FSM_PAGE_BITS -- ビットマップの1ページが受け持つデータファイルのページの数
+ */
+#define FSM_PAGE_BITS (PAGE_SIZE * 8)
+
+/*
+ * FreeSpaceMeta -- 空き領域マップファイルの管理情報(ページ0)
+ *
+ * 空き領域マップファイルのページ数はバッファに残っているページを含めて
+ * ここで数える(getNumPagesは書き出したページしか数えないため)。
+ */
+typedef struct FreeSpaceMeta FreeSpaceMeta;
+struct FreeSpaceMeta {
+    int magic;                          /* FSM_MAGIC */
+    int numPage;                        /* 空き領域マップファイルのページ数 */
+    int firstFree;                      /* これより前のページにはビットが立っていない */
+};
+
+/*
+ * getFreeSpaceFileName -- 空き領域マップファイルの名前を作る
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *
+ * 返り値:
+ *	[tableName].fsmという文字列(文のアリーナに確保する)を返す。
+ *	失敗したらNULLを返す
+ */
+static char *getFreeSpaceFileName(char *tableName)
+{
+    char *filename;
+    int len;
+
+    len = strlen(tableName) + strlen(FSM_FILE_EXT) + 1;
+    if ((filename = allocateMemory(len)) == NULL) {
+        return NULL;
+    }
+    snprintf(filename, len, "%s%s", tableName, FSM_FILE_EXT);
+
+    return filename;
+}
+
+/*
+ * pinFreeSpaceMeta -- 空き領域マップファイルの管理情報のページを固定する
+ *
+ * 返り値:
+ *	成功ならOK、空き領域マップファイルでなかったり失敗したらNGを返す
+ */
+static Result pinFreeSpaceMeta(File *file, FreeSpaceMeta **meta)
+{
+    char *page;
+
+    if (pinPage(file, FSM_META_PAGE, &page) != OK) {
+        return NG;
+    }
+    *meta = (FreeSpaceMeta *) page;
+    if ((*meta) -> magic != FSM_MAGIC) {
+        unpinPage(file, FSM_META_PAGE, UNMODIFIED);
+        return NG;
+    }
+    return OK;
+}
+
+/*
+ * createFreeSpaceFile -- 空き領域マップファイルの作成
+ *
+ * 作成直後は、どのページにもビットが立っていない(データファイルが空の状態)。
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *
+ * 返り値:
+ *	作成に成功したらOK、失敗したらNGを返す
+ */
+Result createFreeSpaceFile(char *tableName)
+{
+    char *filename, *page;
+    File *file;
+    FreeSpaceMeta *meta;
+
+    if ((filename = getFreeSpaceFileName(tableName)) == NULL ||
+        createFile(filename) != OK) {
+        return NG;
+    }
+    if ((file = openFile(filename)) == NULL) {
+        return NG;
+    }
+
+    if (pinNewPage(file, FSM_META_PAGE, &page) != OK) {
+        closeFile(file);
+        return NG;
+    }
+    meta = (FreeSpaceMeta *) page;
+    meta -> magic = FSM_MAGIC;
+    meta -> numPage = FSM_META_PAGE + 1;
+    meta -> firstFree = 0;
+    unpinPage(file, FSM_META_PAGE, MODIFIED);
+
+    return closeFile(file);
+}
+
+/*
+ * deleteFreeSpaceFile -- 空き領域マップファイルの削除
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *
+ * 返り値:
+ *	削除に成功したらOK、失敗したらNGを返す
+ */
+Result deleteFreeSpaceFile(char *tableName)
+{
+    char *filename;
+
+    if ((filename = getFreeSpaceFileName(tableName)) == NULL) {
+        return NG;
+    }
+    return deleteFile(filename);
+}
+
+/*
+ * openFreeSpaceFile -- 空き領域マップファイルのオープン
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *
+ * 返り値:
+ *	オープンした空き領域マップファイルのFile構造体を返す。
+ *	ファイルがないか失敗したらNULLを返す
+ *	使い終わったらcloseFileで閉じること
+ */
+File *openFreeSpaceFile(char *tableName)
+{
+    char *filename;
+
+    if ((filename = getFreeSpaceFileName(tableName)) == NULL) {
+        return NULL;
+    }
+    return openFile(filename);
+}
+
+/*
+ * setPageFree -- データファイルのページに空きがあるかどうかを記録する
+ *
+ * ビットマップのページが足りなければ、ファイルの末尾に足す。
+ *
+ * 引数:
+ *	file: 空き領域マップファイル
+ *	pageNum: データファイルのページ番号
+ *	free: 空きがあれば1、満杯なら0
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す
+ */
+Result setPageFree(File *file, int pageNum, int free)
+{
+    FreeSpaceMeta *meta;
+    char *page;
+    int mapPage = FSM_META_PAGE + 1 + pageNum / FSM_PAGE_BITS;
+    int bit = pageNum % FSM_PAGE_BITS;
+    unsigned char mask = (unsigned char) (1 << (bit % 8));
+    modifyFlag modified = UNMODIFIED;
+    Result result = OK;
+
+    if (pageNum < 0 || pinFreeSpaceMeta(file, &meta) != OK) {
+        return NG;
+    }
+
+    if (mapPage >= meta -> numPage) {
+        /* まだないビットマップのページのビットは立っていない */
+        if (!free) {
+            unpinPage(file, FSM_META_PAGE, UNMODIFIED);
+            return OK;
+        }
+        while (meta -> numPage <= mapPage && result == OK) {
+            if (pinNewPage(file, meta -> numPage, &page) != OK) {
+                result = NG;
+                break;
+            }
+            unpinPage(file, meta -> numPage, MODIFIED);
+            meta -> numPage++;
+            modified = MODIFIED;
+        }
+    }
+
+    if (result == OK && pinPage(file, mapPage, &page) == OK) {
+        if (free && !(page[bit / 8] & mask)) {
+            page[bit / 8] |= mask;
+            unpinPage(file, mapPage, MODIFIED);
+        } else if (!free && (page[bit / 8] & mask)) {
+            page[bit / 8] &= ~mask;
+            unpinPage(file, mapPage, MODIFIED);
+        } else {
+            unpinPage(file, mapPage, UNMODIFIED);
+        }
+        /* 空いたページが探し始める位置より前なら、そこから探すようにする */
+        if (free && pageNum < meta -> firstFree) {
+            meta -> firstFree = pageNum;
+            modified = MODIFIED;
+        }
+    } else {
+        result = NG;
+    }
+
+    unpinPage(file, FSM_META_PAGE, modified);
+    return result;
+}
+
+/*
+ * findFreePage -- 空きのあるデータファイルのページを探す
+ *
+ * 見つけたページより前にはビットが立っていないので、次はそこから探す。
+ * 満杯のページが続く大きなテーブルでも、見るのはたいてい管理情報と
+ * ビットマップの1ページだけである。
+ *
+ * 引数:
+ *	file: 空き領域マップファイル
+ *
+ * 返り値:
+ *	空きのある一番前のページの番号を返す。なければ-1、失敗したら-2を返す
+ */
+int findFreePage(File *file)
+{
+    FreeSpaceMeta *meta;
+    unsigned char *p;
+    char *page;
+    int mapPage, i, found = -1;
+    int first;
+
+    if (pinFreeSpaceMeta(file, &meta) != OK) {
+        return -2;
+    }
+    first = meta -> firstFree;
+
+    for (mapPage = FSM_META_PAGE + 1 + first / FSM_PAGE_BITS;
+         mapPage < meta -> numPage && found == -1; mapPage++) {
+        if (pinPage(file, mapPage, &page) != OK) {
+            unpinPage(file, FSM_META_PAGE, UNMODIFIED);
+            return -2;
+        }
+        p = (unsigned char *) page;
+        i = (mapPage == FSM_META_PAGE + 1 + first / FSM_PAGE_BITS) ? (first % FSM_PAGE_BITS) / 8 : 0;
+        for (; i < PAGE_SIZE; i++) {
+            if (p[i] != 0) {
+                found = (mapPage - FSM_META_PAGE - 1) * FSM_PAGE_BITS + i * 8 + __builtin_ctz(p[i]);
+                break;
+            }
+        }
+        unpinPage(file, mapPage, UNMODIFIED);
+    }
+
+    /* 探し始める位置を進めておく(なければビットマップの末尾) */
+    first = (found == -1) ? (meta -> numPage - FSM_META_PAGE - 1) * FSM_PAGE_BITS : found;
+    if (first != meta -> firstFree) {
+        meta -> firstFree = first;
+        unpinPage(file, FSM_META_PAGE, MODIFIED);
+    } else {
+        unpinPage(file, FSM_META_PAGE, UNMODIFIED);
+    }
+    return found;
+}
@@ -0,0 +1,711 @@
+/*
+ * hash.c -- ハッシュ索引モジュール
+ *
+ * string型のフィールドの値から、その値を持つレコードの位置を引くための
+ * ハッシュ表(線形ハッシュ法)を、データファイルとは別のファイル
+ * (ハッシュ索引ファイル)に置く。等しい値の検索は、値のハッシュ値で
+ * 決まるバケットのページ(とそのあふれページ)だけを読めば済む。
+ *
+ * 索引ファイルの構造(ファイル名: tableName.fieldName.hix)
+ *   ページ0: 管理情報(HashMeta)
+ *   ページ1以降: バケットのページとあふれページ(HashPage)
+ *
+ * バケットの数は、要素の数がバケットの容量の一定の割合を超えるたびに
+ * 1つずつ増やす(splitの指すバケットを2つに分ける)。表全体を作り直す
+ * ことはないので、挿入に時間がかかることはない。バケットのページ番号は、
+ * バケットの数が2のべき乗を超えるたびに、それまでと同じ数だけまとめて
+ * ファイルの末尾に予約する(segment)。ページ自体は、そのバケットを作る
+ * 分割のときに1つずつ作る。
+ */
+
+#include "microdb.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * HASH_FILE_EXT -- ハッシュ索引ファイルの拡張子
+ */
+#define HASH_FILE_EXT ".hix"
+
+/*
+ * HASH_MAGIC -- ハッシュ索引ファイルの先頭ページに書いておく識別用の値
+ */
+#define HASH_MAGIC 0x48494458
+
+/*
+ * HASH_META_PAGE -- 管理情報を置くページの番号
+ */
+#define HASH_META_PAGE 0
+
+/*
+ * HASH_MAX_SEGMENT -- バケットのページをまとめて確保する回数の上限
+ *
+ * segment 0はバケット0、segment s(s >= 1)はバケット2^(s-1)〜2^s-1を収める。
+ */
+#define HASH_MAX_SEGMENT 32
+
+/*
+ * HASH_FILL_PERCENT -- バケットを分ける、要素の数とバケットの容量の割合(%)
+ */
+#define HASH_FILL_PERCENT 75
+
+/*
+ * HashMeta -- ハッシュ索引ファイルの管理情報(ページ0)
+ *
+ * バケットの数は2^level + split。要素のハッシュ値hのバケットは
+ * h mod 2^levelで、それがsplitより小さければ(すでに分けたバケットなら)
+ * h mod 2^(level+1)とする。
+ */
+typedef struct HashMeta HashMeta;
+struct HashMeta {
+    int magic;                          /* HASH_MAGIC */
+    int level;                          /* バケットの数の2を底とする対数(切り捨て) */
+    int split;                          /* 次に分けるバケットの番号 */
+    int numEntry;                       /* 要素の数 */
+    int numPage;                        /* 索引ファイルのページ数(次に使うページ番号) */
+    int freePage;                       /* 空いたあふれページのリストの先頭(なければ-1) */
+    int segment[HASH_MAX_SEGMENT];      /* 各segmentの先頭のページ番号 */
+};
+
+/*
+ * HashEntry -- バケットに収める要素
+ */
+typedef struct HashEntry HashEntry;
+struct HashEntry {
+    char key[MAX_STRING];               /* フィールドの値(後ろは0で埋める) */
+    RecordId rid;                       /* レコードの位置 */
+};
+
+/*
+ * HASH_PAGE_ENTRIES -- 1ページに収まる要素の数
+ */
+#define HASH_PAGE_ENTRIES ((int) ((PAGE_SIZE - 2 * sizeof(int)) / sizeof(HashEntry)))
+
+/*
+ * HashPage -- バケットのページ、あふれページ
+ *
+ * 空いたあふれページでは、overflowを空きページのリストのつなぎに使う。
+ */
+typedef struct HashPage HashPage;
+struct HashPage {
+    int numEntry;                       /* 要素の数 */
+    int overflow;                       /* 次のあふれページのページ番号(なければ-1) */
+    HashEntry entry[HASH_PAGE_ENTRIES]; /* 要素(順序はない) */
+};
+
+_Static_assert(sizeof(HashMeta) <= PAGE_SIZE, "HashMeta must fit in a page");
+_Static_assert(sizeof(HashPage) <= PAGE_SIZE, "HashPage must fit in a page");
+
+/*
+ * HashCursor -- openHashCursorで開始した、等しい値の要素の走査の状態
+ */
+struct HashCursor {
+    File *file;                         /* ハッシュ索引ファイル */
+    char key[MAX_STRING];               /* 探す値 */
+    int pageNum;                        /* 固定中のページ番号 */
+    HashPage *page;                     /* 固定中のページ(読み終えたらNULL) */
+    int pos;                            /* 次に調べるページ中の要素の番号 */
+    Result status;                      /* 途中で失敗したらNG */
+};
+
+/*
+ * getHashFileName -- ハッシュ索引ファイルの名前を作る
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *	fieldName: 索引を付けたフィールドの名前
+ *
+ * 返り値:
+ *	[tableName].[fieldName].hixという文字列(文のアリーナに確保する)を返す。
+ *	失敗したらNULLを返す
+ */
+static char *getHashFileName(char *tableName, char *fieldName)
+{
+    char *filename;
+    int len;
+
+    len = strlen(tableName) + 1 + strlen(fieldName) + strlen(HASH_FILE_EXT) + 1;
+    if ((filename = allocateMemory(len)) == NULL) {
+        return NULL;
+    }
+    snprintf(filename, len, "%s.%s%s", tableName, fieldName, HASH_FILE_EXT);
+
+    return filename;
+}
+
+/*
+ * hashKey -- 値のハッシュ値(FNV-1a)を求める
+ */
+static unsigned int hashKey(char *key)
+{
+    unsigned int h = 2166136261u;
+    int i;
+
+    for (i = 0; i < MAX_STRING && key[i] != '\0'; i++) {
+        h = (h ^ (unsigned char) key[i]) * 16777619u;
+    }
+    return h;
+}
+
+/*
+ * sameKey -- 2つの値が等しいかどうか
+ */
+static int sameKey(char *x, char *y)
+{
+    return strncmp(x, y, MAX_STRING) == 0;
+}
+
+/*
+ * getBucket -- ハッシュ値から、要素を収めるバケットの番号を求める
+ */
+static int getBucket(HashMeta *meta, unsigned int h)
+{
+    unsigned int bucket;
+
+    bucket = h & ((1u << meta -> level) - 1);
+    if (bucket < (unsigned int) meta -> split) {
+        bucket = h & ((1u << (meta -> level + 1)) - 1);
+    }
+    return (int) bucket;
+}
+
+/*
+ * getSegment -- バケットを収めるsegmentの番号を求める
+ */
+static int getSegment(int bucket)
+{
+    return (bucket == 0) ? 0 : 32 - __builtin_clz((unsigned int) bucket);
+}
+
+/*
+ * getBucketPage -- バケットのページ番号を求める
+ */
+static int getBucketPage(HashMeta *meta, int bucket)
+{
+    int s = getSegment(bucket);
+
+    return meta -> segment[s] + ((s == 0) ? 0 : bucket - (1 << (s - 1)));
+}
+
+/*
+ * pinHashMeta -- ハッシュ索引ファイルの管理情報のページを固定する
+ *
+ * 返り値:
+ *	成功ならOK、ハッシュ索引ファイルでなかったり失敗したらNGを返す
+ */
+static Result pinHashMeta(File *file, HashMeta **meta)
+{
+    char *page;
+
+    if (pinPage(file, HASH_META_PAGE, &page) != OK) {
+        return NG;
+    }
+    *meta = (HashMeta *) page;
+    if ((*meta) -> magic != HASH_MAGIC) {
+        unpinPage(file, HASH_META_PAGE, UNMODIFIED);
+        return NG;
+    }
+    return OK;
+}
+
+/*
+ * newHashPage -- 空のあふれページを用意して固定する
+ *
+ * 空いたあふれページがあればそれを使い、なければファイルの末尾に作る。
+ *
+ * 引数:
+ *	file: ハッシュ索引ファイル
+ *	meta: 管理情報(固定中)
+ *	pageNum: 用意したページの番号を格納する場所
+ *	page: 用意したページへのポインタを格納する場所
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す
+ */
+static Result newHashPage(File *file, HashMeta *meta, int *pageNum, HashPage **page)
+{
+    char *p;
+
+    if (meta -> freePage != -1) {
+        if (pinPage(file, meta -> freePage, &p) != OK) {
+            return NG;
+        }
+        *pageNum = meta -> freePage;
+        meta -> freePage = ((HashPage *) p) -> overflow;
+    } else {
+        if (pinNewPage(file, meta -> numPage, &p) != OK) {
+            return NG;
+        }
+        *pageNum = meta -> numPage++;
+    }
+    *page = (HashPage *) p;
+    (*page) -> numEntry = 0;
+    (*page) -> overflow = -1;
+
+    return OK;
+}
+
+/*
+ * addEntry -- バケットに要素を加える
+ *
+ * バケットのページとあふれページを順にたどり、空きのあるページに加える。
+ * どのページもいっぱいなら、あふれページを1つ足す。
+ *
+ * 引数:
+ *	file: ハッシュ索引ファイル
+ *	meta: 管理情報(固定中)
+ *	bucket: バケットの番号
+ *	entry: 加える要素
+ *	unique: 1なら、同じ要素がすでにないかどうかを調べる
+ *
+ * 返り値:
+ *	成功ならOK、同じ要素がすでにあったり失敗したらNGを返す
+ */
+static Result addEntry(File *file, HashMeta *meta, int bucket, HashEntry *entry, int unique)
+{
+    HashPage *page, *next;
+    int pageNum, nextNum, spaceNum = -1, i;
+    char *p;
+
+    pageNum = getBucketPage(meta, bucket);
+    for (;;) {
+        if (pinPage(file, pageNum, &p) != OK) {
+            return NG;
+        }
+        page = (HashPage *) p;
+
+        if (unique) {
+            for (i = 0; i < page -> numEntry; i++) {
+                if (sameKey(page -> entry[i].key, entry -> key) &&
+                    page -> entry[i].rid.pageNum == entry -> rid.pageNum &&
+                    page -> entry[i].rid.slot == entry -> rid.slot) {
+                    unpinPage(file, pageNum, UNMODIFIED);
+                    return NG;
+                }
+            }
+        }
+
+        /* 同じ要素を探すときは、最後のページまでたどってから最初の空きに加える */
+        if (page -> numEntry < HASH_PAGE_ENTRIES) {
+            if (!unique) {
+                page -> entry[page -> numEntry++] = *entry;
+                unpinPage(file, pageNum, MODIFIED);
+                return OK;
+            }
+            if (spaceNum == -1) {
+                spaceNum = pageNum;
+            }
+        }
+        if (page -> overflow == -1) {
+            break;
+        }
+        nextNum = page -> overflow;
+        unpinPage(file, pageNum, UNMODIFIED);
+        pageNum = nextNum;
+    }
+
+    /* 空きのあるページがあれば、そこに加える */
+    if (spaceNum != -1) {
+        if (spaceNum != pageNum) {
+            unpinPage(file, pageNum, UNMODIFIED);
+            pageNum = spaceNum;
+            if (pinPage(file, pageNum, &p) != OK) {
+                return NG;
+            }
+            page = (HashPage *) p;
+        }
+        page -> entry[page -> numEntry++] = *entry;
+        unpinPage(file, pageNum, MODIFIED);
+        return OK;
+    }
+
+    /* どのページもいっぱいなら、最後のページにあふれページをつなぐ */
+    if (newHashPage(file, meta, &nextNum, &next) != OK) {
+        unpinPage(file, pageNum, UNMODIFIED);
+        return NG;
+    }
+    next -> entry[next -> numEntry++] = *entry;
+    page -> overflow = nextNum;
+    unpinPage(file, nextNum, MODIFIED);
+    unpinPage(file, pageNum, MODIFIED);
+
+    return OK;
+}
+
+/*
+ * splitBucket -- splitの指すバケットを2つに分ける
+ *
+ * バケットの要素をすべて取り出して、1ビット多いハッシュ値で元の
+ * バケットと新しいバケットに振り分け直す。元のバケットのあふれページは
+ * 空きページのリストに戻す。
+ *
+ * 引数:
+ *	file: ハッシュ索引ファイル
+ *	meta: 管理情報(固定中)
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す
+ */
+static Result splitBucket(File *file, HashMeta *meta)
+{
+    HashEntry *entries = NULL, *q;
+    HashPage *page;
+    int oldBucket, newBucket, s, i, n = 0, max = 0, pageNum, nextNum, primary;
+    Result result = OK;
+    char *p;
+
+    oldBucket = meta -> split;
+    newBucket = oldBucket + (1 << meta -> level);
+
+    /*
+     * 新しいバケットが次のsegmentの最初なら、segmentのページ番号をまとめて
+     * 予約する(ページはバケットを作るときに1つずつ作るので、ここでは書かない)
+     */
+    s = getSegment(newBucket);
+    if (s >= HASH_MAX_SEGMENT) {
+        return OK;
+    }
+    if (newBucket == (1 << (s - 1))) {
+        meta -> segment[s] = meta -> numPage;
+        meta -> numPage += 1 << (s - 1);
+    }
+
+    /* 新しいバケットのページを作る */
+    if (pinNewPage(file, getBucketPage(meta, newBucket), &p) != OK) {
+        return NG;
+    }
+    ((HashPage *) p) -> overflow = -1;
+    unpinPage(file, getBucketPage(meta, newBucket), MODIFIED);
+
+    /* 元のバケットの要素をすべて取り出し、ページを空にする */
+    primary = pageNum = getBucketPage(meta, oldBucket);
+    while (pageNum != -1) {
+        if (pinPage(file, pageNum, &p) != OK) {
+            free(entries);
+            return NG;
+        }
+        page = (HashPage *) p;
+        if (n + page -> numEntry > max) {
+            max = (n + page -> numEntry) * 2;
+            if ((q = (HashEntry *) realloc(entries, sizeof(HashEntry) * max)) == NULL) {
+                unpinPage(file, pageNum, UNMODIFIED);
+                free(entries);
+                return NG;
+            }
+            entries = q;
+        }
+        if (page -> numEntry > 0) {
+            memcpy(&entries[n], page -> entry, sizeof(HashEntry) * page -> numEntry);
+            n += page -> numEntry;
+        }
+
+        nextNum = page -> overflow;
+        page -> numEntry = 0;
+        if (pageNum == primary) {
+            page -> overflow = -1;
+        } else {
+            page -> overflow = meta -> freePage;
+            meta -> freePage = pageNum;
+        }
+        unpinPage(file, pageNum, MODIFIED);
+        pageNum = nextNum;
+    }
+
+    /* バケットの数を1つ増やしてから、要素を振り分け直す */
+    meta -> split++;
+    if (meta -> split == (1 << meta -> level)) {
+        meta -> level++;
+        meta -> split = 0;
+    }
+    for (i = 0; i < n && result == OK; i++) {
+        result = addEntry(file, meta, getBucket(meta, hashKey(entries[i].key)), &entries[i], 0);
+    }
+
+    free(entries);
+    return result;
+}
+
+/*
+ * createHashFile -- 空のハッシュ索引ファイルの作成
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *	fieldName: 索引を付けるフィールドの名前
+ *
+ * 返り値:
+ *	作成に成功したらOK、失敗したらNGを返す
+ */
+Result createHashFile(char *tableName, char *fieldName)
+{
+    char *filename, *page;
+    File *file;
+    HashMeta *meta;
+
+    if ((filename = getHashFileName(tableName, fieldName)) == NULL ||
+        createFile(filename) != OK) {
+        return NG;
+    }
+    if ((file = openFile(filename)) == NULL) {
+        return NG;
+    }
+
+    /* 管理情報と、空のバケット0を作る */
+    if (pinNewPage(file, HASH_META_PAGE, &page) != OK) {
+        closeFile(file);
+        return NG;
+    }
+    meta = (HashMeta *) page;
+    meta -> magic = HASH_MAGIC;
+    meta -> freePage = -1;
+    meta -> segment[0] = 1;
+    meta -> numPage = 2;
+    unpinPage(file, HASH_META_PAGE, MODIFIED);
+
+    if (pinNewPage(file, 1, &page) != OK) {
+        closeFile(file);
+        return NG;
+    }
+    ((HashPage *) page) -> overflow = -1;
+    unpinPage(file, 1, MODIFIED);
+
+    return closeFile(file);
+}
+
+/*
+ * deleteHashFile -- ハッシュ索引ファイルの削除
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *	fieldName: 索引を付けたフィールドの名前
+ *
+ * 返り値:
+ *	削除に成功したらOK、失敗したらNGを返す
+ */
+Result deleteHashFile(char *tableName, char *fieldName)
+{
+    char *filename;
+
+    if ((filename = getHashFileName(tableName, fieldName)) == NULL) {
+        return NG;
+    }
+    return deleteFile(filename);
+}
+
+/*
+ * openHashFile -- ハッシュ索引ファイルのオープン
+ *
+ * 引数:
+ *	tableName: テーブル名
+ *	fieldName: 索引を付けたフィールドの名前
+ *
+ * 返り値:
+ *	オープンしたハッシュ索引ファイルのFile構造体を返す。失敗したらNULLを返す
+ *	使い終わったらcloseFileで閉じること
+ */
+File *openHashFile(char *tableName, char *fieldName)
+{
+    char *filename;
+
+    if ((filename = getHashFileName(tableName, fieldName)) == NULL) {
+        return NULL;
+    }
+    return openFile(filename);
+}
+
+/*
+ * insertHashEntry -- ハッシュ索引に(値, レコードの位置)を挿入する
+ *
+ * 要素の数がバケットの容量のHASH_FILL_PERCENT%を超えたら、
+ * バケットを1つだけ分ける。
+ *
+ * 引数:
+ *	file: ハッシュ索引ファイル
+ *	key: フィールドの値
+ *	rid: レコードの位置
+ *
+ * 返り値:
+ *	成功ならOK、同じ要素がすでにあったり失敗したらNGを返す
+ */
+Result insertHashEntry(File *file, char *key, RecordId *rid)
+{
+    HashMeta *meta;
+    HashEntry entry;
+    long capacity;
+    Result result;
+
+    if (pinHashMeta(file, &meta) != OK) {
+        return NG;
+    }
+    memset(entry.key, 0, MAX_STRING);
+    strncpy(entry.key, key, MAX_STRING);
+    entry.rid = *rid;
+
+    result = addEntry(file, meta, getBucket(meta, hashKey(entry.key)), &entry, 1);
+    if (result == OK) {
+        meta -> numEntry++;
+        capacity = (long) ((1 << meta -> level) + meta -> split) * HASH_PAGE_ENTRIES;
+        if ((long) meta -> numEntry * 100 > capacity * HASH_FILL_PERCENT) {
+            result = splitBucket(file, meta);
+        }
+    }
+
+    unpinPage(file, HASH_META_PAGE, MODIFIED);
+    return result;
+}
+
+/*
+ * deleteHashEntry -- ハッシュ索引から(値, レコードの位置)を取り除く
+ *
+ * 引数:
+ *	file: ハッシュ索引ファイル
+ *	key: フィールドの値
+ *	rid: レコードの位置
+ *
+ * 返り値:
+ *	成功ならOK、その要素がなかったり失敗したらNGを返す
+ */
+Result deleteHashEntry(File *file, char *key, RecordId *rid)
+{
+    HashMeta *meta;
+    HashPage *page;
+    int pageNum, nextNum, i;
+    char *p;
+
+    if (pinHashMeta(file, &meta) != OK) {
+        return NG;
+    }
+
+    pageNum = getBucketPage(meta, getBucket(meta, hashKey(key)));
+    while (pageNum != -1) {
+        if (pinPage(file, pageNum, &p) != OK) {
+            break;
+        }
+        page = (HashPage *) p;
+        for (i = 0; i < page -> numEntry; i++) {
+            if (sameKey(page -> entry[i].key, key) &&
+                page -> entry[i].rid.pageNum == rid -> pageNum &&
+                page -> entry[i].rid.slot == rid -> slot) {
+                /* ページの最後の要素で埋める(要素の順序はない) */
+                page -> entry[i] = page -> entry[--page -> numEntry];
+                unpinPage(file, pageNum, MODIFIED);
+                meta -> numEntry--;
+                unpinPage(file, HASH_META_PAGE, MODIFIED);
+                return OK;
+            }
+        }
+        nextNum = page -> overflow;
+        unpinPage(file, pageNum, UNMODIFIED);
+        pageNum = nextNum;
+    }
+
+    unpinPage(file, HASH_META_PAGE, UNMODIFIED);
+    return NG;
+}
+
+/*
+ * openHashCursor -- 値がkeyの要素の走査の開始
+ *
+ * 値のバケットのページだけを読む。走査中は読んでいるページを1つだけ
+ * 固定しておく。
+ *
+ * 引数:
+ *	file: ハッシュ索引ファイル
+ *	key: 探す値
+ *
+ * 返り値:
+ *	走査の状態(文のアリーナに確保する)を返す。失敗したらNULLを返す
+ *
+ * ***注意***
+ *	走査を終えたら、ページの固定を解除するため必ずcloseHashCursorを呼ぶこと。
+ */
+HashCursor *openHashCursor(File *file, char *key)
+{
+    HashCursor *cursor;
+    HashMeta *meta;
+    char *p;
+
+    if ((cursor = (HashCursor *) allocateMemory(sizeof(HashCursor))) == NULL) {
+        return NULL;
+    }
+    cursor -> file = file;
+    memset(cursor -> key, 0, MAX_STRING);
+    strncpy(cursor -> key, key, MAX_STRING);
+    cursor -> pos = 0;
+    cursor -> status = OK;
+
+    if (pinHashMeta(file, &meta) != OK) {
+        return NULL;
+    }
+    cursor -> pageNum = getBucketPage(meta, getBucket(meta, hashKey(cursor -> key)));
+    unpinPage(file, HASH_META_PAGE, UNMODIFIED);
+
+    if (pinPage(file, cursor -> pageNum, &p) != OK) {
+        return NULL;
+    }
+    cursor -> page = (HashPage *) p;
+
+    return cursor;
+}
+
+/*
+ * nextHashEntry -- 値が等しい次の要素の取り出し
+ *
+ * 引数:
+ *	cursor: 走査の状態
+ *	rid: 要素のレコードの位置を格納する場所
+ *
+ * 返り値:
+ *	要素を取り出せたらOK、もうなければ(または失敗したら)NGを返す
+ */
+Result nextHashEntry(HashCursor *cursor, RecordId *rid)
+{
+    HashEntry *entry;
+    char *p;
+    int next;
+
+    while (cursor -> page != NULL) {
+        while (cursor -> pos < cursor -> page -> numEntry) {
+            entry = &cursor -> page -> entry[cursor -> pos++];
+            if (sameKey(entry -> key, cursor -> key)) {
+                *rid = entry -> rid;
+                return OK;
+            }
+        }
+
+        /* ページを読み終えたら、あふれページに移る */
+        next = cursor -> page -> overflow;
+        unpinPage(cursor -> file, cursor -> pageNum, UNMODIFIED);
+        cursor -> page = NULL;
+        if (next == -1) {
+            break;
+        }
+        if (pinPage(cursor -> file, next, &p) != OK) {
+            cursor -> status = NG;
+            break;
+        }
+        cursor -> pageNum = next;
+        cursor -> page = (HashPage *) p;
+        cursor -> pos = 0;
+    }
+    return NG;
+}
+
+/*
+ * closeHashCursor -- ハッシュ索引の走査の終了
+ *
+ * 引数:
+ *	cursor: 走査の状態
+ *
+ * 返り値:
+ *	走査が成功していればOK、途中で失敗していたらNGを返す
+ *	(ハッシュ索引ファイルは閉じない)
+ */
+Result closeHashCursor(HashCursor *cursor)
+{
+    if (cursor -> page != NULL) {
+        unpinPage(cursor -> file, cursor -> pageNum, UNMODIFIED);
+        cursor -> page = NULL;
+    }
+    return cursor -> status;
+}
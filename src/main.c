@@ -13,7 +13,7 @@
 /*
  * MAX_INPUT -- 入力行の最大文字数
  */
-#define MAX_INPUT 256
+#define MAX_INPUT 65536
 
 /*
  * MAX_TYPE_NUM -- データ型の最大文字数
@@ -157,6 +157,69 @@ static char *getNextToken()
     return start;
 }
 
+/*
+ * callCreateIndex -- create index文の構文解析とcreateIndexの呼び出し
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	なし
+ *
+ * create indexの書式:
+ *	create index on テーブル名 ( フィールド名 )
+ * integer型のフィールドにはB+木索引、string型のフィールドにはハッシュ索引を作る。
+ */
+static void callCreateIndex()
+{
+    char *token;
+    char *tableName;
+    char *fieldName;
+    TableInfo *tableInfo;
+    int i;
+
+    /* "on"、テーブル名、"("、フィールド名、")"の順に読み込む */
+    token = getNextToken();
+    if (token == NULL || (strcmp(token, "on") != 0 && strcmp(token, "ON") != 0) ||
+	(tableName = getNextToken()) == NULL ||
+	(token = getNextToken()) == NULL || strcmp(token, "(") != 0 ||
+	(fieldName = getNextToken()) == NULL ||
+	(token = getNextToken()) == NULL || strcmp(token, ")") != 0) {
+	/* 文法エラー */
+	printf("入力行に間違いがあります。\n");
+	return;
+    }
+
+    /* フィールドがあって、まだ索引がないかどうかを調べる */
+    if ((tableInfo = getTableInfo(tableName)) == NULL) {
+	printf("テーブル%sがありません。\n", tableName);
+	return;
+    }
+    for (i = 0; i < tableInfo->numField; i++) {
+	if (strcmp(tableInfo->fieldInfo[i].name, fieldName) == 0) {
+	    break;
+	}
+    }
+    if (i == tableInfo->numField) {
+	printf("フィールド%sがありません。\n", fieldName);
+	freeTableInfo(tableInfo);
+	return;
+    }
+    if (tableInfo->fieldInfo[i].indexed) {
+	printf("フィールド%sにはすでに索引があります。\n", fieldName);
+	freeTableInfo(tableInfo);
+	return;
+    }
+    freeTableInfo(tableInfo);
+
+    /* createIndexを呼び出し、索引を作成 */
+    if (createIndex(tableName, fieldName) == OK) {
+	printf("索引を作成しました。\n");
+    } else {
+	printf("索引の作成に失敗しました。\n");
+    }
+}
+
 /*
  * callCreateTable -- create文の構文解析とcreateTableの呼び出し
  *
@@ -168,6 +231,7 @@ static char *getNextToken()
  *
  * create tableの書式:
  *	create table テーブル名 ( フィールド名 データ型, ... )
+ * create indexの場合はcallCreateIndexで処理する。
  * 6/19コミット
  */
 void callCreateTable()
@@ -179,6 +243,10 @@ void callCreateTable()
 
     /* createの次のトークンを読み込み、それが"table"かどうかをチェック */
     token = getNextToken();
+    if (token != NULL && strcmp(token, "index") == 0) {
+	callCreateIndex();
+	return;
+    }
     if (token == NULL || strcmp(token, "table") != 0) {
 	/* 文法エラー */
 	printf("入力行に間違いがあります。\n");
@@ -319,63 +387,29 @@ void callDropTable()
 }
 
 /*
- * callInsertRecord -- insert文の構文解析とinsertRecordの呼び出し
+ * parseInsertValues -- insert文の1レコード分の値の並びの構文解析
  *
  * 引数:
- *	なし
+ *	tableInfo: 挿入するテーブルのデータ定義情報
+ *	recordData: 読み込んだ値を収めるレコードのデータ
  *
  * 返り値:
- *	なし
+ *	解析に成功したらOK、間違いがあればメッセージを表示してNGを返す
  *
- * insertの書式:
- *	insert into テーブル名 values ( フィールド値 , ... )
+ * 値の並びの書式:
+ *	( フィールド値 , ... )
  */
-void callInsertRecord()
+static Result parseInsertValues(TableInfo *tableInfo, RecordData *recordData)
 {
-	char *token;
-    char *tableName;
+    char *token;
     int numField;
-    TableInfo *tableInfo;
-    RecordData *recordData;
-    
-    /*recodData構造体のメモリを確保*/
-    if ((recordData = (RecordData *) malloc(sizeof(RecordData))) == NULL) {
-                    /* エラー処理 */
-    	printf("エラーが発生しました");
-    	return;
-    }
-
-    /* insertの次のトークンを読み込み、それが"into"かどうかをチェック */
-    token = getNextToken();
-    if (token == NULL || strcmp(token, "into") != 0) {
-	/* 文法エラー */
-	printf("入力行に間違いがあります。1\n");
-	return;
-    }
-
-    /* テーブル名を読み込む */
-    if ((tableName = getNextToken()) == NULL) {
-	/* 文法エラー */
-	printf("入力行に間違いがあります。2\n");
-	return;
-    }
-
-
-    /* 次のトークンを読み込み、それが"values"かどうかをチェック */
-    token = getNextToken();
-    if (token == NULL || strcmp(token, "values") != 0) {
-	/* 文法エラー */
-	printf("入力行に間違いがあります。3\n");
-	return;
-    }
-
 
     /* 次のトークンを読み込み、それが"("かどうかをチェック */
     token = getNextToken();
     if (token == NULL || strcmp(token, "(") != 0) {
 	/* 文法エラー */
 	printf("入力行に間違いがあります。4\n");
-	return;
+	return NG;
     }
 
     /*
@@ -388,7 +422,7 @@ void callInsertRecord()
 		if ((token = getNextToken()) == NULL) {
 		    /* 文法エラー */
 		    printf("入力行に間違いがあります。5\n");
-		    return;
+		    return NG;
 		}
 
 		/* 読み込んだトークンが")"だったら、ループから抜ける */
@@ -396,10 +430,10 @@ void callInsertRecord()
 		    break;
 		}
 
-		/* テーブル情報の読み込み*/
-		if( (tableInfo = getTableInfo(tableName)) == NULL){
-			printf("指定したテーブルが存在しません\n");
-			return ;
+		/* テーブルのフィールド数より多い値は挿入できない */
+		if (numField >= tableInfo -> numField) {
+		    printf("値の数がフィールド数を超えています。\n");
+		    return NG;
 		}
 
 		/* フィールド名をレコードデータ配列に挿入*/
@@ -417,12 +451,12 @@ void callInsertRecord()
         case TYPE_STRING:
         if(checkTokenString(token) != OK){
         	fprintf(stderr, "入力された書式に間違いがあります\n" );
-		return;
+		return NG;
         }
         if( removeSingleQuote(token) != OK)
 	  {
 	    fprintf(stderr, "エラーが発生しました\n");
-	    return;
+	    return NG;
 	  }
 	token++;
 	strcpy(recordData -> fieldData[numField].stringValue , token);
@@ -430,7 +464,7 @@ void callInsertRecord()
         default:
         /*ここには来ないはず*/
         printf("エラーが発生しました\n");
-        return ;
+        return NG;
     	}
 
 		/* フィールド数をカウントする */
@@ -439,14 +473,14 @@ void callInsertRecord()
 		/* フィールド数が上限を超えていたらエラー */
 		if (numField > MAX_FIELD) {
 		    printf("フィールド数が上限を超えています。\n");
-		    return;
+		    return NG;
 		}
 
 		/* 次のトークンの読み込み */
 		if ((token = getNextToken()) == NULL) {
 		    /* 文法エラー */
 		    printf("入力行に間違いがあります。\n");
-		    return;
+		    return NG;
 		}
 
 		/* 読み込んだトークンが")"だったら、ループから抜ける */
@@ -458,21 +492,359 @@ void callInsertRecord()
 		} else {
 		    /* 文法エラー */
 		    printf("入力行に間違いがあります。\n");
-		    return;
+		    return NG;
 		}
     }
-  	//TODO ...
 
-    /* insertRecordを呼び出し、テーブルを作成 */
-    if (insertRecord(tableName,recordData) == OK) {
-		printf("データを挿入しました\n");
-		free(recordData);
-    } else {
+    return OK;
+}
+
+/*
+ * callInsertRecord -- insert文の構文解析とinsertRecordsの呼び出し
+ *
+ * 値の並びをすべて読み込んでから、まとめて挿入する。
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	なし
+ *
+ * insertの書式:
+ *	insert into テーブル名 values ( フィールド値 , ... ) , ( フィールド値 , ... ) , ...
+ */
+void callInsertRecord()
+{
+	char *token;
+    char *tableName;
+    TableInfo *tableInfo;
+    RecordData *recordData = NULL, *p;
+    int numRecord = 0, maxRecord = 0;
+
+    /* insertの次のトークンを読み込み、それが"into"かどうかをチェック */
+    token = getNextToken();
+    if (token == NULL || strcmp(token, "into") != 0) {
+	/* 文法エラー */
+	printf("入力行に間違いがあります。1\n");
+	return;
+    }
+
+    /* テーブル名を読み込む */
+    if ((tableName = getNextToken()) == NULL) {
+	/* 文法エラー */
+	printf("入力行に間違いがあります。2\n");
+	return;
+    }
+
+
+    /* 次のトークンを読み込み、それが"values"かどうかをチェック */
+    token = getNextToken();
+    if (token == NULL || strcmp(token, "values") != 0) {
+	/* 文法エラー */
+	printf("入力行に間違いがあります。3\n");
+	return;
+    }
+
+    /* テーブル情報の読み込み(値ごとではなく、一度だけ行う) */
+    if( (tableInfo = getTableInfo(tableName)) == NULL){
+	printf("指定したテーブルが存在しません\n");
+	return ;
+    }
+
+    /* ","で区切られた値の並びを、最後まで読み込む */
+    for (;;) {
+	/* recordData配列が足りなくなったら、倍の大きさにしてコピーする */
+	if (numRecord == maxRecord) {
+	    maxRecord = (maxRecord == 0) ? 16 : maxRecord * 2;
+	    if ((p = (RecordData *) allocateMemory(sizeof(RecordData) * maxRecord)) == NULL) {
+		printf("エラーが発生しました");
+		return;
+	    }
+	    if (numRecord > 0) {
+		memcpy(p, recordData, sizeof(RecordData) * numRecord);
+	    }
+	    recordData = p;
+	}
+
+	memset(&recordData[numRecord], 0, sizeof(RecordData));
+	if (parseInsertValues(tableInfo, &recordData[numRecord]) != OK) {
+	    return;
+	}
+	numRecord++;
+
+	/* 入力の最後か、次の値の並びの前の","か */
+	if ((token = getNextToken()) == NULL) {
+	    break;
+	}
+	if (strcmp(token, ",") != 0) {
+	    /* 文法エラー */
+	    printf("入力行に間違いがあります。\n");
+	    return;
+	}
+    }
+
+    /* insertRecordsを呼び出し、まとめて挿入する */
+    if (insertRecords(tableName, recordData, numRecord, NULL) != OK) {
 	printf("データの挿入に失敗しました\n");
-		free(recordData);
+    } else if (numRecord == 1) {
+	printf("データを挿入しました\n");
+    } else {
+	printf("%d件のデータを挿入しました\n", numRecord);
+    }
+}
+
+/*
+ * parseValue -- 条件式の値を読み込んで、比較の節に設定する
+ *
+ * 引数:
+ *	node: 比較の節(dataTypeを設定しておく)
+ *	token: 値の字句
+ *
+ * 返り値:
+ *	成功ならOK、値の書き方が間違っていればNGを返す
+ */
+static Result parseValue(ConditionNode *node, char *token)
+{
+    if (node->numValue >= MAX_IN_VALUES) {
+	printf("値の数が上限を超えています。\n");
+	return NG;
+    }
+
+    if (node->dataType == TYPE_INTEGER) {
+	/* トークンの文字列を整数値に変換して設定 */
+	node->intValues[node->numValue++] = atoi(token);
+	return OK;
+    }
+
+    /* 文字列は''で囲まれているはずなので、取り除いてから設定 */
+    if (checkTokenString(token) != OK || removeSingleQuote(token) != OK) {
+	printf("条件式の指定に間違いがあります。\n");
+	return NG;
+    }
+    strncpy(node->stringValues[node->numValue++], token + 1, MAX_STRING);
+    return OK;
+}
+
+static ConditionNode *parseOrCondition(TableInfo *tableInfo, char **token);
+
+/*
+ * parseComparison -- 比較1つ(または括弧で囲んだ条件式)の構文解析
+ *
+ * 引数:
+ *	tableInfo: 条件式を適用するテーブルの情報
+ *	token: 読み込み済みの次の字句(解析した部分の次の字句に進める)
+ *
+ * 返り値:
+ *	条件式の節を返す。間違いがあればNULLを返す
+ *
+ * 比較の書式:
+ *	フィールド名 比較演算子 値 (比較演算子は =, !=, <, >, <=, >=)
+ *	フィールド名 between 値 and 値
+ *	フィールド名 in ( 値 , ... )
+ *	( 条件式 )
+ */
+static ConditionNode *parseComparison(TableInfo *tableInfo, char **token)
+{
+    static char *operators[] = { "=", "!=", ">", "<", ">=", "<=" };
+    static OperatorType types[] = { OPR_EQUAL, OPR_NOT_EQUAL, OPR_GREATER_THAN,
+				    OPR_LESS_THAN, OPR_GREATER_EQUAL, OPR_LESS_EQUAL };
+#define NUM_OPERATORS ((int) (sizeof(operators) / sizeof(operators[0])))
+    ConditionNode *node;
+    int i;
+
+    if (*token == NULL) {
+	printf("条件式の指定に間違いがあります。\n");
+	return NULL;
+    }
+
+    /* 括弧で囲まれた条件式 */
+    if (strcmp(*token, "(") == 0) {
+	*token = getNextToken();
+	if ((node = parseOrCondition(tableInfo, token)) == NULL) {
+	    return NULL;
+	}
+	if (*token == NULL || strcmp(*token, ")") != 0) {
+	    printf("条件式の指定に間違いがあります。\n");
+	    return NULL;
+	}
+	*token = getNextToken();
+	return node;
+    }
+
+    if ((node = (ConditionNode *) allocateMemory(sizeof(ConditionNode))) == NULL) {
+	printf("メモリが足りません。\n");
+	return NULL;
+    }
+    memset(node, 0, sizeof(ConditionNode));
+    node->type = CONDITION_TERM;
+    strncpy(node->name, *token, MAX_FIELD_NAME - 1);
+
+    /* 条件式に指定されたフィールドのデータ型を調べる */
+    node->dataType = TYPE_UNKNOWN;
+    for (i = 0; i < tableInfo->numField; i++) {
+	if (strcmp(tableInfo->fieldInfo[i].name, node->name) == 0) {
+	    node->dataType = tableInfo->fieldInfo[i].dataType;
+	    break;
+	}
+    }
+    if (node->dataType == TYPE_UNKNOWN) {
+	printf("指定したフィールドが存在しません。\n");
+	return NULL;
+    }
+
+    /* 比較演算子を読み込む */
+    if ((*token = getNextToken()) == NULL) {
+	printf("条件式の指定に間違いがあります。\n");
+	return NULL;
+    }
+
+    if (strcmp(*token, "between") == 0) {
+	/* between 値 and 値 */
+	node->operator = OPR_BETWEEN;
+	if ((*token = getNextToken()) == NULL || parseValue(node, *token) != OK ||
+	    (*token = getNextToken()) == NULL || strcmp(*token, "and") != 0 ||
+	    (*token = getNextToken()) == NULL || parseValue(node, *token) != OK) {
+	    printf("条件式の指定に間違いがあります。\n");
+	    return NULL;
+	}
+    } else if (strcmp(*token, "in") == 0) {
+	/* in ( 値 , ... ) */
+	node->operator = OPR_IN;
+	if ((*token = getNextToken()) == NULL || strcmp(*token, "(") != 0) {
+	    printf("条件式の指定に間違いがあります。\n");
+	    return NULL;
+	}
+	do {
+	    if ((*token = getNextToken()) == NULL || parseValue(node, *token) != OK ||
+		(*token = getNextToken()) == NULL) {
+		printf("条件式の指定に間違いがあります。\n");
+		return NULL;
+	    }
+	} while (strcmp(*token, ",") == 0);
+	if (strcmp(*token, ")") != 0) {
+	    printf("条件式の指定に間違いがあります。\n");
+	    return NULL;
+	}
+    } else {
+	/* フィールド名 比較演算子 値 */
+	for (i = 0; i < NUM_OPERATORS; i++) {
+	    if (strcmp(*token, operators[i]) == 0) {
+		break;
+	    }
+	}
+	if (i == NUM_OPERATORS) {
+	    printf("条件式の指定に間違いがあります。\n");
+	    return NULL;
+	}
+	node->operator = types[i];
+	if ((*token = getNextToken()) == NULL || parseValue(node, *token) != OK) {
+	    printf("条件式の指定に間違いがあります。\n");
+	    return NULL;
+	}
+    }
+
+    *token = getNextToken();
+    return node;
+}
+
+/*
+ * newConditionNode -- and、orの節を作る
+ *
+ * 引数:
+ *	type: CONDITION_ANDまたはCONDITION_OR
+ *	left: 左側の条件式
+ *	right: 右側の条件式
+ *
+ * 返り値:
+ *	作成した節を返す。失敗したらNULLを返す
+ */
+static ConditionNode *newConditionNode(ConditionType type, ConditionNode *left, ConditionNode *right)
+{
+    ConditionNode *node;
+
+    if ((node = (ConditionNode *) allocateMemory(sizeof(ConditionNode))) == NULL) {
+	printf("メモリが足りません。\n");
+	return NULL;
+    }
+    memset(node, 0, sizeof(ConditionNode));
+    node->type = type;
+    node->left = left;
+    node->right = right;
+    return node;
+}
+
+/*
+ * parseAndCondition -- andでつないだ比較の構文解析
+ *
+ * 引数と返り値はparseComparisonと同じ
+ */
+static ConditionNode *parseAndCondition(TableInfo *tableInfo, char **token)
+{
+    ConditionNode *node, *right;
+
+    if ((node = parseComparison(tableInfo, token)) == NULL) {
+	return NULL;
+    }
+    while (*token != NULL && strcmp(*token, "and") == 0) {
+	*token = getNextToken();
+	if ((right = parseComparison(tableInfo, token)) == NULL ||
+	    (node = newConditionNode(CONDITION_AND, node, right)) == NULL) {
+	    return NULL;
+	}
     }
+    return node;
+}
 
+/*
+ * parseOrCondition -- orでつないだ条件式の構文解析(andはorより先に結びつく)
+ *
+ * 引数と返り値はparseComparisonと同じ
+ */
+static ConditionNode *parseOrCondition(TableInfo *tableInfo, char **token)
+{
+    ConditionNode *node, *right;
 
+    if ((node = parseAndCondition(tableInfo, token)) == NULL) {
+	return NULL;
+    }
+    while (*token != NULL && strcmp(*token, "or") == 0) {
+	*token = getNextToken();
+	if ((right = parseAndCondition(tableInfo, token)) == NULL ||
+	    (node = newConditionNode(CONDITION_OR, node, right)) == NULL) {
+	    return NULL;
+	}
+    }
+    return node;
+}
+
+/*
+ * parseCondition -- where以降の条件式の構文解析
+ *
+ * 引数:
+ *	tableInfo: 条件式を適用するテーブルの情報
+ *
+ * 返り値:
+ *	条件式の木(文のアリーナに確保する)を返す。間違いがあればNULLを返す
+ *
+ * 条件式の書式:
+ *	比較 [ and 比較 ... ] [ or 比較 [ and 比較 ... ] ... ]
+ */
+static ConditionNode *parseCondition(TableInfo *tableInfo)
+{
+    ConditionNode *node;
+    char *token;
+
+    token = getNextToken();
+    if ((node = parseOrCondition(tableInfo, &token)) == NULL) {
+	return NULL;
+    }
+
+    /* 条件式の後ろに余分な字句があれば間違い */
+    if (token != NULL) {
+	printf("条件式の指定に間違いがあります。\n");
+	return NULL;
+    }
+    return node;
 }
 
 /*
@@ -485,8 +857,10 @@ void callInsertRecord()
  *	なし
  *
  * selectの書式:
- *	select * from テーブル名 where 条件式
- *	select フィールド名 , ... from テーブル名 where 条件式 (発展課題)
+ *	select [distinct] * from テーブル名 [where 条件式]
+ *	select [distinct] フィールド名 , ... from テーブル名 [where 条件式]
+ *
+ *	条件式の書き方はparseConditionを参照
  */
 void callSelectRecord()
 {
@@ -494,30 +868,59 @@ void callSelectRecord()
     char *tableName;
     TableInfo *tableInfo;
     Condition cond;
-    int i,len;
+    Scan *scan;
+    int i, j;
     //オールマッチを初期化（OSによっては最初に１が入ってしまう)
     cond.allmach = 0 ;
-    /* selectの次のトークンを読み込み、それが"*"かどうかをチェック */
+    /* distinctがなければNOT_DISTINCTにしておく */
+    cond.distinct = NOT_DISTINCT;
+    cond.where = NULL;
+    /* フィールド名の並びがなければすべてのフィールドを取り出す */
+    cond.numColumn = 0;
+
+    /* selectの次のトークンを読み込む */
     token = getNextToken();
 
     /* selectの次のトークンを読み込み、それがdistinctかどうかをチェック */
-    if( strcmp(token, "distinct") ==  0){
+    if(token != NULL && strcmp(token, "distinct") ==  0){
     	/* distinctがあればDISTINCTフラグを立てておく */
     	cond.distinct = DISTINCT;
     	token = getNextToken();
     }
 
-    /* distinctがなければNOT_DISTINCTにしておく */
-    cond.distinct = NOT_DISTINCT;
-
-    if (token == NULL || strcmp(token, "*") != 0) {
+    if (token == NULL) {
 	/* 文法エラー */
 	printf("入力行に間違いがあります。\n");
 	return;
     }
 
-     /* "*"の次のトークンを読み込み、それが"from"かどうかをチェック */
-    token = getNextToken();
+    /* "*"でなければ、","で区切ったフィールド名を"from"の前まで読み込む */
+    if (strcmp(token, "*") == 0) {
+	token = getNextToken();
+    } else {
+	for (;;) {
+	    if (strcmp(token, ",") == 0 || strcmp(token, "from") == 0 ||
+		cond.numColumn >= MAX_FIELD) {
+		/* 文法エラー */
+		printf("入力行に間違いがあります。\n");
+		return;
+	    }
+	    strncpy(cond.columnNames[cond.numColumn], token, MAX_FIELD_NAME - 1);
+	    cond.columnNames[cond.numColumn][MAX_FIELD_NAME - 1] = '\0';
+	    cond.numColumn++;
+
+	    if ((token = getNextToken()) == NULL || strcmp(token, ",") != 0) {
+		break;
+	    }
+	    if ((token = getNextToken()) == NULL) {
+		/* 文法エラー */
+		printf("入力行に間違いがあります。\n");
+		return;
+	    }
+	}
+    }
+
+     /* フィールド名の並びの次のトークンが"from"かどうかをチェック */
     if (token == NULL || strcmp(token, "from") != 0) {
 	/* 文法エラー */
 	printf("入力行に間違いがあります。\n");
@@ -538,6 +941,19 @@ void callSelectRecord()
 	return;
     }
 
+    /* 取り出すフィールドがテーブルにあるかどうかを調べる */
+    for (i = 0; i < cond.numColumn; i++) {
+	for (j = 0; j < tableInfo->numField; j++) {
+	    if (strcmp(tableInfo->fieldInfo[j].name, cond.columnNames[i]) == 0) {
+		break;
+	    }
+	}
+	if (j == tableInfo->numField) {
+	    printf("指定したフィールドが存在しません。\n");
+	    return;
+	}
+    }
+
     /* 
      * 次のトークンを読み込み、それが"where"かどうかをチェック
 	 * その後がNULLならテーブルを全部表示
@@ -547,7 +963,11 @@ void callSelectRecord()
     if(token == NULL ){
 		/*条件なしのフラグを立てる*/
 		cond.allmach = 1;	
-		printRecordSet(selectRecord(tableName,&cond));
+		scan = openScan(tableName,&cond);
+		printScan(scan);
+		if (scan != NULL) {
+		    closeScan(scan);
+		}
 		return ;
 	}
 
@@ -558,107 +978,22 @@ void callSelectRecord()
 	return;
     }
 
-    /* 次のトークンを読み込み、指定するフィールド名を取得！ */
-    token = getNextToken();
-    if (token == NULL){
-	/* 文法エラー */
-	printf("入力行に間違いがあります。\n");
-	return;
-    }
-
-
-    /*ここからは条件式の部分から構造体を作成していく*/
-    strcpy(cond.name, token);
-
-    /* 条件式に指定されたフィールドのデータ型を調べる */
-    cond.dataType = TYPE_UNKNOWN;
-    for (i = 0; i < tableInfo->numField; i++) {
-		if (strcmp(tableInfo->fieldInfo[i].name, cond.name) == 0) {
-		    /* フィールドのデータ型を構造体に設定してループを抜ける */
-		    cond.dataType = tableInfo->fieldInfo[i].dataType;
-		    break;
-		}
-    }
+    /* where以降の条件式を解析する */
+    cond.where = parseCondition(tableInfo);
 
     /* 不要になったメモリ領域を解放する */
     freeTableInfo(tableInfo);
-    
-    if (cond.dataType == TYPE_UNKNOWN) {
-	printf("指定したフィールドが存在しません。\n");
-	return;
-    }
 
-    /* 条件式の比較演算子を読み込む */
-    if ((token = getNextToken()) == NULL) {
-	/* 文法エラー */
-	printf("条件式の指定に間違いがあります。\n");
+    if (cond.where == NULL) {
 	return;
     }
 
-    /* 条件式の比較演算子を構造体に設定 */
-    /*(tokenの文字列を調べてcond.operatorに適切な値を代入する)*/
-    if (strcmp(token, "=") == 0) {
-		cond.operator = OPR_EQUAL;
-
-	}else if(strcmp(token, "!=") == 0){ 	
-		cond.operator = OPR_NOT_EQUAL;	
-
-	}else if(strcmp(token, ">") == 0){ 	
-		cond.operator = OPR_GREATER_THAN;
-
-	}else if(strcmp(token, "<") == 0){ 	
-		cond.operator =	OPR_LESS_THAN;
-	
-	}else{
-		/*ここにくることは無いはず*/
-		printf("条件式の指定に間違いがあります。\n");
-		return;
-	}
-
-    /* 条件式の値を読み込む */
-    if ((token = getNextToken()) == NULL) {
-	/* 文法エラー */
-	printf("条件式の指定に間違いがあります。\n");
-	return;
+    /*条件式にマッチするレコードの表示*/
+    scan = openScan(tableName,&cond);
+    printScan(scan);
+    if (scan != NULL) {
+	closeScan(scan);
     }
-
-    /* 条件式の値を構造体に設定 */
-    if (cond.dataType == TYPE_INTEGER) {
-
-	/* トークンの文字列を整数値に変換していれる */
-	cond.intValue = atoi(token);
-    
-    } else if (cond.dataType == TYPE_STRING) {
-    	
-    	/*文字として''で囲まれているかを判別*/
-    	if( checkTokenString(token) != OK){
-    		printf("条件式の指定に間違いがあります\n"); 
-    		return;
-    	}
-    	/* シングルクォーテーションを取り除く */
-        if( removeSingleQuote(token) != OK){
-        	fprintf(stderr, "エラーが発生しました\n");
-        }
-	token++;
-	len = strlen(token);
-        strncpy(cond.stringValue, token, len );
-
-        // ......
-        // (tokenの文字列を調べてcond.stringValueに適切な値を入れる)
-        // (string型の値は'Tsukuba'のように「'」で囲まれているはずなので、
-        //  まずは囲まれていることを確認し(囲まれていなければ「条件式の指定に間違いがあります。」と表示する)、
-        //  前後の「'」を取り去った文字列をcond.stringValueに入れる)
-        // ......
-	    } else {
-		/* ここに来ることはないはず */
-		fprintf(stderr, "Unknown data type found.\n");
-		exit(1);
-	    }
-	    /*条件式にマッチするレコードの表示*/
-	printRecordSet(selectRecord(tableName,&cond));
-
-
-
 }
 
 /*
@@ -672,6 +1007,8 @@ void callSelectRecord()
  *
  * deleteの書式:
  *	delete from テーブル名 where 条件式
+ *
+ *	条件式の書き方はparseConditionを参照
  */
 void callDeleteRecord()
 {
@@ -679,9 +1016,11 @@ void callDeleteRecord()
     char *tableName;
     TableInfo *tableInfo;
     Condition cond;
-    int i,len;
     //conditionの初期化　OSによっては最初に１が入り、条件を指定してもすべて削除されてしまう
     cond.allmach = 0 ;
+    cond.distinct = NOT_DISTINCT;
+    cond.where = NULL;
+    cond.numColumn = 0;
     /* deleteの次のトークンを読み込み、それが"from"かどうかをチェック */
     token = getNextToken();
     if (token == NULL || strcmp(token, "from") != 0) {
@@ -727,105 +1066,123 @@ void callDeleteRecord()
 	return;
     }
 
-    /* 条件式のフィールド名を読み込む */
-    if ((token = getNextToken()) == NULL) {
-	/* 文法エラー */
-	printf("入力行に間違いがあります。\n");
+    /* where以降の条件式を解析する */
+    cond.where = parseCondition(tableInfo);
 
-	/* 不要になったメモリ領域を解放する */
-	freeTableInfo(tableInfo);
+    /* 不要になったメモリ領域を解放する */
+    freeTableInfo(tableInfo);
 
+    if (cond.where == NULL) {
 	return;
     }
-    strcpy(cond.name, token);
 
-    /* 条件式に指定されたフィールドのデータ型を調べる */
-    cond.dataType = TYPE_UNKNOWN;
-    for (i = 0; i < tableInfo->numField; i++) {
-	if (strcmp(tableInfo->fieldInfo[i].name, cond.name) == 0) {
-	    /* フィールドのデータ型を構造体に設定してループを抜ける */
-	    cond.dataType = tableInfo->fieldInfo[i].dataType;
-	    break;
-	}
+    if (deleteRecord(tableName ,&cond) != OK) {
+	fprintf(stderr, "テーブルの削除に失敗しました\n" );
+	return ;
     }
+}
 
-    /* 不要になったメモリ領域を解放する */
-    freeTableInfo(tableInfo);
-    
-    /* フィールドのデータ型がわからなければ、文法エラー */
-    if (cond.dataType == TYPE_UNKNOWN) {
-	printf("指定したフィールドが存在しません。\n");
+/*
+ * callShowStatement -- show文の構文解析と実行
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	なし
+ *
+ * showの書式:
+ *	show buffer stats
+ *	show arena stats
+ */
+void callShowStatement()
+{
+    char *token;
+    char *target;
+
+    /* showの次のトークンが"buffer"か"arena"、その次が"stats"かどうかをチェック */
+    target = getNextToken();
+    if (target == NULL || (strcmp(target, "buffer") != 0 && strcmp(target, "arena") != 0)) {
+	/* 文法エラー */
+	printf("入力行に間違いがあります。\n");
 	return;
     }
-
-    /* 条件式の比較演算子を読み込む */
-    if ((token = getNextToken()) == NULL) {
+    token = getNextToken();
+    if (token == NULL || strcmp(token, "stats") != 0) {
 	/* 文法エラー */
-	printf("条件式の指定に間違いがあります。\n");
+	printf("入力行に間違いがあります。\n");
 	return;
     }
 
-    /* 条件式の比較演算子を構造体に設定 */
-    /*(tokenの文字列を調べてcond.operatorに適切な値を代入する)*/
-    if (strcmp(token, "=") == 0) {
-		cond.operator = OPR_EQUAL;
-
-	}else if(strcmp(token, "!=") == 0){ 	
-		cond.operator = OPR_NOT_EQUAL;	
-
-	}else if(strcmp(token, ">") == 0){ 	
-		cond.operator = OPR_GREATER_THAN;
+    if (strcmp(target, "arena") == 0) {
+	printArenaStats();
+    } else {
+	printBufferStats();
+    }
+}
 
-	}else if(strcmp(token, "<") == 0){ 	
-		cond.operator =	OPR_LESS_THAN;
-	
-	}else{
-		/*ここにくることは無いはず*/
-		printf("条件式の指定に間違いがあります。\n");
-		return;
-	}
+/*
+ * callResetStatement -- reset文の構文解析と実行
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	なし
+ *
+ * resetの書式:
+ *	reset buffer stats
+ *	reset arena stats
+ */
+void callResetStatement()
+{
+    char *token;
+    char *target;
 
-    /* 条件式の値を読み込む */
-    if ((token = getNextToken()) == NULL) {
+    /* resetの次のトークンが"buffer"か"arena"、その次が"stats"かどうかをチェック */
+    target = getNextToken();
+    if (target == NULL || (strcmp(target, "buffer") != 0 && strcmp(target, "arena") != 0)) {
 	/* 文法エラー */
-	printf("条件式の指定に間違いがあります。\n");
+	printf("入力行に間違いがあります。\n");
+	return;
+    }
+    token = getNextToken();
+    if (token == NULL || strcmp(token, "stats") != 0) {
+	/* 文法エラー */
+	printf("入力行に間違いがあります。\n");
 	return;
     }
 
-    /* 条件式の値を構造体に設定 */
-    if (cond.dataType == TYPE_INTEGER) {
-	/* トークンの文字列を整数値に変換して設定 */
-	cond.intValue = atoi(token);
-    } else if (cond.dataType == TYPE_STRING) {
-    	
-    	/*データが''で囲まれているかの判定*/
-    	if( checkTokenString(token) != OK){
-    		printf("条件式の指定に間違いがあります\n"); 
-    		return;
-    	}
-    	/* シングルクォーテーションを取り除く */
-        if( removeSingleQuote(token) != OK){
-        	fprintf(stderr, "エラーが発生しました\n");
-        }
-	token++;
-	len = strlen(token);
-        strncpy(cond.stringValue, token, len );
-
-	    } else {
-		/* ここに来ることはないはず */
-		fprintf(stderr, "Unknown data type found.\n");
-		exit(1);
-	    }
-
-    // ......
-    // (このあと、deleteRecord()を呼び出す)
-    // ......
-	 if( deleteRecord(tableName ,&cond) != OK){
-	 	fprintf(stderr, "テーブルの削除に失敗しました\n" );
-	 	return ;
-	 }
+    if (strcmp(target, "arena") == 0) {
+	resetArenaStats();
+    } else {
+	resetBufferStats();
+    }
+    printf("統計情報をリセットしました。\n");
+}
 
+/*
+ * callCheckpoint -- checkpoint文の実行
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	なし
+ *
+ * checkpointの書式:
+ *	checkpoint
+ */
+void callCheckpoint()
+{
+    /* バッファ上の変更済みのページをすべてファイルに書き戻す */
+    if (flushAllBuffers() == OK) {
+	printf("変更されたページを書き戻しました。\n");
+    } else {
+	printf("ページの書き戻しに失敗しました。\n");
+    }
 }
+
 /*
  * checkTokenString -- 文字がシングルクォーテーションで囲まれているかの判別	
  * 
@@ -929,6 +1286,7 @@ int main()
     
 	/* 字句解析するために入力文字列を設定する */
 	strncpy(input, line, MAX_INPUT);
+	input[MAX_INPUT - 1] = '\0';
 	setInputString(input);
 
         /* 入力の履歴を保存する */
@@ -958,6 +1316,9 @@ int main()
 	    break;
 	}
 
+	/* 文の処理に使うメモリは、文のアリーナから確保する */
+	beginStatement();
+
 	/* 最初のトークンが何かによって、呼び出す関数を決める */
 	if (strcmp(token, "create") == 0) {
 	    callCreateTable();
@@ -969,17 +1330,27 @@ int main()
 	    callSelectRecord();
 	} else if (strcmp(token, "delete") == 0) {
 	    callDeleteRecord();
+	} else if (strcmp(token, "show") == 0) {
+	    callShowStatement();
+	} else if (strcmp(token, "reset") == 0) {
+	    callResetStatement();
+	} else if (strcmp(token, "checkpoint") == 0) {
+	    callCheckpoint();
 	} else {
 	    /* 入力に間違いがあった */
 	    printf("入力に間違いがあります。\n");
 	    printf("もう一度入力し直してください。\n\n");
 	}
+
+	/* 文の処理に使ったメモリをまとめて解放する */
+	endStatement();
     }
 
     /* 各モジュールの終了処理 */
     finalizeDataManipModule();
     finalizeDataDefModule();
     finalizeFileModule();
+    finalizeArena();
 }
 
 
@@ -2,6 +2,8 @@
  * microdb.h - 共通定義ファイル
  */
 
+#include <stddef.h>
+
 /*
  * Result -- 成功/失敗を返す返り値
  */
@@ -17,15 +19,97 @@ typedef enum { OK, NG } Result;
  */
 #define MAX_FILENAME 256
 
+/*
+ * modifyFlag -- 変更フラグ
+ */
+typedef enum { UNMODIFIED = 0, MODIFIED = 1 } modifyFlag;
+
+/*
+ * AccessMode -- ファイルのアクセスの仕方
+ */
+typedef enum {
+    ACCESS_NORMAL = 0,                  /* 通常のアクセス */
+    ACCESS_SEQUENTIAL = 1               /* 先頭から順に全ページを読む(順次走査) */
+} AccessMode;
+
 /*
  * File - オープンしたファイルの情報を保持する構造体
  */
 typedef struct File File;
 struct File {
     int desc;                           /* ファイルディスクリプタ */
+    int fileId;                         /* バッファ上でファイルを識別する番号 */
+    AccessMode access;                  /* アクセスの仕方 */
     char name[MAX_FILENAME];            /* ファイル名 */
 };
 
+/*
+ * BufferStats -- バッファの利用状況の統計情報
+ */
+typedef struct BufferStats BufferStats;
+struct BufferStats {
+    long hits;                          /* バッファにページがあった回数 */
+    long misses;                        /* バッファにページがなかった回数 */
+    long evictions;                     /* ページを追い出した回数 */
+    long dirtyWritebacks;               /* 追い出すときに書き戻した回数 */
+    long pagesRead;                     /* ファイルから読み込んだページ数 */
+    long pagesWritten;                  /* ファイルに書き出したページ数 */
+    long bytesRead;                     /* ファイルから読み込んだバイト数 */
+    long bytesWritten;                  /* ファイルに書き出したバイト数 */
+    long pagesPrefetched;               /* 先読みしたページ数 */
+    long prefetchHits;                  /* 先読みしたページが参照された回数 */
+    long prefetchMisses;                /* 先読みしたページが参照されずに追い出された回数 */
+    long backgroundWrites;              /* バックグラウンドライタが書き出したページ数 */
+};
+
+/*
+ * ArenaStats -- 文単位のメモリ領域(アリーナ)の利用状況の統計情報
+ */
+typedef struct ArenaStats ArenaStats;
+struct ArenaStats {
+    long statements;                    /* 処理を終えた文の数 */
+    long lastPeakBytes;                 /* 直前の文で確保したバイト数 */
+    long maxPeakBytes;                  /* 1つの文で確保したバイト数の最大値 */
+    long currentBytes;                  /* 処理中の文で確保しているバイト数 */
+    long blockBytes;                    /* アリーナがmallocで確保している領域の合計 */
+};
+
+/*
+ * arena.cに定義されている関数群
+ */
+extern void *allocateMemory(size_t);
+extern void beginStatement();
+extern void endStatement();
+extern void finalizeArena();
+extern void getArenaStats(ArenaStats *);
+extern void resetArenaStats();
+extern void printArenaStats();
+
+/*
+ * PageRequest -- ページ入出力モジュールに渡す、連続したページの読み書きの要求
+ */
+typedef struct PageRequest PageRequest;
+struct PageRequest {
+    int desc;                           /* ファイルディスクリプタ */
+    int write;                          /* 書き出しなら1、読み込みなら0 */
+    int pageNum;                        /* 先頭のページ番号 */
+    int numPages;                       /* ページ数(iovの要素数) */
+    struct iovec *iov;                  /* 各ページの内容を格納する領域 */
+    long bytes;                         /* 転送したバイト数(失敗なら-1) */
+    int done;                           /* 完了していれば1 */
+};
+
+/*
+ * pageio.cに定義されている関数群
+ */
+extern Result initializePageIO();
+extern void finalizePageIO();
+extern char *getPageIOName();
+extern int isAsyncPageIO();
+extern Result submitPageRequests(PageRequest **, int);
+extern Result startPageRequest(PageRequest *);
+extern Result waitPageRequest(PageRequest *);
+
 /*
  * file.cに定義されている関数群
  */
@@ -37,7 +121,21 @@ extern File *openFile(char *);
 extern Result closeFile(File *);
 extern Result readPage(File *, int, char *);
 extern Result writePage(File *, int, char *);
+extern Result pinPage(File *, int, char **);
+extern Result pinNewPage(File *, int, char **);
+extern Result unpinPage(File *, int, modifyFlag);
+extern Result flushAllBuffers();
+extern Result startBackgroundWriter(int, int);
+extern void stopBackgroundWriter();
+extern void setFileAccessMode(File *, AccessMode);
+extern void setReadaheadWindow(int);
 extern int getNumPages(char *);
+extern Result mapFile(File *, char **, int *);
+extern void unmapFile(char *, int);
+extern void getBufferStats(BufferStats *);
+extern Result getFileBufferStats(char *, BufferStats *);
+extern void resetBufferStats();
+extern void printBufferStats();
 
 
 /*
@@ -67,15 +165,28 @@ typedef struct FieldInfo FieldInfo;
 struct FieldInfo {
     char name[MAX_FIELD_NAME];		/* フィールド名 */
     DataType dataType;			/* フィールドのデータ型 */
+    int offset;				/* レコードの先頭からの位置(バイト数) */
+    int width;				/* レコード中での大きさ(バイト数) */
+    int indexed;			/* 索引(integer型はB+木、string型はハッシュ)を付けていれば1 */
 };
 
+/*
+ * RECORD_FLAG_SIZE -- レコードの先頭に置く「使用中」フラグの大きさ(バイト数)
+ */
+#define RECORD_FLAG_SIZE 1
+
 /*
  * TableInfo -- テーブルの情報を表現する構造体
+ *
+ * offset、width、recordSize、recordsPerPageは、getTableInfoが
+ * データ定義を読み込むときに一度だけ計算する(レコードの配置)。
  */
 typedef struct TableInfo TableInfo;
 struct TableInfo {
     int numField;				/* フィールド数 */
     FieldInfo fieldInfo[MAX_FIELD];		/* フィールド情報の配列 */
+    int recordSize;				/* 1レコードの大きさ(フラグを含む) */
+    int recordsPerPage;				/* 1ページに収まるレコード数 */
 };
 
 
@@ -88,6 +199,8 @@ extern Result createTable(char *, TableInfo *);
 extern Result dropTable(char *);
 extern TableInfo *getTableInfo(char *);
 extern void freeTableInfo(TableInfo *);
+extern void setRecordLayout(TableInfo *);
+extern Result createIndex(char *, char *);
 
 
 /*
@@ -107,23 +220,46 @@ struct FieldData {
 };
 
 /*
- * RecordData -- 1つのレコードのデータを表現する構造体
+ * RecordData -- 挿入する1つのレコードのデータを表現する構造体
  */
 typedef struct RecordData RecordData;
 struct RecordData {
     int numField;			/* フィールド数 */
     FieldData fieldData[MAX_FIELD];	/* フィールド情報 */
-    RecordData *next;
+};
+
+/*
+ * Record -- 検索結果の1つのレコード
+ *
+ * dataはページ上と同じ形式のバイト列(「使用中」フラグを含む)で、
+ * 各フィールドはdata + fieldInfo[k].offsetにある。
+ */
+typedef struct Record Record;
+struct Record {
+    Record *next;			/* 次のレコード */
+    char data[];			/* レコードのバイト列(recordSizeバイト) */
+};
+
+/*
+ * RecordId -- データファイル中のレコードの位置
+ */
+typedef struct RecordId RecordId;
+struct RecordId {
+    int pageNum;			/* ページ番号 */
+    int slot;				/* ページ中のレコードの番号 */
 };
 
 /*
  * RecordSet -- レコードの集合を表現する構造体
+ *
+ * フィールド名とデータ型、レコードの配置はtableInfoに1つだけ持つ。
  */
 typedef struct RecordSet RecordSet;
 struct RecordSet {
     int numRecord;			/* レコード数 */
-    RecordData *tail;       /*最後のレコードリストへのポインタ  */
-    RecordData *recordData;	/* レコードのリストへのポインタ */
+    TableInfo *tableInfo;		/* データ定義情報(カタログキャッシュと共有) */
+    Record *tail;			/* 最後のレコードへのポインタ */
+    Record *record;			/* レコードのリストへのポインタ */
 };
 
 
@@ -135,7 +271,44 @@ enum OperatorType {
     OPR_EQUAL,              /* = */
     OPR_NOT_EQUAL,          /* != */
     OPR_GREATER_THAN,           /* > */
-    OPR_LESS_THAN           /* < */
+    OPR_LESS_THAN,          /* < */
+    OPR_GREATER_EQUAL,      /* >= */
+    OPR_LESS_EQUAL,         /* <= */
+    OPR_BETWEEN,            /* between 値 and 値 */
+    OPR_IN                  /* in (値, ...) */
+};
+
+/*
+ * MAX_IN_VALUES -- 条件式のin (...)に書ける値の数の上限
+ */
+#define MAX_IN_VALUES 16
+
+/*
+ * ConditionType -- 条件式の木の節の種類
+ */
+typedef enum {
+    CONDITION_TERM = 0,         /* フィールド名 比較演算子 値 */
+    CONDITION_AND = 1,          /* left and right */
+    CONDITION_OR = 2            /* left or right */
+} ConditionType;
+
+/*
+ * ConditionNode -- and、orを含む条件式の木の1つの節
+ *
+ * CONDITION_TERMの場合、値はbetweenなら下限と上限の2つ、inなら
+ * numValue個、それ以外は1つ。
+ */
+typedef struct ConditionNode ConditionNode;
+struct ConditionNode {
+    ConditionType type;                 /* 節の種類 */
+    char name[MAX_FIELD_NAME];          /* フィールド名 */
+    DataType dataType;                  /* フィールドのデータ型 */
+    OperatorType operator;              /* 比較演算子 */
+    int numValue;                       /* 値の数 */
+    int intValues[MAX_IN_VALUES];       /* integer型の場合の値 */
+    char stringValues[MAX_IN_VALUES][MAX_STRING];	/* string型の場合の値 */
+    ConditionNode *left;                /* and、orの左側 */
+    ConditionNode *right;               /* and、orの右側 */
 };
 
 /*
@@ -155,6 +328,153 @@ struct Condition {
     char stringValue[MAX_STRING];   /* string型の場合の値 */
     int allmach; /* 条件文がない時(*で全表示されるとき)に１が入力される*/
     distinctFlag distinct;      /* 重複除去フラグ */
+    ConditionNode *where;       /* and、orを含む条件式(NULLなら上の1つの比較を使う) */
+    int numColumn;              /* 取り出すフィールドの数(0ならすべて) */
+    char columnNames[MAX_FIELD][MAX_FIELD_NAME];	/* 取り出すフィールドの名前 */
+};
+
+/*
+ * PredicateKind -- 変換した条件式の種類
+ */
+typedef enum {
+    PREDICATE_ALL = 0,                  /* すべてのレコードが満たす */
+    PREDICATE_NONE = 1,                 /* どのレコードも満たさない */
+    PREDICATE_INTEGER = 2,              /* integer型のフィールドと定数を比べる */
+    PREDICATE_STRING = 3,               /* string型のフィールドと定数を比べる */
+    PREDICATE_AND = 4,                  /* すべての子を満たす */
+    PREDICATE_OR = 5                    /* いずれかの子を満たす */
+} PredicateKind;
+
+/*
+ * Predicate -- ページ上のレコードのバイト列を直接調べるように変換した条件式
+ *
+ * and、orの子は、安くて絞り込みの強い順(先に評価する順)に並べてある。
+ * 子の配列とinの値の配列は文のアリーナに確保する。
+ */
+typedef struct Predicate Predicate;
+struct Predicate {
+    PredicateKind kind;                 /* 条件式の種類 */
+    int offset;                         /* 比べるフィールドのレコード中の位置 */
+    OperatorType operator;              /* 比較演算子 */
+    int intValue;                       /* integer型の場合の定数(betweenなら下限) */
+    int intHigh;                        /* betweenの上限 */
+    char stringValue[MAX_STRING];       /* string型の場合の定数 */
+    int numValue;                       /* inの値の数 */
+    int *intValues;                     /* inの値(integer型) */
+    char (*stringValues)[MAX_STRING];   /* inの値(string型) */
+    int numChild;                       /* and、orの子の数 */
+    Predicate *child;                   /* and、orの子の配列 */
+    double selectivity;                 /* 満たすレコードの割合の見積もり */
+    double cost;                        /* 1レコードを調べる手間の見積もり */
+};
+
+/*
+ * PredicateKernel -- integer型の条件式をページ単位で評価するのに使う命令
+ */
+typedef enum {
+    PREDICATE_KERNEL_SCALAR = 0,        /* 1レコードずつ比べる */
+    PREDICATE_KERNEL_SSE2 = 1,          /* SSE2で4レコードずつ比べる */
+    PREDICATE_KERNEL_AVX2 = 2           /* AVX2で8レコードずつ比べる */
+} PredicateKernel;
+
+/*
+ * SELECTION_BYTES -- 1ページ分の選択ビットマップの大きさ(バイト数)
+ *
+ * レコードは1バイト以上あるので、1ページのレコード数はPAGE_SIZE以下
+ */
+#define SELECTION_BYTES (PAGE_SIZE / 8)
+
+/*
+ * predicate.cに定義されている関数群
+ */
+extern Result initializePredicateModule();
+extern Result setPredicateKernel(PredicateKernel);
+extern char *getPredicateKernelName();
+extern Result compileCondition(TableInfo *, Condition *, Predicate *);
+extern Result checkPredicate(Predicate *, char *);
+extern int filterPage(Predicate *, char *, int, int, unsigned char *);
+extern int nextSelectedSlot(unsigned char *, int, int);
+
+/*
+ * BtreeCursor -- 索引の範囲の走査の状態(btree.cで定義)
+ */
+typedef struct BtreeCursor BtreeCursor;
+
+/*
+ * btree.cに定義されている関数群
+ */
+extern Result createIndexFile(char *, char *);
+extern Result deleteIndexFile(char *, char *);
+extern File *openIndexFile(char *, char *);
+extern Result insertIndexEntry(File *, int, RecordId *);
+extern Result deleteIndexEntry(File *, int, RecordId *);
+extern BtreeCursor *openIndexCursor(File *, int, int);
+extern Result nextIndexEntry(BtreeCursor *, int *, RecordId *);
+extern Result closeIndexCursor(BtreeCursor *);
+
+/*
+ * HashCursor -- ハッシュ索引の等しい値の走査の状態(hash.cで定義)
+ */
+typedef struct HashCursor HashCursor;
+
+/*
+ * hash.cに定義されている関数群
+ */
+extern Result createHashFile(char *, char *);
+extern Result deleteHashFile(char *, char *);
+extern File *openHashFile(char *, char *);
+extern Result insertHashEntry(File *, char *, RecordId *);
+extern Result deleteHashEntry(File *, char *, RecordId *);
+extern HashCursor *openHashCursor(File *, char *);
+extern Result nextHashEntry(HashCursor *, RecordId *);
+extern Result closeHashCursor(HashCursor *);
+
+/*
+ * freespace.cに定義されている関数群
+ */
+extern Result createFreeSpaceFile(char *);
+extern Result deleteFreeSpaceFile(char *);
+extern File *openFreeSpaceFile(char *);
+extern Result setPageFree(File *, int, int);
+extern int findFreePage(File *);
+
+/*
+ * ScanMode -- selectRecordがデータファイルを読む方法
+ */
+typedef enum {
+    SCAN_BUFFERED = 0,                  /* バッファを通して読む */
+    SCAN_MMAP = 1                       /* ファイルをマップして直接読む */
+} ScanMode;
+
+/*
+ * DistinctSet -- 重複除去のための、返したレコードの集合(datamanip.cで定義)
+ */
+typedef struct DistinctSet DistinctSet;
+
+/*
+ * Scan -- openScanで開始したテーブルの走査の状態
+ */
+typedef struct Scan Scan;
+struct Scan {
+    File *file;				/* データファイル */
+    TableInfo *tableInfo;		/* データ定義情報(カタログキャッシュと共有) */
+    TableInfo *resultInfo;		/* nextRecordが返すレコードの配置(射影しなければtableInfo) */
+    int projection[MAX_FIELD];		/* resultInfoの各フィールドのtableInfoでの番号 */
+    char *row;				/* 射影したレコードを組み立てる領域 */
+    Predicate predicate;		/* 取り出すレコードの条件(変換済み) */
+    char *area;				/* マップした領域(マップしていなければNULL) */
+    int numPage;			/* データファイルのページ数 */
+    int pageNum;			/* 処理中のページ番号 */
+    int slot;				/* 次に調べるページ中のレコードの番号 */
+    char *page;				/* 処理中のページ(固定していなければNULL) */
+    File *indexFile;			/* 索引で走査する場合の索引ファイル(全ページを読むならNULL) */
+    BtreeCursor *cursor;		/* B+木索引で走査する場合の索引の走査の状態 */
+    HashCursor *hashCursor;		/* ハッシュ索引で走査する場合の索引の走査の状態 */
+    unsigned char selection[SELECTION_BYTES];	/* 処理中のページで条件に合うレコード */
+    DistinctSet *distinct;		/* 重複除去のため、返したレコードの集合 */
+    long numSpilled;			/* 重複除去で一時ファイルに書き出したレコード数 */
+    long numProbed;			/* 重複除去でハッシュ表の要素と比べた回数 */
+    Result status;			/* 途中で失敗したらNG */
 };
 
 /*
@@ -162,13 +482,26 @@ struct Condition {
  */
 extern Result initializeDataManipModule();
 extern Result finalizeDataManipModule();
-extern Result insertRecord(char *, RecordData *);
+extern Result insertRecord(char *, RecordData *, RecordId *);
+extern Result insertRecords(char *, RecordData *, int, RecordId *);
+extern char *fetchRecord(char *, RecordId *);
+extern Result deleteRecordByRid(char *, RecordId *);
+extern Result updateRecordByRid(char *, RecordId *, RecordData *);
 extern RecordSet *selectRecord(char *,Condition *);
+extern Scan *openScan(char *, Condition *);
+extern char *nextRecord(Scan *);
+extern Result closeScan(Scan *);
 extern void freeRecordSet(RecordSet *);
+extern int getIntField(TableInfo *, char *, int);
+extern char *getStringField(TableInfo *, char *, int);
+extern void setScanMode(ScanMode);
+extern void setDistinctMemory(long);
 extern Result deleteRecord(char *, Condition *);
 extern Result createDataFile(char *);
 extern Result deleteDataFile(char *);
+extern Result buildIndex(char *, char *);
 extern void printRecordSet(RecordSet *);
+extern void printScan(Scan *);
 extern void printTableData(char *);
 /* データを表にして表示する関数 */
 extern void printTableFence(int);
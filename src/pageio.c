@@ -0,0 +1,476 @@
+/*
+ * pageio.c -- ページ入出力モジュール
+ *
+ * ファイルアクセスモジュールが行うページの読み書きを受け持つ。
+ * io_uringが使える環境では、複数の読み書きをまとめて投入し、
+ * 完了もまとめて受け取る。使えない環境ではpreadv/pwritevで1つずつ行う。
+ */
+
+#include "microdb.h"
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * PAGE_IO_ENV -- 入出力の方式を指定する環境変数の名前
+ *
+ * "uring"(既定値)ならio_uringを使い、"sync"ならpreadv/pwritevを使う。
+ * io_uringが使えない環境では、指定にかかわらずpreadv/pwritevを使う。
+ */
+#define PAGE_IO_ENV "MICRODB_IO_BACKEND"
+
+/*
+ * URING_ENTRIES -- io_uringの投入キューの大きさ(同時に発行できる要求の数)
+ */
+#define URING_ENTRIES 64
+
+/*
+ * Uring -- io_uringの投入キューと完了キューを操作するための情報
+ */
+typedef struct Uring Uring;
+struct Uring {
+  int fd;					/* io_uringのファイルディスクリプタ(-1なら使わない) */
+  unsigned int entries;		/* 投入キューの大きさ */
+  unsigned int inFlight;	/* 投入して、まだ完了を受け取っていない要求の数 */
+  void *sqRing;				/* 投入キューとしてマップした領域 */
+  size_t sqRingSize;		/* 投入キューの領域の大きさ */
+  void *cqRing;				/* 完了キューとしてマップした領域 */
+  size_t cqRingSize;		/* 完了キューの領域の大きさ */
+  struct io_uring_sqe *sqes;	/* 投入する要求の配列 */
+  size_t sqesSize;			/* 要求の配列の大きさ */
+  unsigned int *sqHead;		/* 投入キューの先頭(カーネルが進める) */
+  unsigned int *sqTail;		/* 投入キューの末尾(こちらが進める) */
+  unsigned int *sqMask;		/* 投入キューの添字のマスク */
+  unsigned int *sqArray;	/* 投入キューの要素から要求の配列への添字 */
+  unsigned int *cqHead;		/* 完了キューの先頭(こちらが進める) */
+  unsigned int *cqTail;		/* 完了キューの末尾(カーネルが進める) */
+  unsigned int *cqMask;		/* 完了キューの添字のマスク */
+  struct io_uring_cqe *cqes;	/* 完了した要求の配列 */
+};
+
+/*
+ * uring -- io_uringの状態
+ */
+static Uring uring = { -1 };
+
+/*
+ * setupUring -- io_uringの準備
+ *
+ * 引数:
+ *	entries: 投入キューの大きさ
+ *
+ * 返り値:
+ *	成功の場合OK、io_uringが使えない場合NG
+ */
+static Result setupUring(unsigned int entries)
+{
+  struct io_uring_params params;
+  int fd;
+
+  memset(&params, 0, sizeof(params));
+  if ((fd = (int) syscall(__NR_io_uring_setup, entries, &params)) < 0) {
+    return NG;
+  }
+
+  /* 投入キュー、完了キュー、要求の配列をそれぞれマップする */
+  uring.sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+  uring.cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (uring.cqRingSize > uring.sqRingSize) {
+      uring.sqRingSize = uring.cqRingSize;
+    }
+    uring.cqRingSize = 0;
+  }
+  uring.sqRing = mmap(NULL, uring.sqRingSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (uring.sqRing == MAP_FAILED) {
+    close(fd);
+    return NG;
+  }
+  if (uring.cqRingSize == 0) {
+    uring.cqRing = uring.sqRing;
+  } else {
+    uring.cqRing = mmap(NULL, uring.cqRingSize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (uring.cqRing == MAP_FAILED) {
+      munmap(uring.sqRing, uring.sqRingSize);
+      close(fd);
+      return NG;
+    }
+  }
+  uring.sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  uring.sqes = mmap(NULL, uring.sqesSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (uring.sqes == MAP_FAILED) {
+    if (uring.cqRingSize != 0) {
+      munmap(uring.cqRing, uring.cqRingSize);
+    }
+    munmap(uring.sqRing, uring.sqRingSize);
+    close(fd);
+    return NG;
+  }
+
+  uring.sqHead = (unsigned int *) ((char *) uring.sqRing + params.sq_off.head);
+  uring.sqTail = (unsigned int *) ((char *) uring.sqRing + params.sq_off.tail);
+  uring.sqMask = (unsigned int *) ((char *) uring.sqRing + params.sq_off.ring_mask);
+  uring.sqArray = (unsigned int *) ((char *) uring.sqRing + params.sq_off.array);
+  uring.cqHead = (unsigned int *) ((char *) uring.cqRing + params.cq_off.head);
+  uring.cqTail = (unsigned int *) ((char *) uring.cqRing + params.cq_off.tail);
+  uring.cqMask = (unsigned int *) ((char *) uring.cqRing + params.cq_off.ring_mask);
+  uring.cqes = (struct io_uring_cqe *) ((char *) uring.cqRing + params.cq_off.cqes);
+
+  uring.entries = params.sq_entries;
+  uring.inFlight = 0;
+  uring.fd = fd;
+  return OK;
+}
+
+/*
+ * enterUring -- 投入キューにある要求をカーネルに渡し、必要なら完了を待つ
+ *
+ * 引数:
+ *	minComplete: 完了を待つ要求の数(0なら待たない)
+ *
+ * 返り値:
+ *	成功の場合OK、失敗の場合NG
+ */
+static Result enterUring(unsigned int minComplete)
+{
+  unsigned int flags = (minComplete > 0) ? IORING_ENTER_GETEVENTS : 0;
+  unsigned int toSubmit;
+  long ret;
+
+  for (;;) {
+    /* 前回カーネルに渡しきれなかった要求も含めて渡す */
+    toSubmit = *uring.sqTail - __atomic_load_n(uring.sqHead, __ATOMIC_ACQUIRE);
+    ret = syscall(__NR_io_uring_enter, uring.fd, toSubmit, minComplete, flags, NULL, 0);
+    if (ret >= 0) {
+      return OK;
+    }
+    if (errno != EINTR && errno != EAGAIN) {
+      return NG;
+    }
+  }
+}
+
+/*
+ * syncRequest -- 要求をpreadv/pwritevで実行する
+ *
+ * 引数:
+ *	req: 実行する要求
+ *
+ * 返り値:
+ *	なし(結果はreq->bytesに入る)
+ */
+static void syncRequest(PageRequest *req)
+{
+  off_t offset = (off_t) req->pageNum * PAGE_SIZE;
+
+  if (req->write) {
+    req->bytes = pwritev(req->desc, req->iov, req->numPages, offset);
+  } else {
+    req->bytes = preadv(req->desc, req->iov, req->numPages, offset);
+  }
+  req->done = 1;
+}
+
+/*
+ * reapUring -- 完了キューに届いた結果を要求に反映する
+ *
+ * io_uringで失敗した要求(対応していない操作など)は、preadv/pwritevでやり直す。
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	なし
+ */
+static void reapUring()
+{
+  unsigned int head, tail;
+  struct io_uring_cqe *cqe;
+  PageRequest *req;
+
+  head = *uring.cqHead;
+  tail = __atomic_load_n(uring.cqTail, __ATOMIC_ACQUIRE);
+  for (; head != tail; head++) {
+    cqe = &uring.cqes[head & *uring.cqMask];
+    req = (PageRequest *) (unsigned long) cqe->user_data;
+    uring.inFlight--;
+    if (cqe->res < 0) {
+      syncRequest(req);
+    } else {
+      req->bytes = cqe->res;
+      req->done = 1;
+    }
+  }
+  __atomic_store_n(uring.cqHead, head, __ATOMIC_RELEASE);
+}
+
+/*
+ * queueUring -- 要求を投入キューに入れる(カーネルにはまだ渡さない)
+ *
+ * 引数:
+ *	req: 投入する要求
+ *
+ * 返り値:
+ *	投入キューに空きがあればOK、なければNG
+ */
+static Result queueUring(PageRequest *req)
+{
+  unsigned int tail, index;
+  struct io_uring_sqe *sqe;
+
+  /* 完了キューがあふれないよう、同時に発行する要求の数も制限する */
+  tail = *uring.sqTail;
+  if (tail - __atomic_load_n(uring.sqHead, __ATOMIC_ACQUIRE) >= uring.entries ||
+      uring.inFlight >= uring.entries) {
+    return NG;
+  }
+
+  index = tail & *uring.sqMask;
+  sqe = &uring.sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = req->write ? IORING_OP_WRITEV : IORING_OP_READV;
+  sqe->fd = req->desc;
+  sqe->off = (unsigned long long) req->pageNum * PAGE_SIZE;
+  sqe->addr = (unsigned long) req->iov;
+  sqe->len = req->numPages;
+  sqe->user_data = (unsigned long) req;
+  uring.sqArray[index] = index;
+
+  __atomic_store_n(uring.sqTail, tail + 1, __ATOMIC_RELEASE);
+  uring.inFlight++;
+  return OK;
+}
+
+/*
+ * cancelUring -- 投入キューに残っている要求を取り下げ、preadv/pwritevで実行する
+ *
+ * io_uring_enterが失敗したときに使う。投入キューの要求は呼び出し側のiovや
+ * ページを指しているので、キューに残したまま戻ると、後で別の要求と一緒に
+ * カーネルに渡されたときに、解放や再利用された領域を読み書きしてしまう。
+ * カーネルがまだ受け取っていない要求(sqHeadからsqTailまで)だけを取り下げる。
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	なし
+ */
+static void cancelUring()
+{
+  unsigned int head, tail;
+  struct io_uring_sqe *sqe;
+
+  head = __atomic_load_n(uring.sqHead, __ATOMIC_ACQUIRE);
+  tail = *uring.sqTail;
+  for (; head != tail; tail--) {
+    sqe = &uring.sqes[uring.sqArray[(tail - 1) & *uring.sqMask]];
+    syncRequest((PageRequest *) (unsigned long) sqe->user_data);
+    uring.inFlight--;
+  }
+  __atomic_store_n(uring.sqTail, head, __ATOMIC_RELEASE);
+}
+
+/*
+ * initializePageIO -- ページ入出力モジュールの初期化
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	成功の場合OK(io_uringが使えなくてもOKを返す)
+ */
+Result initializePageIO()
+{
+  char *backend;
+
+  /* すでに初期化済みなら何もしない */
+  if (uring.fd != -1) {
+    return OK;
+  }
+
+  backend = getenv(PAGE_IO_ENV);
+  if (backend != NULL && strcmp(backend, "sync") == 0) {
+    return OK;
+  }
+  if (setupUring(URING_ENTRIES) != OK && backend != NULL && strcmp(backend, "uring") == 0) {
+    fprintf(stderr, "io_uring is not available; using pread/pwrite.\n");
+  }
+  return OK;
+}
+
+/*
+ * finalizePageIO -- ページ入出力モジュールの終了処理
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	なし
+ */
+void finalizePageIO()
+{
+  if (uring.fd == -1) {
+    return;
+  }
+
+  /* 発行済みの要求がすべて完了するのを待つ */
+  while (uring.inFlight > 0 && enterUring(1) == OK) {
+    reapUring();
+  }
+  /* 渡せずに残った要求も、閉じる前に実行しておく */
+  cancelUring();
+
+  munmap(uring.sqes, uring.sqesSize);
+  if (uring.cqRing != uring.sqRing) {
+    munmap(uring.cqRing, uring.cqRingSize);
+  }
+  munmap(uring.sqRing, uring.sqRingSize);
+  close(uring.fd);
+  uring.fd = -1;
+}
+
+/*
+ * getPageIOName -- 使用中の入出力の方式の名前
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	"io_uring"または"pread/pwrite"
+ */
+char *getPageIOName()
+{
+  return (uring.fd != -1) ? "io_uring" : "pread/pwrite";
+}
+
+/*
+ * isAsyncPageIO -- 要求を発行して、完了を待たずに戻れるかどうか
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	io_uringを使っていれば1、そうでなければ0
+ */
+int isAsyncPageIO()
+{
+  return uring.fd != -1;
+}
+
+/*
+ * submitPageRequests -- 複数の要求をまとめて実行し、すべての完了を待つ
+ *
+ * io_uringを使っている場合は、すべての要求を一度に投入してから
+ * 完了をまとめて受け取るので、要求は並行して処理される。
+ *
+ * 引数:
+ *	reqs: 要求へのポインタの配列(各要求のiovは呼び出し側で用意する)
+ *	n: 要求の数
+ *
+ * 返り値:
+ *	成功の場合OK、失敗の場合NG(各要求の結果はbytesに入る)
+ */
+Result submitPageRequests(PageRequest **reqs, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++) {
+    reqs[i]->done = 0;
+    reqs[i]->bytes = -1;
+  }
+
+  if (uring.fd == -1) {
+    for (i = 0; i < n; i++) {
+      syncRequest(reqs[i]);
+    }
+    return OK;
+  }
+
+  /* 投入キューに入るだけ入れて投入し、入りきらなければ完了を待って続ける */
+  for (i = 0; i < n; ) {
+    while (i < n && queueUring(reqs[i]) == OK) {
+      i++;
+    }
+    if (enterUring((i < n) ? 1 : 0) != OK) {
+      /* カーネルに渡せなかった要求と、残りの要求はpreadv/pwritevで実行する */
+      cancelUring();
+      for (; i < n; i++) {
+        syncRequest(reqs[i]);
+      }
+      break;
+    }
+    reapUring();
+  }
+
+  /* 残りの要求の完了を待つ */
+  for (i = 0; i < n; i++) {
+    if (waitPageRequest(reqs[i]) != OK) {
+      return NG;
+    }
+  }
+  return OK;
+}
+
+/*
+ * startPageRequest -- 要求を発行し、完了を待たずに戻る
+ *
+ * 引数:
+ *	req: 要求(完了するまで、要求とそのiovを解放してはならない)
+ *
+ * 返り値:
+ *	発行できた場合OK、io_uringを使っていないか投入キューに空きがない場合NG
+ */
+Result startPageRequest(PageRequest *req)
+{
+  if (uring.fd == -1) {
+    return NG;
+  }
+
+  req->done = 0;
+  req->bytes = -1;
+  if (queueUring(req) != OK) {
+    return NG;
+  }
+
+  /* ここでカーネルに渡せなくても、完了を待つときにもう一度渡す */
+  enterUring(0);
+  return OK;
+}
+
+/*
+ * waitPageRequest -- 発行した要求の完了を待つ
+ *
+ * 引数:
+ *	req: startPageRequestまたはsubmitPageRequestsで発行した要求
+ *
+ * 返り値:
+ *	成功の場合OK、失敗の場合NG(要求の結果はbytesに入る)
+ */
+Result waitPageRequest(PageRequest *req)
+{
+  while (!req->done) {
+    reapUring();
+    if (req->done) {
+      break;
+    }
+    if (enterUring(1) != OK) {
+      /* カーネルに渡せていなければ、preadv/pwritevで実行する */
+      cancelUring();
+      reapUring();
+      if (!req->done) {
+        return NG;
+      }
+    }
+  }
+  return OK;
+}
@@ -0,0 +1,869 @@
+/*
+ * predicate.c -- 条件式の評価モジュール
+ *
+ * 検索や削除の条件式(Condition)を、フィールドの位置と定数だけで
+ * 比べられる形(Predicate)に変換し、ページ上のレコードのバイト列に
+ * 対して評価する。1ページ分のレコードをまとめて調べ、条件に
+ * 合うレコードの番号をビットマップ(選択ビットマップ)で返す。
+ * ページ中のレコードは一定の間隔で並んでいるので、integer型のフィールドと
+ * 定数の比較は、複数のレコードをSIMD命令(SSE2、AVX2)で一度に比べる。
+ * どの命令を使うかは、初期化のときにCPUに問い合わせて選ぶ。
+ */
+
+#include "microdb.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define PREDICATE_SIMD 1
+#endif
+
+/*
+ * PREDICATE_KERNEL_ENV -- 条件式の評価に使う命令を指定する環境変数の名前
+ *
+ * "scalar"、"sse2"、"avx2"のいずれか。指定がなければ、CPUが対応している
+ * うちで最も速いものを使う。
+ */
+#define PREDICATE_KERNEL_ENV "MICRODB_PREDICATE_KERNEL"
+
+/*
+ * PREDICATE_INT_COST、PREDICATE_STRING_COST -- 1つの値と比べる手間の見積もり
+ *
+ * and、orの子を並べる順序を決めるときに使う(integer型の比較を1とする)
+ */
+#define PREDICATE_INT_COST 1.0
+#define PREDICATE_STRING_COST 4.0
+
+/*
+ * PREDICATE_EQUAL_SELECTIVITY -- =を満たすレコードの割合の見積もり
+ *
+ * 統計情報は持たないので、比較演算子ごとに決まった値を使う
+ */
+#define PREDICATE_EQUAL_SELECTIVITY 0.1
+
+/*
+ * PREDICATE_RANGE_SELECTIVITY -- <、>、<=、>=を満たすレコードの割合の見積もり
+ */
+#define PREDICATE_RANGE_SELECTIVITY (1.0 / 3.0)
+
+/*
+ * PREDICATE_BETWEEN_SELECTIVITY -- betweenを満たすレコードの割合の見積もり
+ */
+#define PREDICATE_BETWEEN_SELECTIVITY 0.25
+
+/*
+ * kernelNames -- 評価に使う命令の名前(PredicateKernelの順)
+ */
+static char *kernelNames[] = { "scalar", "sse2", "avx2" };
+
+/*
+ * predicateKernel -- 評価に使っている命令
+ */
+static PredicateKernel predicateKernel = PREDICATE_KERNEL_SCALAR;
+
+/*
+ * initializePredicateModule -- 条件式の評価モジュールの初期化
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	成功ならOKを返す(指定された命令が使えなくてもOKを返す)
+ */
+Result initializePredicateModule()
+{
+    char *name;
+    int i;
+
+    /* 使える中で最も速い命令を選ぶ */
+    for (i = PREDICATE_KERNEL_AVX2; i > PREDICATE_KERNEL_SCALAR; i--) {
+        if (setPredicateKernel((PredicateKernel) i) == OK) {
+            break;
+        }
+    }
+    if (i == PREDICATE_KERNEL_SCALAR) {
+        setPredicateKernel(PREDICATE_KERNEL_SCALAR);
+    }
+
+    if ((name = getenv(PREDICATE_KERNEL_ENV)) == NULL) {
+        return OK;
+    }
+    for (i = PREDICATE_KERNEL_SCALAR; i <= PREDICATE_KERNEL_AVX2; i++) {
+        if (strcmp(name, kernelNames[i]) == 0) {
+            break;
+        }
+    }
+    if (i > PREDICATE_KERNEL_AVX2 || setPredicateKernel((PredicateKernel) i) != OK) {
+        fprintf(stderr, "%s=%s is not available, using %s.\n",
+                PREDICATE_KERNEL_ENV, name, getPredicateKernelName());
+    }
+    return OK;
+}
+
+/*
+ * setPredicateKernel -- 条件式の評価に使う命令の指定
+ *
+ * 引数:
+ *	kernel: 使う命令
+ *
+ * 返り値:
+ *	CPUがその命令に対応していればOK、対応していなければNGを返す
+ *	(NGの場合は、使う命令は変わらない)
+ */
+Result setPredicateKernel(PredicateKernel kernel)
+{
+    switch (kernel) {
+    case PREDICATE_KERNEL_SCALAR:
+        break;
+#ifdef PREDICATE_SIMD
+    case PREDICATE_KERNEL_SSE2:
+        /* x86-64ではSSE2は必ず使える */
+        break;
+    case PREDICATE_KERNEL_AVX2:
+        __builtin_cpu_init();
+        if (!__builtin_cpu_supports("avx2")) {
+            return NG;
+        }
+        break;
+#endif
+    default:
+        return NG;
+    }
+
+    predicateKernel = kernel;
+    return OK;
+}
+
+/*
+ * getPredicateKernelName -- 条件式の評価に使っている命令の名前
+ *
+ * 引数:
+ *	なし
+ *
+ * 返り値:
+ *	"scalar"、"sse2"または"avx2"
+ */
+char *getPredicateKernelName()
+{
+    return kernelNames[predicateKernel];
+}
+
+/*
+ * estimateTerm -- 比較1つの、満たす割合と手間を見積もる
+ *
+ * 引数:
+ *	predicate: 変換した比較(selectivityとcostを書き込む)
+ *
+ * 返り値:
+ *	なし
+ */
+static void estimateTerm(Predicate *predicate)
+{
+    double cost;
+
+    cost = (predicate -> kind == PREDICATE_STRING) ? PREDICATE_STRING_COST : PREDICATE_INT_COST;
+    predicate -> cost = cost;
+
+    switch (predicate -> operator) {
+    case OPR_EQUAL:
+        predicate -> selectivity = PREDICATE_EQUAL_SELECTIVITY;
+        break;
+    case OPR_NOT_EQUAL:
+        predicate -> selectivity = 1.0 - PREDICATE_EQUAL_SELECTIVITY;
+        break;
+    case OPR_BETWEEN:
+        predicate -> selectivity = PREDICATE_BETWEEN_SELECTIVITY;
+        break;
+    case OPR_IN:
+        predicate -> selectivity = PREDICATE_EQUAL_SELECTIVITY * predicate -> numValue;
+        if (predicate -> selectivity > 1.0) {
+            predicate -> selectivity = 1.0;
+        }
+        /* 平均して半分の値と比べる */
+        predicate -> cost = cost * (predicate -> numValue + 1) / 2;
+        break;
+    default:
+        predicate -> selectivity = PREDICATE_RANGE_SELECTIVITY;
+        break;
+    }
+}
+
+/*
+ * compileTerm -- 比較1つ(フィールド名 比較演算子 値)を変換する
+ *
+ * 引数:
+ *	tableInfo: データ定義情報(レコードの配置)
+ *	node: 比較の節
+ *	predicate: 変換した結果を書き込む構造体
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す
+ */
+static Result compileTerm(TableInfo *tableInfo, ConditionNode *node, Predicate *predicate)
+{
+    int i;
+
+    memset(predicate, 0, sizeof(Predicate));
+
+    /* 指定されているフィールドを探す(なければすべて満たす) */
+    predicate -> kind = PREDICATE_ALL;
+    for (i = 0; i < tableInfo -> numField; i++) {
+        if (strcmp(tableInfo -> fieldInfo[i].name, node -> name) == 0) {
+            break;
+        }
+    }
+    if (i == tableInfo -> numField) {
+        return OK;
+    }
+
+    predicate -> offset = tableInfo -> fieldInfo[i].offset;
+    predicate -> operator = node -> operator;
+    switch (tableInfo -> fieldInfo[i].dataType) {
+    case TYPE_INTEGER:
+        predicate -> kind = PREDICATE_INTEGER;
+        predicate -> intValue = node -> intValues[0];
+        if (node -> operator == OPR_BETWEEN) {
+            predicate -> intHigh = node -> intValues[1];
+            if (predicate -> intValue > predicate -> intHigh) {
+                predicate -> kind = PREDICATE_NONE;
+                return OK;
+            }
+        } else if (node -> operator == OPR_IN) {
+            predicate -> numValue = node -> numValue;
+            if ((predicate -> intValues = allocateMemory(sizeof(int) * node -> numValue)) == NULL) {
+                return NG;
+            }
+            memcpy(predicate -> intValues, node -> intValues, sizeof(int) * node -> numValue);
+        }
+        break;
+    case TYPE_STRING:
+        /* 文字列型は=、!=、inだけを比べられる */
+        if (node -> operator == OPR_EQUAL || node -> operator == OPR_NOT_EQUAL) {
+            predicate -> kind = PREDICATE_STRING;
+            strncpy(predicate -> stringValue, node -> stringValues[0], MAX_STRING);
+        } else if (node -> operator == OPR_IN) {
+            predicate -> kind = PREDICATE_STRING;
+            predicate -> numValue = node -> numValue;
+            if ((predicate -> stringValues = allocateMemory(MAX_STRING * node -> numValue)) == NULL) {
+                return NG;
+            }
+            memcpy(predicate -> stringValues, node -> stringValues, MAX_STRING * node -> numValue);
+        } else {
+            predicate -> kind = PREDICATE_NONE;
+            return OK;
+        }
+        break;
+    default:
+        predicate -> kind = PREDICATE_NONE;
+        return OK;
+    }
+
+    estimateTerm(predicate);
+    return OK;
+}
+
+/*
+ * compareConjunct -- andの子を先に評価する順に並べるための比較関数
+ *
+ * 満たさないレコードを1つ除くのにかかる手間(cost / (1 - selectivity))の
+ * 小さい順にする。安い比較や、絞り込みの強い比較が先になる。
+ */
+static int compareConjunct(const void *x, const void *y)
+{
+    const Predicate *a = x, *b = y;
+    double ra, rb;
+
+    ra = (a -> selectivity < 1.0) ? a -> cost / (1.0 - a -> selectivity) : HUGE_VAL;
+    rb = (b -> selectivity < 1.0) ? b -> cost / (1.0 - b -> selectivity) : HUGE_VAL;
+    return (ra < rb) ? -1 : (ra > rb) ? 1 : 0;
+}
+
+/*
+ * compareDisjunct -- orの子を先に評価する順に並べるための比較関数
+ *
+ * 満たすレコードを1つ見つけるのにかかる手間(cost / selectivity)の小さい順にする。
+ */
+static int compareDisjunct(const void *x, const void *y)
+{
+    const Predicate *a = x, *b = y;
+    double ra, rb;
+
+    ra = (a -> selectivity > 0.0) ? a -> cost / a -> selectivity : HUGE_VAL;
+    rb = (b -> selectivity > 0.0) ? b -> cost / b -> selectivity : HUGE_VAL;
+    return (ra < rb) ? -1 : (ra > rb) ? 1 : 0;
+}
+
+static Result compileNode(TableInfo *tableInfo, ConditionNode *node, Predicate *predicate);
+
+/*
+ * countOperands -- and(またはor)が続く部分木の、それ以外の節の数を数える
+ */
+static int countOperands(ConditionNode *node, ConditionType type)
+{
+    if (node -> type != type) {
+        return 1;
+    }
+    return countOperands(node -> left, type) + countOperands(node -> right, type);
+}
+
+/*
+ * compileOperands -- and(またはor)が続く部分木の、それ以外の節を順に変換する
+ *
+ * a and (b and c)のような入れ子を、3つの子を持つ1つのandにまとめる。
+ */
+static Result compileOperands(TableInfo *tableInfo, ConditionNode *node, ConditionType type,
+                              Predicate *child, int *numChild)
+{
+    if (node -> type != type) {
+        return compileNode(tableInfo, node, &child[(*numChild)++]);
+    }
+    if (compileOperands(tableInfo, node -> left, type, child, numChild) != OK) {
+        return NG;
+    }
+    return compileOperands(tableInfo, node -> right, type, child, numChild);
+}
+
+/*
+ * compileNode -- 条件式の木を変換する
+ *
+ * and、orは子をまとめてから、結果の決まっている子を取り除き、
+ * 評価する順に並べ替える。
+ *
+ * 引数:
+ *	tableInfo: データ定義情報(レコードの配置)
+ *	node: 条件式の木
+ *	predicate: 変換した結果を書き込む構造体
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す
+ */
+static Result compileNode(TableInfo *tableInfo, ConditionNode *node, Predicate *predicate)
+{
+    Predicate *child;
+    PredicateKind kind, absorbing, neutral;
+    double pass;
+    int numChild, i, n;
+
+    if (node -> type == CONDITION_TERM) {
+        return compileTerm(tableInfo, node, predicate);
+    }
+
+    /* andならどれか1つが満たさなければ満たさない、orならその逆 */
+    if (node -> type == CONDITION_AND) {
+        kind = PREDICATE_AND;
+        absorbing = PREDICATE_NONE;
+        neutral = PREDICATE_ALL;
+    } else {
+        kind = PREDICATE_OR;
+        absorbing = PREDICATE_ALL;
+        neutral = PREDICATE_NONE;
+    }
+
+    n = countOperands(node, node -> type);
+    if ((child = allocateMemory(sizeof(Predicate) * n)) == NULL) {
+        return NG;
+    }
+    numChild = 0;
+    if (compileOperands(tableInfo, node, node -> type, child, &numChild) != OK) {
+        return NG;
+    }
+
+    /* 結果の決まっている子を取り除く */
+    memset(predicate, 0, sizeof(Predicate));
+    n = 0;
+    for (i = 0; i < numChild; i++) {
+        if (child[i].kind == absorbing) {
+            predicate -> kind = absorbing;
+            return OK;
+        }
+        if (child[i].kind != neutral) {
+            child[n++] = child[i];
+        }
+    }
+    if (n == 0) {
+        predicate -> kind = neutral;
+        return OK;
+    }
+    if (n == 1) {
+        *predicate = child[0];
+        return OK;
+    }
+
+    /* 評価する順に並べ、途中で打ち切ることを考えて全体を見積もる */
+    qsort(child, n, sizeof(Predicate), (kind == PREDICATE_AND) ? compareConjunct : compareDisjunct);
+    predicate -> kind = kind;
+    predicate -> numChild = n;
+    predicate -> child = child;
+    pass = 1.0;
+    for (i = 0; i < n; i++) {
+        /* passは、i番目の子まで評価が進むレコードの割合 */
+        predicate -> cost += pass * child[i].cost;
+        pass *= (kind == PREDICATE_AND) ? child[i].selectivity : 1.0 - child[i].selectivity;
+    }
+    predicate -> selectivity = (kind == PREDICATE_AND) ? pass : 1.0 - pass;
+
+    return OK;
+}
+
+/*
+ * compileCondition -- 条件式を、レコードのバイト列を直接調べる形に変換する
+ *
+ * フィールド名で探すのは文の初めに一度だけにして、レコードごとには
+ * フィールドの位置、データ型、比較演算子、定数だけを使って比べる。
+ *
+ * 引数:
+ *	tableInfo: データ定義情報(レコードの配置)
+ *	condition: 条件式
+ *	predicate: 変換した結果を書き込む構造体
+ *
+ * 返り値:
+ *	成功ならOK、失敗ならNGを返す
+ *
+ * ***注意***
+ *	and、orの子やinの値は文のアリーナに確保するので、変換した結果は
+ *	endStatementを呼ぶまでしか使えない。
+ */
+Result compileCondition(TableInfo *tableInfo, Condition *condition, Predicate *predicate)
+{
+    ConditionNode node;
+
+    /*条件式が存在せず、全てのレコード表示の場合*/
+    if (condition -> allmach == 1) {
+        memset(predicate, 0, sizeof(Predicate));
+        predicate -> kind = PREDICATE_ALL;
+        return OK;
+    }
+
+    if (condition -> where != NULL) {
+        return compileNode(tableInfo, condition -> where, predicate);
+    }
+
+    /* 比較1つだけの条件式 */
+    memset(&node, 0, sizeof(node));
+    node.type = CONDITION_TERM;
+    strcpy(node.name, condition -> name);
+    node.dataType = condition -> dataType;
+    node.operator = condition -> operator;
+    node.numValue = 1;
+    node.intValues[0] = condition -> intValue;
+    strncpy(node.stringValues[0], condition -> stringValue, MAX_STRING);
+    return compileNode(tableInfo, &node, predicate);
+}
+
+/*
+ * checkPredicate -- ページ上のレコードが条件を満足するかどうかのチェック
+ *
+ * 引数:
+ *	predicate: compileConditionで変換した条件
+ *	record: チェックするレコードのバイト列
+ *
+ * 返り値:
+ *	レコードrecordが条件を満足すればOK、満足しなければNGを返す
+ */
+Result checkPredicate(Predicate *predicate, char *record)
+{
+    int intValue, cmp, i;
+
+    switch (predicate -> kind) {
+    case PREDICATE_ALL:
+        return OK;
+    case PREDICATE_INTEGER:
+        memcpy(&intValue, record + predicate -> offset, sizeof(int));
+        switch (predicate -> operator) {
+        case OPR_EQUAL:
+            return (intValue == predicate -> intValue) ? OK : NG;
+        case OPR_NOT_EQUAL:
+            return (intValue != predicate -> intValue) ? OK : NG;
+        case OPR_GREATER_THAN:
+            return (intValue > predicate -> intValue) ? OK : NG;
+        case OPR_LESS_THAN:
+            return (intValue < predicate -> intValue) ? OK : NG;
+        case OPR_GREATER_EQUAL:
+            return (intValue >= predicate -> intValue) ? OK : NG;
+        case OPR_LESS_EQUAL:
+            return (intValue <= predicate -> intValue) ? OK : NG;
+        case OPR_BETWEEN:
+            return (intValue >= predicate -> intValue && intValue <= predicate -> intHigh) ? OK : NG;
+        case OPR_IN:
+            for (i = 0; i < predicate -> numValue; i++) {
+                if (intValue == predicate -> intValues[i]) {
+                    return OK;
+                }
+            }
+            return NG;
+        default:
+            return NG;
+        }
+    case PREDICATE_STRING:
+        if (predicate -> operator == OPR_IN) {
+            for (i = 0; i < predicate -> numValue; i++) {
+                if (strncmp(record + predicate -> offset, predicate -> stringValues[i], MAX_STRING) == 0) {
+                    return OK;
+                }
+            }
+            return NG;
+        }
+        cmp = strncmp(record + predicate -> offset, predicate -> stringValue, MAX_STRING);
+        if (predicate -> operator == OPR_EQUAL) {
+            return (cmp == 0) ? OK : NG;
+        }
+        return (cmp != 0) ? OK : NG;
+    case PREDICATE_AND:
+        /* 満たさない子が見つかったら、残りの子は調べない */
+        for (i = 0; i < predicate -> numChild; i++) {
+            if (checkPredicate(&predicate -> child[i], record) != OK) {
+                return NG;
+            }
+        }
+        return OK;
+    case PREDICATE_OR:
+        /* 満たす子が見つかったら、残りの子は調べない */
+        for (i = 0; i < predicate -> numChild; i++) {
+            if (checkPredicate(&predicate -> child[i], record) == OK) {
+                return OK;
+            }
+        }
+        return NG;
+    default:
+        return NG;
+    }
+}
+
+/*
+ * filterScalar -- レコードを1つずつ調べて選択ビットマップを作る
+ *
+ * 引数:
+ *	predicate: 条件
+ *	page: ページの先頭
+ *	recordSize: レコードの大きさ(バイト数)
+ *	slot: 調べる最初のレコードの番号
+ *	numSlot: ページ中のレコードの数
+ *	bitmap: 選択ビットマップ(条件に合うレコードのビットを立てる)
+ *
+ * 返り値:
+ *	なし
+ */
+static void filterScalar(Predicate *predicate, char *page, int recordSize,
+                         int slot, int numSlot, unsigned char *bitmap)
+{
+    char *p;
+
+    for (; slot < numSlot; slot++) {
+        p = page + recordSize * slot;
+        if (*p == 1 && checkPredicate(predicate, p) == OK) {
+            bitmap[slot >> 3] |= 1 << (slot & 7);
+        }
+    }
+}
+
+#ifdef PREDICATE_SIMD
+/*
+ * filterIntSSE2 -- integer型の条件をSSE2で4レコードずつ調べる
+ *
+ * SSE2にはギャザー命令がないので、4レコード分のフィールドの値と
+ * 「使用中」フラグを1つずつ読んでベクトルに詰め、比較はまとめて行う。
+ * 8レコードごとにビットマップの1バイトを作り、残りはfilterScalarで調べる。
+ *
+ * 引数と返り値はfilterScalarと同じ
+ */
+static void filterIntSSE2(Predicate *predicate, char *page, int recordSize,
+                          int slot, int numSlot, unsigned char *bitmap)
+{
+    __m128i low = _mm_set1_epi32(predicate -> intValue);
+    __m128i high = _mm_set1_epi32(predicate -> intHigh);
+    __m128i one = _mm_set1_epi32(1);
+    __m128i value, flag, match;
+    int v[8], f[8];
+    int i, mask, bits;
+    char *p;
+
+    for (; slot + 8 <= numSlot; slot += 8) {
+        p = page + recordSize * slot;
+        for (i = 0; i < 8; i++) {
+            memcpy(&v[i], p + predicate -> offset, sizeof(int));
+            f[i] = *p;
+            p += recordSize;
+        }
+
+        bits = 0;
+        for (i = 0; i < 8; i += 4) {
+            value = _mm_loadu_si128((__m128i *) &v[i]);
+            flag = _mm_cmpeq_epi32(_mm_loadu_si128((__m128i *) &f[i]), one);
+            switch (predicate -> operator) {
+            case OPR_EQUAL:
+                match = _mm_and_si128(_mm_cmpeq_epi32(value, low), flag);
+                break;
+            case OPR_NOT_EQUAL:
+                match = _mm_andnot_si128(_mm_cmpeq_epi32(value, low), flag);
+                break;
+            case OPR_GREATER_THAN:
+                match = _mm_and_si128(_mm_cmpgt_epi32(value, low), flag);
+                break;
+            case OPR_LESS_THAN:
+                match = _mm_and_si128(_mm_cmplt_epi32(value, low), flag);
+                break;
+            case OPR_GREATER_EQUAL:
+                match = _mm_andnot_si128(_mm_cmplt_epi32(value, low), flag);
+                break;
+            case OPR_LESS_EQUAL:
+                match = _mm_andnot_si128(_mm_cmpgt_epi32(value, low), flag);
+                break;
+            case OPR_BETWEEN:
+                match = _mm_andnot_si128(_mm_or_si128(_mm_cmplt_epi32(value, low),
+                                                      _mm_cmpgt_epi32(value, high)), flag);
+                break;
+            default:
+                match = _mm_setzero_si128();
+                break;
+            }
+            mask = _mm_movemask_ps(_mm_castsi128_ps(match));
+            bits |= mask << i;
+        }
+        bitmap[slot >> 3] |= bits;
+    }
+
+    filterScalar(predicate, page, recordSize, slot, numSlot, bitmap);
+}
+
+/*
+ * filterIntAVX2 -- integer型の条件をAVX2で8レコードずつ調べる
+ *
+ * 8レコード分のフィールドの値と「使用中」フラグを、レコードの間隔を
+ * 添字にしたギャザー命令で読む。フラグはレコードの先頭から4バイト
+ * 読んで下位1バイトを使う(integer型のフィールドがあるレコードは
+ * 5バイト以上あるので、ページの外は読まない)。
+ * 残りのレコードはfilterScalarで調べる。
+ *
+ * 引数と返り値はfilterScalarと同じ
+ */
+__attribute__((target("avx2")))
+static void filterIntAVX2(Predicate *predicate, char *page, int recordSize,
+                          int slot, int numSlot, unsigned char *bitmap)
+{
+    __m256i low = _mm256_set1_epi32(predicate -> intValue);
+    __m256i high = _mm256_set1_epi32(predicate -> intHigh);
+    __m256i one = _mm256_set1_epi32(1);
+    __m256i byte = _mm256_set1_epi32(0xff);
+    __m256i index, value, flag, match;
+    char *p;
+
+    index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                               _mm256_set1_epi32(recordSize));
+
+    for (; slot + 8 <= numSlot; slot += 8) {
+        p = page + recordSize * slot;
+        value = _mm256_i32gather_epi32((int *) (p + predicate -> offset), index, 1);
+        flag = _mm256_i32gather_epi32((int *) p, index, 1);
+        flag = _mm256_cmpeq_epi32(_mm256_and_si256(flag, byte), one);
+        switch (predicate -> operator) {
+        case OPR_EQUAL:
+            match = _mm256_and_si256(_mm256_cmpeq_epi32(value, low), flag);
+            break;
+        case OPR_NOT_EQUAL:
+            match = _mm256_andnot_si256(_mm256_cmpeq_epi32(value, low), flag);
+            break;
+        case OPR_GREATER_THAN:
+            match = _mm256_and_si256(_mm256_cmpgt_epi32(value, low), flag);
+            break;
+        case OPR_LESS_THAN:
+            match = _mm256_and_si256(_mm256_cmpgt_epi32(low, value), flag);
+            break;
+        case OPR_GREATER_EQUAL:
+            match = _mm256_andnot_si256(_mm256_cmpgt_epi32(low, value), flag);
+            break;
+        case OPR_LESS_EQUAL:
+            match = _mm256_andnot_si256(_mm256_cmpgt_epi32(value, low), flag);
+            break;
+        case OPR_BETWEEN:
+            match = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpgt_epi32(low, value),
+                                                        _mm256_cmpgt_epi32(value, high)), flag);
+            break;
+        default:
+            match = _mm256_setzero_si256();
+            break;
+        }
+        bitmap[slot >> 3] |= _mm256_movemask_ps(_mm256_castsi256_ps(match));
+    }
+
+    filterScalar(predicate, page, recordSize, slot, numSlot, bitmap);
+}
+#endif
+
+/*
+ * isVectorPredicate -- SIMD命令で調べられる条件かどうか
+ *
+ * 引数:
+ *	predicate: 条件
+ *
+ * 返り値:
+ *	integer型のフィールドと定数の比較(in以外)で、SIMD命令を使う設定なら1、
+ *	そうでなければ0
+ */
+static int isVectorPredicate(Predicate *predicate)
+{
+    return predicateKernel != PREDICATE_KERNEL_SCALAR &&
+        predicate -> kind == PREDICATE_INTEGER && predicate -> operator != OPR_IN;
+}
+
+/*
+ * filterNode -- 条件に合うレコードのビットを、0にしたビットマップに立てる
+ *
+ * andは子を順に評価し、前の子で残ったレコードだけを次の子で調べる
+ * (残りがなくなれば打ち切る)。orは、まだ満たしていないレコードだけを
+ * 次の子で調べる。SIMD命令で調べられる子は、ページ全体を調べてから
+ * ビットマップ同士を組み合わせる。
+ *
+ * 引数:
+ *	predicate: 条件
+ *	page: ページの先頭
+ *	recordSize: レコードの大きさ(バイト数)
+ *	numSlot: ページ中のレコードの数
+ *	bitmap: 選択ビットマップ(0にしておく)
+ *
+ * 返り値:
+ *	なし
+ */
+static void filterNode(Predicate *predicate, char *page, int recordSize, int numSlot,
+                       unsigned char *bitmap)
+{
+    unsigned char other[SELECTION_BYTES];
+    int numBytes = (numSlot + 7) / 8;
+    int i, k, slot, any;
+    char *p;
+
+    switch (predicate -> kind) {
+    case PREDICATE_NONE:
+        return;
+    case PREDICATE_AND:
+        filterNode(&predicate -> child[0], page, recordSize, numSlot, bitmap);
+        for (i = 1; i < predicate -> numChild; i++) {
+            /* 残ったレコードがなければ、残りの子は調べない */
+            any = 0;
+            for (k = 0; k < numBytes; k++) {
+                any |= bitmap[k];
+            }
+            if (any == 0) {
+                return;
+            }
+
+            if (isVectorPredicate(&predicate -> child[i])) {
+                memset(other, 0, numBytes);
+                filterNode(&predicate -> child[i], page, recordSize, numSlot, other);
+                for (k = 0; k < numBytes; k++) {
+                    bitmap[k] &= other[k];
+                }
+                continue;
+            }
+            for (slot = nextSelectedSlot(bitmap, 0, numSlot); slot >= 0;
+                 slot = nextSelectedSlot(bitmap, slot + 1, numSlot)) {
+                if (checkPredicate(&predicate -> child[i], page + recordSize * slot) != OK) {
+                    bitmap[slot >> 3] &= ~(1 << (slot & 7));
+                }
+            }
+        }
+        return;
+    case PREDICATE_OR:
+        filterNode(&predicate -> child[0], page, recordSize, numSlot, bitmap);
+        for (i = 1; i < predicate -> numChild; i++) {
+            if (isVectorPredicate(&predicate -> child[i])) {
+                memset(other, 0, numBytes);
+                filterNode(&predicate -> child[i], page, recordSize, numSlot, other);
+                for (k = 0; k < numBytes; k++) {
+                    bitmap[k] |= other[k];
+                }
+                continue;
+            }
+            for (slot = 0; slot < numSlot; slot++) {
+                /* すでに満たしているレコードは調べない */
+                p = page + recordSize * slot;
+                if (*p == 1 && (bitmap[slot >> 3] & (1 << (slot & 7))) == 0 &&
+                    checkPredicate(&predicate -> child[i], p) == OK) {
+                    bitmap[slot >> 3] |= 1 << (slot & 7);
+                }
+            }
+        }
+        return;
+    case PREDICATE_INTEGER:
+        if (isVectorPredicate(predicate)) {
+            switch (predicateKernel) {
+#ifdef PREDICATE_SIMD
+            case PREDICATE_KERNEL_AVX2:
+                filterIntAVX2(predicate, page, recordSize, 0, numSlot, bitmap);
+                return;
+            case PREDICATE_KERNEL_SSE2:
+                filterIntSSE2(predicate, page, recordSize, 0, numSlot, bitmap);
+                return;
+#endif
+            default:
+                break;
+            }
+        }
+        filterScalar(predicate, page, recordSize, 0, numSlot, bitmap);
+        return;
+    default:
+        filterScalar(predicate, page, recordSize, 0, numSlot, bitmap);
+        return;
+    }
+}
+
+/*
+ * filterPage -- ページ中で条件に合うレコードの選択ビットマップを作る
+ *
+ * 使用中で、条件を満たすレコードの番号のビットを立てる(k番目のレコードは
+ * bitmap[k / 8]の下から(k % 8)番目のビット)。
+ *
+ * 引数:
+ *	predicate: compileConditionで変換した条件
+ *	page: ページの先頭
+ *	recordSize: レコードの大きさ(バイト数)
+ *	numSlot: ページ中のレコードの数(PAGE_SIZE以下)
+ *	bitmap: 選択ビットマップを書き込む領域(SELECTION_BYTESバイト)
+ *
+ * 返り値:
+ *	条件に合ったレコードの数
+ */
+int filterPage(Predicate *predicate, char *page, int recordSize, int numSlot,
+               unsigned char *bitmap)
+{
+    int i, count;
+
+    memset(bitmap, 0, (numSlot + 7) / 8);
+    filterNode(predicate, page, recordSize, numSlot, bitmap);
+
+    count = 0;
+    for (i = 0; i < (numSlot + 7) / 8; i++) {
+        count += __builtin_popcount(bitmap[i]);
+    }
+    return count;
+}
+
+/*
+ * nextSelectedSlot -- 選択ビットマップで次にビットが立っているレコードの番号
+ *
+ * 引数:
+ *	bitmap: filterPageで作った選択ビットマップ
+ *	slot: 調べ始めるレコードの番号
+ *	numSlot: ページ中のレコードの数
+ *
+ * 返り値:
+ *	slot以降で最初に選択されたレコードの番号を返す。なければ-1を返す
+ */
+int nextSelectedSlot(unsigned char *bitmap, int slot, int numSlot)
+{
+    int bits;
+
+    while (slot < numSlot) {
+        /* 8レコード分がまとめて選ばれていなければ読み飛ばす */
+        bits = bitmap[slot >> 3] >> (slot & 7);
+        if (bits == 0) {
+            slot = (slot | 7) + 1;
+            continue;
+        }
+        slot += __builtin_ctz(bits);
+        return (slot < numSlot) ? slot : -1;
+    }
+    return -1;
+}
@@ -0,0 +1,135 @@
+/*
+ * 文単位のメモリ管理モジュール(アリーナ)テストプログラム
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "microdb.h"
+
+/*
+ * テスト名
+ */
+#define TEST_NAME "test-arena"
+
+/*
+ * test1 -- 確保した領域の境界と内容
+ */
+Result test1()
+{
+    char *p[100];
+    int i;
+
+    beginStatement();
+    for (i = 0; i < 100; i++) {
+	/* 大きさを変えながら確保し、それぞれに異なる内容を書く */
+	if ((p[i] = allocateMemory(i * 37 + 1)) == NULL) {
+	    fprintf(stderr, "Cannot allocate memory.\n");
+	    return NG;
+	}
+	if (((unsigned long) p[i] & 15) != 0) {
+	    fprintf(stderr, "Memory is not aligned.\n");
+	    return NG;
+	}
+	memset(p[i], i, i * 37 + 1);
+    }
+
+    /* 後から確保した領域で、前の領域が壊れていないこと */
+    for (i = 0; i < 100; i++) {
+	if (p[i][0] != i || p[i][i * 37] != i) {
+	    fprintf(stderr, "Memory %d is broken.\n", i);
+	    return NG;
+	}
+    }
+    endStatement();
+
+    return OK;
+}
+
+/*
+ * test2 -- 文ごとのピークの統計と、領域の再利用
+ */
+Result test2()
+{
+    ArenaStats stats;
+    long reserved;
+    int i;
+
+    resetArenaStats();
+
+    /* 1MBを確保する文 */
+    beginStatement();
+    for (i = 0; i < 1024; i++) {
+	allocateMemory(1024);
+    }
+    getArenaStats(&stats);
+    if (stats.currentBytes != 1024 * 1024) {
+	fprintf(stderr, "Current bytes is wrong: %ld\n", stats.currentBytes);
+	return NG;
+    }
+    endStatement();
+
+    /* 小さな文 */
+    beginStatement();
+    allocateMemory(100);
+    endStatement();
+
+    getArenaStats(&stats);
+    if (stats.statements != 2 || stats.lastPeakBytes != 112 ||
+	stats.maxPeakBytes != 1024 * 1024 || stats.currentBytes != 0) {
+	fprintf(stderr, "Statistics are wrong: %ld %ld %ld\n",
+		stats.statements, stats.lastPeakBytes, stats.maxPeakBytes);
+	return NG;
+    }
+
+    /* 同じ大きさの文を繰り返しても、新しく領域を確保しない */
+    for (i = 0; i < 10; i++) {
+	beginStatement();
+	allocateMemory(256 * 1024);
+	allocateMemory(256 * 1024);
+	endStatement();
+	getArenaStats(&stats);
+	if (i == 0) {
+	    reserved = stats.blockBytes;
+	}
+    }
+    if (stats.blockBytes > reserved) {
+	fprintf(stderr, "Blocks are not reused: %ld > %ld\n", stats.blockBytes, reserved);
+	return NG;
+    }
+    printArenaStats();
+
+    /* 大きな文のあとでも、残しておく領域の量には上限がある */
+    beginStatement();
+    allocateMemory(16 * 1024 * 1024);
+    endStatement();
+    getArenaStats(&stats);
+    if (stats.maxPeakBytes != 16 * 1024 * 1024 || stats.blockBytes > 1024 * 1024) {
+	fprintf(stderr, "Large statement is not handled: %ld\n", stats.blockBytes);
+	return NG;
+    }
+
+    return OK;
+}
+
+int main(int argc, char **argv)
+{
+    /* テストの実行 */
+    fprintf(stderr, "%s: test 1: Start\n", TEST_NAME);
+    if (test1() == OK) {
+	fprintf(stderr, "%s: test 1: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 1: NG\n\n", TEST_NAME);
+    }
+
+    fprintf(stderr, "%s: test 2: Start\n", TEST_NAME);
+    if (test2() == OK) {
+	fprintf(stderr, "%s: test 2: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 2: NG\n\n", TEST_NAME);
+    }
+
+    finalizeArena();
+
+    exit(0);
+}
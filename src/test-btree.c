@@ -0,0 +1,251 @@
+/*
+ * B+木索引モジュールテストプログラム
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "microdb.h"
+
+/*
+ * テスト名
+ */
+#define TEST_NAME "test-btree"
+
+/*
+ * テスト用の索引ファイル(TEST_TABLE.TEST_FIELD.idx)
+ */
+#define TEST_TABLE "test_btree"
+#define TEST_FIELD "key"
+#define TEST_FILE "test_btree.key.idx"
+
+/*
+ * NUM_KEY -- test1で使う値の種類(0〜NUM_KEY-1)
+ */
+#define NUM_KEY 1000
+
+/*
+ * NUM_ENTRY -- test1で挿入する要素の数(内部節も分かれるように多くする)
+ */
+#define NUM_ENTRY 100000
+
+/*
+ * NUM_SEQUENTIAL -- test2で値の昇順に挿入する要素の数
+ */
+#define NUM_SEQUENTIAL 200000
+
+/*
+ * count -- 値ごとの、索引に入っているはずの要素の数
+ */
+int count[NUM_KEY];
+
+/*
+ * checkRange -- 値がlow以上high以下の要素を走査して、数と順序を確かめる
+ */
+Result checkRange(File *file, int low, int high)
+{
+    BtreeCursor *cursor;
+    RecordId rid, last;
+    int key, lastKey = INT_MIN, i, n = 0, expected = 0;
+
+    for (i = (low < 0 ? 0 : low); i <= high && i < NUM_KEY; i++) {
+	expected += count[i];
+    }
+
+    if ((cursor = openIndexCursor(file, low, high)) == NULL) {
+	fprintf(stderr, "Cannot open cursor.\n");
+	return NG;
+    }
+    while (nextIndexEntry(cursor, &key, &rid) == OK) {
+	if (key < low || key > high) {
+	    fprintf(stderr, "Key %d is out of range [%d, %d].\n", key, low, high);
+	    closeIndexCursor(cursor);
+	    return NG;
+	}
+	if (n > 0 && (key < lastKey || (key == lastKey && rid.pageNum <= last.pageNum))) {
+	    fprintf(stderr, "Entries are not sorted at key %d.\n", key);
+	    closeIndexCursor(cursor);
+	    return NG;
+	}
+	lastKey = key;
+	last = rid;
+	n++;
+    }
+    if (closeIndexCursor(cursor) != OK) {
+	fprintf(stderr, "Cursor failed.\n");
+	return NG;
+    }
+    if (n != expected) {
+	fprintf(stderr, "Count in [%d, %d] is wrong: %d != %d\n", low, high, n, expected);
+	return NG;
+    }
+    return OK;
+}
+
+/*
+ * test1 -- ばらばらの順序での挿入、範囲の走査、削除
+ *
+ * 要素のレコードの位置は(要素の番号, 0)にして、同じ値の要素を区別する。
+ */
+Result test1()
+{
+    File *file;
+    RecordId rid;
+    int i;
+
+    deleteFile(TEST_FILE);
+    if (createIndexFile(TEST_TABLE, TEST_FIELD) != OK ||
+	(file = openIndexFile(TEST_TABLE, TEST_FIELD)) == NULL) {
+	fprintf(stderr, "Cannot create index file.\n");
+	return NG;
+    }
+
+    /* 値がばらばらの要素を挿入する */
+    memset(count, 0, sizeof(count));
+    rid.slot = 0;
+    for (i = 0; i < NUM_ENTRY; i++) {
+	rid.pageNum = i;
+	if (insertIndexEntry(file, (i * 7919) % NUM_KEY, &rid) != OK) {
+	    fprintf(stderr, "Cannot insert entry %d.\n", i);
+	    return NG;
+	}
+	count[(i * 7919) % NUM_KEY]++;
+    }
+
+    /* 同じ要素は挿入できない */
+    rid.pageNum = 0;
+    if (insertIndexEntry(file, 0, &rid) != NG) {
+	fprintf(stderr, "Duplicate entry was inserted.\n");
+	return NG;
+    }
+
+    if (checkRange(file, 500, 500) != OK ||
+	checkRange(file, INT_MIN, 10) != OK ||
+	checkRange(file, 990, INT_MAX) != OK ||
+	checkRange(file, 100, 300) != OK ||
+	checkRange(file, INT_MIN, INT_MAX) != OK ||
+	checkRange(file, 2000, 3000) != OK ||
+	checkRange(file, 10, 9) != OK) {
+	return NG;
+    }
+
+    /* 番号が偶数の要素を取り除く */
+    for (i = 0; i < NUM_ENTRY; i += 2) {
+	rid.pageNum = i;
+	if (deleteIndexEntry(file, (i * 7919) % NUM_KEY, &rid) != OK) {
+	    fprintf(stderr, "Cannot delete entry %d.\n", i);
+	    return NG;
+	}
+	count[(i * 7919) % NUM_KEY]--;
+    }
+
+    /* 取り除いた要素はもうない */
+    rid.pageNum = 0;
+    if (deleteIndexEntry(file, 0, &rid) != NG) {
+	fprintf(stderr, "Deleted entry was found.\n");
+	return NG;
+    }
+
+    if (checkRange(file, 500, 500) != OK ||
+	checkRange(file, 100, 300) != OK ||
+	checkRange(file, INT_MIN, INT_MAX) != OK) {
+	return NG;
+    }
+
+    /* 閉じて開き直しても同じ内容が読める */
+    if (closeFile(file) != OK || (file = openIndexFile(TEST_TABLE, TEST_FIELD)) == NULL) {
+	fprintf(stderr, "Cannot reopen index file.\n");
+	return NG;
+    }
+    if (checkRange(file, 0, NUM_KEY - 1) != OK) {
+	return NG;
+    }
+
+    closeFile(file);
+    deleteIndexFile(TEST_TABLE, TEST_FIELD);
+    return OK;
+}
+
+/*
+ * test2 -- 値の昇順の挿入(葉が詰まったままになること)
+ */
+Result test2()
+{
+    BtreeCursor *cursor;
+    File *file;
+    RecordId rid;
+    int i, key, numPage;
+
+    if (createIndexFile(TEST_TABLE, TEST_FIELD) != OK ||
+	(file = openIndexFile(TEST_TABLE, TEST_FIELD)) == NULL) {
+	fprintf(stderr, "Cannot create index file.\n");
+	return NG;
+    }
+
+    rid.slot = 0;
+    for (i = 0; i < NUM_SEQUENTIAL; i++) {
+	rid.pageNum = i;
+	if (insertIndexEntry(file, i, &rid) != OK) {
+	    fprintf(stderr, "Cannot insert entry %d.\n", i);
+	    return NG;
+	}
+    }
+
+    /* すべての要素が順に読める */
+    if ((cursor = openIndexCursor(file, INT_MIN, INT_MAX)) == NULL) {
+	return NG;
+    }
+    for (i = 0; nextIndexEntry(cursor, &key, &rid) == OK; i++) {
+	if (key != i || rid.pageNum != i) {
+	    fprintf(stderr, "Entry %d is wrong: %d\n", i, key);
+	    closeIndexCursor(cursor);
+	    return NG;
+	}
+    }
+    closeIndexCursor(cursor);
+    if (i != NUM_SEQUENTIAL) {
+	fprintf(stderr, "Count is wrong: %d != %d\n", i, NUM_SEQUENTIAL);
+	return NG;
+    }
+    closeFile(file);
+
+    /* 葉を半分ずつに分けていれば、ページ数はおよそ2倍になる */
+    numPage = getNumPages(TEST_FILE);
+    fprintf(stderr, "%d entries in %d pages\n", NUM_SEQUENTIAL, numPage);
+    if (numPage > NUM_SEQUENTIAL / (PAGE_SIZE / 12) * 11 / 10 + 4) {
+	fprintf(stderr, "Leaves are not full.\n");
+	return NG;
+    }
+
+    deleteIndexFile(TEST_TABLE, TEST_FIELD);
+    return OK;
+}
+
+int main(int argc, char **argv)
+{
+    if (initializeFileModule() != OK) {
+	fprintf(stderr, "Cannot initialize file module.\n");
+	exit(1);
+    }
+
+    /* テストの実行 */
+    fprintf(stderr, "%s: test 1: Start\n", TEST_NAME);
+    if (test1() == OK) {
+	fprintf(stderr, "%s: test 1: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 1: NG\n\n", TEST_NAME);
+    }
+
+    fprintf(stderr, "%s: test 2: Start\n", TEST_NAME);
+    if (test2() == OK) {
+	fprintf(stderr, "%s: test 2: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 2: NG\n\n", TEST_NAME);
+    }
+
+    finalizeFileModule();
+    finalizeArena();
+
+    exit(0);
+}
@@ -9,6 +9,11 @@
 
 #define TABLE_NAME "student"
 
+/*
+ * DISTINCT_VALUES -- 重複除去のテストで挿入するレコードの種類
+ */
+#define DISTINCT_VALUES 5000
+
 /*
  * test1 -- レコードの挿入
  */
@@ -44,7 +49,7 @@ Result test1()
 
     record.numField = i;
 
-    if (insertRecord(TABLE_NAME, &record) != OK) {
+    if (insertRecord(TABLE_NAME, &record, NULL) != OK) {
 	fprintf(stderr, "Cannot insert record.\n");
 	return NG;
     }
@@ -76,7 +81,7 @@ Result test1()
 
     record.numField = i;
 
-    if (insertRecord(TABLE_NAME, &record) != OK) {
+    if (insertRecord(TABLE_NAME, &record, NULL) != OK) {
 	fprintf(stderr, "Cannot insert record.\n");
 	return NG;
     }
@@ -108,7 +113,7 @@ Result test1()
 
     record.numField = i;
 
-    if (insertRecord(TABLE_NAME, &record) != OK) {
+    if (insertRecord(TABLE_NAME, &record, NULL) != OK) {
 	fprintf(stderr, "Cannot insert record.\n");
 	return NG;
     }
@@ -140,7 +145,7 @@ Result test1()
 
     record.numField = i;
 
-    if (insertRecord(TABLE_NAME, &record) != OK) {
+    if (insertRecord(TABLE_NAME, &record, NULL) != OK) {
 	fprintf(stderr, "Cannot insert record.\n");
 	return NG;
     }
@@ -172,7 +177,7 @@ Result test1()
 
     record.numField = i;
 
-    if (insertRecord(TABLE_NAME, &record) != OK) {
+    if (insertRecord(TABLE_NAME, &record, NULL) != OK) {
 	fprintf(stderr, "Cannot insert record.\n");
 	return NG;
     }
@@ -204,7 +209,7 @@ Result test1()
 
     record.numField = i;
 
-    if (insertRecord(TABLE_NAME, &record) != OK) {
+    if (insertRecord(TABLE_NAME, &record, NULL) != OK) {
 	fprintf(stderr, "Cannot insert record.\n");
 	return NG;
     }
@@ -223,6 +228,8 @@ Result test2()
     RecordSet *recordSet;
     Condition condition;
 
+    memset(&condition, 0, sizeof(condition));
+
     /*
      * 以下の検索を実行
      * select * from TABLE_NAME where age > 17
@@ -242,6 +249,14 @@ Result test2()
     printf("age > 17, not distinct\n");
     printRecordSet(recordSet);
 
+    /* 結果の行は、テーブルの定義と同じ配置のバイト列で読める */
+    if (recordSet->numRecord != 3 ||
+	getIntField(recordSet->tableInfo, recordSet->record->data, 2) <= 17 ||
+	strcmp(getStringField(recordSet->tableInfo, recordSet->record->data, 1), "Mickey") != 0) {
+	fprintf(stderr, "Records selected are wrong.\n");
+	return NG;
+    }
+
     /* 結果を解放 */
     freeRecordSet(recordSet);
 
@@ -263,6 +278,10 @@ Result test2()
     /* 結果を表示 */
     printf("age > 17, distinct\n");
     printRecordSet(recordSet);
+    if (recordSet->numRecord != 2) {
+	fprintf(stderr, "2 records expected, but %d selected.\n", recordSet->numRecord);
+	return NG;
+    }
 
     /* 結果を解放 */
     freeRecordSet(recordSet);
@@ -285,6 +304,10 @@ Result test2()
     /* 結果を表示 */
     printf("address != 'Florida', not distinct\n");
     printRecordSet(recordSet);
+    if (recordSet->numRecord != 3) {
+	fprintf(stderr, "3 records expected, but %d selected.\n", recordSet->numRecord);
+	return NG;
+    }
 
     /* 結果を解放 */
     freeRecordSet(recordSet);
@@ -307,17 +330,122 @@ Result test2()
     /* 結果を表示 */
     printf("address != 'Florida', distinct\n");
     printRecordSet(recordSet);
+    if (recordSet->numRecord != 2) {
+	fprintf(stderr, "2 records expected, but %d selected.\n", recordSet->numRecord);
+	return NG;
+    }
 
     /* 結果を解放 */
     freeRecordSet(recordSet);
 
+    /*
+     * 以下の検索を実行
+     * select * from TABLE_NAME where name = 'Minnie'
+     * select * from TABLE_NAME where age < 18
+     */
+    strcpy(condition.name, "name");
+    condition.dataType = TYPE_STRING;
+    condition.operator = OPR_EQUAL;
+    strcpy(condition.stringValue, "Minnie");
+    condition.distinct = NOT_DISTINCT;
+    if ((recordSet = selectRecord(TABLE_NAME, &condition)) == NULL ||
+	recordSet->numRecord != 1) {
+	fprintf(stderr, "name = 'Minnie' is wrong.\n");
+	return NG;
+    }
+    freeRecordSet(recordSet);
+
+    strcpy(condition.name, "age");
+    condition.dataType = TYPE_INTEGER;
+    condition.operator = OPR_LESS_THAN;
+    condition.intValue = 18;
+    if ((recordSet = selectRecord(TABLE_NAME, &condition)) == NULL ||
+	recordSet->numRecord != 3) {
+	fprintf(stderr, "age < 18 is wrong.\n");
+	return NG;
+    }
+    freeRecordSet(recordSet);
+
     return OK;
 }
 
 /*
- * test3 -- 削除
+ * countRecords -- 条件なしで走査したレコードの数
+ */
+int countRecords()
+{
+    Scan *scan;
+    Condition condition;
+    int n = 0;
+
+    memset(&condition, 0, sizeof(condition));
+    condition.allmach = 1;
+    condition.distinct = NOT_DISTINCT;
+    if ((scan = openScan(TABLE_NAME, &condition)) == NULL) {
+	return -1;
+    }
+    while (nextRecord(scan) != NULL) {
+	n++;
+    }
+    if (closeScan(scan) != OK) {
+	return -1;
+    }
+
+    return n;
+}
+
+/*
+ * test3 -- データファイルをマップして読む検索
  */
 Result test3()
+{
+    File *file;
+    char *page;
+    int numBuffered, numMapped;
+
+    /* バッファを通して読んだ場合とマップして読んだ場合で、結果が同じはず */
+    setScanMode(SCAN_BUFFERED);
+    numBuffered = countRecords();
+    setScanMode(SCAN_MMAP);
+    numMapped = countRecords();
+    if (numBuffered <= 0 || numMapped != numBuffered) {
+	fprintf(stderr, "Mapped scan found %d records (buffered %d).\n", numMapped, numBuffered);
+	setScanMode(SCAN_BUFFERED);
+	return NG;
+    }
+
+    /*
+     * バッファ上だけで先頭のレコードを消しておく(ファイルには書き戻さない)
+     * マップして読む場合も、この変更が反映されていなければならない
+     */
+    if ((file = openFile(TABLE_NAME ".dat")) == NULL || pinPage(file, 0, &page) != OK) {
+	fprintf(stderr, "Cannot pin page.\n");
+	setScanMode(SCAN_BUFFERED);
+	return NG;
+    }
+    page[0] = 0;
+    unpinPage(file, 0, MODIFIED);
+    numMapped = countRecords();
+    setScanMode(SCAN_BUFFERED);
+
+    /* 消したレコードを元に戻す */
+    pinPage(file, 0, &page);
+    page[0] = 1;
+    unpinPage(file, 0, MODIFIED);
+    closeFile(file);
+
+    if (numMapped != numBuffered - 1) {
+	fprintf(stderr, "Mapped scan does not see a dirty page (%d records).\n", numMapped);
+	return NG;
+    }
+
+    return OK;
+}
+
+/*
+ * test4 -- 削除
+ */
+Result test4()
 {
     Condition condition;
 
@@ -336,10 +464,11 @@ Result test3()
      * 以下の検索を実行
      * delete from TABLE_NAME where age = 17
      */
+    memset(&condition, 0, sizeof(condition));
     strcpy(condition.name, "age");
     condition.dataType = TYPE_INTEGER;
     condition.operator = OPR_EQUAL;
-    strcpy(condition.stringValue, "17");
+    condition.intValue = 17;
 
     if (deleteRecord(TABLE_NAME, &condition) != OK) {
 	fprintf(stderr, "Cannot delete records.\n");
@@ -353,92 +482,1447 @@ Result test3()
 }
 
 /*
- * main -- データ操作モジュールのテスト
+ * test5 -- カタログキャッシュとレコードの配置
  */
-int main(int argc, char **argv)
+Result test5()
+{
+    char tableName[20];
+    TableInfo tableInfo, *first, *second;
+
+    /* 同じテーブルの定義は、2回目以降もキャッシュの同じ領域を返す */
+    if ((first = getTableInfo(TABLE_NAME)) == NULL ||
+	(second = getTableInfo(TABLE_NAME)) == NULL) {
+	fprintf(stderr, "Cannot get table info.\n");
+	return NG;
+    }
+    if (first != second || first->numField != 4) {
+	fprintf(stderr, "Cached table info is wrong.\n");
+	return NG;
+    }
+
+    /* レコードの配置は読み込んだときに計算されている(フラグ1バイトに続けて並ぶ) */
+    if (first->fieldInfo[0].offset != 1 || first->fieldInfo[1].offset != 1 + MAX_STRING ||
+	first->fieldInfo[2].offset != 1 + MAX_STRING * 2 ||
+	first->fieldInfo[3].offset != 1 + MAX_STRING * 2 + sizeof(int) ||
+	first->fieldInfo[3].width != MAX_STRING ||
+	first->recordSize != 1 + MAX_STRING * 3 + sizeof(int) ||
+	first->recordsPerPage != PAGE_SIZE / first->recordSize) {
+	fprintf(stderr, "Record layout is wrong.\n");
+	return NG;
+    }
+    freeTableInfo(second);
+    freeTableInfo(first);
+
+    /* 作り直したテーブルでは、新しい定義を読み込む */
+    strcpy(tableName, TABLE_NAME "_c");
+    dropTable(tableName);
+    tableInfo.numField = 1;
+    strcpy(tableInfo.fieldInfo[0].name, "id");
+    tableInfo.fieldInfo[0].dataType = TYPE_STRING;
+    if (createTable(tableName, &tableInfo) != OK ||
+	(first = getTableInfo(tableName)) == NULL || first->numField != 1) {
+	fprintf(stderr, "Cannot create table.\n");
+	return NG;
+    }
+    dropTable(tableName);
+
+    tableInfo.numField = 2;
+    strcpy(tableInfo.fieldInfo[1].name, "age");
+    tableInfo.fieldInfo[1].dataType = TYPE_INTEGER;
+    if (createTable(tableName, &tableInfo) != OK ||
+	(first = getTableInfo(tableName)) == NULL || first->numField != 2 ||
+	first->fieldInfo[1].dataType != TYPE_INTEGER) {
+	fprintf(stderr, "Catalog was not invalidated.\n");
+	return NG;
+    }
+    dropTable(tableName);
+
+    /* 削除したテーブルの定義は返さない */
+    if (getTableInfo(tableName) != NULL) {
+	fprintf(stderr, "Dropped table is still in the catalog.\n");
+	return NG;
+    }
+
+    return OK;
+}
+
+/*
+ * test6 -- 走査(カーソル)
+ */
+Result test6()
+{
+    Scan *scan;
+    Condition condition;
+    char *record;
+    int n;
+
+    /*
+     * 以下の検索を走査で実行
+     * select distinct * from TABLE_NAME where address != 'Florida'
+     */
+    memset(&condition, 0, sizeof(condition));
+    strcpy(condition.name, "address");
+    condition.dataType = TYPE_STRING;
+    condition.operator = OPR_NOT_EQUAL;
+    strcpy(condition.stringValue, "Florida");
+    condition.distinct = DISTINCT;
+
+    if ((scan = openScan(TABLE_NAME, &condition)) == NULL) {
+	fprintf(stderr, "Cannot open scan.\n");
+	return NG;
+    }
+    for (n = 0; (record = nextRecord(scan)) != NULL; n++) {
+	if (strcmp(getStringField(scan->tableInfo, record, 3), "Florida") == 0) {
+	    fprintf(stderr, "Record does not match the condition.\n");
+	    closeScan(scan);
+	    return NG;
+	}
+    }
+    if (closeScan(scan) != OK || n != 2) {
+	fprintf(stderr, "2 records expected, but %d scanned.\n", n);
+	return NG;
+    }
+
+    /* 途中で終えた走査は、固定していたページを解除する */
+    condition.distinct = NOT_DISTINCT;
+    if ((scan = openScan(TABLE_NAME, &condition)) == NULL ||
+	nextRecord(scan) == NULL || closeScan(scan) != OK) {
+	fprintf(stderr, "Cannot close scan in the middle.\n");
+	return NG;
+    }
+
+    /* 表示も走査を使う */
+    if ((scan = openScan(TABLE_NAME, &condition)) == NULL) {
+	fprintf(stderr, "Cannot open scan.\n");
+	return NG;
+    }
+    printScan(scan);
+    closeScan(scan);
+
+    return OK;
+}
+
+/*
+ * test7 -- メモリの上限を超える重複除去
+ */
+Result test7()
 {
     char tableName[20];
     TableInfo tableInfo;
-    int i;
+    RecordData record;
+    Condition condition;
+    Scan *scan;
+    char *p;
+    static char found[DISTINCT_VALUES];
+    long spilled;
+    int i, n, id;
+
+    /* create table TABLE_NAME_d (id integer, name string) */
+    strcpy(tableName, TABLE_NAME "_d");
+    dropTable(tableName);
+    tableInfo.numField = 2;
+    strcpy(tableInfo.fieldInfo[0].name, "id");
+    tableInfo.fieldInfo[0].dataType = TYPE_INTEGER;
+    strcpy(tableInfo.fieldInfo[1].name, "name");
+    tableInfo.fieldInfo[1].dataType = TYPE_STRING;
+    if (createTable(tableName, &tableInfo) != OK) {
+	fprintf(stderr, "Cannot create table.\n");
+	return NG;
+    }
 
-    /* ファイルモジュールを初期化する */
-    if (initializeFileModule() != OK) {
-	fprintf(stderr, "Cannot initialize file module.\n");
-	exit(1);
+    /* DISTINCT_VALUES種類のレコードを2回ずつ挿入する */
+    record.numField = 2;
+    for (i = 0; i < DISTINCT_VALUES * 2; i++) {
+	memset(&record.fieldData, 0, sizeof(FieldData) * 2);
+	record.fieldData[0].intValue = i % DISTINCT_VALUES;
+	snprintf(record.fieldData[1].stringValue, MAX_STRING, "v%d", i % DISTINCT_VALUES);
+	if (insertRecord(tableName, &record, NULL) != OK) {
+	    fprintf(stderr, "Cannot insert record.\n");
+	    return NG;
+	}
     }
 
-    /* データ定義ジュールを初期化する */
-    if (initializeDataDefModule() != OK) {
-	fprintf(stderr, "Cannot initialize data definition module.\n");
-	exit(1);
+    /* ハッシュ表が上限に達して、一時ファイルに書き出すようにする */
+    setDistinctMemory(128 * 1024);
+
+    memset(&condition, 0, sizeof(condition));
+    condition.allmach = 1;
+    condition.distinct = DISTINCT;
+    if ((scan = openScan(tableName, &condition)) == NULL) {
+	fprintf(stderr, "Cannot open scan.\n");
+	return NG;
+    }
+    memset(found, 0, sizeof(found));
+    for (n = 0; (p = nextRecord(scan)) != NULL; n++) {
+	id = getIntField(scan->tableInfo, p, 0);
+	if (id < 0 || id >= DISTINCT_VALUES || found[id]) {
+	    fprintf(stderr, "Record %d is returned twice.\n", id);
+	    closeScan(scan);
+	    return NG;
+	}
+	found[id] = 1;
+    }
+    spilled = scan->numSpilled;
+    fprintf(stderr, "%d records, %ld spilled\n", n, spilled);
+    if (closeScan(scan) != OK || n != DISTINCT_VALUES || spilled == 0) {
+	fprintf(stderr, "Distinct records are wrong.\n");
+	return NG;
     }
 
-    /* データ操作ジュールを初期化する */
-    if (initializeDataManipModule() != OK) {
-	fprintf(stderr, "Cannot initialize data manipulation module.\n");
-	exit(1);
+    dropTable(tableName);
+    return OK;
+}
+
+/*
+ * makeTerm -- 比較1つの条件式の節を作る(値はintValueかstringValueの1つ)
+ */
+ConditionNode *makeTerm(ConditionNode *node, char *name, DataType dataType,
+			OperatorType operator, int intValue, char *stringValue)
+{
+    memset(node, 0, sizeof(ConditionNode));
+    node->type = CONDITION_TERM;
+    strcpy(node->name, name);
+    node->dataType = dataType;
+    node->operator = operator;
+    node->numValue = 1;
+    node->intValues[0] = intValue;
+    if (stringValue != NULL) {
+	strcpy(node->stringValues[0], stringValue);
+    }
+    return node;
+}
+
+/*
+ * makeNode -- and、orの節を作る
+ */
+ConditionNode *makeNode(ConditionNode *node, ConditionType type,
+			ConditionNode *left, ConditionNode *right)
+{
+    memset(node, 0, sizeof(ConditionNode));
+    node->type = type;
+    node->left = left;
+    node->right = right;
+    return node;
+}
+
+/*
+ * test8 -- and、orを含む条件式での検索と削除
+ */
+Result test8()
+{
+    char tableName[20];
+    TableInfo tableInfo;
+    RecordData record;
+    Condition condition;
+    RecordSet *recordSet;
+    ConditionNode node[8];
+    int i;
+
+    /* create table TABLE_NAME_w (id integer, name string) */
+    strcpy(tableName, TABLE_NAME "_w");
+    dropTable(tableName);
+    tableInfo.numField = 2;
+    strcpy(tableInfo.fieldInfo[0].name, "id");
+    tableInfo.fieldInfo[0].dataType = TYPE_INTEGER;
+    strcpy(tableInfo.fieldInfo[1].name, "name");
+    tableInfo.fieldInfo[1].dataType = TYPE_STRING;
+    if (createTable(tableName, &tableInfo) != OK) {
+	fprintf(stderr, "Cannot create table.\n");
+	return NG;
+    }
+
+    /* (0, 'n0'), (1, 'n1'), ..., (99, 'n9')を挿入する */
+    record.numField = 2;
+    for (i = 0; i < 100; i++) {
+	memset(&record.fieldData, 0, sizeof(FieldData) * 2);
+	record.fieldData[0].intValue = i;
+	snprintf(record.fieldData[1].stringValue, MAX_STRING, "n%d", i % 10);
+	if (insertRecord(tableName, &record, NULL) != OK) {
+	    fprintf(stderr, "Cannot insert record.\n");
+	    return NG;
+	}
     }
 
     /*
-     * このプログラムの前回の実行の時のデータ定義残っている可能性があるので、
-     * とりあえず削除する
+     * 以下の検索を実行
+     * select * from TABLE_NAME_w where id >= 10 and id < 20 or name in ('n3', 'n4')
      */
-    dropTable(TABLE_NAME);
+    memset(&condition, 0, sizeof(condition));
+    makeTerm(&node[0], "name", TYPE_STRING, OPR_IN, 0, "n3");
+    strcpy(node[0].stringValues[1], "n4");
+    node[0].numValue = 2;
+    condition.where =
+	makeNode(&node[1], CONDITION_OR,
+		 makeNode(&node[2], CONDITION_AND,
+			  makeTerm(&node[3], "id", TYPE_INTEGER, OPR_GREATER_EQUAL, 10, NULL),
+			  makeTerm(&node[4], "id", TYPE_INTEGER, OPR_LESS_THAN, 20, NULL)),
+		 &node[0]);
+    if ((recordSet = selectRecord(tableName, &condition)) == NULL ||
+	recordSet->numRecord != 28) {
+	fprintf(stderr, "and/or condition is wrong.\n");
+	return NG;
+    }
+    freeRecordSet(recordSet);
 
     /*
-     * 以下のテーブルを作成
-     * create table student (
-     *   id string,
-     *   name string,
-     *   age integer,
-     *   address string
-     * )
+     * 以下の削除を実行
+     * delete from TABLE_NAME_w where id between 50 and 59 and name = 'n5'
      */
-    strcpy(tableName, TABLE_NAME);
-    i = 0;
+    makeTerm(&node[0], "id", TYPE_INTEGER, OPR_BETWEEN, 50, NULL);
+    node[0].intValues[1] = 59;
+    node[0].numValue = 2;
+    condition.where =
+	makeNode(&node[1], CONDITION_AND, &node[0],
+		 makeTerm(&node[2], "name", TYPE_STRING, OPR_EQUAL, 0, "n5"));
+    if (deleteRecord(tableName, &condition) != OK) {
+	fprintf(stderr, "Cannot delete records.\n");
+	return NG;
+    }
 
-    strcpy(tableInfo.fieldInfo[i].name, "id");
-    tableInfo.fieldInfo[i].dataType = TYPE_STRING;
-    i++;
+    /* 削除したのは(55, 'n5')だけ */
+    condition.where = makeTerm(&node[0], "id", TYPE_INTEGER, OPR_LESS_EQUAL, 99, NULL);
+    if ((recordSet = selectRecord(tableName, &condition)) == NULL ||
+	recordSet->numRecord != 99) {
+	fprintf(stderr, "Records deleted are wrong.\n");
+	return NG;
+    }
+    freeRecordSet(recordSet);
 
-    strcpy(tableInfo.fieldInfo[i].name, "name");
-    tableInfo.fieldInfo[i].dataType = TYPE_STRING;
-    i++;
+    dropTable(tableName);
+    return OK;
+}
 
-    strcpy(tableInfo.fieldInfo[i].name, "age");
-    tableInfo.fieldInfo[i].dataType = TYPE_INTEGER;
-    i++;
+/*
+ * test9 -- フィールドを指定した検索(射影)
+ */
+Result test9()
+{
+    char tableName[20];
+    TableInfo tableInfo;
+    RecordData record;
+    Condition condition;
+    RecordSet *recordSet;
+    Record *r;
+    Scan *scan;
+    char *p;
+    int i, k, n;
+
+    /* create table TABLE_NAME_p (c0 integer, ..., c39 integer) */
+    strcpy(tableName, TABLE_NAME "_p");
+    dropTable(tableName);
+    tableInfo.numField = MAX_FIELD;
+    for (k = 0; k < MAX_FIELD; k++) {
+	snprintf(tableInfo.fieldInfo[k].name, MAX_FIELD_NAME, "c%d", k);
+	tableInfo.fieldInfo[k].dataType = TYPE_INTEGER;
+    }
+    if (createTable(tableName, &tableInfo) != OK) {
+	fprintf(stderr, "Cannot create table.\n");
+	return NG;
+    }
 
-    strcpy(tableInfo.fieldInfo[i].name, "address");
-    tableInfo.fieldInfo[i].dataType = TYPE_STRING;
-    i++;
+    /* i番目のレコードのckは i * 100 + k (最後のフィールドだけ i % 5) */
+    record.numField = MAX_FIELD;
+    for (i = 0; i < 50; i++) {
+	memset(&record.fieldData, 0, sizeof(record.fieldData));
+	for (k = 0; k < MAX_FIELD; k++) {
+	    record.fieldData[k].intValue = (k == MAX_FIELD - 1) ? i % 5 : i * 100 + k;
+	}
+	if (insertRecord(tableName, &record, NULL) != OK) {
+	    fprintf(stderr, "Cannot insert record.\n");
+	    return NG;
+	}
+    }
 
-    tableInfo.numField = i;
+    /*
+     * 以下の検索を実行
+     * select c37, c3 from TABLE_NAME_p where c20 >= 2020
+     */
+    memset(&condition, 0, sizeof(condition));
+    strcpy(condition.name, "c20");
+    condition.dataType = TYPE_INTEGER;
+    condition.operator = OPR_GREATER_EQUAL;
+    condition.intValue = 2020;
+    condition.numColumn = 2;
+    strcpy(condition.columnNames[0], "c37");
+    strcpy(condition.columnNames[1], "c3");
+    if ((recordSet = selectRecord(tableName, &condition)) == NULL ||
+	recordSet->numRecord != 30) {
+	fprintf(stderr, "Projected records are wrong.\n");
+	return NG;
+    }
 
-    /* テーブルの作成 */
-    if (createTable(tableName, &tableInfo) != OK) {
-	/* テーブルの作成に失敗 */
-	fprintf(stderr, "Cannot create table.\n");
-	exit(1);
+    /* 取り出したフィールドだけを詰めて収める */
+    if (recordSet->tableInfo->numField != 2 ||
+	recordSet->tableInfo->recordSize != RECORD_FLAG_SIZE + 2 * sizeof(int)) {
+	fprintf(stderr, "Projected layout is wrong.\n");
+	return NG;
     }
+    for (r = recordSet->record, i = 20; r != NULL; r = r->next, i++) {
+	if (getIntField(recordSet->tableInfo, r->data, 0) != i * 100 + 37 ||
+	    getIntField(recordSet->tableInfo, r->data, 1) != i * 100 + 3) {
+	    fprintf(stderr, "Projected values are wrong.\n");
+	    return NG;
+	}
+    }
+    printRecordSet(recordSet);
+    freeRecordSet(recordSet);
 
-    /* 挿入テスト */
-    fprintf(stderr, "test1: Start\n\n");
-    if (test1() == OK) {
-	fprintf(stderr, "test1: OK\n\n");
-    } else {
-	fprintf(stderr, "test1: NG\n\n");
+    /*
+     * 以下の検索を走査で実行
+     * select distinct c39 from TABLE_NAME_p
+     */
+    memset(&condition, 0, sizeof(condition));
+    condition.allmach = 1;
+    condition.distinct = DISTINCT;
+    condition.numColumn = 1;
+    strcpy(condition.columnNames[0], "c39");
+    if ((scan = openScan(tableName, &condition)) == NULL) {
+	fprintf(stderr, "Cannot open scan.\n");
+	return NG;
+    }
+    for (n = 0; (p = nextRecord(scan)) != NULL; n++) {
+	if (getIntField(scan->resultInfo, p, 0) != n) {
+	    fprintf(stderr, "Distinct projected value is wrong.\n");
+	    closeScan(scan);
+	    return NG;
+	}
+    }
+    if (closeScan(scan) != OK || n != 5) {
+	fprintf(stderr, "5 records expected, but %d scanned.\n", n);
+	return NG;
     }
 
-    /* 検索テスト */
-    fprintf(stderr, "test2: Start\n\n");
-    if (test2() == OK) {
-	fprintf(stderr, "test2: OK\n\n");
-    } else {
-	fprintf(stderr, "test2: NG\n\n");
+    /* ないフィールドは指定できない */
+    strcpy(condition.columnNames[0], "c40");
+    if (openScan(tableName, &condition) != NULL) {
+	fprintf(stderr, "Unknown column is accepted.\n");
+	return NG;
     }
 
-    /* 削除テスト */
+    dropTable(tableName);
+    return OK;
+}
+
+/*
+ * countIndexed -- 同じ条件をid(索引あり)とscore(索引なし、idと同じ値)で検索して、数が一致するか
+ *
+ * 引数の条件はidについて書き、scoreについての条件は名前だけ変えて作る。
+ */
+Result countIndexed(char *tableName, ConditionNode *where, int numNode)
+{
+    Condition condition;
+    RecordSet *byIndex, *byScan;
+    Scan *scan;
+    int i, indexed;
+
+    memset(&condition, 0, sizeof(condition));
+    condition.where = where;
+    if ((scan = openScan(tableName, &condition)) == NULL) {
+	return NG;
+    }
+    indexed = (scan->cursor != NULL);
+    closeScan(scan);
+    if ((byIndex = selectRecord(tableName, &condition)) == NULL) {
+	return NG;
+    }
+
+    for (i = 0; i < numNode; i++) {
+	if (where[i].type == CONDITION_TERM && strcmp(where[i].name, "id") == 0) {
+	    strcpy(where[i].name, "score");
+	}
+    }
+    if ((byScan = selectRecord(tableName, &condition)) == NULL) {
+	return NG;
+    }
+    for (i = 0; i < numNode; i++) {
+	if (where[i].type == CONDITION_TERM && strcmp(where[i].name, "score") == 0) {
+	    strcpy(where[i].name, "id");
+	}
+    }
+
+    if (!indexed || byIndex->numRecord != byScan->numRecord) {
+	fprintf(stderr, "Index scan is wrong: indexed %d, %d != %d\n",
+		indexed, byIndex->numRecord, byScan->numRecord);
+	return NG;
+    }
+    return OK;
+}
+
+/*
+ * test10 -- 索引を使った検索と削除
+ */
+Result test10()
+{
+    char tableName[20];
+    TableInfo tableInfo, *info;
+    RecordData record;
+    Condition condition;
+    ConditionNode node[5];
+    int i, low[] = { 500, 0, 999, -5 }, high[] = { 500, 99, 1200, 5 };
+
+    /* create table TABLE_NAME_x (id integer, score integer, name string) */
+    strcpy(tableName, TABLE_NAME "_x");
+    dropTable(tableName);
+    tableInfo.numField = 3;
+    strcpy(tableInfo.fieldInfo[0].name, "id");
+    tableInfo.fieldInfo[0].dataType = TYPE_INTEGER;
+    strcpy(tableInfo.fieldInfo[1].name, "score");
+    tableInfo.fieldInfo[1].dataType = TYPE_INTEGER;
+    strcpy(tableInfo.fieldInfo[2].name, "name");
+    tableInfo.fieldInfo[2].dataType = TYPE_STRING;
+    if (createTable(tableName, &tableInfo) != OK) {
+	fprintf(stderr, "Cannot create table.\n");
+	return NG;
+    }
+
+    /* idとscoreが同じ値(0〜999、重複あり)のレコードを、索引を作る前と後に挿入する */
+    record.numField = 3;
+    for (i = 0; i < 3000; i++) {
+	if (i == 2000) {
+	    if (createIndex(tableName, "id") != OK) {
+		fprintf(stderr, "Cannot create index.\n");
+		return NG;
+	    }
+	}
+	memset(&record.fieldData, 0, sizeof(record.fieldData));
+	record.fieldData[0].intValue = (i * 37) % 1000;
+	record.fieldData[1].intValue = (i * 37) % 1000;
+	snprintf(record.fieldData[2].stringValue, MAX_STRING, "n%d", i % 10);
+	if (insertRecord(tableName, &record, NULL) != OK) {
+	    fprintf(stderr, "Cannot insert record.\n");
+	    return NG;
+	}
+    }
+
+    /* ないフィールドや、索引のあるフィールドには作れない */
+    if (createIndex(tableName, "nope") != NG || createIndex(tableName, "id") != NG) {
+	fprintf(stderr, "Index was created twice or on unknown field.\n");
+	return NG;
+    }
+    if ((info = getTableInfo(tableName)) == NULL ||
+	!info->fieldInfo[0].indexed || info->fieldInfo[1].indexed) {
+	fprintf(stderr, "Index is not recorded.\n");
+	return NG;
+    }
+
+    for (i = 0; i < 4; i++) {
+	if (countIndexed(tableName, makeTerm(&node[0], "id", TYPE_INTEGER, OPR_EQUAL, low[i], NULL), 1) != OK ||
+	    countIndexed(tableName, makeTerm(&node[0], "id", TYPE_INTEGER, OPR_LESS_THAN, low[i], NULL), 1) != OK ||
+	    countIndexed(tableName, makeTerm(&node[0], "id", TYPE_INTEGER, OPR_GREATER_THAN, low[i], NULL), 1) != OK) {
+	    return NG;
+	}
+	makeTerm(&node[0], "id", TYPE_INTEGER, OPR_BETWEEN, low[i], NULL);
+	node[0].intValues[1] = high[i];
+	node[0].numValue = 2;
+	if (countIndexed(tableName, &node[0], 1) != OK) {
+	    return NG;
+	}
+    }
+
+    /* id > 100 and id <= 200 and name = 'n3' (索引で引いてから残りの条件を調べる) */
+    makeNode(&node[0], CONDITION_AND,
+	     makeNode(&node[1], CONDITION_AND,
+		      makeTerm(&node[2], "id", TYPE_INTEGER, OPR_GREATER_THAN, 100, NULL),
+		      makeTerm(&node[3], "id", TYPE_INTEGER, OPR_LESS_EQUAL, 200, NULL)),
+	     makeTerm(&node[4], "name", TYPE_STRING, OPR_EQUAL, 0, "n3"));
+    if (countIndexed(tableName, node, 5) != OK) {
+	return NG;
+    }
+
+    /* 索引で引く削除(id < 100)と、全ページを読む削除(name = 'n3')のどちらも索引を更新する */
+    memset(&condition, 0, sizeof(condition));
+    condition.where = makeTerm(&node[0], "id", TYPE_INTEGER, OPR_LESS_THAN, 100, NULL);
+    if (deleteRecord(tableName, &condition) != OK) {
+	fprintf(stderr, "Cannot delete records by index.\n");
+	return NG;
+    }
+    condition.where = makeTerm(&node[0], "name", TYPE_STRING, OPR_EQUAL, 0, "n3");
+    if (deleteRecord(tableName, &condition) != OK) {
+	fprintf(stderr, "Cannot delete records.\n");
+	return NG;
+    }
+
+    /* 空いた場所に挿入し直す */
+    for (i = 0; i < 500; i++) {
+	memset(&record.fieldData, 0, sizeof(record.fieldData));
+	record.fieldData[0].intValue = i % 200;
+	record.fieldData[1].intValue = i % 200;
+	strcpy(record.fieldData[2].stringValue, "new");
+	if (insertRecord(tableName, &record, NULL) != OK) {
+	    fprintf(stderr, "Cannot insert record.\n");
+	    return NG;
+	}
+    }
+
+    for (i = 0; i < 4; i++) {
+	makeTerm(&node[0], "id", TYPE_INTEGER, OPR_BETWEEN, low[i], NULL);
+	node[0].intValues[1] = high[i];
+	node[0].numValue = 2;
+	if (countIndexed(tableName, &node[0], 1) != OK ||
+	    countIndexed(tableName, makeTerm(&node[0], "id", TYPE_INTEGER, OPR_GREATER_THAN, low[i], NULL), 1) != OK) {
+	    return NG;
+	}
+    }
+
+    dropTable(tableName);
+    return OK;
+}
+
+/*
+ * countHashed -- name = keyをname(ハッシュ索引あり)とcopy(索引なし、nameと同じ値)で検索して、数が一致するか
+ */
+Result countHashed(char *tableName, char *key, int expected)
+{
+    Condition condition;
+    ConditionNode node;
+    RecordSet *byIndex, *byScan;
+    Scan *scan;
+    int indexed;
+
+    memset(&condition, 0, sizeof(condition));
+    condition.where = makeTerm(&node, "name", TYPE_STRING, OPR_EQUAL, 0, key);
+    if ((scan = openScan(tableName, &condition)) == NULL) {
+	return NG;
+    }
+    indexed = (scan->hashCursor != NULL);
+    closeScan(scan);
+    if ((byIndex = selectRecord(tableName, &condition)) == NULL) {
+	return NG;
+    }
+    strcpy(node.name, "copy");
+    if ((byScan = selectRecord(tableName, &condition)) == NULL) {
+	return NG;
+    }
+
+    if (!indexed || byIndex->numRecord != byScan->numRecord ||
+	(expected >= 0 && byIndex->numRecord != expected)) {
+	fprintf(stderr, "Hash index scan for '%s' is wrong: indexed %d, %d, %d, %d\n",
+		key, indexed, byIndex->numRecord, byScan->numRecord, expected);
+	return NG;
+    }
+    return OK;
+}
+
+/*
+ * test11 -- ハッシュ索引を使った検索と削除
+ */
+Result test11()
+{
+    char tableName[20], key[MAX_STRING];
+    TableInfo tableInfo;
+    RecordData record;
+    Condition condition;
+    ConditionNode node[3];
+    RecordSet *recordSet;
+    Scan *scan;
+    int i, indexed;
+
+    /* create table TABLE_NAME_h (id integer, name string, copy string) */
+    strcpy(tableName, TABLE_NAME "_h");
+    dropTable(tableName);
+    tableInfo.numField = 3;
+    strcpy(tableInfo.fieldInfo[0].name, "id");
+    tableInfo.fieldInfo[0].dataType = TYPE_INTEGER;
+    strcpy(tableInfo.fieldInfo[1].name, "name");
+    tableInfo.fieldInfo[1].dataType = TYPE_STRING;
+    strcpy(tableInfo.fieldInfo[2].name, "copy");
+    tableInfo.fieldInfo[2].dataType = TYPE_STRING;
+    if (createTable(tableName, &tableInfo) != OK) {
+	fprintf(stderr, "Cannot create table.\n");
+	return NG;
+    }
+
+    /* nameとcopyが同じ値('k0'〜'k299'を10回ずつ)のレコードを、索引を作る前と後に挿入する */
+    record.numField = 3;
+    for (i = 0; i < 3000; i++) {
+	if (i == 1000 && createIndex(tableName, "name") != OK) {
+	    fprintf(stderr, "Cannot create hash index.\n");
+	    return NG;
+	}
+	memset(&record.fieldData, 0, sizeof(record.fieldData));
+	record.fieldData[0].intValue = i;
+	snprintf(record.fieldData[1].stringValue, MAX_STRING, "k%d", i % 300);
+	strcpy(record.fieldData[2].stringValue, record.fieldData[1].stringValue);
+	if (insertRecord(tableName, &record, NULL) != OK) {
+	    fprintf(stderr, "Cannot insert record.\n");
+	    return NG;
+	}
+    }
+
+    if (countHashed(tableName, "k0", 10) != OK ||
+	countHashed(tableName, "k150", 10) != OK ||
+	countHashed(tableName, "k299", 10) != OK ||
+	countHashed(tableName, "k300", 0) != OK) {
+	return NG;
+    }
+
+    /* ハッシュ索引で引く削除(name = 'k7')と、全ページを読む削除(id < 500)のどちらも索引を更新する */
+    memset(&condition, 0, sizeof(condition));
+    condition.where = makeTerm(&node[0], "name", TYPE_STRING, OPR_EQUAL, 0, "k7");
+    if (deleteRecord(tableName, &condition) != OK) {
+	fprintf(stderr, "Cannot delete records by hash index.\n");
+	return NG;
+    }
+    condition.where = makeTerm(&node[0], "id", TYPE_INTEGER, OPR_LESS_THAN, 500, NULL);
+    if (deleteRecord(tableName, &condition) != OK) {
+	fprintf(stderr, "Cannot delete records.\n");
+	return NG;
+    }
+    for (i = 0; i < 300; i += 7) {
+	snprintf(key, MAX_STRING, "k%d", i);
+	if (countHashed(tableName, key, (i == 7) ? 0 : -1) != OK) {
+	    return NG;
+	}
+    }
+
+    /* name = 'k8' and id >= 1000 (ハッシュ索引で引いてから残りの条件を調べる) */
+    condition.where =
+	makeNode(&node[0], CONDITION_AND,
+		 makeTerm(&node[1], "id", TYPE_INTEGER, OPR_GREATER_EQUAL, 1000, NULL),
+		 makeTerm(&node[2], "name", TYPE_STRING, OPR_EQUAL, 0, "k8"));
+    if ((scan = openScan(tableName, &condition)) == NULL) {
+	return NG;
+    }
+    indexed = (scan->hashCursor != NULL);
+    closeScan(scan);
+    if (!indexed || (recordSet = selectRecord(tableName, &condition)) == NULL ||
+	recordSet->numRecord != 6) {
+	fprintf(stderr, "and condition with hash index is wrong.\n");
+	return NG;
+    }
+    freeRecordSet(recordSet);
+
+    dropTable(tableName);
+    return OK;
+}
+
+/*
+ * countById -- id = keyの(索引で引いた)レコードの数を数える
+ */
+int countById(char *tableName, int key)
+{
+    Condition condition;
+    ConditionNode node;
+    RecordSet *recordSet;
+    int n;
+
+    memset(&condition, 0, sizeof(condition));
+    condition.where = makeTerm(&node, "id", TYPE_INTEGER, OPR_EQUAL, key, NULL);
+    if ((recordSet = selectRecord(tableName, &condition)) == NULL) {
+	return -1;
+    }
+    n = recordSet->numRecord;
+    freeRecordSet(recordSet);
+    return n;
+}
+
+/*
+ * test12 -- レコードの位置による読み込み、更新、削除
+ */
+Result test12()
+{
+    char tableName[20];
+    TableInfo tableInfo, *info;
+    RecordData record;
+    RecordId rid[1000], bad;
+    char *p;
+    int i;
+
+    /* create table TABLE_NAME_r (id integer, name string), idに索引 */
+    strcpy(tableName, TABLE_NAME "_r");
+    dropTable(tableName);
+    tableInfo.numField = 2;
+    strcpy(tableInfo.fieldInfo[0].name, "id");
+    tableInfo.fieldInfo[0].dataType = TYPE_INTEGER;
+    strcpy(tableInfo.fieldInfo[1].name, "name");
+    tableInfo.fieldInfo[1].dataType = TYPE_STRING;
+    if (createTable(tableName, &tableInfo) != OK || createIndex(tableName, "id") != OK) {
+	fprintf(stderr, "Cannot create table.\n");
+	return NG;
+    }
+    if ((info = getTableInfo(tableName)) == NULL) {
+	return NG;
+    }
+
+    /* 挿入したレコードの位置が返り、その位置で読める */
+    record.numField = 2;
+    for (i = 0; i < 1000; i++) {
+	memset(&record.fieldData, 0, sizeof(record.fieldData));
+	record.fieldData[0].intValue = i;
+	snprintf(record.fieldData[1].stringValue, MAX_STRING, "r%d", i);
+	if (insertRecord(tableName, &record, &rid[i]) != OK) {
+	    fprintf(stderr, "Cannot insert record.\n");
+	    return NG;
+	}
+	if (i > 0 && rid[i].pageNum == rid[i - 1].pageNum && rid[i].slot == rid[i - 1].slot) {
+	    fprintf(stderr, "Same record id was returned.\n");
+	    return NG;
+	}
+    }
+    for (i = 0; i < 1000; i += 7) {
+	if ((p = fetchRecord(tableName, &rid[i])) == NULL ||
+	    getIntField(info, p, 0) != i || atoi(getStringField(info, p, 1) + 1) != i) {
+	    fprintf(stderr, "Record %d (%d, %d) is wrong.\n", i, rid[i].pageNum, rid[i].slot);
+	    return NG;
+	}
+    }
+
+    /* 3の倍数のレコードのidを書き換える(索引も新しい値で引ける) */
+    for (i = 0; i < 1000; i += 3) {
+	memset(&record.fieldData, 0, sizeof(record.fieldData));
+	record.fieldData[0].intValue = i + 10000;
+	strcpy(record.fieldData[1].stringValue, "updated");
+	if (updateRecordByRid(tableName, &rid[i], &record) != OK) {
+	    fprintf(stderr, "Cannot update record %d.\n", i);
+	    return NG;
+	}
+    }
+    if ((p = fetchRecord(tableName, &rid[3])) == NULL ||
+	getIntField(info, p, 0) != 10003 || strcmp(getStringField(info, p, 1), "updated") != 0) {
+	fprintf(stderr, "Updated record is wrong.\n");
+	return NG;
+    }
+    if (countById(tableName, 3) != 0 || countById(tableName, 10003) != 1 || countById(tableName, 4) != 1) {
+	fprintf(stderr, "Index is not updated.\n");
+	return NG;
+    }
+
+    /* 5の倍数のレコードを削除する(削除したレコードはもう読めず、索引からも消える) */
+    for (i = 0; i < 1000; i += 5) {
+	if (deleteRecordByRid(tableName, &rid[i]) != OK) {
+	    fprintf(stderr, "Cannot delete record %d.\n", i);
+	    return NG;
+	}
+    }
+    if (fetchRecord(tableName, &rid[5]) != NULL || deleteRecordByRid(tableName, &rid[5]) != NG ||
+	updateRecordByRid(tableName, &rid[5], &record) != NG) {
+	fprintf(stderr, "Deleted record was found.\n");
+	return NG;
+    }
+    if (countById(tableName, 5) != 0 || countById(tableName, 10015) != 0 ||
+	countById(tableName, 10006) != 1 || countById(tableName, 7) != 1) {
+	fprintf(stderr, "Index is not updated after delete.\n");
+	return NG;
+    }
+
+    /* 範囲外の位置は読めない */
+    bad.pageNum = 1000;
+    bad.slot = 0;
+    if (fetchRecord(tableName, &bad) != NULL) {
+	return NG;
+    }
+    bad.pageNum = 0;
+    bad.slot = -1;
+    if (fetchRecord(tableName, &bad) != NULL || deleteRecordByRid(tableName, &bad) != NG) {
+	return NG;
+    }
+
+    /* 空いた場所には新しいレコードが入る */
+    if (insertRecord(tableName, &record, &bad) != OK ||
+	bad.pageNum != rid[0].pageNum || bad.slot != rid[0].slot) {
+	fprintf(stderr, "Free slot was not reused.\n");
+	return NG;
+    }
+
+    dropTable(tableName);
+    return OK;
+}
+
+/*
+ * test13 -- 空き領域マップによる挿入場所の選択
+ */
+Result test13()
+{
+    char tableName[20], fsmName[30];
+    TableInfo tableInfo;
+    RecordData record;
+    RecordId rid[3000], r;
+    int i;
+
+    /* create table TABLE_NAME_f (id integer) */
+    strcpy(tableName, TABLE_NAME "_f");
+    snprintf(fsmName, sizeof(fsmName), "%s.fsm", tableName);
+    dropTable(tableName);
+    tableInfo.numField = 1;
+    strcpy(tableInfo.fieldInfo[0].name, "id");
+    tableInfo.fieldInfo[0].dataType = TYPE_INTEGER;
+    if (createTable(tableName, &tableInfo) != OK) {
+	fprintf(stderr, "Cannot create table.\n");
+	return NG;
+    }
+
+    /* 空きがなければ順にページを足していく */
+    record.numField = 1;
+    for (i = 0; i < 3000; i++) {
+	record.fieldData[0].intValue = i;
+	if (insertRecord(tableName, &record, &rid[i]) != OK) {
+	    fprintf(stderr, "Cannot insert record.\n");
+	    return NG;
+	}
+	if (i > 0 && (rid[i].pageNum < rid[i - 1].pageNum ||
+		      (rid[i].pageNum == rid[i - 1].pageNum && rid[i].slot != rid[i - 1].slot + 1))) {
+	    fprintf(stderr, "Record %d was not appended.\n", i);
+	    return NG;
+	}
+    }
+
+    /* 後ろのページの空きと前のページの空きでは、前が先に使われる */
+    if (deleteRecordByRid(tableName, &rid[2500]) != OK || deleteRecordByRid(tableName, &rid[10]) != OK) {
+	return NG;
+    }
+    if (insertRecord(tableName, &record, &r) != OK || r.pageNum != rid[10].pageNum || r.slot != rid[10].slot ||
+	insertRecord(tableName, &record, &r) != OK || r.pageNum != rid[2500].pageNum || r.slot != rid[2500].slot) {
+	fprintf(stderr, "Free slot was not reused.\n");
+	return NG;
+    }
+
+    /* 空き領域マップファイルがなくなっても、データファイルから作り直す */
+    deleteFile(fsmName);
+    if (deleteRecordByRid(tableName, &rid[1500]) != OK) {
+	return NG;
+    }
+    if (insertRecord(tableName, &record, &r) != OK || r.pageNum != rid[1500].pageNum || r.slot != rid[1500].slot) {
+	fprintf(stderr, "Free slot was not reused after rebuild.\n");
+	return NG;
+    }
+    if (insertRecord(tableName, &record, &r) != OK || r.pageNum < rid[2999].pageNum) {
+	fprintf(stderr, "Record was not appended after rebuild.\n");
+	return NG;
+    }
+
+    dropTable(tableName);
+    if (getNumPages(fsmName) != -1) {
+	fprintf(stderr, "Free space map file was not deleted.\n");
+	return NG;
+    }
+    return OK;
+}
+
+/*
+ * test14 -- 複数のレコードの一括挿入
+ */
+Result test14()
+{
+    char tableName[20];
+    TableInfo tableInfo, *info;
+    RecordData *rows;
+    RecordId rid[2000];
+    Condition condition;
+    RecordSet *recordSet;
+    char *p;
+    int i;
+
+    /* create table TABLE_NAME_b (id integer, name string), idに索引 */
+    strcpy(tableName, TABLE_NAME "_b");
+    dropTable(tableName);
+    tableInfo.numField = 2;
+    strcpy(tableInfo.fieldInfo[0].name, "id");
+    tableInfo.fieldInfo[0].dataType = TYPE_INTEGER;
+    strcpy(tableInfo.fieldInfo[1].name, "name");
+    tableInfo.fieldInfo[1].dataType = TYPE_STRING;
+    if (createTable(tableName, &tableInfo) != OK || createIndex(tableName, "id") != OK ||
+	(info = getTableInfo(tableName)) == NULL) {
+	fprintf(stderr, "Cannot create table.\n");
+	return NG;
+    }
+    if ((rows = (RecordData *) calloc(2000, sizeof(RecordData))) == NULL) {
+	return NG;
+    }
+    for (i = 0; i < 2000; i++) {
+	rows[i].numField = 2;
+	rows[i].fieldData[0].intValue = i;
+	snprintf(rows[i].fieldData[1].stringValue, MAX_STRING, "b%d", i);
+    }
+
+    /* 空のテーブルには、ページの先頭から順に詰めて挿入する */
+    if (insertRecords(tableName, rows, 1000, rid) != OK) {
+	fprintf(stderr, "Cannot insert records.\n");
+	free(rows);
+	return NG;
+    }
+    for (i = 0; i < 1000; i++) {
+	if (rid[i].pageNum != i / info->recordsPerPage || rid[i].slot != i % info->recordsPerPage) {
+	    fprintf(stderr, "Record %d was placed at (%d, %d).\n", i, rid[i].pageNum, rid[i].slot);
+	    free(rows);
+	    return NG;
+	}
+    }
+
+    /* 空いた場所を先に埋めてから、末尾にページを足す */
+    for (i = 0; i < 1000; i += 100) {
+	if (deleteRecordByRid(tableName, &rid[i]) != OK) {
+	    free(rows);
+	    return NG;
+	}
+    }
+    if (insertRecords(tableName, rows + 1000, 1000, rid + 1000) != OK) {
+	fprintf(stderr, "Cannot insert records.\n");
+	free(rows);
+	return NG;
+    }
+    for (i = 0; i < 10; i++) {
+	if (rid[1000 + i].pageNum != rid[i * 100].pageNum || rid[1000 + i].slot != rid[i * 100].slot) {
+	    fprintf(stderr, "Free slot was not reused by batch.\n");
+	    free(rows);
+	    return NG;
+	}
+    }
+    if (rid[999].slot + 1 < info->recordsPerPage ?
+	(rid[1010].pageNum != rid[999].pageNum || rid[1010].slot != rid[999].slot + 1) :
+	(rid[1010].pageNum != rid[999].pageNum + 1 || rid[1010].slot != 0)) {
+	fprintf(stderr, "Records were not appended after free slots.\n");
+	free(rows);
+	return NG;
+    }
+    free(rows);
+
+    /* どのレコードも読めて、索引でも引ける */
+    for (i = 1000; i < 2000; i += 37) {
+	if ((p = fetchRecord(tableName, &rid[i])) == NULL || getIntField(info, p, 0) != i) {
+	    fprintf(stderr, "Record %d is wrong.\n", i);
+	    return NG;
+	}
+    }
+    memset(&condition, 0, sizeof(condition));
+    if ((recordSet = selectRecord(tableName, &condition)) == NULL || recordSet->numRecord != 1990) {
+	fprintf(stderr, "Number of records is wrong.\n");
+	return NG;
+    }
+    freeRecordSet(recordSet);
+    if (countById(tableName, 1500) != 1 || countById(tableName, 100) != 0 || countById(tableName, 101) != 1) {
+	fprintf(stderr, "Index is wrong after batch insert.\n");
+	return NG;
+    }
+
+    /* 0件の挿入は何もしない */
+    if (insertRecords(tableName, NULL, 0, NULL) != OK) {
+	return NG;
+    }
+
+    dropTable(tableName);
+    return OK;
+}
+
+/*
+ * test15 -- 一括挿入の途中で索引への追加が失敗する場合
+ *
+ * 次に挿入される位置を指す要素を、あらかじめハッシュ索引に入れておいて
+ * 失敗させる。失敗したレコードは、ページにもどの索引にも残らない。
+ */
+Result test15()
+{
+    char tableName[20], key[MAX_STRING];
+    TableInfo tableInfo;
+    RecordData rows[3];
+    RecordId rid[3], next;
+    File *file;
+    int i;
+
+    /* create table TABLE_NAME_e (id integer, name string)、両方に索引 */
+    strcpy(tableName, TABLE_NAME "_e");
+    dropTable(tableName);
+    tableInfo.numField = 2;
+    strcpy(tableInfo.fieldInfo[0].name, "id");
+    tableInfo.fieldInfo[0].dataType = TYPE_INTEGER;
+    strcpy(tableInfo.fieldInfo[1].name, "name");
+    tableInfo.fieldInfo[1].dataType = TYPE_STRING;
+    if (createTable(tableName, &tableInfo) != OK ||
+	createIndex(tableName, "id") != OK || createIndex(tableName, "name") != OK) {
+	fprintf(stderr, "Cannot create table.\n");
+	return NG;
+    }
+
+    memset(rows, 0, sizeof(rows));
+    for (i = 0; i < 3; i++) {
+	rows[i].numField = 2;
+	rows[i].fieldData[0].intValue = 100 + i;
+	snprintf(rows[i].fieldData[1].stringValue, MAX_STRING, "e%d", i);
+    }
+    if (insertRecords(tableName, rows, 1, rid) != OK) {
+	return NG;
+    }
+
+    /* 一括挿入の2件目が入るはずの位置(rid[0]の2つ後)を指す要素を、ハッシュ索引に入れておく */
+    next.pageNum = rid[0].pageNum;
+    next.slot = rid[0].slot + 2;
+    memset(key, 0, MAX_STRING);
+    strcpy(key, "e1");
+    if ((file = openHashFile(tableName, "name")) == NULL ||
+	insertHashEntry(file, key, &next) != OK || closeFile(file) != OK) {
+	return NG;
+    }
+
+    /* 1件目は入り、2件目で失敗して、3件目は入らない */
+    rows[0].fieldData[0].intValue = 200;
+    strcpy(rows[0].fieldData[1].stringValue, "f0");
+    if (insertRecords(tableName, rows, 3, rid) != NG) {
+	fprintf(stderr, "Batch insert did not fail.\n");
+	return NG;
+    }
+    if (fetchRecord(tableName, &rid[0]) == NULL || fetchRecord(tableName, &next) != NULL) {
+	fprintf(stderr, "Failed record was left on the page.\n");
+	return NG;
+    }
+    if (countById(tableName, 200) != 1 || countById(tableName, 101) != 0 || countById(tableName, 102) != 0) {
+	fprintf(stderr, "Failed record was left in the index.\n");
+	return NG;
+    }
+
+    /* 余計な要素を取り除けば、同じ位置に入る */
+    if ((file = openHashFile(tableName, "name")) == NULL ||
+	deleteHashEntry(file, key, &next) != OK || closeFile(file) != OK) {
+	return NG;
+    }
+    if (insertRecords(tableName, rows + 1, 2, rid + 1) != OK ||
+	rid[1].pageNum != next.pageNum || rid[1].slot != next.slot ||
+	countById(tableName, 101) != 1 || countById(tableName, 102) != 1) {
+	fprintf(stderr, "Cannot insert records again.\n");
+	return NG;
+    }
+
+    dropTable(tableName);
+    return OK;
+}
+
+/*
+ * test16 -- 一時ファイルに書き出した分割の重複除去でのハッシュ表の偏り
+ *
+ * 分割のレコードはハッシュ値の下位ビットがそろっているので、そのビットで
+ * バケットを決めると一部のバケットに集まり、比べる要素の数が増える。
+ */
+Result test16()
+{
+    char tableName[20];
+    TableInfo tableInfo;
+    RecordData *rows;
+    Condition condition;
+    Scan *scan;
+    long spilled, probed;
+    int i, n;
+
+    /* create table TABLE_NAME_h (id integer, name string) */
+    strcpy(tableName, TABLE_NAME "_h");
+    dropTable(tableName);
+    tableInfo.numField = 2;
+    strcpy(tableInfo.fieldInfo[0].name, "id");
+    tableInfo.fieldInfo[0].dataType = TYPE_INTEGER;
+    strcpy(tableInfo.fieldInfo[1].name, "name");
+    tableInfo.fieldInfo[1].dataType = TYPE_STRING;
+    if (createTable(tableName, &tableInfo) != OK) {
+	fprintf(stderr, "Cannot create table.\n");
+	return NG;
+    }
+
+    /* 重複のない40000件を挿入する */
+    if ((rows = (RecordData *) calloc(40000, sizeof(RecordData))) == NULL) {
+	return NG;
+    }
+    for (i = 0; i < 40000; i++) {
+	rows[i].numField = 2;
+	rows[i].fieldData[0].intValue = i;
+	snprintf(rows[i].fieldData[1].stringValue, MAX_STRING, "h%d", i);
+    }
+    if (insertRecords(tableName, rows, 40000, NULL) != OK) {
+	fprintf(stderr, "Cannot insert records.\n");
+	free(rows);
+	return NG;
+    }
+    free(rows);
+
+    /* 大半のレコードが分割に書き出され、分割はそれぞれ1回で表に収まる */
+    setDistinctMemory(256 * 1024);
+
+    memset(&condition, 0, sizeof(condition));
+    condition.allmach = 1;
+    condition.distinct = DISTINCT;
+    if ((scan = openScan(tableName, &condition)) == NULL) {
+	fprintf(stderr, "Cannot open scan.\n");
+	return NG;
+    }
+    for (n = 0; nextRecord(scan) != NULL; n++) {
+    }
+    spilled = scan->numSpilled;
+    probed = scan->numProbed;
+    fprintf(stderr, "%d records, %ld spilled, %ld probed\n", n, spilled, probed);
+    if (closeScan(scan) != OK || n != 40000 || spilled < 20000) {
+	fprintf(stderr, "Distinct records are wrong.\n");
+	return NG;
+    }
+
+    /* バケット数はレコード数以上に保たれるので、1件あたり平均2要素も比べない */
+    if (probed > 2L * (n + spilled)) {
+	fprintf(stderr, "Hash chains are too long.\n");
+	return NG;
+    }
+
+    dropTable(tableName);
+    return OK;
+}
+
+/*
+ * test17 -- 位置を指定した更新で索引への追加が失敗する場合
+ *
+ * 更新後の値とレコードの位置の組を、あらかじめハッシュ索引に入れておいて
+ * 失敗させる。レコードもどの索引も更新前のままになる。
+ */
+Result test17()
+{
+    char tableName[20], key[MAX_STRING];
+    TableInfo tableInfo, *info;
+    RecordData record;
+    RecordId rid;
+    File *file;
+    char *p;
+
+    /* create table TABLE_NAME_u (id integer, name string)、両方に索引 */
+    strcpy(tableName, TABLE_NAME "_u");
+    dropTable(tableName);
+    tableInfo.numField = 2;
+    strcpy(tableInfo.fieldInfo[0].name, "id");
+    tableInfo.fieldInfo[0].dataType = TYPE_INTEGER;
+    strcpy(tableInfo.fieldInfo[1].name, "name");
+    tableInfo.fieldInfo[1].dataType = TYPE_STRING;
+    if (createTable(tableName, &tableInfo) != OK ||
+	createIndex(tableName, "id") != OK || createIndex(tableName, "name") != OK ||
+	(info = getTableInfo(tableName)) == NULL) {
+	fprintf(stderr, "Cannot create table.\n");
+	return NG;
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.numField = 2;
+    record.fieldData[0].intValue = 1;
+    strcpy(record.fieldData[1].stringValue, "u1");
+    if (insertRecord(tableName, &record, &rid) != OK) {
+	return NG;
+    }
+
+    /* 更新後のnameとridの組を、ハッシュ索引に入れておく */
+    memset(key, 0, MAX_STRING);
+    strcpy(key, "u2");
+    if ((file = openHashFile(tableName, "name")) == NULL ||
+	insertHashEntry(file, key, &rid) != OK || closeFile(file) != OK) {
+	return NG;
+    }
+
+    /* idの索引には加えられるが、nameの索引で失敗する */
+    record.fieldData[0].intValue = 2;
+    strcpy(record.fieldData[1].stringValue, "u2");
+    if (updateRecordByRid(tableName, &rid, &record) != NG) {
+	fprintf(stderr, "Update did not fail.\n");
+	return NG;
+    }
+    if ((p = fetchRecord(tableName, &rid)) == NULL ||
+	getIntField(info, p, 0) != 1 || strcmp(getStringField(info, p, 1), "u1") != 0) {
+	fprintf(stderr, "Record was changed by failed update.\n");
+	return NG;
+    }
+    if (countById(tableName, 1) != 1 || countById(tableName, 2) != 0) {
+	fprintf(stderr, "Index was changed by failed update.\n");
+	return NG;
+    }
+
+    /* 余計な要素を取り除けば、更新できる */
+    if ((file = openHashFile(tableName, "name")) == NULL ||
+	deleteHashEntry(file, key, &rid) != OK || closeFile(file) != OK) {
+	return NG;
+    }
+    if (updateRecordByRid(tableName, &rid, &record) != OK ||
+	countById(tableName, 1) != 0 || countById(tableName, 2) != 1) {
+	fprintf(stderr, "Cannot update record again.\n");
+	return NG;
+    }
+
+    dropTable(tableName);
+    return OK;
+}
+
+/*
+ * test18 -- 削除で索引から取り除くのが失敗する場合
+ *
+ * レコードの要素をハッシュ索引から消しておいて失敗させる。そのレコードは
+ * 削除されずに残り、B+木索引の要素も元に戻る。
+ */
+Result test18()
+{
+    char tableName[20], key[MAX_STRING];
+    TableInfo tableInfo;
+    RecordData record;
+    RecordId rid[3];
+    Condition condition;
+    ConditionNode node;
+    File *file;
+    int i;
+
+    /* create table TABLE_NAME_x (id integer, name string)、両方に索引 */
+    strcpy(tableName, TABLE_NAME "_x");
+    dropTable(tableName);
+    tableInfo.numField = 2;
+    strcpy(tableInfo.fieldInfo[0].name, "id");
+    tableInfo.fieldInfo[0].dataType = TYPE_INTEGER;
+    strcpy(tableInfo.fieldInfo[1].name, "name");
+    tableInfo.fieldInfo[1].dataType = TYPE_STRING;
+    if (createTable(tableName, &tableInfo) != OK ||
+	createIndex(tableName, "id") != OK || createIndex(tableName, "name") != OK) {
+	fprintf(stderr, "Cannot create table.\n");
+	return NG;
+    }
+
+    record.numField = 2;
+    for (i = 0; i < 3; i++) {
+	memset(&record.fieldData, 0, sizeof(record.fieldData));
+	record.fieldData[0].intValue = i;
+	snprintf(record.fieldData[1].stringValue, MAX_STRING, "x%d", i);
+	if (insertRecord(tableName, &record, &rid[i]) != OK) {
+	    return NG;
+	}
+    }
+
+    /* id = 0のレコードの要素を、ハッシュ索引から消しておく */
+    memset(key, 0, MAX_STRING);
+    strcpy(key, "x0");
+    if ((file = openHashFile(tableName, "name")) == NULL ||
+	deleteHashEntry(file, key, &rid[0]) != OK || closeFile(file) != OK) {
+	return NG;
+    }
+
+    /* 位置を指定した削除 */
+    if (deleteRecordByRid(tableName, &rid[0]) != NG) {
+	fprintf(stderr, "Delete by rid did not fail.\n");
+	return NG;
+    }
+    if (fetchRecord(tableName, &rid[0]) == NULL || countById(tableName, 0) != 1) {
+	fprintf(stderr, "Record was deleted by failed delete by rid.\n");
+	return NG;
+    }
+
+    /* B+木索引で引く削除 */
+    memset(&condition, 0, sizeof(condition));
+    condition.where = makeTerm(&node, "id", TYPE_INTEGER, OPR_EQUAL, 0, NULL);
+    if (deleteRecord(tableName, &condition) != NG) {
+	fprintf(stderr, "Indexed delete did not fail.\n");
+	return NG;
+    }
+    if (fetchRecord(tableName, &rid[0]) == NULL || countById(tableName, 0) != 1) {
+	fprintf(stderr, "Record was deleted by failed indexed delete.\n");
+	return NG;
+    }
+
+    /* 全ページを読む削除(ほかのレコードは削除される) */
+    condition.where = makeTerm(&node, "name", TYPE_STRING, OPR_NOT_EQUAL, 0, "x2");
+    if (deleteRecord(tableName, &condition) != NG) {
+	fprintf(stderr, "Full scan delete did not fail.\n");
+	return NG;
+    }
+    if (fetchRecord(tableName, &rid[0]) == NULL || countById(tableName, 0) != 1 ||
+	fetchRecord(tableName, &rid[1]) != NULL || countById(tableName, 1) != 0 ||
+	fetchRecord(tableName, &rid[2]) == NULL) {
+	fprintf(stderr, "Records are wrong after failed full scan delete.\n");
+	return NG;
+    }
+
+    /* 要素を戻せば削除できる */
+    if ((file = openHashFile(tableName, "name")) == NULL ||
+	insertHashEntry(file, key, &rid[0]) != OK || closeFile(file) != OK) {
+	return NG;
+    }
+    if (deleteRecordByRid(tableName, &rid[0]) != OK ||
+	fetchRecord(tableName, &rid[0]) != NULL || countById(tableName, 0) != 0) {
+	fprintf(stderr, "Cannot delete record again.\n");
+	return NG;
+    }
+
+    dropTable(tableName);
+    return OK;
+}
+
+/*
+ * main -- データ操作モジュールのテスト
+ */
+int main(int argc, char **argv)
+{
+    char tableName[20];
+    TableInfo tableInfo;
+    int i;
+
+    /* ファイルモジュールを初期化する */
+    if (initializeFileModule() != OK) {
+	fprintf(stderr, "Cannot initialize file module.\n");
+	exit(1);
+    }
+
+    /* データ定義ジュールを初期化する */
+    if (initializeDataDefModule() != OK) {
+	fprintf(stderr, "Cannot initialize data definition module.\n");
+	exit(1);
+    }
+
+    /* データ操作ジュールを初期化する */
+    if (initializeDataManipModule() != OK) {
+	fprintf(stderr, "Cannot initialize data manipulation module.\n");
+	exit(1);
+    }
+
+    /*
+     * このプログラムの前回の実行の時のデータ定義残っている可能性があるので、
+     * とりあえず削除する
+     */
+    dropTable(TABLE_NAME);
+
+    /*
+     * 以下のテーブルを作成
+     * create table student (
+     *   id string,
+     *   name string,
+     *   age integer,
+     *   address string
+     * )
+     */
+    strcpy(tableName, TABLE_NAME);
+    i = 0;
+
+    strcpy(tableInfo.fieldInfo[i].name, "id");
+    tableInfo.fieldInfo[i].dataType = TYPE_STRING;
+    i++;
+
+    strcpy(tableInfo.fieldInfo[i].name, "name");
+    tableInfo.fieldInfo[i].dataType = TYPE_STRING;
+    i++;
+
+    strcpy(tableInfo.fieldInfo[i].name, "age");
+    tableInfo.fieldInfo[i].dataType = TYPE_INTEGER;
+    i++;
+
+    strcpy(tableInfo.fieldInfo[i].name, "address");
+    tableInfo.fieldInfo[i].dataType = TYPE_STRING;
+    i++;
+
+    tableInfo.numField = i;
+
+    /* テーブルの作成 */
+    if (createTable(tableName, &tableInfo) != OK) {
+	/* テーブルの作成に失敗 */
+	fprintf(stderr, "Cannot create table.\n");
+	exit(1);
+    }
+
+    /* 挿入テスト */
+    fprintf(stderr, "test1: Start\n\n");
+    if (test1() == OK) {
+	fprintf(stderr, "test1: OK\n\n");
+    } else {
+	fprintf(stderr, "test1: NG\n\n");
+    }
+
+    /* 検索テスト */
+    fprintf(stderr, "test2: Start\n\n");
+    if (test2() == OK) {
+	fprintf(stderr, "test2: OK\n\n");
+    } else {
+	fprintf(stderr, "test2: NG\n\n");
+    }
+
+    /* マップして読む検索のテスト */
     fprintf(stderr, "test3: Start\n\n");
     if (test3() == OK) {
 	fprintf(stderr, "test3: OK\n\n");
@@ -446,6 +1930,126 @@ int main(int argc, char **argv)
 	fprintf(stderr, "test3: NG\n\n");
     }
 
+    /* 削除テスト */
+    fprintf(stderr, "test4: Start\n\n");
+    if (test4() == OK) {
+	fprintf(stderr, "test4: OK\n\n");
+    } else {
+	fprintf(stderr, "test4: NG\n\n");
+    }
+
+    /* カタログキャッシュのテスト */
+    fprintf(stderr, "test5: Start\n\n");
+    if (test5() == OK) {
+	fprintf(stderr, "test5: OK\n\n");
+    } else {
+	fprintf(stderr, "test5: NG\n\n");
+    }
+
+    /* 走査のテスト */
+    fprintf(stderr, "test6: Start\n\n");
+    if (test6() == OK) {
+	fprintf(stderr, "test6: OK\n\n");
+    } else {
+	fprintf(stderr, "test6: NG\n\n");
+    }
+
+    /* 重複除去のテスト */
+    fprintf(stderr, "test7: Start\n\n");
+    if (test7() == OK) {
+	fprintf(stderr, "test7: OK\n\n");
+    } else {
+	fprintf(stderr, "test7: NG\n\n");
+    }
+
+    /* and、orを含む条件式のテスト */
+    fprintf(stderr, "test8: Start\n\n");
+    if (test8() == OK) {
+	fprintf(stderr, "test8: OK\n\n");
+    } else {
+	fprintf(stderr, "test8: NG\n\n");
+    }
+
+    /* 射影のテスト */
+    fprintf(stderr, "test9: Start\n\n");
+    if (test9() == OK) {
+	fprintf(stderr, "test9: OK\n\n");
+    } else {
+	fprintf(stderr, "test9: NG\n\n");
+    }
+
+    /* 索引のテスト */
+    fprintf(stderr, "test10: Start\n\n");
+    if (test10() == OK) {
+	fprintf(stderr, "test10: OK\n\n");
+    } else {
+	fprintf(stderr, "test10: NG\n\n");
+    }
+
+    /* ハッシュ索引のテスト */
+    fprintf(stderr, "test11: Start\n\n");
+    if (test11() == OK) {
+	fprintf(stderr, "test11: OK\n\n");
+    } else {
+	fprintf(stderr, "test11: NG\n\n");
+    }
+
+    /* レコードの位置による操作のテスト */
+    fprintf(stderr, "test12: Start\n\n");
+    if (test12() == OK) {
+	fprintf(stderr, "test12: OK\n\n");
+    } else {
+	fprintf(stderr, "test12: NG\n\n");
+    }
+
+    /* 空き領域マップのテスト */
+    fprintf(stderr, "test13: Start\n\n");
+    if (test13() == OK) {
+	fprintf(stderr, "test13: OK\n\n");
+    } else {
+	fprintf(stderr, "test13: NG\n\n");
+    }
+
+    /* 一括挿入のテスト */
+    fprintf(stderr, "test14: Start\n\n");
+    if (test14() == OK) {
+	fprintf(stderr, "test14: OK\n\n");
+    } else {
+	fprintf(stderr, "test14: NG\n\n");
+    }
+
+    /* 一括挿入の失敗のテスト */
+    fprintf(stderr, "test15: Start\n\n");
+    if (test15() == OK) {
+	fprintf(stderr, "test15: OK\n\n");
+    } else {
+	fprintf(stderr, "test15: NG\n\n");
+    }
+
+    /* 分割の重複除去のテスト */
+    fprintf(stderr, "test16: Start\n\n");
+    if (test16() == OK) {
+	fprintf(stderr, "test16: OK\n\n");
+    } else {
+	fprintf(stderr, "test16: NG\n\n");
+    }
+
+    /* 位置を指定した更新の失敗のテスト */
+    fprintf(stderr, "test17: Start\n\n");
+    if (test17() == OK) {
+	fprintf(stderr, "test17: OK\n\n");
+    } else {
+	fprintf(stderr, "test17: NG\n\n");
+    }
+
+    /* 削除の失敗のテスト */
+    fprintf(stderr, "test18: Start\n\n");
+    if (test18() == OK) {
+	fprintf(stderr, "test18: OK\n\n");
+    } else {
+	fprintf(stderr, "test18: NG\n\n");
+    }
+
     /* 後始末 */
     dropTable(TABLE_NAME);
     finalizeDataManipModule();
@@ -6,6 +6,7 @@
 #include <string.h>
 #include <time.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include "microdb.h"
 
 /*
@@ -196,9 +197,249 @@ Result test3()
 }
 
 /*
- * test4 -- ファイルの削除
+ * test4 -- ページのピンとピン解除
  */
 Result test4()
+{
+    File *file;
+    char *pinned;
+    char page[PAGE_SIZE];
+
+    if ((file = openFile(TEST_FILE1)) == NULL) {
+	fprintf(stderr, "Cannot open file.\n");
+	return NG;
+    }
+
+    /* ピンしたページの内容が書き込んだものと同じかチェックする */
+    if (pinPage(file, 0, &pinned) != OK) {
+	fprintf(stderr, "Cannot pin page.\n");
+	return NG;
+    }
+    if (memcmp(pagePattern[0], pinned, PAGE_SIZE) != 0) {
+	fprintf(stderr, "Pinned page is wrong.\n");
+	return NG;
+    }
+
+    /* バッファ上のページを直接書き換えて、変更ありとしてピンを解除する */
+    pinned[0] = 'X';
+    if (unpinPage(file, 0, MODIFIED) != OK) {
+	fprintf(stderr, "Cannot unpin page.\n");
+	return NG;
+    }
+    pagePattern[0][0] = 'X';
+
+    /* ピンしていないページのピン解除は失敗するはず */
+    if (unpinPage(file, 0, UNMODIFIED) != NG) {
+	fprintf(stderr, "Unpinned a page that is not pinned.\n");
+	return NG;
+    }
+
+    if (closeFile(file) == NG) {
+	fprintf(stderr, "Cannot close file.\n");
+	return NG;
+    }
+
+    /* オープンし直して、変更がファイルに反映されているかチェックする */
+    if ((file = openFile(TEST_FILE1)) == NULL) {
+	fprintf(stderr, "Cannot open file.\n");
+	return NG;
+    }
+    if (readPage(file, 0, page) != OK || memcmp(pagePattern[0], page, PAGE_SIZE) != 0) {
+	fprintf(stderr, "Modified page is wrong.\n");
+	return NG;
+    }
+    if (closeFile(file) == NG) {
+	fprintf(stderr, "Cannot close file.\n");
+	return NG;
+    }
+
+    return OK;
+}
+
+/*
+ * test5 -- チェックポイントによる変更済みページの書き戻し
+ */
+Result test5()
+{
+    File *file;
+    FILE *fp;
+    char page[PAGE_SIZE];
+    int i;
+
+    if ((file = openFile(TEST_FILE1)) == NULL) {
+	fprintf(stderr, "Cannot open file.\n");
+	return NG;
+    }
+
+    /* 連続したページと離れたページを書き換える */
+    for (i = 2; i < FILE_SIZE; i++) {
+	if (i == 6) {
+	    continue;
+	}
+	pagePattern[i][0] = 'C';
+	if (writePage(file, i, pagePattern[i]) != OK) {
+	    fprintf(stderr, "Cannot write page.\n");
+	    return NG;
+	}
+    }
+
+    /* クローズせずに書き戻し、ファイルの内容を直接読んで確かめる */
+    if (flushAllBuffers() != OK) {
+	fprintf(stderr, "Cannot flush buffers.\n");
+	return NG;
+    }
+    if ((fp = fopen(TEST_FILE1, "r")) == NULL) {
+	fprintf(stderr, "Cannot open file.\n");
+	return NG;
+    }
+    for (i = 0; i < FILE_SIZE; i++) {
+	if (fread(page, PAGE_SIZE, 1, fp) != 1 ||
+	    memcmp(pagePattern[i], page, PAGE_SIZE) != 0) {
+	    fprintf(stderr, "Page %d on disk is wrong.\n", i);
+	    fclose(fp);
+	    return NG;
+	}
+    }
+    fclose(fp);
+
+    if (closeFile(file) == NG) {
+	fprintf(stderr, "Cannot close file.\n");
+	return NG;
+    }
+
+    return OK;
+}
+
+/*
+ * test6 -- 順次走査での先読み
+ */
+Result test6()
+{
+    File *file;
+    FILE *fp;
+    BufferStats stats;
+    char page[PAGE_SIZE];
+    int i;
+
+    /* バッファにページが残っていない状態のファイルを直接作る */
+    deleteFile(TEST_FILE2);
+    if ((fp = fopen(TEST_FILE2, "w")) == NULL) {
+	fprintf(stderr, "Cannot create file.\n");
+	return NG;
+    }
+    for (i = 0; i < FILE_SIZE; i++) {
+	fwrite(pagePattern[i], PAGE_SIZE, 1, fp);
+    }
+    fclose(fp);
+
+    if ((file = openFile(TEST_FILE2)) == NULL) {
+	fprintf(stderr, "Cannot open file.\n");
+	return NG;
+    }
+
+    /* 4ページずつ先読みしながら、先頭から順に読む */
+    setReadaheadWindow(4);
+    setFileAccessMode(file, ACCESS_SEQUENTIAL);
+    for (i = 0; i < FILE_SIZE; i++) {
+	if (readPage(file, i, page) != OK || memcmp(pagePattern[i], page, PAGE_SIZE) != 0) {
+	    fprintf(stderr, "Page %d is wrong.\n", i);
+	    return NG;
+	}
+    }
+
+    /*
+     * 要求されて読んだページ(多くても0, 4, 8ページ目)以外は先読みで読んでいて、
+     * 先読みしたページはすべて参照されているはず
+     */
+    if (getFileBufferStats(TEST_FILE2, &stats) != OK) {
+	fprintf(stderr, "Cannot get buffer statistics.\n");
+	return NG;
+    }
+    if (stats.misses > 3 || stats.misses + stats.pagesPrefetched != FILE_SIZE ||
+	stats.prefetchHits != stats.pagesPrefetched || stats.pagesRead != FILE_SIZE) {
+	fprintf(stderr, "Readahead statistics are wrong (misses %ld, prefetched %ld, hits %ld).\n",
+		stats.misses, stats.pagesPrefetched, stats.prefetchHits);
+	return NG;
+    }
+
+    if (closeFile(file) == NG) {
+	fprintf(stderr, "Cannot close file.\n");
+	return NG;
+    }
+
+    return OK;
+}
+
+/*
+ * test7 -- バックグラウンドライタによる変更済みページの書き出し
+ */
+Result test7()
+{
+    File *file;
+    FILE *fp;
+    BufferStats stats;
+    char page[PAGE_SIZE];
+    int i;
+
+    /* すべてのバッファを未変更に保つよう、バックグラウンドライタを動かす */
+    stopBackgroundWriter();
+    if (startBackgroundWriter(10000, 100) != OK) {
+	fprintf(stderr, "Cannot start background writer.\n");
+	return NG;
+    }
+
+    if ((file = openFile(TEST_FILE1)) == NULL) {
+	fprintf(stderr, "Cannot open file.\n");
+	return NG;
+    }
+    for (i = 0; i < FILE_SIZE; i++) {
+	pagePattern[i][1] = 'W';
+	if (writePage(file, i, pagePattern[i]) != OK) {
+	    fprintf(stderr, "Cannot write page.\n");
+	    return NG;
+	}
+    }
+
+    /* クローズしなくても、しばらくすればファイルに書き出されているはず */
+    for (i = 0; i < 50; i++) {
+	getFileBufferStats(TEST_FILE1, &stats);
+	if (stats.backgroundWrites >= FILE_SIZE) {
+	    break;
+	}
+	usleep(100000);
+    }
+    if (stats.backgroundWrites < FILE_SIZE) {
+	fprintf(stderr, "Background writer wrote only %ld pages.\n", stats.backgroundWrites);
+	return NG;
+    }
+    stopBackgroundWriter();
+
+    if ((fp = fopen(TEST_FILE1, "r")) == NULL) {
+	fprintf(stderr, "Cannot open file.\n");
+	return NG;
+    }
+    for (i = 0; i < FILE_SIZE; i++) {
+	if (fread(page, PAGE_SIZE, 1, fp) != 1 ||
+	    memcmp(pagePattern[i], page, PAGE_SIZE) != 0) {
+	    fprintf(stderr, "Page %d on disk is wrong.\n", i);
+	    fclose(fp);
+	    return NG;
+	}
+    }
+    fclose(fp);
+
+    if (closeFile(file) == NG) {
+	fprintf(stderr, "Cannot close file.\n");
+	return NG;
+    }
+
+    return OK;
+}
+
+/*
+ * test8 -- ファイルの削除
+ */
+Result test8()
 {
     if (deleteFile(TEST_FILE1) == NG) {
 	fprintf(stderr, "Cannot delete file.\n");
@@ -278,6 +519,34 @@ int main(int argc, char **argv)
 	fprintf(stderr, "%s: test 4: NG\n\n", TEST_NAME);
     }
 
+    fprintf(stderr, "%s: test 5: Start\n", TEST_NAME);
+    if (test5() == OK) {
+	fprintf(stderr, "%s: test 5: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 5: NG\n\n", TEST_NAME);
+    }
+
+    fprintf(stderr, "%s: test 6: Start\n", TEST_NAME);
+    if (test6() == OK) {
+	fprintf(stderr, "%s: test 6: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 6: NG\n\n", TEST_NAME);
+    }
+
+    fprintf(stderr, "%s: test 7: Start\n", TEST_NAME);
+    if (test7() == OK) {
+	fprintf(stderr, "%s: test 7: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 7: NG\n\n", TEST_NAME);
+    }
+
+    fprintf(stderr, "%s: test 8: Start\n", TEST_NAME);
+    if (test8() == OK) {
+	fprintf(stderr, "%s: test 8: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 8: NG\n\n", TEST_NAME);
+    }
+
     /*
      * ファイルアクセスモジュールの終了処理
      */
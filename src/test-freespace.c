@@ -0,0 +1,166 @@
+/*
+ * 空き領域マップモジュールテストプログラム
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "microdb.h"
+
+/*
+ * テスト名
+ */
+#define TEST_NAME "test-freespace"
+
+/*
+ * テスト用の空き領域マップファイル(TEST_TABLE.fsm)
+ */
+#define TEST_TABLE "test_freespace"
+#define TEST_FILE "test_freespace.fsm"
+
+/*
+ * NUM_PAGE -- test2で使うデータファイルのページの数(ビットマップが複数ページになる)
+ */
+#define NUM_PAGE (PAGE_SIZE * 8 * 3)
+
+/*
+ * test1 -- 空きの記録と、空きのあるページの検索
+ */
+Result test1()
+{
+    File *file;
+
+    deleteFile(TEST_FILE);
+    if (createFreeSpaceFile(TEST_TABLE) != OK ||
+	(file = openFreeSpaceFile(TEST_TABLE)) == NULL) {
+	fprintf(stderr, "Cannot create free space map file.\n");
+	return NG;
+    }
+
+    /* 空のうちは見つからない */
+    if (findFreePage(file) != -1) {
+	fprintf(stderr, "Free page was found in empty map.\n");
+	return NG;
+    }
+
+    if (setPageFree(file, 5, 1) != OK || setPageFree(file, 9, 1) != OK ||
+	findFreePage(file) != 5) {
+	fprintf(stderr, "Page 5 was not found.\n");
+	return NG;
+    }
+
+    /* 満杯にしたページは飛ばす */
+    if (setPageFree(file, 5, 0) != OK || findFreePage(file) != 9) {
+	fprintf(stderr, "Page 9 was not found.\n");
+	return NG;
+    }
+
+    /* 前のページが空けば、そこから見つかる */
+    if (setPageFree(file, 2, 1) != OK || findFreePage(file) != 2) {
+	fprintf(stderr, "Page 2 was not found.\n");
+	return NG;
+    }
+
+    /* 閉じて開き直しても同じ内容が読める */
+    if (closeFile(file) != OK || (file = openFreeSpaceFile(TEST_TABLE)) == NULL) {
+	fprintf(stderr, "Cannot reopen free space map file.\n");
+	return NG;
+    }
+    if (setPageFree(file, 2, 0) != OK || findFreePage(file) != 9 ||
+	setPageFree(file, 9, 0) != OK || findFreePage(file) != -1) {
+	fprintf(stderr, "Map is wrong after reopen.\n");
+	return NG;
+    }
+
+    closeFile(file);
+    deleteFreeSpaceFile(TEST_TABLE);
+    if (openFreeSpaceFile(TEST_TABLE) != NULL) {
+	fprintf(stderr, "Free space map file was not deleted.\n");
+	return NG;
+    }
+    return OK;
+}
+
+/*
+ * test2 -- ビットマップが複数ページにわたる場合
+ */
+Result test2()
+{
+    File *file;
+    int i, numPage;
+
+    if (createFreeSpaceFile(TEST_TABLE) != OK ||
+	(file = openFreeSpaceFile(TEST_TABLE)) == NULL) {
+	fprintf(stderr, "Cannot create free space map file.\n");
+	return NG;
+    }
+
+    /* 7の倍数のページに空きがある */
+    for (i = 0; i < NUM_PAGE; i += 7) {
+	if (setPageFree(file, i, 1) != OK) {
+	    fprintf(stderr, "Cannot set page %d.\n", i);
+	    return NG;
+	}
+    }
+
+    /* 前から順に埋めていくと、空きのあるページが順に見つかる */
+    for (i = 0; i < NUM_PAGE; i += 7) {
+	if (findFreePage(file) != i) {
+	    fprintf(stderr, "Page %d was not found.\n", i);
+	    return NG;
+	}
+	if (setPageFree(file, i, 0) != OK) {
+	    return NG;
+	}
+    }
+    if (findFreePage(file) != -1) {
+	fprintf(stderr, "Free page was found in full map.\n");
+	return NG;
+    }
+
+    /* 途中のページを空ける */
+    if (setPageFree(file, NUM_PAGE - 1, 1) != OK || setPageFree(file, PAGE_SIZE * 8 + 3, 1) != OK ||
+	findFreePage(file) != PAGE_SIZE * 8 + 3) {
+	fprintf(stderr, "Freed page was not found.\n");
+	return NG;
+    }
+    closeFile(file);
+
+    /* 管理情報とビットマップ3ページ */
+    numPage = getNumPages(TEST_FILE);
+    if (numPage != 4) {
+	fprintf(stderr, "Number of pages is wrong: %d\n", numPage);
+	return NG;
+    }
+
+    deleteFreeSpaceFile(TEST_TABLE);
+    return OK;
+}
+
+int main(int argc, char **argv)
+{
+    if (initializeFileModule() != OK) {
+	fprintf(stderr, "Cannot initialize file module.\n");
+	exit(1);
+    }
+
+    /* テストの実行 */
+    fprintf(stderr, "%s: test 1: Start\n", TEST_NAME);
+    if (test1() == OK) {
+	fprintf(stderr, "%s: test 1: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 1: NG\n\n", TEST_NAME);
+    }
+
+    fprintf(stderr, "%s: test 2: Start\n", TEST_NAME);
+    if (test2() == OK) {
+	fprintf(stderr, "%s: test 2: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 2: NG\n\n", TEST_NAME);
+    }
+
+    finalizeFileModule();
+    finalizeArena();
+
+    exit(0);
+}
@@ -0,0 +1,259 @@
+/*
+ * ハッシュ索引モジュールテストプログラム
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "microdb.h"
+
+/*
+ * テスト名
+ */
+#define TEST_NAME "test-hash"
+
+/*
+ * テスト用のハッシュ索引ファイル(TEST_TABLE.TEST_FIELD.hix)
+ */
+#define TEST_TABLE "test_hash"
+#define TEST_FIELD "name"
+#define TEST_FILE "test_hash.name.hix"
+
+/*
+ * NUM_KEY -- test1で使う値の種類
+ */
+#define NUM_KEY 2000
+
+/*
+ * NUM_ENTRY -- test1で挿入する要素の数(バケットが何度も分かれるように多くする)
+ */
+#define NUM_ENTRY 100000
+
+/*
+ * NUM_SAME -- test2で同じ値に挿入する要素の数(あふれページが長くつながる)
+ */
+#define NUM_SAME 5000
+
+/*
+ * count -- 値ごとの、索引に入っているはずの要素の数
+ */
+int count[NUM_KEY];
+
+/*
+ * makeKey -- 番号kの値を作る
+ */
+void makeKey(char *key, int k)
+{
+    memset(key, 0, MAX_STRING);
+    snprintf(key, MAX_STRING, "name%d", k);
+}
+
+/*
+ * checkKey -- 値が番号kの要素を走査して、数を確かめる
+ */
+Result checkKey(File *file, int k, int expected)
+{
+    HashCursor *cursor;
+    RecordId rid;
+    char key[MAX_STRING];
+    int n = 0;
+
+    makeKey(key, k);
+    if ((cursor = openHashCursor(file, key)) == NULL) {
+	fprintf(stderr, "Cannot open cursor.\n");
+	return NG;
+    }
+    while (nextHashEntry(cursor, &rid) == OK) {
+	if (k < NUM_KEY && rid.pageNum % NUM_KEY != k) {
+	    fprintf(stderr, "Entry for %s is wrong: %d\n", key, rid.pageNum);
+	    closeHashCursor(cursor);
+	    return NG;
+	}
+	n++;
+    }
+    if (closeHashCursor(cursor) != OK) {
+	fprintf(stderr, "Cursor failed.\n");
+	return NG;
+    }
+    if (n != expected) {
+	fprintf(stderr, "Count of %s is wrong: %d != %d\n", key, n, expected);
+	return NG;
+    }
+    return OK;
+}
+
+/*
+ * test1 -- 挿入(バケットの分割)、検索、削除
+ *
+ * 要素のレコードの位置は(要素の番号, 0)で、値は番号 % NUM_KEYから作る。
+ */
+Result test1()
+{
+    File *file;
+    RecordId rid;
+    char key[MAX_STRING];
+    int i, k, numPage;
+
+    deleteFile(TEST_FILE);
+    if (createHashFile(TEST_TABLE, TEST_FIELD) != OK ||
+	(file = openHashFile(TEST_TABLE, TEST_FIELD)) == NULL) {
+	fprintf(stderr, "Cannot create hash index file.\n");
+	return NG;
+    }
+
+    memset(count, 0, sizeof(count));
+    rid.slot = 0;
+    for (i = 0; i < NUM_ENTRY; i++) {
+	rid.pageNum = i;
+	makeKey(key, i % NUM_KEY);
+	if (insertHashEntry(file, key, &rid) != OK) {
+	    fprintf(stderr, "Cannot insert entry %d.\n", i);
+	    return NG;
+	}
+	count[i % NUM_KEY]++;
+    }
+
+    /* 同じ要素は挿入できない */
+    rid.pageNum = 0;
+    makeKey(key, 0);
+    if (insertHashEntry(file, key, &rid) != NG) {
+	fprintf(stderr, "Duplicate entry was inserted.\n");
+	return NG;
+    }
+
+    for (k = 0; k < NUM_KEY; k += 37) {
+	if (checkKey(file, k, count[k]) != OK) {
+	    return NG;
+	}
+    }
+    if (checkKey(file, NUM_KEY, 0) != OK) {
+	return NG;
+    }
+
+    /* 番号が3の倍数の要素を取り除く */
+    for (i = 0; i < NUM_ENTRY; i += 3) {
+	rid.pageNum = i;
+	makeKey(key, i % NUM_KEY);
+	if (deleteHashEntry(file, key, &rid) != OK) {
+	    fprintf(stderr, "Cannot delete entry %d.\n", i);
+	    return NG;
+	}
+	count[i % NUM_KEY]--;
+    }
+    rid.pageNum = 0;
+    makeKey(key, 0);
+    if (deleteHashEntry(file, key, &rid) != NG) {
+	fprintf(stderr, "Deleted entry was found.\n");
+	return NG;
+    }
+
+    /* 閉じて開き直しても同じ内容が読める */
+    if (closeFile(file) != OK || (file = openHashFile(TEST_TABLE, TEST_FIELD)) == NULL) {
+	fprintf(stderr, "Cannot reopen hash index file.\n");
+	return NG;
+    }
+    for (k = 0; k < NUM_KEY; k += 13) {
+	if (checkKey(file, k, count[k]) != OK) {
+	    return NG;
+	}
+    }
+    closeFile(file);
+
+    /* 1つの値の要素は50個なので、バケットは1ページにほぼ収まっているはず */
+    numPage = getNumPages(TEST_FILE);
+    fprintf(stderr, "%d entries in %d pages\n", NUM_ENTRY, numPage);
+    if (numPage > NUM_ENTRY / (PAGE_SIZE / 28) * 3) {
+	fprintf(stderr, "Too many pages.\n");
+	return NG;
+    }
+
+    deleteHashFile(TEST_TABLE, TEST_FIELD);
+    return OK;
+}
+
+/*
+ * test2 -- 同じ値の要素が多い場合(あふれページ)
+ */
+Result test2()
+{
+    File *file;
+    RecordId rid;
+    char key[MAX_STRING];
+    int i;
+
+    if (createHashFile(TEST_TABLE, TEST_FIELD) != OK ||
+	(file = openHashFile(TEST_TABLE, TEST_FIELD)) == NULL) {
+	fprintf(stderr, "Cannot create hash index file.\n");
+	return NG;
+    }
+
+    /* 番号NUM_KEYの値(他の値と混ざらない)の要素を挿入する */
+    makeKey(key, NUM_KEY);
+    for (i = 0; i < NUM_SAME; i++) {
+	rid.pageNum = i;
+	rid.slot = i % 7;
+	if (insertHashEntry(file, key, &rid) != OK) {
+	    fprintf(stderr, "Cannot insert entry %d.\n", i);
+	    return NG;
+	}
+    }
+    if (checkKey(file, NUM_KEY, NUM_SAME) != OK) {
+	return NG;
+    }
+
+    /* 半分を取り除いて挿入し直す */
+    for (i = 0; i < NUM_SAME; i += 2) {
+	rid.pageNum = i;
+	rid.slot = i % 7;
+	if (deleteHashEntry(file, key, &rid) != OK) {
+	    fprintf(stderr, "Cannot delete entry %d.\n", i);
+	    return NG;
+	}
+    }
+    if (checkKey(file, NUM_KEY, NUM_SAME / 2) != OK) {
+	return NG;
+    }
+    for (i = 0; i < NUM_SAME; i += 2) {
+	rid.pageNum = i;
+	rid.slot = i % 7;
+	if (insertHashEntry(file, key, &rid) != OK) {
+	    fprintf(stderr, "Cannot insert entry %d again.\n", i);
+	    return NG;
+	}
+    }
+    if (checkKey(file, NUM_KEY, NUM_SAME) != OK) {
+	return NG;
+    }
+
+    closeFile(file);
+    deleteHashFile(TEST_TABLE, TEST_FIELD);
+    return OK;
+}
+
+int main(int argc, char **argv)
+{
+    if (initializeFileModule() != OK) {
+	fprintf(stderr, "Cannot initialize file module.\n");
+	exit(1);
+    }
+
+    /* テストの実行 */
+    fprintf(stderr, "%s: test 1: Start\n", TEST_NAME);
+    if (test1() == OK) {
+	fprintf(stderr, "%s: test 1: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 1: NG\n\n", TEST_NAME);
+    }
+
+    fprintf(stderr, "%s: test 2: Start\n", TEST_NAME);
+    if (test2() == OK) {
+	fprintf(stderr, "%s: test 2: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 2: NG\n\n", TEST_NAME);
+    }
+
+    finalizeFileModule();
+    finalizeArena();
+
+    exit(0);
+}
@@ -0,0 +1,280 @@
+/*
+ * ページ入出力モジュールテストプログラム
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <dirent.h>
+#include "microdb.h"
+
+/*
+ * テスト名
+ */
+#define TEST_NAME "test-pageio"
+
+/*
+ * テスト用ファイルのファイル名
+ */
+#define TEST_FILE "testfile-pageio"
+
+/*
+ * ファイルサイズ(ファイルに書き込むページ数)
+ */
+#define FILE_SIZE 8
+
+/*
+ * ファイルに書くパターンと、読み込んだ内容
+ */
+char pagePattern[FILE_SIZE][PAGE_SIZE];
+char readBuffer[FILE_SIZE][PAGE_SIZE];
+
+/*
+ * desc -- テスト用ファイルのファイルディスクリプタ
+ */
+int desc;
+
+/*
+ * setRequest -- 連続したページの要求を作る
+ */
+void setRequest(PageRequest *req, struct iovec *iov, int write,
+		char pages[][PAGE_SIZE], int pageNum, int numPages)
+{
+    int i;
+
+    for (i = 0; i < numPages; i++) {
+	iov[i].iov_base = pages[pageNum + i];
+	iov[i].iov_len = PAGE_SIZE;
+    }
+    req->desc = desc;
+    req->write = write;
+    req->pageNum = pageNum;
+    req->numPages = numPages;
+    req->iov = iov;
+}
+
+/*
+ * test1 -- 複数の書き出し要求をまとめて実行し、1つの要求で読み込む
+ */
+Result test1()
+{
+    PageRequest reqs[3], *reqList[3];
+    struct iovec iov[FILE_SIZE];
+    int i;
+
+    /* 0〜2、3、4〜7ページ目を別々の要求として一度に書き出す */
+    setRequest(&reqs[0], &iov[0], 1, pagePattern, 0, 3);
+    setRequest(&reqs[1], &iov[3], 1, pagePattern, 3, 1);
+    setRequest(&reqs[2], &iov[4], 1, pagePattern, 4, 4);
+    for (i = 0; i < 3; i++) {
+	reqList[i] = &reqs[i];
+    }
+    if (submitPageRequests(reqList, 3) != OK) {
+	fprintf(stderr, "Cannot submit requests.\n");
+	return NG;
+    }
+    for (i = 0; i < 3; i++) {
+	if (!reqs[i].done || reqs[i].bytes != (long) PAGE_SIZE * reqs[i].numPages) {
+	    fprintf(stderr, "Request %d is not completed.\n", i);
+	    return NG;
+	}
+    }
+
+    /* ファイル全体を1つの要求で読み込んで比べる */
+    setRequest(&reqs[0], iov, 0, readBuffer, 0, FILE_SIZE);
+    if (submitPageRequests(reqList, 1) != OK ||
+	reqs[0].bytes != (long) PAGE_SIZE * FILE_SIZE ||
+	memcmp(pagePattern, readBuffer, sizeof(readBuffer)) != 0) {
+	fprintf(stderr, "Pages read are wrong.\n");
+	return NG;
+    }
+
+    return OK;
+}
+
+/*
+ * test2 -- 完了を待たずに発行した読み込み要求
+ */
+Result test2()
+{
+    PageRequest req;
+    struct iovec iov[FILE_SIZE];
+
+    memset(readBuffer, 0, sizeof(readBuffer));
+
+    /* io_uringが使えない環境では、発行できないことだけ確かめる */
+    setRequest(&req, iov, 0, readBuffer, 2, 4);
+    if (!isAsyncPageIO()) {
+	return (startPageRequest(&req) == NG) ? OK : NG;
+    }
+
+    if (startPageRequest(&req) != OK || waitPageRequest(&req) != OK) {
+	fprintf(stderr, "Cannot read pages asynchronously.\n");
+	return NG;
+    }
+    if (!req.done || req.bytes != (long) PAGE_SIZE * 4 ||
+	memcmp(pagePattern[2], readBuffer[2], PAGE_SIZE * 4) != 0) {
+	fprintf(stderr, "Pages read are wrong.\n");
+	return NG;
+    }
+
+    /* ファイルの末尾を超えた部分は読み込まれない */
+    setRequest(&req, iov, 0, readBuffer, 6, 2);
+    req.pageNum = FILE_SIZE - 1;
+    if (startPageRequest(&req) != OK || waitPageRequest(&req) != OK ||
+	req.bytes != PAGE_SIZE) {
+	fprintf(stderr, "Short read is wrong.\n");
+	return NG;
+    }
+
+    return OK;
+}
+
+/*
+ * findUringDesc -- io_uringのファイルディスクリプタを探す
+ */
+int findUringDesc()
+{
+    DIR *dir;
+    struct dirent *ent;
+    char path[64], link[64];
+    ssize_t len;
+    int fd = -1;
+
+    if ((dir = opendir("/proc/self/fd")) == NULL) {
+	return -1;
+    }
+    while ((ent = readdir(dir)) != NULL && fd == -1) {
+	snprintf(path, sizeof(path), "/proc/self/fd/%s", ent->d_name);
+	if ((len = readlink(path, link, sizeof(link) - 1)) > 0) {
+	    link[len] = '\0';
+	    if (strstr(link, "io_uring") != NULL) {
+		fd = atoi(ent->d_name);
+	    }
+	}
+    }
+    closedir(dir);
+    return fd;
+}
+
+/*
+ * test3 -- io_uring_enterが失敗する場合(要求を投入キューに残さない)
+ *
+ * io_uringのファイルディスクリプタを/dev/nullに差し替えて失敗させる。
+ */
+Result test3()
+{
+    PageRequest reqs[3], *reqList[3], req;
+    struct iovec iov[FILE_SIZE], iov2[FILE_SIZE];
+    static char writeBuffer[FILE_SIZE][PAGE_SIZE];
+    int i, ringDesc, savedDesc, nullDesc;
+
+    if (!isAsyncPageIO()) {
+	return OK;
+    }
+    if ((ringDesc = findUringDesc()) == -1 || (savedDesc = dup(ringDesc)) == -1 ||
+	(nullDesc = open("/dev/null", O_RDWR)) == -1 || dup2(nullDesc, ringDesc) == -1) {
+	fprintf(stderr, "Cannot replace io_uring descriptor.\n");
+	return NG;
+    }
+    close(nullDesc);
+
+    /* 書き出しはpwritevで行われる */
+    memcpy(writeBuffer, pagePattern, sizeof(writeBuffer));
+    setRequest(&reqs[0], &iov[0], 1, writeBuffer, 0, 3);
+    setRequest(&reqs[1], &iov[3], 1, writeBuffer, 3, 1);
+    setRequest(&reqs[2], &iov[4], 1, writeBuffer, 4, 4);
+    for (i = 0; i < 3; i++) {
+	reqList[i] = &reqs[i];
+    }
+    if (submitPageRequests(reqList, 3) != OK) {
+	fprintf(stderr, "Requests failed without io_uring_enter.\n");
+	return NG;
+    }
+    for (i = 0; i < 3; i++) {
+	if (!reqs[i].done || reqs[i].bytes != (long) PAGE_SIZE * reqs[i].numPages) {
+	    fprintf(stderr, "Request %d is not completed.\n", i);
+	    return NG;
+	}
+    }
+
+    /* 発行だけした読み込みも、完了を待つときにpreadvで行われる */
+    memset(readBuffer, 0, sizeof(readBuffer));
+    setRequest(&req, iov2, 0, readBuffer, 1, 5);
+    if (startPageRequest(&req) != OK || waitPageRequest(&req) != OK ||
+	req.bytes != (long) PAGE_SIZE * 5 ||
+	memcmp(pagePattern[1], readBuffer[1], PAGE_SIZE * 5) != 0) {
+	fprintf(stderr, "Started request failed without io_uring_enter.\n");
+	return NG;
+    }
+
+    /* 元に戻したあと、取り下げた要求が古い領域で実行されることはない */
+    memset(writeBuffer, 'x', sizeof(writeBuffer));
+    memset(readBuffer, 0, sizeof(readBuffer));
+    if (dup2(savedDesc, ringDesc) == -1) {
+	return NG;
+    }
+    close(savedDesc);
+    setRequest(&req, iov2, 0, readBuffer, 0, FILE_SIZE);
+    reqList[0] = &req;
+    if (submitPageRequests(reqList, 1) != OK ||
+	memcmp(pagePattern, readBuffer, sizeof(readBuffer)) != 0) {
+	fprintf(stderr, "Pages were overwritten by stale requests.\n");
+	return NG;
+    }
+
+    return OK;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j;
+
+    if (initializePageIO() != OK) {
+	fprintf(stderr, "%s: initialization failed.\n", TEST_NAME);
+    }
+    fprintf(stderr, "%s: backend: %s\n", TEST_NAME, getPageIOName());
+
+    if ((desc = open(TEST_FILE, O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1) {
+	fprintf(stderr, "%s: cannot create file.\n", TEST_NAME);
+	exit(1);
+    }
+
+    /* ページごとに異なる内容を作る */
+    for (i = 0; i < FILE_SIZE; i++) {
+	for (j = 0; j < PAGE_SIZE; j++) {
+	    pagePattern[i][j] = 'a' + (i + j) % 26;
+	}
+    }
+
+    /* テストの実行 */
+    fprintf(stderr, "%s: test 1: Start\n", TEST_NAME);
+    if (test1() == OK) {
+	fprintf(stderr, "%s: test 1: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 1: NG\n\n", TEST_NAME);
+    }
+
+    fprintf(stderr, "%s: test 2: Start\n", TEST_NAME);
+    if (test2() == OK) {
+	fprintf(stderr, "%s: test 2: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 2: NG\n\n", TEST_NAME);
+    }
+
+    fprintf(stderr, "%s: test 3: Start\n", TEST_NAME);
+    if (test3() == OK) {
+	fprintf(stderr, "%s: test 3: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 3: NG\n\n", TEST_NAME);
+    }
+
+    close(desc);
+    unlink(TEST_FILE);
+    finalizePageIO();
+
+    exit(0);
+}
@@ -0,0 +1,325 @@
+/*
+ * 条件式の評価モジュールテストプログラム
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "microdb.h"
+
+/*
+ * テスト名
+ */
+#define TEST_NAME "test-predicate"
+
+/*
+ * page -- テスト用のページ
+ */
+char page[PAGE_SIZE];
+
+/*
+ * makePage -- レコードの大きさがrecordSizeのページを乱数で作る
+ *
+ * 各レコードは「使用中」フラグ、integer型のフィールド(offsetの位置)からなる。
+ * 値は小さな範囲に偏らせて、等しいものが多く出るようにする。
+ */
+int makePage(int recordSize, int offset)
+{
+    int numSlot, i, value;
+    char *p;
+
+    numSlot = PAGE_SIZE / recordSize;
+    memset(page, 0xa5, sizeof(page));
+    for (i = 0; i < numSlot; i++) {
+	p = page + recordSize * i;
+	*p = (rand() % 4 == 0) ? 0 : 1;
+	switch (rand() % 8) {
+	case 0:
+	    value = INT_MIN;
+	    break;
+	case 1:
+	    value = INT_MAX;
+	    break;
+	default:
+	    value = rand() % 16 - 8;
+	    break;
+	}
+	memcpy(p + offset, &value, sizeof(int));
+    }
+    return numSlot;
+}
+
+/*
+ * checkBitmap -- 選択ビットマップが1レコードずつ調べた結果と一致するか
+ */
+Result checkBitmap(Predicate *predicate, int recordSize, int numSlot,
+		   unsigned char *bitmap, int count)
+{
+    int i, expected = 0, selected;
+    char *p;
+
+    for (i = 0; i < numSlot; i++) {
+	p = page + recordSize * i;
+	selected = (*p == 1 && checkPredicate(predicate, p) == OK);
+	expected += selected;
+	if (((bitmap[i >> 3] >> (i & 7)) & 1) != selected) {
+	    fprintf(stderr, "Slot %d is wrong (kernel %s, size %d, operator %d, value %d).\n",
+		    i, getPredicateKernelName(), recordSize, predicate -> operator,
+		    predicate -> intValue);
+	    return NG;
+	}
+    }
+    if (count != expected) {
+	fprintf(stderr, "Count is wrong: %d != %d\n", count, expected);
+	return NG;
+    }
+    return OK;
+}
+
+/*
+ * test1 -- どの命令でも、integer型の条件の結果が1レコードずつ調べた結果と同じ
+ */
+Result test1()
+{
+    static int recordSizes[] = { 5, 8, 9, 29, 33, 100 };
+    static OperatorType operators[] = { OPR_EQUAL, OPR_NOT_EQUAL, OPR_GREATER_THAN, OPR_LESS_THAN };
+    static int values[] = { 0, 3, -8, INT_MIN, INT_MAX };
+    unsigned char bitmap[SELECTION_BYTES];
+    Predicate predicate;
+    int kernel, s, o, v, numSlot, count, offset;
+
+    for (kernel = PREDICATE_KERNEL_SCALAR; kernel <= PREDICATE_KERNEL_AVX2; kernel++) {
+	if (setPredicateKernel((PredicateKernel) kernel) != OK) {
+	    fprintf(stderr, "kernel %d is not available.\n", kernel);
+	    continue;
+	}
+	for (s = 0; s < sizeof(recordSizes) / sizeof(recordSizes[0]); s++) {
+	    /* フィールドはレコードの末尾に置く(ページの末尾まで読ませる) */
+	    offset = recordSizes[s] - sizeof(int);
+	    numSlot = makePage(recordSizes[s], offset);
+	    for (o = 0; o < 4; o++) {
+		for (v = 0; v < sizeof(values) / sizeof(values[0]); v++) {
+		    memset(&predicate, 0, sizeof(predicate));
+		    predicate.kind = PREDICATE_INTEGER;
+		    predicate.offset = offset;
+		    predicate.operator = operators[o];
+		    predicate.intValue = values[v];
+		    count = filterPage(&predicate, page, recordSizes[s], numSlot, bitmap);
+		    if (checkBitmap(&predicate, recordSizes[s], numSlot, bitmap, count) != OK) {
+			return NG;
+		    }
+		}
+	    }
+	}
+    }
+
+    return OK;
+}
+
+/*
+ * test2 -- integer型以外の条件と、選択ビットマップのたどり方
+ */
+Result test2()
+{
+    unsigned char bitmap[SELECTION_BYTES];
+    Predicate predicate;
+    int numSlot, count, slot, n;
+
+    numSlot = makePage(9, 5);
+
+    /* 条件がなければ、使用中のレコードがすべて選ばれる */
+    memset(&predicate, 0, sizeof(predicate));
+    predicate.kind = PREDICATE_ALL;
+    count = filterPage(&predicate, page, 9, numSlot, bitmap);
+    if (checkBitmap(&predicate, 9, numSlot, bitmap, count) != OK) {
+	return NG;
+    }
+
+    /* nextSelectedSlotで、選ばれたレコードを順にすべてたどれる */
+    n = 0;
+    for (slot = nextSelectedSlot(bitmap, 0, numSlot); slot >= 0;
+	 slot = nextSelectedSlot(bitmap, slot + 1, numSlot)) {
+	if (page[9 * slot] != 1) {
+	    fprintf(stderr, "Slot %d is not used.\n", slot);
+	    return NG;
+	}
+	n++;
+    }
+    if (n != count) {
+	fprintf(stderr, "Selected slots are wrong: %d != %d\n", n, count);
+	return NG;
+    }
+
+    /* どのレコードも満たさない条件 */
+    predicate.kind = PREDICATE_NONE;
+    if (filterPage(&predicate, page, 9, numSlot, bitmap) != 0 ||
+	nextSelectedSlot(bitmap, 0, numSlot) != -1) {
+	fprintf(stderr, "PREDICATE_NONE is wrong.\n");
+	return NG;
+    }
+
+    /* string型の条件(フィールドの内容を書き換えて比べる) */
+    strcpy(page + 9 * 10 + 1, "abcdefg");
+    page[9 * 10] = 1;
+    predicate.kind = PREDICATE_STRING;
+    predicate.offset = 1;
+    predicate.operator = OPR_EQUAL;
+    strcpy(predicate.stringValue, "abcdefg");
+    if (filterPage(&predicate, page, 9, numSlot, bitmap) != 1 ||
+	nextSelectedSlot(bitmap, 0, numSlot) != 10) {
+	fprintf(stderr, "PREDICATE_STRING is wrong.\n");
+	return NG;
+    }
+
+    return OK;
+}
+
+/*
+ * test3 -- and、orを含む条件式の変換と、ページ単位の評価
+ */
+Result test3()
+{
+    static OperatorType operators[] = { OPR_EQUAL, OPR_NOT_EQUAL, OPR_GREATER_EQUAL,
+					OPR_LESS_EQUAL, OPR_BETWEEN, OPR_IN };
+    unsigned char bitmap[SELECTION_BYTES];
+    TableInfo tableInfo;
+    Condition condition;
+    ConditionNode node[5];
+    Predicate predicate;
+    int kernel, o, numSlot, count;
+
+    /* (name string, id integer)というレコード(名前が先) */
+    memset(&tableInfo, 0, sizeof(tableInfo));
+    tableInfo.numField = 2;
+    strcpy(tableInfo.fieldInfo[0].name, "name");
+    tableInfo.fieldInfo[0].dataType = TYPE_STRING;
+    tableInfo.fieldInfo[0].offset = RECORD_FLAG_SIZE;
+    strcpy(tableInfo.fieldInfo[1].name, "id");
+    tableInfo.fieldInfo[1].dataType = TYPE_INTEGER;
+    tableInfo.fieldInfo[1].offset = RECORD_FLAG_SIZE + MAX_STRING;
+    tableInfo.recordSize = RECORD_FLAG_SIZE + MAX_STRING + sizeof(int);
+    tableInfo.recordsPerPage = PAGE_SIZE / tableInfo.recordSize;
+
+    /* name != 'x' and (id > 5 and id = 3) */
+    memset(node, 0, sizeof(node));
+    node[0].type = CONDITION_AND;
+    node[0].left = &node[1];
+    node[0].right = &node[2];
+    node[1].type = CONDITION_TERM;
+    strcpy(node[1].name, "name");
+    node[1].operator = OPR_NOT_EQUAL;
+    node[1].numValue = 1;
+    strcpy(node[1].stringValues[0], "x");
+    node[2].type = CONDITION_AND;
+    node[2].left = &node[3];
+    node[2].right = &node[4];
+    node[3].type = CONDITION_TERM;
+    strcpy(node[3].name, "id");
+    node[3].operator = OPR_GREATER_THAN;
+    node[3].numValue = 1;
+    node[3].intValues[0] = 5;
+    node[4] = node[3];
+    node[4].operator = OPR_EQUAL;
+    node[4].intValues[0] = 3;
+
+    memset(&condition, 0, sizeof(condition));
+    condition.where = &node[0];
+
+    /* 入れ子のandは1つにまとめ、integer型の=、>、string型の順に並べる */
+    beginStatement();
+    if (compileCondition(&tableInfo, &condition, &predicate) != OK ||
+	predicate.kind != PREDICATE_AND || predicate.numChild != 3 ||
+	predicate.child[0].operator != OPR_EQUAL ||
+	predicate.child[1].operator != OPR_GREATER_THAN ||
+	predicate.child[2].kind != PREDICATE_STRING) {
+	fprintf(stderr, "Conjuncts are not ordered.\n");
+	return NG;
+    }
+    endStatement();
+
+    /* name > 'x' or (id between 1 and 5 and id = 3)のname > 'x'は取り除く */
+    node[0].type = CONDITION_OR;
+    node[1].operator = OPR_GREATER_THAN;
+    node[3].operator = OPR_BETWEEN;
+    node[3].numValue = 2;
+    node[3].intValues[0] = 1;
+    node[3].intValues[1] = 5;
+    beginStatement();
+    if (compileCondition(&tableInfo, &condition, &predicate) != OK ||
+	predicate.kind != PREDICATE_AND || predicate.numChild != 2) {
+	fprintf(stderr, "Constant disjuncts are not removed.\n");
+	return NG;
+    }
+    endStatement();
+
+    /*
+     * id = 3 or (id op 値 and name != '\x01')を、どの命令でも
+     * 1レコードずつ調べた結果と同じように評価する
+     */
+    node[0].type = CONDITION_OR;
+    node[1] = node[4];
+    node[2].type = CONDITION_AND;
+    node[4].type = CONDITION_TERM;
+    strcpy(node[4].name, "name");
+    node[4].operator = OPR_NOT_EQUAL;
+    strcpy(node[4].stringValues[0], "\x01");
+    node[3].numValue = 3;
+    node[3].intValues[0] = -4;
+    node[3].intValues[1] = 4;
+    node[3].intValues[2] = 7;
+    numSlot = makePage(tableInfo.recordSize, tableInfo.fieldInfo[1].offset);
+    for (kernel = PREDICATE_KERNEL_SCALAR; kernel <= PREDICATE_KERNEL_AVX2; kernel++) {
+	if (setPredicateKernel((PredicateKernel) kernel) != OK) {
+	    continue;
+	}
+	for (o = 0; o < sizeof(operators) / sizeof(operators[0]); o++) {
+	    node[3].operator = operators[o];
+	    beginStatement();
+	    if (compileCondition(&tableInfo, &condition, &predicate) != OK) {
+		fprintf(stderr, "Cannot compile condition.\n");
+		return NG;
+	    }
+	    count = filterPage(&predicate, page, tableInfo.recordSize, numSlot, bitmap);
+	    if (checkBitmap(&predicate, tableInfo.recordSize, numSlot, bitmap, count) != OK) {
+		return NG;
+	    }
+	    endStatement();
+	}
+    }
+
+    return OK;
+}
+
+int main(int argc, char **argv)
+{
+    srand(1);
+    initializePredicateModule();
+    fprintf(stderr, "%s: kernel: %s\n", TEST_NAME, getPredicateKernelName());
+
+    /* テストの実行 */
+    fprintf(stderr, "%s: test 1: Start\n", TEST_NAME);
+    if (test1() == OK) {
+	fprintf(stderr, "%s: test 1: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 1: NG\n\n", TEST_NAME);
+    }
+
+    fprintf(stderr, "%s: test 2: Start\n", TEST_NAME);
+    if (test2() == OK) {
+	fprintf(stderr, "%s: test 2: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 2: NG\n\n", TEST_NAME);
+    }
+
+    fprintf(stderr, "%s: test 3: Start\n", TEST_NAME);
+    if (test3() == OK) {
+	fprintf(stderr, "%s: test 3: OK\n\n", TEST_NAME);
+    } else {
+	fprintf(stderr, "%s: test 3: NG\n\n", TEST_NAME);
+    }
+
+    finalizeArena();
+
+    exit(0);
+}